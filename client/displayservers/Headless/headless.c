@@ -0,0 +1,270 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+/*
+ * A display server without a window that has the EGL renderer draw into a
+ * pbuffer on a surfaceless display. Nothing is presented and there is no
+ * input, it exists so the frame and render paths can be benchmarked and
+ * tested without a compositor.
+ */
+
+#include "interface/displayserver.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <EGL/eglext.h>
+
+#include "app.h"
+#include "egl_dynprocs.h"
+#include "eglutil.h"
+#include "common/debug.h"
+#include "common/option.h"
+#include "common/time.h"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static struct
+{
+  int width, height;
+}
+headless;
+
+static void headlessSetup(void)
+{
+  static struct Option options[] =
+  {
+    {
+      .module       = "headless",
+      .name         = "enable",
+      .description  = "Render offscreen without a window, for benchmarks",
+      .type         = OPTION_TYPE_BOOL,
+      .value.x_bool = false,
+    },
+    {0}
+  };
+
+  option_register(options);
+}
+
+static bool headlessProbe(void)
+{
+  return option_get_bool("headless", "enable");
+}
+
+static bool headlessEarlyInit(void)
+{
+  return true;
+}
+
+static bool headlessInit(const LG_DSInitParams params)
+{
+  if (params.opengl)
+  {
+    DEBUG_ERROR("The headless display server only supports the EGL renderer");
+    return false;
+  }
+
+  headless.width  = params.w;
+  headless.height = params.h;
+  DEBUG_INFO("Rendering headless at %dx%d", headless.width, headless.height);
+  return true;
+}
+
+static void headlessStartup(void)
+{
+  app_handleResizeEvent(headless.width, headless.height, 1.0,
+      (struct Border) {0, 0, 0, 0});
+}
+
+static void headlessShutdown(void)
+{
+}
+
+static void headlessFree(void)
+{
+}
+
+static bool headlessGetProp(LG_DSProperty prop, void * ret)
+{
+  if (prop != LG_DS_PBUFFER_SIZE)
+    return false;
+
+  *(LG_DSPbufferSize *)ret = (LG_DSPbufferSize) {
+    .width  = headless.width,
+    .height = headless.height
+  };
+  return true;
+}
+
+#ifdef ENABLE_EGL
+static EGLDisplay headlessGetEGLDisplay(void)
+{
+  const char * early_exts = eglQueryString(NULL, EGL_EXTENSIONS);
+
+  if (util_hasGLExt(early_exts, "EGL_MESA_platform_surfaceless") &&
+      g_egl_dynProcs.eglGetPlatformDisplay)
+  {
+    DEBUG_INFO("Using the surfaceless EGL platform");
+    return g_egl_dynProcs.eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+        EGL_DEFAULT_DISPLAY, NULL);
+  }
+
+  DEBUG_INFO("Using eglGetDisplay");
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static EGLNativeWindowType headlessGetEGLNativeWindow(void)
+{
+  return (EGLNativeWindowType)0;
+}
+
+static bool headlessEGLSwapBuffers(EGLDisplay display, EGLSurface surface,
+    const struct Rect * damage, int count, uint64_t frameToken,
+    uint64_t * swapTime, bool * presentTracked)
+{
+  *presentTracked      = false;
+  const uint64_t start = nanotime();
+
+  // nothing is presented, wait for the GPU so the swap covers its work instead
+  const bool result =
+    eglSwapBuffers(display, surface) && eglWaitClient();
+
+  *swapTime = nanotime() - start;
+  return result;
+}
+#endif
+
+#ifdef ENABLE_OPENGL
+static LG_DSGLContext headlessGLCreateContext(void)
+{
+  return NULL;
+}
+
+static void headlessGLDeleteContext(LG_DSGLContext context)
+{
+}
+
+static void headlessGLMakeCurrent(LG_DSGLContext context)
+{
+}
+
+static void headlessGLSetSwapInterval(int interval)
+{
+}
+
+static void headlessGLSwapBuffers(void)
+{
+}
+#endif
+
+static void headlessGuestPointerUpdated(double x, double y, double localX,
+    double localY)
+{
+}
+
+static void headlessSetPointer(LG_DSPointer pointer)
+{
+}
+
+static void headlessNoop(void)
+{
+}
+
+static bool headlessFalse(void)
+{
+  return false;
+}
+
+static bool headlessGetKeyLabel(int sc, char * label, size_t size)
+{
+  return false;
+}
+
+static void headlessWarpPointer(int x, int y, bool exiting)
+{
+}
+
+static bool headlessIsValidPointerPos(int x, int y)
+{
+  return false;
+}
+
+static void headlessWait(unsigned int time)
+{
+  usleep(time * 1000U);
+}
+
+static void headlessSetWindowSize(int w, int h)
+{
+}
+
+static void headlessSetFullscreen(bool fs)
+{
+}
+
+struct LG_DisplayServerOps LGDS_Headless =
+{
+  .name                = "Headless",
+  .setup               = headlessSetup,
+  .probe               = headlessProbe,
+  .earlyInit           = headlessEarlyInit,
+  .init                = headlessInit,
+  .startup             = headlessStartup,
+  .shutdown            = headlessShutdown,
+  .free                = headlessFree,
+  .getProp             = headlessGetProp,
+#ifdef ENABLE_EGL
+  .getEGLDisplay       = headlessGetEGLDisplay,
+  .getEGLNativeWindow  = headlessGetEGLNativeWindow,
+  .eglSwapBuffers      = headlessEGLSwapBuffers,
+#endif
+#ifdef ENABLE_OPENGL
+  .glCreateContext     = headlessGLCreateContext,
+  .glDeleteContext     = headlessGLDeleteContext,
+  .glMakeCurrent       = headlessGLMakeCurrent,
+  .glSetSwapInterval   = headlessGLSetSwapInterval,
+  .glSwapBuffers       = headlessGLSwapBuffers,
+#endif
+  .guestPointerUpdated = headlessGuestPointerUpdated,
+  .setPointer          = headlessSetPointer,
+  .grabPointer         = headlessNoop,
+  .ungrabPointer       = headlessNoop,
+  .isPointerGrabbed    = headlessFalse,
+  .capturePointer      = headlessNoop,
+  .uncapturePointer    = headlessNoop,
+  .isPointerCaptured   = headlessFalse,
+  .getKeyLabel         = headlessGetKeyLabel,
+  .grabKeyboard        = headlessNoop,
+  .ungrabKeyboard      = headlessNoop,
+  .warpPointer         = headlessWarpPointer,
+  .realignPointer      = headlessNoop,
+  .isValidPointerPos   = headlessIsValidPointerPos,
+  .inhibitIdle         = headlessNoop,
+  .uninhibitIdle       = headlessNoop,
+  .wait                = headlessWait,
+  .setWindowSize       = headlessSetWindowSize,
+  .setFullscreen       = headlessSetFullscreen,
+  .getFullscreen       = headlessFalse,
+  .minimize            = headlessNoop,
+};
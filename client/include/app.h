@@ -109,6 +109,13 @@ bool app_getProp(LG_DSProperty prop, void * ret);
  */
 bool app_getHDRDescFailed(void);
 
+/**
+ * Applies the newest cursor position through onMouseEvent if it has moved
+ * since the render started. Called on the render thread by renderers that
+ * late latch the cursor immediately before drawing it.
+ */
+bool app_latchCursor(void);
+
 #ifdef ENABLE_EGL
 EGLDisplay app_getEGLDisplay(void);
 EGLNativeWindowType app_getEGLNativeWindow(void);
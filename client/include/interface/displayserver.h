@@ -59,6 +59,13 @@ typedef enum LG_DSProperty
    * return data type: LG_DSHDRWhiteLevels
    */
   LG_DS_HDR_WHITE_LEVELS,
+
+  /**
+   * returns the size of the pbuffer the renderer must draw into, only
+   * implemented by display servers without a native window
+   * return data type: LG_DSPbufferSize
+   */
+  LG_DS_PBUFFER_SIZE,
 }
 LG_DSProperty;
 
@@ -69,6 +76,13 @@ typedef struct LG_DSHDRWhiteLevels
 }
 LG_DSHDRWhiteLevels;
 
+typedef struct LG_DSPbufferSize
+{
+  int width;
+  int height;
+}
+LG_DSPbufferSize;
+
 enum LG_DSWarpSupport
 {
   LG_DS_WARP_NONE,
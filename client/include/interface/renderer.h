@@ -89,6 +89,8 @@ typedef struct LG_RendererFormat
   unsigned int      pitch;   // scanline bytes (or compressed size)
   unsigned int      bpp;     // bits per pixel (zero if compressed)
   LG_RendererRotate rotate;  // guest rotation
+  bool              compressed; // the frame data is coded with framecodec
+  size_t            bufferSize; // readable framebuffer bytes when compressed
 
   // HDR static metadata, valid when hdrMetadata is true
   uint16_t hdrDisplayPrimary[3][2];
@@ -133,6 +135,9 @@ typedef struct LG_RendererCapture
 }
 LG_RendererCapture;
 
+/* the most asynchronous captures a renderer may have begun but not released */
+#define LG_RENDERER_MAX_CAPTURES 8
+
 #define LG_RENDERER_FRAME_TOKEN_NONE 0
 
 typedef uint64_t LG_RendererFrameToken;
@@ -149,6 +154,8 @@ typedef struct LG_RendererFrameTiming
   uint64_t              desktopTime; /* desktop work, excluding effects */
   uint64_t              composeTime; /* composition, excluding UI overlay */
   uint64_t              swapTime;    /* actual EGL buffer swap */
+  uint64_t              swapEnd;     /* nanotime the swap returned at */
+  uint64_t              cursorLatchTime; /* late cursor latch to swap done */
   bool                  presentTracked; /* presentation feedback expected */
 }
 LG_RendererFrameTiming;
@@ -289,6 +296,21 @@ typedef struct LG_RendererOps
    * current. The caller owns capture->data and must free it. */
   bool (*capture)(LG_Renderer * renderer, LG_RendererCapture * capture);
 
+  /* Optional asynchronous variant of capture. captureBegin queues a readback
+   * of the composed framebuffer and returns false if every buffer is still
+   * queued or mapped. captureMap fetches the oldest queued capture once its
+   * transfer has completed, blocking for it if wait is set, and returns false
+   * if there is none or it is not ready yet. capture->data points into a
+   * mapping that stays valid, from any thread, until captureRelease unmaps the
+   * oldest mapped capture. Captures are mapped and released in the order they
+   * were begun, and no more than LG_RENDERER_MAX_CAPTURES are ever in flight.
+   * Context: renderThread while the graphics context is current, captureBegin
+   * before swap */
+  bool (*captureBegin)(LG_Renderer * renderer);
+  bool (*captureMap)(LG_Renderer * renderer, bool wait,
+      LG_RendererCapture * capture);
+  void (*captureRelease)(LG_Renderer * renderer);
+
   /* called to create a texture from the specified 32-bit RGB image data. This
    * method is for use with Dear ImGui
    * Context: renderThread */
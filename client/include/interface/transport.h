@@ -196,6 +196,9 @@ typedef struct LG_TransportFrameTiming
    * payload. These do not include status callbacks or renderer import time. */
   uint64_t receiveTime;
   uint64_t prepareTime;
+  /* The benchmark case the frame belongs to, or NULL if it is not measured.
+   * The string must remain valid until the transport is destroyed. */
+  const char * benchCase;
 }
 LG_TransportFrameTiming;
 
@@ -213,6 +216,11 @@ typedef struct LG_TransportFrameFormat
   uint32_t stride;
   uint32_t pitch;
 
+  /* The data is coded with framecodec, bufferSize bounds how much of the
+   * framebuffer the decoder may read. */
+  bool   compressed;
+  size_t bufferSize;
+
   bool hdr;
   bool hdrPQ;
   bool hdrMetadata;
@@ -323,10 +323,41 @@ void egl_desktopConfigUI(EGL_Desktop * desktop)
   }
 }
 
+/* switch the desktop texture over to staged uploads from the framebuffer */
+static bool egl_desktopDisableDMA(EGL_Desktop * desktop)
+{
+  desktop->useDMA = false;
+
+  const char * gl_exts = (const char *)glGetString(GL_EXTENSIONS);
+  if (!util_hasGLExt(gl_exts, "GL_EXT_buffer_storage"))
+  {
+    DEBUG_ERROR("GL_EXT_buffer_storage is needed to use EGL backend");
+    return false;
+  }
+
+  egl_textureFree(&desktop->texture);
+  if (!egl_textureInit(&desktop->texture, desktop->display,
+        EGL_TEXTYPE_FRAMEBUFFER))
+  {
+    DEBUG_ERROR("Failed to initialize the desktop texture");
+    return false;
+  }
+
+  return true;
+}
+
 bool egl_desktopSetup(EGL_Desktop * desktop, const LG_RendererFormat format)
 {
   memcpy(&desktop->format, &format, sizeof(LG_RendererFormat));
 
+  /* compressed frames are decoded on the CPU and can not be imported */
+  if (format.compressed && desktop->useDMA)
+  {
+    DEBUG_INFO("Frames are compressed, disabling DMABUF imports");
+    if (!egl_desktopDisableDMA(desktop))
+      return false;
+  }
+
   enum EGL_PixelFormat pixFmt;
   switch(format.type)
   {
@@ -387,12 +418,13 @@ bool egl_desktopUpdate(EGL_Desktop * desktop, const FrameBuffer * frame,
     void * releaseOpaque, uint64_t releaseHandle)
 {
   /*
-   * Both the DMA and staged upload paths need a complete frame. Do this
-   * before selecting either path so a producer that is still filling an
-   * indirect frame cannot be mistaken for a broken DMA import. Retain the
-   * last image and release a direct frame lease when there is one.
+   * The DMA path needs a complete frame. Do this before attempting the import
+   * so a producer that is still filling an indirect frame cannot be mistaken
+   * for a broken DMA import. Retain the last image and release a direct frame
+   * lease when there is one.
    */
-  if (unlikely(!framebuffer_wait_timed(
+  const bool useDMA = desktop->useDMA && dmaFd >= 0;
+  if (useDMA && unlikely(!framebuffer_wait_timed(
           frame, desktop->texture->format.dataSize, waitTimeNs)))
   {
     if (releaseFn)
@@ -400,7 +432,7 @@ bool egl_desktopUpdate(EGL_Desktop * desktop, const FrameBuffer * frame,
     return true;
   }
 
-  if (likely(desktop->useDMA && dmaFd >= 0))
+  if (likely(useDMA))
   {
     if (likely(egl_textureUpdateFromDMA(
             desktop->texture, frame, frameToken, dmaFd, waitTimeNs,
@@ -419,34 +451,31 @@ bool egl_desktopUpdate(EGL_Desktop * desktop, const FrameBuffer * frame,
       DEBUG_WARN("This is not a bug in Looking Glass");
     }
 
-    desktop->useDMA = false;
-
-    const char * gl_exts = (const char *)glGetString(GL_EXTENSIONS);
-    if (!util_hasGLExt(gl_exts, "GL_EXT_buffer_storage"))
-    {
-      DEBUG_ERROR("GL_EXT_buffer_storage is needed to use EGL backend");
-      return false;
-    }
-
-    egl_textureFree(&desktop->texture);
-    if (!egl_textureInit(&desktop->texture, desktop->display,
-          EGL_TEXTYPE_FRAMEBUFFER))
-    {
-      DEBUG_ERROR("Failed to initialize the desktop texture");
-      return false;
-    }
-
-    if (!egl_desktopSetup(desktop, desktop->format))
+    if (!egl_desktopDisableDMA(desktop) ||
+        !egl_desktopSetup(desktop, desktop->format))
       return false;
   }
 
   /*
+   * The staged upload does not wait for the whole frame, it copies each chunk
+   * into the PBO as soon as the producer's write pointer passes it so our copy
+   * overlaps the producer's.
+   *
    * Streamed textures trigger post-processing when the render context submits
    * the upload. Signalling here can race with that submission and process the
    * previous texture contents instead.
    */
-  if (likely(egl_textureUpdateFromFrame(desktop->texture, frame, frameToken,
-        damageRects, damageRectsCount, waitTimeNs)))
+  bool incomplete = false;
+  const bool updated = egl_textureUpdateFromFrame(desktop->texture, frame,
+      frameToken, damageRects, damageRectsCount,
+      desktop->format.compressed ? desktop->format.bufferSize : 0,
+      waitTimeNs, &incomplete);
+
+  /* a producer that stalled part way through is not an error, the copy waits
+   * on exactly the bytes it needs so a timeout there means the frame was not
+   * written in time. The texture has discarded the partial copy so skip the
+   * frame and retain the last image */
+  if (likely(updated) || incomplete)
   {
     if (releaseFn)
       releaseFn(releaseOpaque, releaseHandle);
@@ -472,6 +501,11 @@ void egl_desktopResize(EGL_Desktop * desktop, int width, int height)
   atomic_store(&desktop->processFrame, true);
 }
 
+unsigned int egl_desktopDamageMargin(EGL_Desktop * desktop)
+{
+  return egl_postProcessDamageMargin(desktop->pp);
+}
+
 bool egl_desktopRender(EGL_Desktop * desktop, unsigned int outputWidth,
     unsigned int outputHeight, const float x, const float y,
     const float scaleX, const float scaleY, enum EGL_DesktopScaleType scaleType,
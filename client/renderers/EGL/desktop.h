@@ -56,6 +56,7 @@ bool egl_desktopUpdate(EGL_Desktop * desktop, const FrameBuffer * frame,
 void egl_desktopRestart(EGL_Desktop * desktop);
 void egl_desktopPoll(EGL_Desktop * desktop);
 void egl_desktopResize(EGL_Desktop * desktop, int width, int height);
+unsigned int egl_desktopDamageMargin(EGL_Desktop * desktop);
 bool egl_desktopRender(EGL_Desktop * desktop, unsigned int outputWidth,
     unsigned int outputHeight, const float x, const float y,
     const float scaleX, const float scaleY, enum EGL_DesktopScaleType scaleType,
@@ -28,6 +28,8 @@
 #include "common/rects.h"
 #include "common/time.h"
 #include "common/locking.h"
+#include "common/paths.h"
+#include "common/stringutils.h"
 #include "app.h"
 #include "util.h"
 
@@ -52,6 +54,7 @@
 #include "hdr_overlay.h"
 #include "hdr_compose.h"
 #include "postprocess.h"
+#include "readback.h"
 #include "util.h"
 
 #define MAX_BUFFER_AGE        3
@@ -75,6 +78,9 @@ struct Inst
   struct Options    opt;
 
   EGLNativeWindowType  nativeWind;
+  LG_DSPbufferSize     pbuffer;
+  bool                 headless;
+  EGLint               pbufferAge;
   EGLDisplay           display;
   EGLConfig            configs;
   EGLSurface           surface;
@@ -85,6 +91,7 @@ struct Inst
   EGL_Damage      * damage;  // the damage display
   EGL_HDROverlay  * hdrOverlay;
   EGL_HDRCompose  * hdrCompose;
+  EGL_Readback    * readback; // asynchronous captures
   bool              imgui;   // if imgui was initialized
 
   LG_RendererFormat    format;
@@ -110,6 +117,7 @@ struct Inst
   float mouseScaleX, mouseScaleY;
   bool  showDamage;
   bool  scalePointer;
+  bool  lateLatchCursor;
 
   struct CursorState cursorLast;
 
@@ -217,6 +225,20 @@ static struct Option egl_options[] =
     .type         = OPTION_TYPE_BOOL,
     .value.x_bool = true
   },
+  {
+    .module       = "egl",
+    .name         = "shaderCache",
+    .description  = "Keep linked shader programs on disk to speed up startup",
+    .type         = OPTION_TYPE_BOOL,
+    .value.x_bool = true
+  },
+  {
+    .module       = "egl",
+    .name         = "lateLatchCursor",
+    .description  = "Sample the newest cursor position just before drawing it",
+    .type         = OPTION_TYPE_BOOL,
+    .value.x_bool = false
+  },
   {
     .module       = "egl",
     .name         = "mapHDRtoSDR",
@@ -315,6 +337,8 @@ static void egl_deinitialize(LG_Renderer * renderer)
   egl_damageFree (&this->damage);
   egl_hdrOverlayFree(&this->hdrOverlay);
   egl_hdrComposeFree(&this->hdrCompose);
+  egl_readbackFree(&this->readback);
+  egl_shaderCacheFree();
 
   LG_LOCK_FREE(this->lock);
   LG_LOCK_FREE(this->desktopDamageLock);
@@ -982,8 +1006,10 @@ static bool egl_renderStartup(LG_Renderer * renderer, bool useDMA)
 {
   struct Inst * this = UPCAST(struct Inst, renderer);
 
+  // display servers without a window have us render into a pbuffer
+  this->headless   = app_getProp(LG_DS_PBUFFER_SIZE, &this->pbuffer);
   this->nativeWind = app_getEGLNativeWindow();
-  if (!this->nativeWind)
+  if (!this->nativeWind && !this->headless)
   {
     DEBUG_ERROR("Failed to get EGL native window");
     return false;
@@ -1062,6 +1088,8 @@ static bool egl_renderStartup(LG_Renderer * renderer, bool useDMA)
     if (hasFloatConfigs)
       EGL_CONFIG_ATTR(EGL_COLOR_COMPONENT_TYPE_EXT, configs[i].componentType);
     EGL_CONFIG_ATTR(EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT);
+    if (this->headless)
+      EGL_CONFIG_ATTR(EGL_SURFACE_TYPE , EGL_PBUFFER_BIT);
     EGL_CONFIG_ATTR(EGL_SAMPLE_BUFFERS , maxSamples > 0 ? 1 : 0);
     EGL_CONFIG_ATTR(EGL_SAMPLES        , maxSamples);
     attr[ai] = EGL_NONE;
@@ -1095,7 +1123,27 @@ static bool egl_renderStartup(LG_Renderer * renderer, bool useDMA)
     EGL_NONE
   };
 
-  this->surface = eglCreateWindowSurface(this->display, this->configs, this->nativeWind, surfattr);
+  if (this->headless)
+  {
+    const EGLint pbufattr[] =
+    {
+      EGL_WIDTH , this->pbuffer.width,
+      EGL_HEIGHT, this->pbuffer.height,
+      EGL_NONE
+    };
+
+    this->surface = eglCreatePbufferSurface(this->display, this->configs,
+        pbufattr);
+    if (this->surface == EGL_NO_SURFACE)
+    {
+      DEBUG_ERROR("Failed to create EGL pbuffer (eglError: 0x%x)",
+          eglGetError());
+      return false;
+    }
+  }
+  else
+    this->surface = eglCreateWindowSurface(this->display, this->configs, this->nativeWind, surfattr);
+
   if (this->surface == EGL_NO_SURFACE)
   {
     // On Nvidia proprietary drivers on Wayland, specifying EGL_RENDER_BUFFER can cause
@@ -1202,6 +1250,19 @@ static bool egl_renderStartup(LG_Renderer * renderer, bool useDMA)
     return false;
   }
 
+  if (option_get_bool("egl", "shaderCache"))
+  {
+    char * cacheDir;
+    if (alloc_sprintf(&cacheDir, "%s/shader-cache", lgConfigDir()) < 0)
+      DEBUG_ERROR("Out of memory");
+    else
+    {
+      if (egl_shaderCacheInit(cacheDir))
+        DEBUG_INFO("Shader cache: %s", cacheDir);
+      free(cacheDir);
+    }
+  }
+
   if (this->surfaceSupportsPQ &&
       !util_hasGLExt(gl_exts, "GL_EXT_color_buffer_half_float") &&
       !util_hasGLExt(gl_exts, "GL_EXT_color_buffer_float"))
@@ -1211,7 +1272,8 @@ static bool egl_renderStartup(LG_Renderer * renderer, bool useDMA)
     this->surfaceSupportsPQ = false;
   }
 
-  this->hasBufferAge = util_hasGLExt(client_exts, "EGL_EXT_buffer_age");
+  this->hasBufferAge = this->headless ||
+    util_hasGLExt(client_exts, "EGL_EXT_buffer_age");
   if (!this->hasBufferAge)
     DEBUG_WARN("GL_EXT_buffer_age is not supported, will not perform as well.");
 
@@ -1225,7 +1287,8 @@ static bool egl_renderStartup(LG_Renderer * renderer, bool useDMA)
   if (this->noSwapDamage)
     DEBUG_WARN("egl:noSwapDamage specified, disabling swap buffers with damage.");
 
-  this->scalePointer = option_get_bool("egl", "scalePointer");
+  this->scalePointer    = option_get_bool("egl", "scalePointer");
+  this->lateLatchCursor = option_get_bool("egl", "lateLatchCursor");
 
   if (!g_egl_dynProcs.glEGLImageTargetTexture2DOES)
     DEBUG_INFO("glEGLImageTargetTexture2DOES unavilable, DMA support disabled");
@@ -1286,6 +1349,12 @@ static bool egl_renderStartup(LG_Renderer * renderer, bool useDMA)
     return false;
   }
 
+  if (!egl_readbackInit(&this->readback))
+  {
+    DEBUG_ERROR("Failed to initialize the readback buffers");
+    return false;
+  }
+
   if (!egl_hdrOverlayInit(&this->hdrOverlay))
   {
     DEBUG_ERROR("Failed to initialize the HDR overlay");
@@ -1318,6 +1387,10 @@ inline static EGLint egl_bufferAge(struct Inst * this)
   if (!this->hasBufferAge)
     return 0;
 
+  // a pbuffer is never swapped, it holds whatever was last drawn into it
+  if (this->headless)
+    return this->pbufferAge;
+
   EGLint result;
   if (eglQuerySurface(this->display, this->surface, EGL_BUFFER_AGE_EXT, &result) == EGL_FALSE)
   {
@@ -1333,14 +1406,17 @@ static FrameDamageRect egl_expandDesktopDamage(
   int width, height;
   egl_getDesktopSize(this, &width, &height);
 
-  const uint32_t x = rect->x > DESKTOP_DAMAGE_MARGIN ?
-    rect->x - DESKTOP_DAMAGE_MARGIN : 0;
-  const uint32_t y = rect->y > DESKTOP_DAMAGE_MARGIN ?
-    rect->y - DESKTOP_DAMAGE_MARGIN : 0;
+  /* the post-processing filters also rebuild the pixels around the damage
+   * that sample it */
+  const uint32_t margin =
+    DESKTOP_DAMAGE_MARGIN + egl_desktopDamageMargin(this->desktop);
+
+  const uint32_t x = rect->x > margin ? rect->x - margin : 0;
+  const uint32_t y = rect->y > margin ? rect->y - margin : 0;
   const uint32_t right = (uint32_t)min((uint64_t)width,
-    (uint64_t)rect->x + rect->width + DESKTOP_DAMAGE_MARGIN);
+    (uint64_t)rect->x + rect->width + margin);
   const uint32_t bottom = (uint32_t)min((uint64_t)height,
-    (uint64_t)rect->y + rect->height + DESKTOP_DAMAGE_MARGIN);
+    (uint64_t)rect->y + rect->height + margin);
 
   return (FrameDamageRect) {
     .x      = x,
@@ -1629,10 +1705,19 @@ static bool egl_render(LG_Renderer * renderer, LG_RendererRotate rotate,
   timing->frameToken = frameConsumed ?
     frameToken : LG_RENDERER_FRAME_TOKEN_NONE;
 
+  uint64_t latchTime = 0;
   if (haveDesktop)
   {
     if (desktopRendered)
     {
+      /* pick up any cursor movement since the render started, after the
+       * desktop and effects so the position is as fresh as possible */
+      if (this->lateLatchCursor)
+      {
+        app_latchCursor();
+        latchTime = nanotime();
+      }
+
       cursorState = egl_cursorRender(this->cursor,
           ((this->showSwSurface ? LG_ROTATE_0 : this->format.rotate) + rotate) %
             LG_ROTATE_MAX,
@@ -1789,36 +1874,43 @@ static bool egl_render(LG_Renderer * renderer, LG_RendererRotate rotate,
       this->display, this->surface, damage,
       this->noSwapDamage ? 0 : damageIdx, timing->frameToken,
       &timing->swapTime, &timing->presentTracked);
+  timing->swapEnd = nanotime();
 
   if (!swapResult)
     DEBUG_ERROR("Failed to swap EGL buffers (eglError: 0x%x)", eglGetError());
+  else
+  {
+    if (latchTime)
+      timing->cursorLatchTime = nanotime() - latchTime;
+    if (this->headless)
+      this->pbufferAge = 1;
+  }
 
   return swapResult;
 }
 
-static bool egl_capture(LG_Renderer * renderer, LG_RendererCapture * capture)
+static bool egl_captureDescribe(struct Inst * this,
+    LG_RendererCapture * capture, GLenum * dataType)
 {
-  struct Inst * this = UPCAST(struct Inst, renderer);
-  if (!capture || this->width <= 0 || this->height <= 0)
+  if (this->width <= 0 || this->height <= 0)
     return false;
 
   size_t bytesPerPixel;
-  GLenum dataType;
   switch (this->captureFormat)
   {
     case LG_CAPTURE_RGBA8:
       bytesPerPixel = 4;
-      dataType      = GL_UNSIGNED_BYTE;
+      *dataType     = GL_UNSIGNED_BYTE;
       break;
 
     case LG_CAPTURE_RGB10_A2:
       bytesPerPixel = 4;
-      dataType      = GL_UNSIGNED_INT_2_10_10_10_REV;
+      *dataType     = GL_UNSIGNED_INT_2_10_10_10_REV;
       break;
 
     case LG_CAPTURE_RGBA32F:
       bytesPerPixel = sizeof(float) * 4;
-      dataType      = GL_FLOAT;
+      *dataType     = GL_FLOAT;
       break;
 
     default:
@@ -1830,9 +1922,28 @@ static bool egl_capture(LG_Renderer * renderer, LG_RendererCapture * capture)
         SIZE_MAX / ((size_t)this->width * bytesPerPixel))
     return false;
 
-  const size_t stride   = (size_t)this->width * bytesPerPixel;
-  const size_t dataSize = stride * this->height;
-  void * data = malloc(dataSize);
+  const size_t stride = (size_t)this->width * bytesPerPixel;
+  *capture = (LG_RendererCapture) {
+    .width     = this->width,
+    .height    = this->height,
+    .stride    = stride,
+    .dataSize  = stride * this->height,
+    .format    = this->captureFormat,
+    .hdr       = this->format.hdr,
+    .hdrPQ     = this->format.hdrPQ,
+    .nativeHDR = this->nativeHDR,
+  };
+  return true;
+}
+
+static bool egl_capture(LG_Renderer * renderer, LG_RendererCapture * capture)
+{
+  struct Inst * this = UPCAST(struct Inst, renderer);
+  GLenum dataType;
+  if (!capture || !egl_captureDescribe(this, capture, &dataType))
+    return false;
+
+  void * data = malloc(capture->dataSize);
   if (!data)
     return false;
 
@@ -1847,20 +1958,34 @@ static bool egl_capture(LG_Renderer * renderer, LG_RendererCapture * capture)
     return false;
   }
 
-  *capture = (LG_RendererCapture) {
-    .width     = this->width,
-    .height    = this->height,
-    .stride    = stride,
-    .dataSize  = dataSize,
-    .format    = this->captureFormat,
-    .hdr       = this->format.hdr,
-    .hdrPQ     = this->format.hdrPQ,
-    .nativeHDR = this->nativeHDR,
-    .data      = data,
-  };
+  capture->data = data;
   return true;
 }
 
+static bool egl_captureBegin(LG_Renderer * renderer)
+{
+  struct Inst * this = UPCAST(struct Inst, renderer);
+  LG_RendererCapture desc;
+  GLenum dataType;
+  if (!egl_captureDescribe(this, &desc, &dataType))
+    return false;
+
+  return egl_readbackBegin(this->readback, &desc, dataType);
+}
+
+static bool egl_captureMap(LG_Renderer * renderer, bool wait,
+    LG_RendererCapture * capture)
+{
+  struct Inst * this = UPCAST(struct Inst, renderer);
+  return egl_readbackMap(this->readback, wait, capture);
+}
+
+static void egl_captureRelease(LG_Renderer * renderer)
+{
+  struct Inst * this = UPCAST(struct Inst, renderer);
+  egl_readbackRelease(this->readback);
+}
+
 static void * egl_createTexture(LG_Renderer * renderer,
   int width, int height, uint8_t * data)
 {
@@ -1984,6 +2109,9 @@ struct LG_RendererOps LGR_EGL =
   .renderStartup         = egl_renderStartup,
   .render                = egl_render,
   .capture               = egl_capture,
+  .captureBegin          = egl_captureBegin,
+  .captureMap            = egl_captureMap,
+  .captureRelease        = egl_captureRelease,
   .createTexture         = egl_createTexture,
   .freeTexture           = egl_freeTexture,
 
@@ -38,6 +38,18 @@ typedef struct EGL_FilterRects
 }
 EGL_FilterRects;
 
+/* a pointwise stage fused into the filter that follows it */
+typedef struct EGL_FilterFuse
+{
+  /* the fuseSource of the stage */
+  const char * source;
+  /* the output size of the stage */
+  unsigned int width, height;
+  /* the input of the stage, now bound to the filter, is a DMA texture */
+  bool useDMA;
+}
+EGL_FilterFuse;
+
 typedef struct EGL_Filter EGL_Filter;
 /* Takes ownership of filter when it returns true. */
 typedef bool (*EGL_FilterAddFn)(void * opaque, EGL_Filter * filter);
@@ -56,6 +68,11 @@ typedef struct EGL_FilterOps
   /* disable partial rendering and swap damage while this filter is active */
   bool fullFrame;
 
+  /* the radius in input pixels this filter samples around each output pixel,
+   * the damage is grown by it so the output is rebuilt wherever the input
+   * changed */
+  unsigned int footprint;
+
   /* early initialization for registration of options */
   void (*earlyInit)(void);
 
@@ -107,6 +124,25 @@ typedef struct EGL_FilterOps
   /* called when the filter output is no loger needed so it can release memory
    * this is optional */
   void (*release)(EGL_Filter * filter);
+
+  /* returns a single line of GLSL defining `vec4 fuseFetch(ivec2 pos)` that
+   * computes the output texel at pos from the input bound to sampler1, so the
+   * next filter can run on this filter's input and its pass is skipped.
+   * this is optional and only for pointwise filters, NULL if not fusable */
+  const char * (*fuseSource)(EGL_Filter * filter);
+
+  /* read the input through the stage in fuse instead of the texture, or the
+   * texture again if fuse is NULL. Called after prepare on every active
+   * filter that has it each time the chain is configured, so a program that
+   * depends on the input can be compiled here rather than in setup.
+   * false if the stage can't be fused in.
+   * this is optional and only for filters that read texels by position */
+  bool (*fuseInput)(EGL_Filter * filter, const EGL_FilterFuse * fuse);
+
+  /* returns true if setup needs to run again without the chain changing,
+   * such as when the filter has finished loading in the background.
+   * this is optional */
+  bool (*changed)(EGL_Filter * filter);
 }
 EGL_FilterOps;
 
@@ -194,3 +230,25 @@ static inline void egl_filterRelease(EGL_Filter * filter)
   if (filter->ops.release)
     filter->ops.release(filter);
 }
+
+static inline const char * egl_filterFuseSource(EGL_Filter * filter)
+{
+  if (filter->ops.fuseSource)
+    return filter->ops.fuseSource(filter);
+  return NULL;
+}
+
+static inline bool egl_filterFuseInput(EGL_Filter * filter,
+    const EGL_FilterFuse * fuse)
+{
+  if (filter->ops.fuseInput)
+    return filter->ops.fuseInput(filter, fuse);
+  return !fuse;
+}
+
+static inline bool egl_filterChanged(EGL_Filter * filter)
+{
+  if (filter->ops.changed)
+    return filter->ops.changed(filter);
+  return false;
+}
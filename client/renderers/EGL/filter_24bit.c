@@ -187,11 +187,30 @@ static EGL_Texture * egl_filter24bitRun(EGL_Filter * filter,
   return egl_effectRun(this->effect, rects, texture);
 }
 
+/* the unpack of convert_24bit.frag, the output swizzle is its own inverse */
+#define FUSE_24BIT(swizzle) \
+  "vec4 fuseFetch(ivec2 p) { " \
+    "uint x = uint(p.x); uint i = x % 4u; " \
+    "vec4 c0 = texelFetch(sampler1, ivec2( x * 3u       / 4u, p.y), 0); " \
+    "vec4 c1 = texelFetch(sampler1, ivec2((x * 3u + 1u) / 4u, p.y), 0); " \
+    "vec4 c2 = texelFetch(sampler1, ivec2((x * 3u + 2u) / 4u, p.y), 0); " \
+    "return vec4(c0.barg[i], c1.gbar[i], c2.rgba[i], 1.0)." swizzle "; }"
+
+static const char * egl_filter24bitFuseSource(EGL_Filter * filter)
+{
+  EGL_Filter24bit * this = UPCAST(EGL_Filter24bit, filter);
+
+  static const char bgr[] = FUSE_24BIT("bgra");
+  static const char rgb[] = FUSE_24BIT("rgba");
+  return this->format == EGL_PF_BGR_32 ? bgr : rgb;
+}
+
 EGL_FilterOps egl_filter24bitOps =
 {
   .id           = "24bit",
   .name         = "24bit",
   .type         = EGL_FILTER_TYPE_INTERNAL,
+  .footprint    = 1,
   .earlyInit    = NULL,
   .init         = egl_filter24bitInit,
   .free         = egl_filter24bitFree,
@@ -201,5 +220,6 @@ EGL_FilterOps egl_filter24bitOps =
   .setup        = egl_filter24bitSetup,
   .getOutputRes = egl_filter24bitGetOutputRes,
   .prepare      = egl_filter24bitPrepare,
-  .run          = egl_filter24bitRun
+  .run          = egl_filter24bitRun,
+  .fuseSource   = egl_filter24bitFuseSource
 };
@@ -55,6 +55,7 @@ typedef struct EGL_FilterDownscale
   bool         enable;
   EGL_Shader * nearest;
   EGL_Uniform * uNearest;
+  EGL_Uniform * uFuseSize;
   EGL_Shader * linear;
   EGL_Shader * lanczos2;
   EGL_Effect * effect;
@@ -62,6 +63,10 @@ typedef struct EGL_FilterDownscale
 
   DownscaleFilter filter;
   int useDMA;
+  EGL_FilterFuse fuse;
+  bool nearestCompiled;
+  const char * nearestSource;
+  bool nearestDMA;
   enum EGL_PixelFormat pixFmt;
   unsigned int width, height;
   float pixelSize;
@@ -189,7 +194,8 @@ static bool egl_filterDownscaleInit(EGL_Filter ** filter)
     goto error_effect;
   }
 
-  this->uNearest = egl_shaderGetUniform(this->nearest, "uConfig");
+  this->uNearest  = egl_shaderGetUniform(this->nearest, "uConfig");
+  this->uFuseSize = egl_shaderGetUniform(this->nearest, "uFuseSize");
 
   egl_filterDownscaleLoadState(&this->base);
 
@@ -295,6 +301,37 @@ static bool egl_filterDownscaleImguiConfig(EGL_Filter * filter)
   return redraw;
 }
 
+static bool nearestCompile(EGL_FilterDownscale * this)
+{
+  const bool useDMA = this->fuse.source ? this->fuse.useDMA : this->useDMA;
+  if (this->nearestCompiled &&
+      this->nearestSource == this->fuse.source &&
+      this->nearestDMA    == useDMA)
+    return true;
+
+  const EGL_ShaderDefine defines[] =
+  {
+    { "FUSE_SOURCE", this->fuse.source },
+    { 0 }
+  };
+
+  this->nearestCompiled = false;
+  if (!egl_shaderCompile(this->nearest,
+        b_shader_basic_vert    , b_shader_basic_vert_size,
+        b_shader_downscale_frag, b_shader_downscale_frag_size,
+        useDMA, this->fuse.source ? defines : NULL)
+     )
+  {
+    DEBUG_ERROR("Failed to compile the shader");
+    return false;
+  }
+
+  this->nearestCompiled = true;
+  this->nearestSource   = this->fuse.source;
+  this->nearestDMA      = useDMA;
+  return true;
+}
+
 static bool egl_filterDownscaleSetup(EGL_Filter * filter,
     enum EGL_PixelFormat pixFmt, unsigned int width, unsigned int height,
     unsigned int desktopWidth, unsigned int desktopHeight,
@@ -310,17 +347,6 @@ static bool egl_filterDownscaleSetup(EGL_Filter * filter,
 
   if (this->useDMA != useDMA)
   {
-    if (!egl_shaderCompile(this->nearest,
-          b_shader_basic_vert    , b_shader_basic_vert_size,
-          b_shader_downscale_frag,
-          b_shader_downscale_frag_size,
-          useDMA, NULL)
-       )
-    {
-      DEBUG_ERROR("Failed to compile the shader");
-      return false;
-    }
-
     if (!egl_shaderCompile(this->linear,
           b_shader_basic_vert, b_shader_basic_vert_size,
           b_shader_downscale_linear_frag,
@@ -346,6 +372,9 @@ static bool egl_filterDownscaleSetup(EGL_Filter * filter,
     this->useDMA = useDMA;
   }
 
+  // the nearest program is compiled by fuseInput once the chain knows if the
+  // input is fused
+
   if (this->prepared               &&
       pixFmt       == this->pixFmt &&
       this->width  == width        &&
@@ -418,11 +447,33 @@ static EGL_Texture * egl_filterDownscaleRun(EGL_Filter * filter,
   return egl_effectRun(this->effect, rects, texture);
 }
 
+static bool egl_filterDownscaleFuseInput(EGL_Filter * filter,
+    const EGL_FilterFuse * fuse)
+{
+  EGL_FilterDownscale * this = UPCAST(EGL_FilterDownscale, filter);
+
+  // the other filters sample between texels
+  if (fuse && this->filter != DOWNSCALE_NEAREST)
+    return false;
+
+  this->fuse = fuse ? *fuse : (EGL_FilterFuse) {};
+  if (!nearestCompile(this))
+  {
+    this->fuse = (EGL_FilterFuse) {};
+    return false;
+  }
+
+  if (fuse)
+    egl_uniform2f(this->uFuseSize, fuse->width, fuse->height);
+  return true;
+}
+
 EGL_FilterOps egl_filterDownscaleOps =
 {
   .id           = "downscale",
   .name         = "Downscaler",
   .type         = EGL_FILTER_TYPE_DOWNSCALE,
+  .footprint    = 1,
   .earlyInit    = egl_filterDownscaleEarlyInit,
   .init         = egl_filterDownscaleInit,
   .free         = egl_filterDownscaleFree,
@@ -432,5 +483,6 @@ EGL_FilterOps egl_filterDownscaleOps =
   .setup        = egl_filterDownscaleSetup,
   .getOutputRes = egl_filterDownscaleGetOutputRes,
   .prepare      = egl_filterDownscalePrepare,
-  .run          = egl_filterDownscaleRun
+  .run          = egl_filterDownscaleRun,
+  .fuseInput    = egl_filterDownscaleFuseInput
 };
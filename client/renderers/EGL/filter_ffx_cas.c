@@ -38,11 +38,16 @@ typedef struct EGL_FilterFFXCAS
   EGL_Shader     * shader;
   EGL_Uniform    * uConsts;
   EGL_Uniform    * uHDRScale;
+  EGL_Uniform    * uFuseSize;
   EGL_Effect     * effect;
   EGL_EffectPass * pass;
   bool             enable;
 
   int useDMA;
+  EGL_FilterFuse fuse;
+  bool compiled;
+  const char * compiledSource;
+  bool compiledDMA;
   enum EGL_PixelFormat pixFmt;
   unsigned int width, height;
   float sharpness;
@@ -137,6 +142,7 @@ static bool egl_filterFFXCASInit(EGL_Filter ** filter)
 
   this->uConsts   = egl_shaderGetUniform(this->shader, "uConsts"  );
   this->uHDRScale = egl_shaderGetUniform(this->shader, "uHDRScale");
+  this->uFuseSize = egl_shaderGetUniform(this->shader, "uFuseSize");
   egl_filterFFXCASLoadState(&this->base);
 
   *filter = &this->base;
@@ -208,6 +214,37 @@ static bool egl_filterFFXCASImguiConfig(EGL_Filter * filter)
   return redraw;
 }
 
+static bool casCompile(EGL_FilterFFXCAS * this)
+{
+  const bool useDMA = this->fuse.source ? this->fuse.useDMA : this->useDMA;
+  if (this->compiled &&
+      this->compiledSource == this->fuse.source &&
+      this->compiledDMA    == useDMA)
+    return true;
+
+  const EGL_ShaderDefine defines[] =
+  {
+    { "FUSE_SOURCE", this->fuse.source },
+    { 0 }
+  };
+
+  this->compiled = false;
+  if (!egl_shaderCompile(this->shader,
+        b_shader_basic_vert  , b_shader_basic_vert_size,
+        b_shader_ffx_cas_frag, b_shader_ffx_cas_frag_size,
+        useDMA, this->fuse.source ? defines : NULL)
+     )
+  {
+    DEBUG_ERROR("Failed to compile the shader");
+    return false;
+  }
+
+  this->compiled       = true;
+  this->compiledSource = this->fuse.source;
+  this->compiledDMA    = useDMA;
+  return true;
+}
+
 static bool egl_filterFFXCASSetup(EGL_Filter * filter,
     enum EGL_PixelFormat pixFmt, unsigned int width, unsigned int height,
     unsigned int desktopWidth, unsigned int desktopHeight,
@@ -218,20 +255,9 @@ static bool egl_filterFFXCASSetup(EGL_Filter * filter,
   if (!this->enable)
     return false;
 
-  if (this->useDMA != useDMA)
-  {
-    if (!egl_shaderCompile(this->shader,
-          b_shader_basic_vert  , b_shader_basic_vert_size,
-          b_shader_ffx_cas_frag, b_shader_ffx_cas_frag_size,
-          useDMA, NULL)
-       )
-    {
-      DEBUG_ERROR("Failed to compile the shader");
-      return false;
-    }
-
-    this->useDMA = useDMA;
-  }
+  /* compiled by fuseInput once the chain knows if the input is fused, which
+   * the chain always calls after setup, so each reconfigure compiles once */
+  this->useDMA = useDMA;
 
   if (pixFmt == this->pixFmt && this->width == width && this->height == height)
     return true;
@@ -281,11 +307,29 @@ static EGL_Texture * egl_filterFFXCASRun(EGL_Filter * filter,
   return egl_effectRun(this->effect, rects, texture);
 }
 
+static bool egl_filterFFXCASFuseInput(EGL_Filter * filter,
+    const EGL_FilterFuse * fuse)
+{
+  EGL_FilterFFXCAS * this = UPCAST(EGL_FilterFFXCAS, filter);
+
+  this->fuse = fuse ? *fuse : (EGL_FilterFuse) {};
+  if (!casCompile(this))
+  {
+    this->fuse = (EGL_FilterFuse) {};
+    return false;
+  }
+
+  if (fuse)
+    egl_uniform2f(this->uFuseSize, fuse->width, fuse->height);
+  return true;
+}
+
 EGL_FilterOps egl_filterFFXCASOps =
 {
   .id           = "ffxCAS",
   .name         = "AMD FidelityFX CAS",
   .type         = EGL_FILTER_TYPE_EFFECT,
+  .footprint    = 1,
   .earlyInit    = egl_filterFFXCASEarlyInit,
   .init         = egl_filterFFXCASInit,
   .free         = egl_filterFFXCASFree,
@@ -295,5 +339,6 @@ EGL_FilterOps egl_filterFFXCASOps =
   .setup        = egl_filterFFXCASSetup,
   .getOutputRes = egl_filterFFXCASGetOutputRes,
   .prepare      = egl_filterFFXCASPrepare,
-  .run          = egl_filterFFXCASRun
+  .run          = egl_filterFFXCASRun,
+  .fuseInput    = egl_filterFFXCASFuseInput
 };
@@ -402,6 +402,7 @@ EGL_FilterOps egl_filterFFXFSR1Ops =
   .id               = "ffxFSR1",
   .name             = "AMD FidelityFX FSR",
   .type             = EGL_FILTER_TYPE_UPSCALE,
+  .footprint        = 3, // EASU 12-tap, then RCAS on the output
   .earlyInit        = egl_filterFFXFSR1EarlyInit,
   .init             = egl_filterFFXFSR1Init,
   .free             = egl_filterFFXFSR1Free,
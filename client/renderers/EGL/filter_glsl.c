@@ -21,13 +21,18 @@
 #define _GNU_SOURCE
 #include "filter.h"
 #include "effect.h"
+#include "glsl_expr.h"
 #include "app.h"
 
+#include "common/array.h"
 #include "common/debug.h"
+#include "common/event.h"
+#include "common/locking.h"
 #include "common/option.h"
 #include "common/paths.h"
 #include "common/stringlist.h"
 #include "common/stringutils.h"
+#include "common/thread.h"
 #include "common/time.h"
 #include "cimgui.h"
 #include "util.h"
@@ -37,10 +42,10 @@
 #include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
-#include <float.h>
 #include <limits.h>
 #include <math.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -49,7 +54,6 @@
 #include <sys/stat.h>
 
 #define GLSL_MAX_TEXTURES 16
-#define GLSL_EXPR_STACK   128
 
 typedef struct GLSLInput
 {
@@ -64,9 +68,10 @@ typedef struct GLSLPass
   char * desc;
   char * hook;
   char * save;
-  char * widthExpr;
-  char * heightExpr;
-  char * whenExpr;
+  unsigned int saveIndex; // the slot SAVE is kept in during setup
+  EGL_GLSLExpr * width;
+  EGL_GLSLExpr * height;
+  EGL_GLSLExpr * when;
   char * body;
 
   char ** binds;
@@ -102,8 +107,22 @@ typedef struct EGL_FilterGLSL
   unsigned int passCount;
   EGL_Effect * effect;
 
+  /* set by the loader thread once the file has been parsed */
+  _Atomic(bool) loaded;
+  _Atomic(bool) loadChanged;
+
   bool enable;
   bool active;
+
+  /* the inputs setup last ran with, it only runs again if they change */
+  bool setupValid;
+  struct
+  {
+    unsigned int width, height;
+    unsigned int targetWidth, targetHeight;
+    bool useDMA;
+  }
+  setupKey;
   EGL_PixelFormat outputFormat;
   unsigned int inputWidth, inputHeight;
   unsigned int targetWidth, targetHeight;
@@ -143,6 +162,17 @@ StringBuffer;
 
 static EGL_FilterGLSL * g_filters;
 static char * g_shaderPath;
+static LGThread * g_loader;
+static atomic_bool g_loaderStop;
+
+/* guards g_filters against the loader thread, which never holds it while
+ * parsing, g_loading is the filter it is parsing and g_loadDone is signalled
+ * each time it finishes one. These live from the first create until the last
+ * filter is freed. */
+static bool g_initialized;
+static LG_Lock g_filtersLock;
+static EGL_FilterGLSL * g_loading;
+static LGEvent * g_loadDone;
 
 static void glslFree(EGL_Filter * filter);
 
@@ -362,6 +392,25 @@ static bool setDirective(char ** output, const char * start, const char * end)
   return *output != NULL;
 }
 
+static bool setExpression(EGL_FilterGLSL * filter, GLSLPass * pass,
+    EGL_GLSLExpr ** output, const char * directive,
+    const char * start, const char * end)
+{
+  if (*output)
+    return false;
+
+  char * text = trimDuplicate(start, end);
+  if (!text)
+    return false;
+
+  const bool result = egl_glslExprCompile(output, text);
+  free(text);
+  if (!result)
+    setError(&filter->error, "Invalid %s expression in pass '%s'", directive,
+        pass->desc);
+  return result;
+}
+
 static bool parseDirective(EGL_FilterGLSL * filter, GLSLPass * pass,
     const char * start, const char * end)
 {
@@ -381,11 +430,11 @@ static bool parseDirective(EGL_FilterGLSL * filter, GLSLPass * pass,
   if (KEY("SAVE"))
     return setDirective(&pass->save, value, end);
   if (KEY("WIDTH"))
-    return setDirective(&pass->widthExpr, value, end);
+    return setExpression(filter, pass, &pass->width, "WIDTH", value, end);
   if (KEY("HEIGHT"))
-    return setDirective(&pass->heightExpr, value, end);
+    return setExpression(filter, pass, &pass->height, "HEIGHT", value, end);
   if (KEY("WHEN"))
-    return setDirective(&pass->whenExpr, value, end);
+    return setExpression(filter, pass, &pass->when, "WHEN", value, end);
   if (KEY("COMPONENTS"))
   {
     char * text = trimDuplicate(value, end);
@@ -407,9 +456,9 @@ static void freePass(GLSLPass * pass)
   free(pass->desc);
   free(pass->hook);
   free(pass->save);
-  free(pass->widthExpr);
-  free(pass->heightExpr);
-  free(pass->whenExpr);
+  egl_glslExprFree(&pass->width);
+  egl_glslExprFree(&pass->height);
+  egl_glslExprFree(&pass->when);
   free(pass->body);
   for (unsigned int i = 0; i < pass->bindCount; ++i)
     free(pass->binds[i]);
@@ -420,6 +469,57 @@ static void freePass(GLSLPass * pass)
   egl_shaderFree(&pass->shader);
 }
 
+/* saved textures are kept in the slot of the first pass that saves them */
+static int savedIndex(void * opaque, const char * name)
+{
+  const EGL_FilterGLSL * filter = opaque;
+  if (!strcmp(name, "MAIN") || !strcmp(name, "HOOKED"))
+    return -1;
+
+  for (unsigned int i = 0; i < filter->passCount; ++i)
+    if (filter->passes[i].save && !strcmp(filter->passes[i].save, name))
+      return i;
+  return -1;
+}
+
+static bool resolveSaved(EGL_FilterGLSL * filter)
+{
+  for (unsigned int i = 0; i < filter->passCount; ++i)
+  {
+    GLSLPass * pass = filter->passes + i;
+    if (pass->save)
+    {
+      const int index = savedIndex(filter, pass->save);
+      pass->saveIndex = index < 0 ? i : (unsigned int)index;
+    }
+
+    const struct
+    {
+      const char * directive;
+      EGL_GLSLExpr * expr;
+    }
+    exprs[] =
+    {
+      { "WIDTH" , pass->width  },
+      { "HEIGHT", pass->height },
+      { "WHEN"  , pass->when   },
+    };
+
+    for (unsigned int j = 0; j < ARRAY_LENGTH(exprs); ++j)
+    {
+      const char * unknown;
+      if (exprs[j].expr &&
+          !egl_glslExprResolve(exprs[j].expr, savedIndex, filter, &unknown))
+      {
+        setError(&filter->error, "%s expression in pass '%s' reads unknown "
+            "texture '%s'", exprs[j].directive, pass->desc, unknown);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
 static bool parseFile(EGL_FilterGLSL * filter)
 {
   char * source;
@@ -430,9 +530,6 @@ static bool parseFile(EGL_FilterGLSL * filter)
     return false;
   }
 
-  if (!egl_effectInit(&filter->effect))
-    goto fail;
-
   const char * sourceEnd = source + length;
   const char * marker = nextDescription(source, sourceEnd);
   while (marker)
@@ -509,8 +606,7 @@ static bool parseFile(EGL_FilterGLSL * filter)
     pass->external = calloc(pass->bindCount, sizeof(*pass->external));
     pass->uTextureInfo = calloc(pass->bindCount, sizeof(*pass->uTextureInfo));
     if (!pass->body || !pass->inputs || !pass->external ||
-        !pass->uTextureInfo || !egl_shaderInit(&pass->shader) ||
-        !egl_effectAddPass(filter->effect, pass->shader, &pass->effectPass))
+        !pass->uTextureInfo)
       goto fail;
 
     marker = blockEnd < sourceEnd ? blockEnd : NULL;
@@ -522,7 +618,7 @@ static bool parseFile(EGL_FilterGLSL * filter)
     setError(&filter->error, "No GLSL hook passes found");
     return false;
   }
-  return true;
+  return resolveSaved(filter);
 
 fail:
   free(source);
@@ -531,6 +627,31 @@ fail:
   return false;
 }
 
+/* the effect and its passes need the GL context, create them once the file
+ * has been loaded */
+static bool createObjects(EGL_FilterGLSL * filter)
+{
+  if (filter->effect)
+    return true;
+
+  if (!egl_effectInit(&filter->effect))
+    return false;
+
+  for (unsigned int i = 0; i < filter->passCount; ++i)
+  {
+    GLSLPass * pass = filter->passes + i;
+    if (!egl_shaderInit(&pass->shader) ||
+        !egl_effectAddPass(filter->effect, pass->shader, &pass->effectPass))
+    {
+      for (unsigned int j = 0; j <= i; ++j)
+        egl_shaderFree(&filter->passes[j].shader);
+      egl_effectFree(&filter->effect);
+      return false;
+    }
+  }
+  return true;
+}
+
 static const GLSLResource * findResource(const GLSLContext * context,
     const char * name)
 {
@@ -539,7 +660,7 @@ static const GLSLResource * findResource(const GLSLContext * context,
   if (!strcmp(name, "NATIVE") || !strcmp(name, "NATIVE_CROPPED"))
     return context->original;
   for (unsigned int i = 0; i < context->savedCount; ++i)
-    if (!strcmp(context->saved[i].name, name))
+    if (context->saved[i].name && !strcmp(context->saved[i].name, name))
       return context->saved + i;
   return NULL;
 }
@@ -553,135 +674,44 @@ static bool savedBefore(const EGL_FilterGLSL * filter,
   return false;
 }
 
-static bool expressionValue(const GLSLContext * context, const char * token,
-    double * value)
+static bool expressionSize(void * opaque, EGL_GLSLExprSource source,
+    unsigned int index, unsigned int * width, unsigned int * height)
 {
-  char * end;
-  errno = 0;
-  const double number = strtod(token, &end);
-  if (!errno && *token && !*end)
+  const GLSLContext * context = opaque;
+  const GLSLResource * resource;
+  switch(source)
   {
-    *value = number;
-    return true;
-  }
+    case EGL_GLSL_EXPR_OUTPUT:
+      *width  = context->targetWidth;
+      *height = context->targetHeight;
+      return true;
 
-  char * name = lg_strdup(token);
-  if (!name)
-    return false;
-  char * component = strrchr(name, '.');
-  if (!component)
-  {
-    free(name);
-    return false;
-  }
-  *component++ = '\0';
+    case EGL_GLSL_EXPR_MAIN:
+      resource = context->current;
+      break;
 
-  unsigned int width, height;
-  if (!strcmp(name, "OUTPUT"))
-  {
-    width = context->targetWidth;
-    height = context->targetHeight;
-  }
-  else
-  {
-    const GLSLResource * resource = findResource(context, name);
-    if (!resource)
-    {
-      free(name);
-      return false;
-    }
-    width = resource->width;
-    height = resource->height;
-  }
+    case EGL_GLSL_EXPR_NATIVE:
+      resource = context->original;
+      break;
 
-  if (!strcmp(component, "w") || !strcmp(component, "width"))
-    *value = width;
-  else if (!strcmp(component, "h") || !strcmp(component, "height"))
-    *value = height;
-  else
-  {
-    free(name);
-    return false;
+    default:
+      // not saved yet by this point in the chain
+      if (index >= context->savedCount || !context->saved[index].name)
+        return false;
+      resource = context->saved + index;
+      break;
   }
-  free(name);
-  return true;
-}
 
-static bool expressionValueFinite(double value)
-{
-  _Static_assert(sizeof(double) == sizeof(uint64_t) &&
-      DBL_MANT_DIG == 53 && DBL_MAX_EXP == 1024,
-      "GLSL expressions require IEEE-754 binary64 doubles");
-
-  /* isfinite() is not valid with -ffinite-math-only under Clang. Inspect the
-   * binary64 exponent directly so expression overflow can still be rejected. */
-  uint64_t bits;
-  memcpy(&bits, &value, sizeof(bits));
-  return (bits & UINT64_C(0x7ff0000000000000)) !=
-    UINT64_C(0x7ff0000000000000);
+  *width  = resource->width;
+  *height = resource->height;
+  return true;
 }
 
 static bool evaluateExpression(const GLSLContext * context,
-    const char * expression, double fallback, double * result)
+    const EGL_GLSLExpr * expr, double fallback, double * result)
 {
-  if (!expression)
-  {
-    *result = fallback;
-    return true;
-  }
-
-  char * copy = lg_strdup(expression);
-  if (!copy)
-    return false;
-
-  double stack[GLSL_EXPR_STACK];
-  unsigned int count = 0;
-  char * state;
-  for (char * token = strtok_r(copy, " \t\r\n", &state); token;
-       token = strtok_r(NULL, " \t\r\n", &state))
-  {
-    if (!strcmp(token, "!"))
-    {
-      if (!count)
-        goto fail;
-      stack[count - 1] = !stack[count - 1];
-      continue;
-    }
-
-    if (strlen(token) == 1 && strchr("+-*/><=%", *token))
-    {
-      if (count < 2)
-        goto fail;
-      const double right = stack[--count];
-      double * left = &stack[count - 1];
-      switch(*token)
-      {
-        case '+': *left += right; break;
-        case '-': *left -= right; break;
-        case '*': *left *= right; break;
-        case '/': if (right == 0.0) goto fail; *left /= right; break;
-        case '>': *left = *left > right; break;
-        case '<': *left = *left < right; break;
-        case '=': *left = *left == right; break;
-        case '%': if (right == 0.0) goto fail; *left = fmod(*left, right); break;
-      }
-      continue;
-    }
-
-    if (count == GLSL_EXPR_STACK ||
-        !expressionValue(context, token, &stack[count++]))
-      goto fail;
-  }
-
-  if (count != 1 || !expressionValueFinite(stack[0]))
-    goto fail;
-  *result = stack[0];
-  free(copy);
-  return true;
-
-fail:
-  free(copy);
-  return false;
+  return egl_glslExprEval(expr, fallback, expressionSize, (void *)context,
+      result);
 }
 
 static bool hasBind(const GLSLPass * pass, const char * name)
@@ -805,23 +835,11 @@ oom:
   return false;
 }
 
-static bool updateSaved(GLSLResource * saved, unsigned int * count,
-    const GLSLResource * resource)
-{
-  for (unsigned int i = 0; i < *count; ++i)
-    if (!strcmp(saved[i].name, resource->name))
-    {
-      saved[i] = *resource;
-      return true;
-    }
-  saved[(*count)++] = *resource;
-  return true;
-}
-
 static void glslLoadState(EGL_Filter * filter)
 {
   EGL_FilterGLSL * this = UPCAST(EGL_FilterGLSL, filter);
-  this->enable = enabledInOption(this->base.ops.id);
+  this->enable     = enabledInOption(this->base.ops.id);
+  this->setupValid = false;
 }
 
 static void glslSaveState(EGL_Filter * filter)
@@ -835,24 +853,36 @@ static bool glslImguiConfig(EGL_Filter * filter)
   bool enable = this->enable;
   igCheckbox("Enabled", &enable);
   igTextWrapped("%s", this->path);
-  igText("Passes: %u", this->passCount);
-
-  if (this->error)
-    igTextWrapped("Load error: %s", this->error);
-  else if (this->runtimeError)
-    igTextWrapped("Runtime error: %s", this->runtimeError);
-  else if (this->active)
-    igText("Resolution: %ux%u -> %ux%u", this->inputWidth,
-        this->inputHeight, this->outputWidth, this->outputHeight);
+
+  if (!atomic_load(&this->loaded))
+    igText("Loading...");
   else
-    igText("Inactive");
+  {
+    igText("Passes: %u", this->passCount);
+    if (this->error)
+      igTextWrapped("Load error: %s", this->error);
+    else if (this->runtimeError)
+      igTextWrapped("Runtime error: %s", this->runtimeError);
+    else if (this->active)
+      igText("Resolution: %ux%u -> %ux%u", this->inputWidth,
+          this->inputHeight, this->outputWidth, this->outputHeight);
+    else
+      igText("Inactive");
+  }
 
   if (enable == this->enable)
     return false;
-  this->enable = enable;
+  this->enable     = enable;
+  this->setupValid = false;
   return true;
 }
 
+static bool glslChanged(EGL_Filter * filter)
+{
+  EGL_FilterGLSL * this = UPCAST(EGL_FilterGLSL, filter);
+  return atomic_exchange(&this->loadChanged, false) && this->enable;
+}
+
 static void glslSetOutputResHint(EGL_Filter * filter,
     unsigned int width, unsigned int height)
 {
@@ -866,15 +896,31 @@ static bool glslSetup(EGL_Filter * filter, EGL_PixelFormat pixFmt,
     unsigned int desktopWidth, unsigned int desktopHeight, bool useDMA)
 {
   EGL_FilterGLSL * this = UPCAST(EGL_FilterGLSL, filter);
+  if (this->setupValid &&
+      this->setupKey.width        == width              &&
+      this->setupKey.height       == height             &&
+      this->setupKey.targetWidth  == this->targetWidth  &&
+      this->setupKey.targetHeight == this->targetHeight &&
+      this->setupKey.useDMA       == useDMA)
+    return this->active;
+
+  this->setupValid = false;
   this->active = false;
   this->outputTexture = NULL;
   free(this->runtimeError);
   this->runtimeError = NULL;
+
+  if (!this->enable || !atomic_load(&this->loaded) || this->error)
+    return false;
+
   for (unsigned int i = 0; i < this->passCount; ++i)
     this->passes[i].active = false;
 
-  if (!this->enable || this->error)
+  if (!createObjects(this))
+  {
+    setError(&this->runtimeError, "Out of memory creating the passes");
     return false;
+  }
 
   GLSLResource original = {
     .name = "NATIVE", .width = width, .height = height,
@@ -882,10 +928,10 @@ static bool glslSetup(EGL_Filter * filter, EGL_PixelFormat pixFmt,
   };
   GLSLResource current = original;
   current.name = "MAIN";
+  // indexed by GLSLPass.saveIndex, unset slots have no name
   GLSLResource * saved = calloc(this->passCount, sizeof(*saved));
   if (!saved)
     return false;
-  unsigned int savedCount = 0;
   bool mainChanged = false;
 
   for (unsigned int passIndex = 0; passIndex < this->passCount; ++passIndex)
@@ -895,7 +941,7 @@ static bool glslSetup(EGL_Filter * filter, EGL_PixelFormat pixFmt,
       .original = &original,
       .current = &current,
       .saved = saved,
-      .savedCount = savedCount,
+      .savedCount = this->passCount,
       .targetWidth = this->targetWidth,
       .targetHeight = this->targetHeight,
     };
@@ -923,7 +969,7 @@ static bool glslSetup(EGL_Filter * filter, EGL_PixelFormat pixFmt,
       continue;
 
     double condition;
-    if (!evaluateExpression(&context, pass->whenExpr, 1.0, &condition))
+    if (!evaluateExpression(&context, pass->when, 1.0, &condition))
     {
       setError(&this->runtimeError, "Invalid WHEN expression in pass: %s",
           pass->desc);
@@ -933,9 +979,9 @@ static bool glslSetup(EGL_Filter * filter, EGL_PixelFormat pixFmt,
       continue;
 
     double outputWidth, outputHeight;
-    if (!evaluateExpression(&context, pass->widthExpr,
+    if (!evaluateExpression(&context, pass->width,
           current.width, &outputWidth) ||
-        !evaluateExpression(&context, pass->heightExpr,
+        !evaluateExpression(&context, pass->height,
           current.height, &outputHeight) ||
         outputWidth < 1.0 || outputHeight < 1.0 ||
         outputWidth > UINT_MAX || outputHeight > UINT_MAX)
@@ -982,10 +1028,16 @@ static bool glslSetup(EGL_Filter * filter, EGL_PixelFormat pixFmt,
       mainChanged = true;
     }
     else
-      updateSaved(saved, &savedCount, &output);
+      saved[pass->saveIndex] = output;
   }
 
   free(saved);
+  this->setupValid = true;
+  this->setupKey.width        = width;
+  this->setupKey.height       = height;
+  this->setupKey.targetWidth  = this->targetWidth;
+  this->setupKey.targetHeight = this->targetHeight;
+  this->setupKey.useDMA       = useDMA;
   if (!mainChanged)
     return false;
 
@@ -1058,6 +1110,7 @@ static EGL_FilterOps glslOps =
   .getOutputRes     = glslGetOutputRes,
   .prepare          = glslPrepare,
   .run              = glslRun,
+  .changed          = glslChanged,
 };
 
 static bool createFilter(const char * root, const char * relative,
@@ -1082,10 +1135,11 @@ static bool createFilter(const char * root, const char * relative,
     *extension = '\0';
   app_registerImGuiText(this->base.ops.name);
 
-  parseFile(this);
   this->enable = enabledInOption(this->base.ops.id);
+  LG_LOCK(g_filtersLock);
   this->next = g_filters;
   g_filters = this;
+  LG_UNLOCK(g_filtersLock);
   *result = &this->base;
   return true;
 
@@ -1094,14 +1148,75 @@ fail:
   return false;
 }
 
+static void stopLoader(void)
+{
+  if (!g_loader)
+    return;
+
+  atomic_store(&g_loaderStop, true);
+  lgJoinThread(g_loader, NULL);
+  g_loader = NULL;
+}
+
+static bool globalsInit(void)
+{
+  if (g_initialized)
+    return true;
+
+  g_loadDone = lgCreateEvent(true, 0);
+  if (!g_loadDone)
+  {
+    DEBUG_ERROR("Failed to create the GLSL loader event");
+    return false;
+  }
+
+  LG_LOCK_INIT(g_filtersLock);
+  g_initialized = true;
+  return true;
+}
+
+static void globalsFree(void)
+{
+  if (!g_initialized)
+    return;
+
+  stopLoader();
+  lgFreeEvent(g_loadDone);
+  g_loadDone = NULL;
+  LG_LOCK_FREE(g_filtersLock);
+  g_initialized = false;
+}
+
 static void glslFree(EGL_Filter * filter)
 {
   EGL_FilterGLSL * this = UPCAST(EGL_FilterGLSL, filter);
-  EGL_FilterGLSL ** link = &g_filters;
-  while (*link && *link != this)
-    link = &(*link)->next;
-  if (*link)
-    *link = this->next;
+
+  /* the loader keeps going for the other filters, only wait for it if it is
+   * parsing this one */
+  bool last = false;
+  if (g_initialized)
+  {
+    LG_LOCK(g_filtersLock);
+    while (g_loading == this)
+    {
+      LG_UNLOCK(g_filtersLock);
+      lgWaitEvent(g_loadDone, TIMEOUT_INFINITE);
+      LG_LOCK(g_filtersLock);
+    }
+
+    EGL_FilterGLSL ** link = &g_filters;
+    while (*link && *link != this)
+      link = &(*link)->next;
+    if (*link)
+    {
+      *link = this->next;
+      last  = !g_filters;
+    }
+    LG_UNLOCK(g_filtersLock);
+  }
+
+  if (last)
+    globalsFree();
 
   for (unsigned int i = 0; i < this->passCount; ++i)
     freePass(this->passes + i);
@@ -1206,8 +1321,48 @@ static int comparePaths(const void * left, const void * right)
   return strcmp(*(const char * const *)left, *(const char * const *)right);
 }
 
+/* reads and parses the shader files so a large pack doesn't stall the render
+ * thread, each filter stays inactive until its file has been loaded */
+static int loaderThread(void * opaque)
+{
+  while (!atomic_load(&g_loaderStop))
+  {
+    /* filters may be freed while this runs, so find the next one to load
+     * under the lock and claim it */
+    LG_LOCK(g_filtersLock);
+    EGL_FilterGLSL * filter = g_filters;
+    while (filter && atomic_load(&filter->loaded))
+      filter = filter->next;
+    g_loading = filter;
+    LG_UNLOCK(g_filtersLock);
+
+    if (!filter)
+      break;
+
+    if (parseFile(filter))
+      DEBUG_INFO("Loaded runtime GLSL filter: %s", filter->relative);
+    else
+      DEBUG_ERROR("Failed to load runtime GLSL filter %s: %s",
+          filter->relative, filter->error);
+
+    atomic_store(&filter->loaded, true);
+    atomic_store(&filter->loadChanged, true);
+
+    LG_LOCK(g_filtersLock);
+    g_loading = NULL;
+    LG_UNLOCK(g_filtersLock);
+    lgSignalEvent(g_loadDone);
+    app_invalidateWindow(false);
+  }
+  return 0;
+}
+
 static bool glslCreate(EGL_FilterAddFn add, void * opaque)
 {
+  stopLoader();
+  if (!globalsInit())
+    return false;
+
   const char * configured = option_get_string("eglFilter", "glslPath");
   free(g_shaderPath);
   g_shaderPath = NULL;
@@ -1262,11 +1417,22 @@ static bool glslCreate(EGL_FilterAddFn add, void * opaque)
       result = false;
       break;
     }
-    DEBUG_INFO("Loaded runtime GLSL filter: %s", sorted[i]);
   }
 
   free(sorted);
   stringlist_free(&files);
+
+  if (!g_filters)
+    globalsFree();
+  else if (result)
+  {
+    atomic_store(&g_loaderStop, false);
+    if (!lgCreateThread("GLSLLoader", loaderThread, NULL, &g_loader))
+    {
+      DEBUG_ERROR("Failed to create the GLSL loader thread");
+      return false;
+    }
+  }
   return result;
 }
 
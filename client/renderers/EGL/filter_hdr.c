@@ -157,6 +157,17 @@ static EGL_Texture * egl_filterHDRRun(EGL_Filter * filter,
   return egl_effectRun(this->effect, rects, texture);
 }
 
+static const char * egl_filterHDRFuseSource(EGL_Filter * filter)
+{
+  (void)filter;
+
+  /* hdr_decode.frag, the reading filter includes hdr.h */
+  return
+    "vec4 fuseFetch(ivec2 p) { "
+      "vec4 pq = texelFetch(sampler1, p, 0); "
+      "return vec4(bt2020to709(pq2lin(pq.rgb, 1.0)) * 125.0, pq.a); }";
+}
+
 EGL_FilterOps egl_filterHDRDecodeOps =
 {
   .id           = "hdrDecode",
@@ -167,5 +178,6 @@ EGL_FilterOps egl_filterHDRDecodeOps =
   .setup        = egl_filterHDRSetup,
   .getOutputRes = egl_filterHDRGetOutputRes,
   .prepare      = egl_filterHDRPrepare,
-  .run          = egl_filterHDRRun
+  .run          = egl_filterHDRRun,
+  .fuseSource   = egl_filterHDRFuseSource
 };
@@ -0,0 +1,331 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "glsl_expr.h"
+
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum GLSLExprOp
+{
+  GLSL_OP_CONST,
+  GLSL_OP_WIDTH,
+  GLSL_OP_HEIGHT,
+  GLSL_OP_NOT,
+  GLSL_OP_ADD,
+  GLSL_OP_SUB,
+  GLSL_OP_MUL,
+  GLSL_OP_DIV,
+  GLSL_OP_GT,
+  GLSL_OP_LT,
+  GLSL_OP_EQ,
+  GLSL_OP_MOD
+};
+
+#define GLSL_EXPR_UNRESOLVED UINT_MAX
+
+typedef struct GLSLExprInstr
+{
+  enum GLSLExprOp op;
+  union
+  {
+    double value;
+    struct
+    {
+      EGL_GLSLExprSource source;
+      unsigned int index; // GLSL_EXPR_UNRESOLVED until resolved
+      const char * name;
+    };
+  };
+}
+GLSLExprInstr;
+
+struct EGL_GLSLExpr
+{
+  // the tokenized expression, saved texture names point into it
+  char * names;
+  unsigned int count;
+  GLSLExprInstr code[];
+};
+
+static bool exprFinite(double value)
+{
+  _Static_assert(sizeof(double) == sizeof(uint64_t) &&
+      DBL_MANT_DIG == 53 && DBL_MAX_EXP == 1024,
+      "GLSL expressions require IEEE-754 binary64 doubles");
+
+  /* isfinite() is not valid with -ffinite-math-only under Clang. Inspect the
+   * binary64 exponent directly so expression overflow can still be rejected. */
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return (bits & UINT64_C(0x7ff0000000000000)) !=
+    UINT64_C(0x7ff0000000000000);
+}
+
+/* apply a binary operator, false on division by zero */
+static bool exprApply(enum GLSLExprOp op, double * left, double right)
+{
+  switch(op)
+  {
+    case GLSL_OP_ADD: *left += right; break;
+    case GLSL_OP_SUB: *left -= right; break;
+    case GLSL_OP_MUL: *left *= right; break;
+    case GLSL_OP_DIV: if (right == 0.0) return false; *left /= right; break;
+    case GLSL_OP_GT : *left = *left > right; break;
+    case GLSL_OP_LT : *left = *left < right; break;
+    case GLSL_OP_EQ : *left = *left == right; break;
+    case GLSL_OP_MOD: if (right == 0.0) return false;
+                      *left = fmod(*left, right); break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+static bool exprOperand(GLSLExprInstr * instr, char * token)
+{
+  char * end;
+  errno = 0;
+  const double number = strtod(token, &end);
+  if (!errno && *token && !*end)
+  {
+    instr->op    = GLSL_OP_CONST;
+    instr->value = number;
+    return true;
+  }
+
+  char * component = strrchr(token, '.');
+  if (!component)
+    return false;
+  *component++ = '\0';
+
+  if (!strcmp(component, "w") || !strcmp(component, "width"))
+    instr->op = GLSL_OP_WIDTH;
+  else if (!strcmp(component, "h") || !strcmp(component, "height"))
+    instr->op = GLSL_OP_HEIGHT;
+  else
+    return false;
+
+  instr->name  = NULL;
+  instr->index = GLSL_EXPR_UNRESOLVED;
+  if (!strcmp(token, "OUTPUT"))
+    instr->source = EGL_GLSL_EXPR_OUTPUT;
+  else if (!strcmp(token, "MAIN") || !strcmp(token, "HOOKED"))
+    instr->source = EGL_GLSL_EXPR_MAIN;
+  else if (!strcmp(token, "NATIVE") || !strcmp(token, "NATIVE_CROPPED"))
+    instr->source = EGL_GLSL_EXPR_NATIVE;
+  else
+  {
+    instr->source = EGL_GLSL_EXPR_SAVED;
+    instr->name   = token;
+  }
+  return true;
+}
+
+bool egl_glslExprCompile(EGL_GLSLExpr ** expr, const char * expression)
+{
+  *expr = NULL;
+
+  // every token is at least one character and a separator
+  const size_t length   = strlen(expression);
+  const size_t maxCount = length / 2 + 1;
+  EGL_GLSLExpr * this = calloc(1,
+      sizeof(*this) + maxCount * sizeof(*this->code));
+  if (!this)
+    return false;
+
+  this->names = malloc(length + 1);
+  if (!this->names)
+    goto fail;
+  memcpy(this->names, expression, length + 1);
+
+  unsigned int depth = 0;
+  char * state;
+  for (char * token = strtok_r(this->names, " \t\r\n", &state); token;
+       token = strtok_r(NULL, " \t\r\n", &state))
+  {
+    GLSLExprInstr * instr = this->code + this->count;
+    GLSLExprInstr * last  = this->count ? instr - 1 : NULL;
+
+    if (!strcmp(token, "!"))
+    {
+      if (!depth)
+        goto fail;
+
+      if (last->op == GLSL_OP_CONST)
+        last->value = !last->value;
+      else
+      {
+        instr->op = GLSL_OP_NOT;
+        ++this->count;
+      }
+      continue;
+    }
+
+    if (strlen(token) == 1 && strchr("+-*/><=%", *token))
+    {
+      if (depth < 2)
+        goto fail;
+      --depth;
+
+      switch(*token)
+      {
+        case '+': instr->op = GLSL_OP_ADD; break;
+        case '-': instr->op = GLSL_OP_SUB; break;
+        case '*': instr->op = GLSL_OP_MUL; break;
+        case '/': instr->op = GLSL_OP_DIV; break;
+        case '>': instr->op = GLSL_OP_GT ; break;
+        case '<': instr->op = GLSL_OP_LT ; break;
+        case '=': instr->op = GLSL_OP_EQ ; break;
+        case '%': instr->op = GLSL_OP_MOD; break;
+      }
+
+      // both operands are constants, division by zero is left to fail when
+      // the expression is evaluated
+      if (last[ 0].op == GLSL_OP_CONST &&
+          last[-1].op == GLSL_OP_CONST)
+      {
+        double value = last[-1].value;
+        if (exprApply(instr->op, &value, last->value))
+        {
+          last[-1].value = value;
+          --this->count;
+          continue;
+        }
+      }
+
+      ++this->count;
+      continue;
+    }
+
+    if (depth == EGL_GLSL_EXPR_STACK || !exprOperand(instr, token))
+      goto fail;
+
+    ++depth;
+    ++this->count;
+  }
+
+  if (depth != 1)
+    goto fail;
+
+  *expr = this;
+  return true;
+
+fail:
+  free(this->names);
+  free(this);
+  return false;
+}
+
+void egl_glslExprFree(EGL_GLSLExpr ** expr)
+{
+  if (!*expr)
+    return;
+
+  free((*expr)->names);
+  free(*expr);
+  *expr = NULL;
+}
+
+bool egl_glslExprResolve(EGL_GLSLExpr * expr, EGL_GLSLExprResolveFn resolveFn,
+    void * opaque, const char ** unknown)
+{
+  for (unsigned int i = 0; i < expr->count; ++i)
+  {
+    GLSLExprInstr * instr = expr->code + i;
+    if ((instr->op != GLSL_OP_WIDTH && instr->op != GLSL_OP_HEIGHT) ||
+        instr->source != EGL_GLSL_EXPR_SAVED)
+      continue;
+
+    const int index = resolveFn(opaque, instr->name);
+    if (index < 0)
+    {
+      *unknown = instr->name;
+      return false;
+    }
+    instr->index = index;
+  }
+  return true;
+}
+
+bool egl_glslExprConstant(const EGL_GLSLExpr * expr, double * value)
+{
+  if (expr->count != 1 || expr->code[0].op != GLSL_OP_CONST)
+    return false;
+
+  *value = expr->code[0].value;
+  return true;
+}
+
+bool egl_glslExprEval(const EGL_GLSLExpr * expr, double fallback,
+    EGL_GLSLExprSizeFn sizeFn, void * opaque, double * result)
+{
+  if (!expr)
+  {
+    *result = fallback;
+    return true;
+  }
+
+  double stack[EGL_GLSL_EXPR_STACK];
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < expr->count; ++i)
+  {
+    const GLSLExprInstr * instr = expr->code + i;
+    switch(instr->op)
+    {
+      case GLSL_OP_CONST:
+        stack[count++] = instr->value;
+        break;
+
+      case GLSL_OP_WIDTH:
+      case GLSL_OP_HEIGHT:
+      {
+        unsigned int width, height;
+        if ((instr->source == EGL_GLSL_EXPR_SAVED &&
+              instr->index == GLSL_EXPR_UNRESOLVED) ||
+            !sizeFn(opaque, instr->source, instr->index, &width, &height))
+          return false;
+        stack[count++] = instr->op == GLSL_OP_WIDTH ? width : height;
+        break;
+      }
+
+      case GLSL_OP_NOT:
+        stack[count - 1] = !stack[count - 1];
+        break;
+
+      default:
+        --count;
+        if (!exprApply(instr->op, &stack[count - 1], stack[count]))
+          return false;
+        break;
+    }
+  }
+
+  if (!exprFinite(stack[0]))
+    return false;
+
+  *result = stack[0];
+  return true;
+}
@@ -0,0 +1,73 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+/*
+ * The WIDTH, HEIGHT and WHEN expressions of mpv style GLSL hooks. These are in
+ * reverse polish notation and are compiled once when the shader is loaded into
+ * a list of instructions for a small stack machine, folding any constant
+ * sub-expressions as they are found. Saved texture names are resolved to
+ * indices once the whole shader is known, so evaluation does no string
+ * handling.
+ */
+
+#define EGL_GLSL_EXPR_STACK 128
+
+typedef struct EGL_GLSLExpr EGL_GLSLExpr;
+
+typedef enum EGL_GLSLExprSource
+{
+  EGL_GLSL_EXPR_OUTPUT, // the size of the output target
+  EGL_GLSL_EXPR_MAIN,   // MAIN or HOOKED
+  EGL_GLSL_EXPR_NATIVE, // NATIVE or NATIVE_CROPPED
+  EGL_GLSL_EXPR_SAVED   // a texture saved by an earlier pass
+}
+EGL_GLSLExprSource;
+
+/* returns the index of the saved texture `name`, or -1 if there is none */
+typedef int (*EGL_GLSLExprResolveFn)(void * opaque, const char * name);
+
+/* returns false if the texture does not exist, index is only set for
+ * EGL_GLSL_EXPR_SAVED and is the one given by the EGL_GLSLExprResolveFn */
+typedef bool (*EGL_GLSLExprSizeFn)(void * opaque, EGL_GLSLExprSource source,
+    unsigned int index, unsigned int * width, unsigned int * height);
+
+/* returns false if the expression is invalid */
+bool egl_glslExprCompile(EGL_GLSLExpr ** expr, const char * expression);
+void egl_glslExprFree(EGL_GLSLExpr ** expr);
+
+/**
+ * Resolve the saved texture names of expr with resolveFn, an expression that
+ * reads a saved texture fails to evaluate until this has succeeded. Returns
+ * false and sets unknown to the first name that did not resolve, it remains
+ * valid until the expression is freed.
+ */
+bool egl_glslExprResolve(EGL_GLSLExpr * expr, EGL_GLSLExprResolveFn resolveFn,
+    void * opaque, const char ** unknown);
+
+/* returns true and sets value if the expression reads no texture sizes */
+bool egl_glslExprConstant(const EGL_GLSLExpr * expr, double * value);
+
+/* evaluate expr, or return fallback if expr is NULL */
+bool egl_glslExprEval(const EGL_GLSLExpr * expr, double fallback,
+    EGL_GLSLExprSizeFn sizeFn, void * opaque, double * result);
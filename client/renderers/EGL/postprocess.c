@@ -21,6 +21,7 @@
 #define _GNU_SOURCE
 #include "postprocess.h"
 #include "filters.h"
+#include "texture_util.h"
 #include "app.h"
 #include "cimgui.h"
 
@@ -70,9 +71,21 @@ struct EGL_PostProcess
     unsigned int outputX, outputY;
     bool outputHDRPQ;
     bool fullFrame;
+    unsigned int damageMargin;
   }
   config;
 
+  bool fullRun;
+
+  bool fuse;
+  struct
+  {
+    unsigned int passes; // passes run by the chain
+    unsigned int fused;  // passes skipped by fusing them into the next one
+    size_t       bytes;  // intermediate writes and reads skipped per frame
+  }
+  fuseStats;
+
   EGL_DesktopRects * rects;
   GLfloat matrix[6];
 
@@ -101,6 +114,13 @@ void egl_postProcessEarlyInit(void)
       .description    = "The initial filter preset to load",
       .type           = OPTION_TYPE_STRING
     },
+    {
+      .module         = "egl",
+      .name           = "fuseFilters",
+      .description    = "Fuse pointwise filter stages into the next filter",
+      .type           = OPTION_TYPE_BOOL,
+      .value.x_bool   = true
+    },
     { 0 }
   };
   option_register(options);
@@ -490,6 +510,18 @@ static void configUI(void * opaque, int * id)
   redraw |= presetsUI(this);
   igSeparator();
 
+  if (this->config.valid)
+  {
+    igText("Passes: %u", this->fuseStats.passes);
+    if (this->fuseStats.fused)
+    {
+      igSameLine(0.0f, -1.0f);
+      igText("(%u fused, %.1f MiB per frame saved)", this->fuseStats.fused,
+          this->fuseStats.bytes / 1048576.0);
+    }
+    igSeparator();
+  }
+
   static size_t mouseIdx = -1;
   static bool   moving   = false;
   static size_t moveIdx  = 0;
@@ -615,6 +647,7 @@ bool egl_postProcessInit(EGL_PostProcess ** pp)
     goto error_hdr;
   }
 
+  this->fuse = option_get_bool("egl", "fuseFilters");
   loadPresetList(this);
   reorderFilters(this);
   app_overlayConfigRegisterTab("EGL Filters", configUI, this);
@@ -718,12 +751,103 @@ void egl_postProcessInvalidate(EGL_PostProcess * this)
 
 bool egl_postProcessConfigModified(EGL_PostProcess * this)
 {
+  EGL_Filter * filter;
+  vector_forEach(filter, &this->filters)
+    if (egl_filterChanged(filter))
+      egl_postProcessInvalidate(this);
+
   return atomic_load_explicit(&this->modified, memory_order_acquire);
 }
 
 bool egl_postProcessNeedsFullFrame(EGL_PostProcess * this)
 {
-  return this->config.valid && this->config.fullFrame;
+  return this->config.valid && this->fullRun;
+}
+
+unsigned int egl_postProcessDamageMargin(EGL_PostProcess * this)
+{
+  return this->config.valid ? this->config.damageMargin : 0;
+}
+
+/* grow the margin by the filter footprint, converted from the filter input
+ * pixels to desktop pixels */
+static unsigned int footprintMargin(const EGL_Filter * filter,
+    unsigned int inputX, unsigned int inputY,
+    int desktopWidth, int desktopHeight)
+{
+  const unsigned int footprint = filter->ops.footprint;
+  if (!footprint || !inputX || !inputY)
+    return 0;
+
+  const unsigned int x =
+    (footprint * desktopWidth  + inputX - 1) / inputX;
+  const unsigned int y =
+    (footprint * desktopHeight + inputY - 1) / inputY;
+
+  // a scaled input also rounds the sample positions
+  const bool scaled = inputX != (unsigned)desktopWidth ||
+    inputY != (unsigned)desktopHeight;
+  return max(x, y) + (scaled ? 1 : 0);
+}
+
+/* skip the pass of each pointwise filter the next filter can read through,
+ * see fuseSource in filter.h */
+static bool fuseChain(EGL_PostProcess * this, bool useDMA)
+{
+  EGL_Filter ** filters = vector_data(&this->activeFilters);
+  const size_t  count   = vector_size(&this->activeFilters);
+  size_t kept = 0;
+  bool   fusedInto = false;
+
+  this->fuseStats.fused = 0;
+  this->fuseStats.bytes = 0;
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    EGL_Filter * filter = filters[i];
+    EGL_Filter * next   = i + 1 < count ? filters[i + 1] : NULL;
+
+    // a filter reading through a fused stage can't be fused itself
+    const char * source = this->fuse && next && !fusedInto ?
+      egl_filterFuseSource(filter) : NULL;
+
+    if (!fusedInto && !egl_filterFuseInput(filter, NULL))
+    {
+      DEBUG_ERROR("EGL filter '%s' failed to reset its input", filter->ops.id);
+      return false;
+    }
+
+    if (source)
+    {
+      EGL_FilterFuse fuse = { .source = source, .useDMA = useDMA };
+      EGL_PixelFormat pixFmt;
+      egl_filterGetOutputRes(filter, &fuse.width, &fuse.height, &pixFmt);
+
+      if (egl_filterFuseInput(next, &fuse))
+      {
+        EGL_TexFormat fmt;
+        if (egl_texUtilGetFormat(&(EGL_TexSetup) {
+              .pixFmt = pixFmt,
+              .width  = fuse.width,
+              .height = fuse.height }, &fmt))
+          this->fuseStats.bytes += 2 * fmt.bpp * fuse.width * fuse.height;
+
+        ++this->fuseStats.fused;
+        fusedInto = true;
+        continue;
+      }
+    }
+
+    filters[kept++] = filter;
+    fusedInto = false;
+    useDMA    = false;
+  }
+
+  while (vector_size(&this->activeFilters) > kept)
+    vector_pop(&this->activeFilters);
+
+  this->fuseStats.passes = kept;
+  return true;
 }
 
 static bool configMatches(EGL_PostProcess * this, EGL_PixelFormat pixFmt,
@@ -758,6 +882,7 @@ static bool configureChain(EGL_PostProcess * this, EGL_PixelFormat pixFmt,
   EGL_PixelFormat outputFormat = pixFmt;
   bool inputDMA = useDMA;
   bool fullFrame = false;
+  unsigned int damageMargin = 0;
 
   EGL_Filter * filter;
   vector_forEach(filter, &this->internalFilters)
@@ -775,7 +900,9 @@ static bool configureChain(EGL_PostProcess * this, EGL_PixelFormat pixFmt,
       return false;
     }
 
-    fullFrame |= filter->ops.fullFrame;
+    fullFrame    |= filter->ops.fullFrame;
+    damageMargin += footprintMargin(filter, outputX, outputY,
+        desktopWidth, desktopHeight);
     egl_filterGetOutputRes(filter, &outputX, &outputY, &outputFormat);
     inputDMA = false;
   }
@@ -785,6 +912,7 @@ static bool configureChain(EGL_PostProcess * this, EGL_PixelFormat pixFmt,
   const EGL_PixelFormat baseOutputFormat = outputFormat;
   const bool            baseInputDMA     = inputDMA;
   const bool            baseFullFrame    = fullFrame;
+  const unsigned int    baseDamageMargin = damageMargin;
 
   // Effects operate in linear scRGB. Probe them against the format produced
   // by the decoder first so an inactive chain does not compile or execute an
@@ -811,7 +939,9 @@ static bool configureChain(EGL_PostProcess * this, EGL_PixelFormat pixFmt,
       return false;
     }
 
-    fullFrame |= filter->ops.fullFrame;
+    fullFrame    |= filter->ops.fullFrame;
+    damageMargin += footprintMargin(filter, outputX, outputY,
+        desktopWidth, desktopHeight);
     egl_filterGetOutputRes(filter, &outputX, &outputY, &outputFormat);
     inputDMA = false;
   }
@@ -828,6 +958,7 @@ static bool configureChain(EGL_PostProcess * this, EGL_PixelFormat pixFmt,
       vector_clear(&this->effectFilters);
       effectsActive = false;
       fullFrame     = baseFullFrame;
+      damageMargin  = baseDamageMargin;
     }
     else if (!vector_push(&this->activeFilters, &this->hdrDecode))
     {
@@ -851,6 +982,13 @@ static bool configureChain(EGL_PostProcess * this, EGL_PixelFormat pixFmt,
     outputY = baseOutputY;
   }
 
+  if (!fuseChain(this, useDMA))
+  {
+    vector_clear(&this->activeFilters);
+    vector_clear(&this->effectFilters);
+    return false;
+  }
+
   egl_desktopRectsMatrix(this->matrix,
       desktopWidth, desktopHeight, 0.0f, 0.0f, 1.0f, 1.0f, LG_ROTATE_0);
 
@@ -867,6 +1005,7 @@ static bool configureChain(EGL_PostProcess * this, EGL_PixelFormat pixFmt,
   this->config.outputY       = outputY;
   this->config.outputHDRPQ   = hdrPQ && !effectsActive;
   this->config.fullFrame     = fullFrame;
+  this->config.damageMargin  = damageMargin;
   this->config.valid         = true;
   return true;
 }
@@ -910,6 +1049,8 @@ bool egl_postProcessRun(EGL_PostProcess * this, EGL_Texture * tex,
         rects, NULL, -1, desktopWidth, desktopHeight);
   }
 
+  /* a rebuilt chain has no valid output outside of the damage yet */
+  this->fullRun = reconfigure || this->config.fullFrame;
   if (this->config.fullFrame)
   {
     rects = this->rects;
@@ -40,9 +40,14 @@ void egl_postProcessInvalidate(EGL_PostProcess * this);
 /* returns true if the configuration was modified since the last run */
 bool egl_postProcessConfigModified(EGL_PostProcess * this);
 
-/* true when an active filter requires full-frame rendering and damage */
+/* true when the last run rebuilt the whole output, either because an active
+ * filter requires full-frame rendering or because the chain was rebuilt */
 bool egl_postProcessNeedsFullFrame(EGL_PostProcess * this);
 
+/* the number of desktop pixels damage must be grown by to cover the
+ * footprints of the active filters */
+unsigned int egl_postProcessDamageMargin(EGL_PostProcess * this);
+
 /* apply the filters to the supplied texture
  * targetX/Y is the final target output dimension hint if scalers are present */
 bool egl_postProcessRun(EGL_PostProcess * this, EGL_Texture * tex,
@@ -0,0 +1,206 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "readback.h"
+#include "state.h"
+
+#include "egldebug.h"
+#include "common/debug.h"
+
+#include <stdlib.h>
+
+struct ReadbackSlot
+{
+  GLuint             pbo;
+  size_t             size;
+  GLsync             sync;
+  void             * map;
+  LG_RendererCapture desc;
+};
+
+struct EGL_Readback
+{
+  struct ReadbackSlot slots[EGL_READBACK_BUFFERS];
+
+  /* free running counters, begin - release slots are in use */
+  unsigned int beginIdx;
+  unsigned int mapIdx;
+  unsigned int releaseIdx;
+};
+
+_Static_assert(EGL_READBACK_BUFFERS <= LG_RENDERER_MAX_CAPTURES,
+    "more readback buffers than a renderer may have in flight");
+
+bool egl_readbackInit(EGL_Readback ** readback)
+{
+  EGL_Readback * this = calloc(1, sizeof(*this));
+  if (!this)
+  {
+    DEBUG_ERROR("Failed to allocate ram");
+    return false;
+  }
+
+  *readback = this;
+  return true;
+}
+
+void egl_readbackFree(EGL_Readback ** readback)
+{
+  EGL_Readback * this = *readback;
+  if (!this)
+    return;
+
+  for(int i = 0; i < EGL_READBACK_BUFFERS; ++i)
+  {
+    struct ReadbackSlot * slot = &this->slots[i];
+    if (slot->sync)
+      glDeleteSync(slot->sync);
+
+    if (!slot->pbo)
+      continue;
+
+    if (slot->map)
+    {
+      egl_stateBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glDeleteBuffers(1, &slot->pbo);
+  }
+  egl_stateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  free(this);
+  *readback = NULL;
+}
+
+bool egl_readbackBegin(EGL_Readback * this, const LG_RendererCapture * desc,
+    GLenum dataType)
+{
+  if (this->beginIdx - this->releaseIdx == EGL_READBACK_BUFFERS)
+    return false;
+
+  struct ReadbackSlot * slot =
+    &this->slots[this->beginIdx % EGL_READBACK_BUFFERS];
+
+  /* an error left by earlier code would be blamed on the readback below, report
+   * it here instead of discarding it */
+  GLenum error;
+  while ((error = glGetError()) != GL_NO_ERROR)
+    DEBUG_WARN("GL error 0x%04x was pending before the readback", error);
+
+  if (!slot->pbo)
+    glGenBuffers(1, &slot->pbo);
+
+  egl_stateBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+  if (slot->size < desc->dataSize)
+  {
+    glBufferData(GL_PIXEL_PACK_BUFFER, desc->dataSize, NULL, GL_STREAM_READ);
+    slot->size = desc->dataSize;
+  }
+
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, desc->width, desc->height, GL_RGBA, dataType, NULL);
+  egl_stateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  if (glGetError() != GL_NO_ERROR)
+  {
+    // the buffer may not have been allocated, size it again next time
+    slot->size = 0;
+    DEBUG_ERROR("Failed to read the composed EGL framebuffer");
+    return false;
+  }
+
+  slot->sync      = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot->desc      = *desc;
+  slot->desc.data = NULL;
+  ++this->beginIdx;
+  return true;
+}
+
+bool egl_readbackMap(EGL_Readback * this, bool wait,
+    LG_RendererCapture * capture)
+{
+  if (this->mapIdx == this->beginIdx)
+    return false;
+
+  struct ReadbackSlot * slot =
+    &this->slots[this->mapIdx % EGL_READBACK_BUFFERS];
+
+  if (slot->sync)
+  {
+    const GLenum result = glClientWaitSync(slot->sync,
+        wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+        wait ? GL_TIMEOUT_IGNORED         : 0);
+
+    switch(result)
+    {
+      case GL_ALREADY_SIGNALED:
+      case GL_CONDITION_SATISFIED:
+        break;
+
+      case GL_TIMEOUT_EXPIRED:
+        if (!wait)
+          return false;
+        DEBUG_ERROR("Readback sync unexpectedly timed out");
+        break;
+
+      case GL_WAIT_FAILED:
+      case GL_INVALID_VALUE:
+        // mapping the buffer waits for the transfer anyway
+        DEBUG_GL_ERROR("glClientWaitSync failed on a readback");
+        break;
+    }
+
+    glDeleteSync(slot->sync);
+    slot->sync = 0;
+  }
+
+  egl_stateBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+  slot->map = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot->desc.dataSize,
+      GL_MAP_READ_BIT);
+  egl_stateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  if (!slot->map)
+  {
+    DEBUG_GL_ERROR("glMapBufferRange failed of %zu bytes",
+        slot->desc.dataSize);
+    return false;
+  }
+
+  *capture      = slot->desc;
+  capture->data = slot->map;
+  ++this->mapIdx;
+  return true;
+}
+
+void egl_readbackRelease(EGL_Readback * this)
+{
+  if (this->releaseIdx == this->mapIdx)
+    return;
+
+  struct ReadbackSlot * slot =
+    &this->slots[this->releaseIdx % EGL_READBACK_BUFFERS];
+
+  egl_stateBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  egl_stateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  slot->map = NULL;
+  ++this->releaseIdx;
+}
@@ -0,0 +1,57 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <GLES3/gl3.h>
+
+#include "interface/renderer.h"
+
+/*
+ * A ring of pixel pack buffers the composed framebuffer is read into without
+ * waiting for the transfer. Each read is fenced and only mapped once the GPU
+ * has finished it, normally a frame or two later. Reads are mapped and
+ * released in the order they were begun.
+ */
+
+#define EGL_READBACK_BUFFERS 4
+
+typedef struct EGL_Readback EGL_Readback;
+
+bool egl_readbackInit(EGL_Readback ** readback);
+void egl_readbackFree(EGL_Readback ** readback);
+
+/**
+ * Queue a read of the bound framebuffer described by `desc` as `dataType`
+ * texels. Returns false if every buffer is still queued or mapped.
+ */
+bool egl_readbackBegin(EGL_Readback * this, const LG_RendererCapture * desc,
+    GLenum dataType);
+
+/**
+ * Map the oldest queued read into `capture` once it has completed, waiting for
+ * it if `wait` is set. Returns false if there is none or it is not ready.
+ */
+bool egl_readbackMap(EGL_Readback * this, bool wait,
+    LG_RendererCapture * capture);
+
+/* unmap the oldest mapped read */
+void egl_readbackRelease(EGL_Readback * this);
@@ -20,14 +20,52 @@
 
 #include "shader.h"
 #include "state.h"
+#include "common/array.h"
 #include "common/debug.h"
 #include "common/stringutils.h"
 #include "util.h"
 
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHADER_CACHE_MAGIC   0x4353474c // LGSC
+#define SHADER_CACHE_VERSION 2
+#define SHADER_CACHE_MAX     (16 * 1024 * 1024)
+
+// runtime variants keep adding entries, evict the least recently used past this
+#define SHADER_CACHE_MAX_ENTRIES 256
+#define SHADER_CACHE_MAX_TOTAL   (128 * 1024 * 1024)
+
+struct ShaderCacheId
+{
+  uint64_t key;   // names the entry
+  uint64_t check; // independent hash verified before the binary is used
+  uint32_t vertexSize;
+  uint32_t fragmentSize;
+};
+
+struct ShaderCacheHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  struct ShaderCacheId id;
+  uint32_t format;
+  uint32_t length;
+};
+
+static struct
+{
+  char * dir;
+}
+l_shaderCache;
 
 struct EGL_Uniform
 {
@@ -159,6 +197,358 @@ static void shaderResolveUniforms(EGL_Shader * this)
   }
 }
 
+static uint64_t fnv1a(uint64_t hash, const void * data, size_t size)
+{
+  const uint8_t * bytes = data;
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+  return hash;
+}
+
+// not every filesystem fills in d_type, ask for the ones that are left unknown
+static unsigned char shaderCacheEntryType(int fd, const struct dirent * entry)
+{
+  if (entry->d_type != DT_UNKNOWN)
+    return entry->d_type;
+
+  struct stat st;
+  if (fstatat(fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+    return DT_UNKNOWN;
+
+  if (S_ISDIR(st.st_mode))
+    return DT_DIR;
+  if (S_ISREG(st.st_mode))
+    return DT_REG;
+  return DT_UNKNOWN;
+}
+
+static void shaderCacheRemoveDir(int parent, const char * name)
+{
+  int fd = openat(parent, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+  if (fd < 0)
+    return;
+
+  DIR * dir = fdopendir(fd);
+  if (!dir)
+  {
+    close(fd);
+    return;
+  }
+
+  struct dirent * entry;
+  while ((entry = readdir(dir)) != NULL)
+    if (shaderCacheEntryType(fd, entry) == DT_REG)
+      unlinkat(fd, entry->d_name, 0);
+
+  closedir(dir);
+  unlinkat(parent, name, AT_REMOVEDIR);
+}
+
+/* Entries are only valid for the driver build that produced them so each
+ * build gets its own directory, remove the ones left by any other build along
+ * with the loose entries written by the previous cache version. */
+static void shaderCachePurge(const char * dir, const char * keep)
+{
+  DIR * d = opendir(dir);
+  if (!d)
+    return;
+
+  struct dirent * entry;
+  while ((entry = readdir(d)) != NULL)
+  {
+    const char * name = entry->d_name;
+    if (strcmp(name, keep) == 0)
+      continue;
+
+    const size_t        len  = strlen(name);
+    const unsigned char type = shaderCacheEntryType(dirfd(d), entry);
+    if (type == DT_DIR)
+    {
+      if (len == 16 && strspn(name, "0123456789abcdef") == len)
+      {
+        DEBUG_INFO("Removing stale shader cache: %s/%s", dir, name);
+        shaderCacheRemoveDir(dirfd(d), name);
+      }
+    }
+    else if (type == DT_REG &&
+        ((len > 4 && strcmp(name + len - 4, ".bin"    ) == 0) ||
+         (len > 8 && strcmp(name + len - 8, ".bin.tmp") == 0)))
+      unlinkat(dirfd(d), name, 0);
+  }
+
+  closedir(d);
+}
+
+bool egl_shaderCacheInit(const char * dir)
+{
+  /* the core ES 3.0 program binary entry points are used, querying the formats
+   * on an ES 2.0 context only raises GL_INVALID_ENUM */
+  int esMaj = 0;
+  const char * version = (const char *)glGetString(GL_VERSION);
+  if (!version || sscanf(version, "OpenGL ES %d", &esMaj) != 1 || esMaj < 3)
+  {
+    DEBUG_INFO("Program binaries need OpenGL ES 3.0, shader cache disabled");
+    return false;
+  }
+
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  if (glGetError() != GL_NO_ERROR || formats <= 0)
+  {
+    DEBUG_INFO("Program binaries are not supported, shader cache disabled");
+    return false;
+  }
+
+  if (mkdir(dir, S_IRWXU) < 0 && errno != EEXIST)
+  {
+    DEBUG_WARN("Failed to create the shader cache directory: %s", dir);
+    return false;
+  }
+
+  const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+  uint64_t driver = 0xcbf29ce484222325ULL;
+  for (int i = 0; i < ARRAY_LENGTH(strings); ++i)
+  {
+    const char * str = (const char *)glGetString(strings[i]);
+    if (!str)
+      return false;
+    driver = fnv1a(driver, str, strlen(str) + 1);
+  }
+
+  char name[17];
+  snprintf(name, sizeof(name), "%016" PRIx64, driver);
+  shaderCachePurge(dir, name);
+
+  char * path;
+  if (alloc_sprintf(&path, "%s/%s", dir, name) < 0)
+  {
+    DEBUG_ERROR("Out of memory");
+    return false;
+  }
+
+  if (mkdir(path, S_IRWXU) < 0 && errno != EEXIST)
+  {
+    DEBUG_WARN("Failed to create the shader cache directory: %s", path);
+    free(path);
+    return false;
+  }
+
+  free(l_shaderCache.dir);
+  l_shaderCache.dir = path;
+  return true;
+}
+
+void egl_shaderCacheFree(void)
+{
+  free(l_shaderCache.dir);
+  l_shaderCache.dir = NULL;
+}
+
+static char * shaderCachePath(uint64_t key)
+{
+  char * path;
+  if (alloc_sprintf(&path, "%s/%016" PRIx64 ".bin",
+        l_shaderCache.dir, key) < 0)
+    return NULL;
+  return path;
+}
+
+static bool shaderCacheLoad(EGL_Shader * this, const struct ShaderCacheId * id)
+{
+  char * path = shaderCachePath(id->key);
+  if (!path)
+    return false;
+
+  FILE * fp = fopen(path, "rb");
+  if (!fp)
+  {
+    free(path);
+    return false;
+  }
+
+  bool   result = false;
+  void * binary = NULL;
+  struct ShaderCacheHeader header;
+  if (fread(&header, sizeof(header), 1, fp) != 1 ||
+      header.magic   != SHADER_CACHE_MAGIC   ||
+      header.version != SHADER_CACHE_VERSION ||
+      memcmp(&header.id, id, sizeof(*id)) != 0 ||
+      header.length  == 0                    ||
+      header.length  >  SHADER_CACHE_MAX)
+    goto exit;
+
+  binary = malloc(header.length);
+  if (!binary || fread(binary, header.length, 1, fp) != 1)
+    goto exit;
+
+  this->shader = glCreateProgram();
+  glProgramBinary(this->shader, header.format, binary, header.length);
+
+  GLint status = GL_FALSE;
+  glGetProgramiv(this->shader, GL_LINK_STATUS, &status);
+  if (status == GL_FALSE)
+  {
+    glDeleteProgram(this->shader);
+    this->shader = 0;
+
+    // a rejected binary may raise an error, don't leave it for a later check
+    while (glGetError() != GL_NO_ERROR)
+      ;
+    goto exit;
+  }
+
+  result = true;
+
+  // the modification time orders the entries for eviction
+  futimens(fileno(fp), NULL);
+
+exit:
+  fclose(fp);
+  free(binary);
+
+  // the driver may reject a binary after an update, rebuild it
+  if (!result)
+    unlink(path);
+  free(path);
+  return result;
+}
+
+struct ShaderCacheEntry
+{
+  char     name[32];
+  time_t   mtime;
+  uint64_t size;
+};
+
+static int shaderCacheEntryCompare(const void * a, const void * b)
+{
+  const struct ShaderCacheEntry * ea = a, * eb = b;
+  return (ea->mtime > eb->mtime) - (ea->mtime < eb->mtime);
+}
+
+/* Remove the least recently used entries once the directory grows past
+ * SHADER_CACHE_MAX_ENTRIES or SHADER_CACHE_MAX_TOTAL bytes. */
+static void shaderCacheTrim(void)
+{
+  DIR * d = opendir(l_shaderCache.dir);
+  if (!d)
+    return;
+
+  struct ShaderCacheEntry * entries = NULL;
+  size_t count = 0, capacity = 0;
+  uint64_t total = 0;
+
+  struct dirent * entry;
+  while ((entry = readdir(d)) != NULL)
+  {
+    const char * name = entry->d_name;
+    const size_t len  = strlen(name);
+    if (len < 5 || len >= sizeof(entries->name) ||
+        strcmp(name + len - 4, ".bin") != 0)
+      continue;
+
+    struct stat st;
+    if (fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) < 0 ||
+        !S_ISREG(st.st_mode))
+      continue;
+
+    if (count == capacity)
+    {
+      const size_t newCap = capacity ? capacity * 2 : 64;
+      struct ShaderCacheEntry * tmp =
+        realloc(entries, newCap * sizeof(*entries));
+      if (!tmp)
+      {
+        DEBUG_ERROR("Out of memory");
+        goto exit;
+      }
+      entries  = tmp;
+      capacity = newCap;
+    }
+
+    struct ShaderCacheEntry * e = entries + count++;
+    memcpy(e->name, name, len + 1);
+    e->mtime = st.st_mtime;
+    e->size  = st.st_size;
+    total   += st.st_size;
+  }
+
+  if (count <= SHADER_CACHE_MAX_ENTRIES && total <= SHADER_CACHE_MAX_TOTAL)
+    goto exit;
+
+  qsort(entries, count, sizeof(*entries), shaderCacheEntryCompare);
+  for (size_t i = 0; i < count &&
+      (count - i > SHADER_CACHE_MAX_ENTRIES || total > SHADER_CACHE_MAX_TOTAL);
+      ++i)
+  {
+    unlinkat(dirfd(d), entries[i].name, 0);
+    total -= entries[i].size;
+  }
+
+exit:
+  closedir(d);
+  free(entries);
+}
+
+static void shaderCacheStore(EGL_Shader * this,
+    const struct ShaderCacheId * id)
+{
+  GLint length = 0;
+  glGetProgramiv(this->shader, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0 || length > SHADER_CACHE_MAX)
+    return;
+
+  void * binary = malloc(length);
+  if (!binary)
+  {
+    DEBUG_ERROR("Out of memory");
+    return;
+  }
+
+  char * path = shaderCachePath(id->key);
+  char * temp = NULL;
+  FILE * fp   = NULL;
+
+  struct ShaderCacheHeader header =
+  {
+    .magic   = SHADER_CACHE_MAGIC,
+    .version = SHADER_CACHE_VERSION,
+    .id      = *id,
+  };
+
+  GLenum format;
+  glGetProgramBinary(this->shader, length, &length, &format, binary);
+  if (length <= 0 || !path || alloc_sprintf(&temp, "%s.tmp", path) < 0)
+    goto exit;
+
+  header.format = format;
+  header.length = length;
+
+  // write to a temporary file so a partial binary is never loaded
+  fp = fopen(temp, "wb");
+  if (!fp)
+  {
+    DEBUG_WARN("Failed to open %s for writing", temp);
+    goto exit;
+  }
+
+  const bool written =
+    fwrite(&header, sizeof(header), 1, fp) == 1 &&
+    fwrite(binary, length, 1, fp) == 1;
+  if (fclose(fp) != 0 || !written || rename(temp, path) != 0)
+  {
+    DEBUG_WARN("Failed to write the shader cache entry: %s", path);
+    unlink(temp);
+  }
+  else
+    shaderCacheTrim();
+
+exit:
+  free(temp);
+  free(path);
+  free(binary);
+}
+
 static bool shaderCompile(EGL_Shader * this, const char * vertex_code,
     size_t vertex_size, const char * fragment_code, size_t fragment_size)
 {
@@ -169,6 +559,29 @@ static bool shaderCompile(EGL_Shader * this, const char * vertex_code,
     this->hasShader = false;
   }
 
+  struct ShaderCacheId id = { 0 };
+  if (l_shaderCache.dir)
+  {
+    id.vertexSize   = vertex_size;
+    id.fragmentSize = fragment_size;
+
+    id.key = 0xcbf29ce484222325ULL;
+    id.key = fnv1a(id.key, vertex_code  , vertex_size  );
+    id.key = fnv1a(id.key, fragment_code, fragment_size);
+
+    // hashed in the opposite order from an unrelated basis
+    id.check = 0x84222325cbf29ce4ULL;
+    id.check = fnv1a(id.check, fragment_code, fragment_size);
+    id.check = fnv1a(id.check, vertex_code  , vertex_size  );
+
+    if (shaderCacheLoad(this, &id))
+    {
+      this->hasShader = true;
+      shaderResolveUniforms(this);
+      return true;
+    }
+  }
+
   GLint  length;
   GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
 
@@ -237,6 +650,9 @@ static bool shaderCompile(EGL_Shader * this, const char * vertex_code,
   this->shader = glCreateProgram();
   glAttachShader(this->shader, vertexShader  );
   glAttachShader(this->shader, fragmentShader);
+  if (l_shaderCache.dir)
+    glProgramParameteri(this->shader,
+        GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   glLinkProgram(this->shader);
 
   glGetProgramiv(this->shader, GL_LINK_STATUS, &result);
@@ -274,6 +690,9 @@ static bool shaderCompile(EGL_Shader * this, const char * vertex_code,
   glDeleteShader(fragmentShader);
   glDeleteShader(vertexShader  );
 
+  if (l_shaderCache.dir)
+    shaderCacheStore(this, &id);
+
   this->hasShader = true;
   shaderResolveUniforms(this);
   return true;
@@ -76,6 +76,16 @@ typedef struct EGL_ShaderDefine
 }
 EGL_ShaderDefine;
 
+/*
+ * Linked programs are kept as driver program binaries in a subdirectory of
+ * `dir` named for the driver build, keyed by the final shader sources, and are
+ * loaded from there instead of compiled when possible. The least recently used
+ * entries are evicted once the directory grows too large and directories left
+ * by other driver builds are removed. Requires a current OpenGL ES 3.0 context.
+ */
+bool egl_shaderCacheInit(const char * dir);
+void egl_shaderCacheFree(void);
+
 bool egl_shaderInit(EGL_Shader ** shader);
 void egl_shaderFree(EGL_Shader ** shader);
 
@@ -10,13 +10,16 @@ out vec4  fragColor;
 uniform sampler2D sampler1;
 uniform vec3      uConfig;
 
+#include "hdr.h"
+#include "fuse.h"
+
 void main()
 {
   float pixelSize = uConfig.x;
   float vOffset   = uConfig.y;
   float hOffset   = uConfig.z;
 
-  vec2 inRes  = vec2(textureSize(sampler1, 0));
+  vec2 inRes  = vec2(inputSize());
   ivec2 point = ivec2(
     (floor((fragCoord * inRes) / pixelSize) * pixelSize) +
     pixelSize / 2.0f
@@ -25,5 +28,5 @@ void main()
   point.x += int(pixelSize * hOffset);
   point.y += int(pixelSize * vOffset);
 
-  fragColor = texelFetch(sampler1, point, 0);
+  fragColor = inputFetch(point);
 }
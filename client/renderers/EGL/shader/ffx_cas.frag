@@ -18,10 +18,11 @@ uniform float     uHDRScale;
 #define A_GLSL 1
 
 #include "ffx_a.h"
+#include "fuse.h"
 
 vec3 imageLoad(ivec2 point)
 {
-  vec3 color = texelFetch(sampler1, point, 0).rgb;
+  vec3 color = inputFetch(point).rgb;
   if (uHDRScale > 0.0)
     color = max(bt709to2020(color * uHDRScale), vec3(0.0));
 
@@ -39,7 +40,7 @@ void CasInput(inout AF1 r,inout AF1 g,inout AF1 b) {}
 
 void main()
 {
-  vec2  res   = vec2(textureSize(sampler1, 0));
+  vec2  res   = vec2(inputSize());
   uvec2 point = uvec2(fragCoord * res);
 
   CasFilter(
@@ -0,0 +1,28 @@
+// Filters that read their input texel by texel do so through inputFetch so
+// a pointwise stage in front of them can be fused in, FUSE_SOURCE then
+// defines fuseFetch reading that stage's own input from sampler1.
+#ifdef FUSE_SOURCE
+  uniform vec2 uFuseSize;
+
+  FUSE_SOURCE
+
+  ivec2 inputSize()
+  {
+    return ivec2(uFuseSize);
+  }
+
+  vec4 inputFetch(ivec2 p)
+  {
+    return fuseFetch(clamp(p, ivec2(0), ivec2(uFuseSize) - 1));
+  }
+#else
+  ivec2 inputSize()
+  {
+    return textureSize(sampler1, 0);
+  }
+
+  vec4 inputFetch(ivec2 p)
+  {
+    return texelFetch(sampler1, p, 0);
+  }
+#endif
@@ -162,22 +162,24 @@ bool egl_textureUpdateRect(EGL_Texture * this,
 bool egl_textureUpdateFromFrame(EGL_Texture * this,
     const FrameBuffer * frame, LG_RendererFrameToken frameToken,
     const FrameDamageRect * damageRects, int damageRectsCount,
-    uint64_t * waitTimeNs)
+    size_t compressedLimit, uint64_t * waitTimeNs, bool * incomplete)
 {
   const struct EGL_TexUpdate update =
   {
-    .type       = EGL_TEXTYPE_FRAMEBUFFER,
-    .frameToken = frameToken,
-    .x          = 0,
-    .y          = 0,
-    .width      = this->format.width,
-    .height     = this->format.height,
-    .pitch      = this->format.pitch,
-    .stride     = this->format.stride,
-    .frame      = frame,
-    .rects      = damageRects,
-    .rectCount  = damageRectsCount,
-    .waitTimeNs = waitTimeNs,
+    .type            = EGL_TEXTYPE_FRAMEBUFFER,
+    .frameToken      = frameToken,
+    .x               = 0,
+    .y               = 0,
+    .width           = this->format.width,
+    .height          = this->format.height,
+    .pitch           = this->format.pitch,
+    .stride          = this->format.stride,
+    .frame           = frame,
+    .rects           = damageRects,
+    .rectCount       = damageRectsCount,
+    .compressedLimit = compressedLimit,
+    .waitTimeNs      = waitTimeNs,
+    .incomplete      = incomplete,
   };
 
   return this->ops.update(this, &update);
@@ -70,6 +70,11 @@ typedef struct EGL_TexUpdate
       const FrameBuffer * frame;
       const FrameDamageRect * rects;
       int rectCount;
+      // the readable size of a compressed frame, zero if not compressed
+      size_t compressedLimit;
+      /* set if the producer did not finish the frame in time or it could not
+       * be decoded, the upload is skipped rather than failed */
+      bool * incomplete;
     };
 
     /* EGL_TEXTYPE_DMABUF */
@@ -143,7 +148,7 @@ bool egl_textureUpdateRect(EGL_Texture * texture,
 bool egl_textureUpdateFromFrame(EGL_Texture * texture,
     const FrameBuffer * frame, LG_RendererFrameToken frameToken,
     const FrameDamageRect * damageRects, int damageRectsCount,
-    uint64_t * waitTimeNs);
+    size_t compressedLimit, uint64_t * waitTimeNs, bool * incomplete);
 
 bool egl_textureUpdateFromDMA(EGL_Texture * texture,
     const FrameBuffer * frame, LG_RendererFrameToken frameToken,
@@ -22,6 +22,7 @@
 
 #include "texture_buffer.h"
 #include "common/debug.h"
+#include "common/framecodec.h"
 #include "common/rects.h"
 
 struct TexDamage
@@ -91,8 +92,24 @@ static bool egl_texFBUpdate(EGL_Texture * texture, const EGL_TexUpdate * update)
   bool damageAll = !update->rects || update->rectCount == 0 || damage->count < 0 ||
     damage->count + update->rectCount > LG_MAX_FRAME_DAMAGE_RECTS;
   bool complete;
+  bool timedOut = false;
 
-  if (damageAll)
+  if (update->compressedLimit)
+  {
+    /* a compressed frame always carries every row */
+    const FrameCodecResult result = frameCodec_decode(
+      update->frame,
+      update->compressedLimit,
+      parent->buf[parent->bufIndex].map,
+      texture->format.pitch,
+      texture->format.height,
+      texture->format.pitch,
+      update->waitTimeNs
+    );
+    complete = result == FRAMECODEC_RESULT_OK;
+    timedOut = result == FRAMECODEC_RESULT_TIMEOUT;
+  }
+  else if (damageAll)
   {
     complete = framebuffer_read_timed(
       update->frame,
@@ -152,10 +169,17 @@ static bool egl_texFBUpdate(EGL_Texture * texture, const EGL_TexUpdate * update)
     }
   }
 
+  // the raw copies only fail if a wait on the producer timed out
+  if (!update->compressedLimit)
+    timedOut = !complete;
+
   if (unlikely(!complete))
   {
     /* The mapped PBO may contain a partial copy. Force a full refresh if the
-     * caller recovers, and never expose this slot to the render context. */
+     * caller recovers, and never expose this slot to the render context. Only
+     * a stalled producer is recoverable, a corrupt frame is an error. */
+    if (timedOut && update->incomplete)
+      *update->incomplete = true;
     damage->count                         = -1;
     parent->buf[parent->bufIndex].updated = false;
     parent->slotToken[parent->bufIndex]   = LG_RENDERER_FRAME_TOKEN_NONE;
@@ -34,6 +34,7 @@
 #include "common/debug.h"
 #include "common/option.h"
 #include "common/framebuffer.h"
+#include "common/framecodec.h"
 #include "common/locking.h"
 #include "gl_dynprocs.h"
 #include "util.h"
@@ -1309,15 +1310,27 @@ static bool drawFrame(struct Inst * this,
   glPixelStorei(GL_UNPACK_ROW_LENGTH, this->format.frameWidth);
 
   this->texPos = 0;
-  framebuffer_read_fn(
-    this->frame,
-    this->format.dataHeight,
-    this->format.dataWidth,
-    bpp,
-    this->format.pitch,
-    opengl_bufferFn,
-    this
-  );
+  if (this->format.compressed)
+    frameCodec_decodeFn(
+      this->frame,
+      this->format.bufferSize,
+      this->format.dataHeight,
+      this->format.dataWidth * bpp,
+      this->format.pitch,
+      opengl_bufferFn,
+      this,
+      NULL
+    );
+  else
+    framebuffer_read_fn(
+      this->frame,
+      this->format.dataHeight,
+      this->format.dataWidth,
+      bpp,
+      this->format.pitch,
+      opengl_bufferFn,
+      this
+    );
 
   LG_UNLOCK(this->frameLock);
 
@@ -794,6 +794,11 @@ bool app_getHDRDescFailed(void)
   return atomic_load(&g_state.hdrDescFailed);
 }
 
+bool app_latchCursor(void)
+{
+  return renderQueue_latchCursor();
+}
+
 #ifdef ENABLE_EGL
 EGLDisplay app_getEGLDisplay(void)
 {
@@ -0,0 +1,189 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "bench.h"
+
+#include "common/array.h"
+#include "common/debug.h"
+#include "common/vector.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const struct
+{
+  const char * name;
+  size_t       offset;
+  unsigned     stage;
+}
+stages[] =
+{
+  { "import"  , offsetof(OverlayFrameTiming, import  ),
+    OVERLAY_FRAME_TIMING_IMPORT   },
+  { "dispatch", offsetof(OverlayFrameTiming, dispatch),
+    OVERLAY_FRAME_TIMING_DISPATCH },
+  { "queue"   , offsetof(OverlayFrameTiming, queue   ),
+    OVERLAY_FRAME_TIMING_QUEUE    },
+  { "setup"   , offsetof(OverlayFrameTiming, setup   ),
+    OVERLAY_FRAME_TIMING_SETUP    },
+  { "effects" , offsetof(OverlayFrameTiming, effects ),
+    OVERLAY_FRAME_TIMING_EFFECTS  },
+  { "desktop" , offsetof(OverlayFrameTiming, desktop ),
+    OVERLAY_FRAME_TIMING_DESKTOP  },
+  { "compose" , offsetof(OverlayFrameTiming, compose ),
+    OVERLAY_FRAME_TIMING_COMPOSE  },
+  { "swap"    , offsetof(OverlayFrameTiming, swap    ),
+    OVERLAY_FRAME_TIMING_SWAP     },
+};
+
+struct Bench
+{
+  FILE   * file;
+  char     benchCase[64];
+  unsigned frames;
+  uint64_t first, last;
+  Vector   samples[ARRAY_LENGTH(stages)];
+};
+
+bool bench_create(Bench ** bench, const char * path)
+{
+  Bench * this = calloc(1, sizeof(*this));
+  if (!this)
+  {
+    DEBUG_ERROR("out of memory");
+    return false;
+  }
+
+  for(unsigned i = 0; i < ARRAY_LENGTH(stages); ++i)
+    if (!vector_create(&this->samples[i], sizeof(float), 1024))
+    {
+      DEBUG_ERROR("out of memory");
+      goto err;
+    }
+
+  this->file = path ? fopen(path, "w") : stdout;
+  if (!this->file)
+  {
+    DEBUG_ERROR("Failed to open the benchmark output: %s", path);
+    goto err;
+  }
+
+  *bench = this;
+  return true;
+
+err:
+  for(unsigned i = 0; i < ARRAY_LENGTH(stages); ++i)
+    vector_destroy(&this->samples[i]);
+  free(this);
+  return false;
+}
+
+static int compareFloat(const void * a, const void * b)
+{
+  const float x = *(const float *)a;
+  const float y = *(const float *)b;
+  return (x > y) - (x < y);
+}
+
+/* nearest rank percentile of the sorted `values` */
+static float percentile(const float * values, size_t count, double p)
+{
+  size_t rank = (size_t)ceil(p / 100.0 * count);
+  return values[rank ? rank - 1 : 0];
+}
+
+static void bench_flush(Bench * this)
+{
+  if (!this->frames)
+    return;
+
+  const double fps = this->frames > 1 && this->last > this->first ?
+    (this->frames - 1) * 1e9 / (this->last - this->first) : 0.0;
+
+  fprintf(this->file, "{\"case\":\"%s\",\"frames\":%u,\"fps\":%.2f",
+      this->benchCase, this->frames, fps);
+
+  for(unsigned i = 0; i < ARRAY_LENGTH(stages); ++i)
+  {
+    Vector * samples = &this->samples[i];
+    const size_t count = vector_size(samples);
+    if (!count)
+      continue;
+
+    float * values = vector_data(samples);
+    qsort(values, count, sizeof(*values), compareFloat);
+    fprintf(this->file,
+        ",\"%s\":{\"p50\":%.4f,\"p90\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+        stages[i].name,
+        percentile(values, count, 50.0),
+        percentile(values, count, 90.0),
+        percentile(values, count, 99.0),
+        values[count - 1]);
+    vector_clear(samples);
+  }
+
+  fputs("}\n", this->file);
+  fflush(this->file);
+  this->frames = 0;
+}
+
+void bench_free(Bench ** bench)
+{
+  Bench * this = *bench;
+  if (!this)
+    return;
+
+  bench_flush(this);
+  if (this->file != stdout)
+    fclose(this->file);
+
+  for(unsigned i = 0; i < ARRAY_LENGTH(stages); ++i)
+    vector_destroy(&this->samples[i]);
+
+  free(this);
+  *bench = NULL;
+}
+
+void bench_sample(Bench * this, const char * benchCase,
+    const OverlayFrameTiming * timing)
+{
+  if (strcmp(this->benchCase, benchCase) != 0)
+  {
+    bench_flush(this);
+    snprintf(this->benchCase, sizeof(this->benchCase), "%s", benchCase);
+  }
+
+  if (!this->frames++)
+    this->first = timing->timestamp;
+  this->last = timing->timestamp;
+
+  for(unsigned i = 0; i < ARRAY_LENGTH(stages); ++i)
+  {
+    if (!(timing->validMask & (1U << stages[i].stage)))
+      continue;
+
+    float value = *(const float *)((const uint8_t *)timing + stages[i].offset);
+    if (!vector_push(&this->samples[i], &value))
+      DEBUG_ERROR("out of memory");
+  }
+}
@@ -0,0 +1,45 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+#ifndef _H_LG_BENCH_
+#define _H_LG_BENCH_
+
+#include <stdbool.h>
+
+#include "overlays.h"
+
+/*
+ * Collects the per-stage frame timings of a benchmark run and writes one JSON
+ * object per case, one per line, with the percentiles of each stage in
+ * milliseconds. The samples of a case must arrive together, a case is written
+ * out when the next one starts and when the benchmark is freed.
+ */
+
+typedef struct Bench Bench;
+
+/* write the results to `path`, or stdout if NULL */
+bool bench_create(Bench ** bench, const char * path);
+void bench_free(Bench ** bench);
+
+void bench_sample(Bench * bench, const char * benchCase,
+    const OverlayFrameTiming * timing);
+
+#endif
@@ -0,0 +1,205 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "capture_stream.h"
+
+#include "common/debug.h"
+#include "common/event.h"
+#include "common/thread.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct CaptureStreamFrame
+{
+  LG_TestCaptureHeader header;
+  const void         * data;
+};
+
+struct CaptureStream
+{
+  FILE       * file;
+  const char * path;
+  LGThread   * thread;
+  LGEvent    * pushedEvent;
+  LGEvent    * writtenEvent;
+
+  struct CaptureStreamFrame frames[CAPTURE_STREAM_DEPTH];
+  atomic_uint_least64_t pushed;
+  atomic_uint_least64_t written;
+  atomic_bool           failed;
+  atomic_bool           stop;
+};
+
+static int captureStream_thread(void * opaque)
+{
+  CaptureStream * this = opaque;
+  uint64_t written = atomic_load_explicit(&this->written,
+      memory_order_relaxed);
+
+  for(;;)
+  {
+    if (written == atomic_load_explicit(&this->pushed, memory_order_acquire))
+    {
+      // frames pushed before the stop request are visible once it is
+      if (atomic_load_explicit(&this->stop, memory_order_acquire) &&
+          written == atomic_load_explicit(&this->pushed, memory_order_acquire))
+        break;
+
+      lgWaitEvent(this->pushedEvent, TIMEOUT_INFINITE);
+      continue;
+    }
+
+    const struct CaptureStreamFrame * frame =
+      &this->frames[written % CAPTURE_STREAM_DEPTH];
+
+    /* flush every frame so a reader on a pipe sees it whole, and keep
+     * consuming after a failure so the producer can release its buffers */
+    if (!atomic_load_explicit(&this->failed, memory_order_relaxed) &&
+        (fwrite(&frame->header, sizeof(frame->header), 1, this->file) != 1 ||
+         fwrite(frame->data, frame->header.dataSize, 1, this->file) != 1 ||
+         fflush(this->file) != 0))
+    {
+      DEBUG_ERROR("Failed to write frame %" PRIu64 " to the capture stream: %s",
+          frame->header.frameSerial, this->path);
+      atomic_store_explicit(&this->failed, true, memory_order_release);
+    }
+
+    atomic_store_explicit(&this->written, ++written, memory_order_release);
+    lgSignalEvent(this->writtenEvent);
+  }
+
+  return 0;
+}
+
+bool captureStream_open(CaptureStream ** stream, const char * path)
+{
+  CaptureStream * this = calloc(1, sizeof(*this));
+  if (!this)
+  {
+    DEBUG_ERROR("out of memory");
+    return false;
+  }
+
+  this->path = path;
+  atomic_init(&this->pushed , 0);
+  atomic_init(&this->written, 0);
+  atomic_init(&this->failed , false);
+  atomic_init(&this->stop   , false);
+
+  this->file = fopen(path, "wb");
+  if (!this->file)
+  {
+    DEBUG_ERROR("Failed to open the capture stream: %s", path);
+    goto err;
+  }
+
+  if (!(this->pushedEvent  = lgCreateEvent(true, 0)) ||
+      !(this->writtenEvent = lgCreateEvent(true, 0)))
+  {
+    DEBUG_ERROR("Failed to create the capture stream events");
+    goto err;
+  }
+
+  if (!lgCreateThread("CaptureStream", captureStream_thread, this,
+        &this->thread))
+  {
+    DEBUG_ERROR("Failed to create the capture stream thread");
+    goto err;
+  }
+
+  *stream = this;
+  return true;
+
+err:
+  if (this->writtenEvent)
+    lgFreeEvent(this->writtenEvent);
+  if (this->pushedEvent)
+    lgFreeEvent(this->pushedEvent);
+  if (this->file)
+    fclose(this->file);
+  free(this);
+  return false;
+}
+
+bool captureStream_close(CaptureStream ** stream)
+{
+  CaptureStream * this = *stream;
+  if (!this)
+    return true;
+
+  atomic_store_explicit(&this->stop, true, memory_order_release);
+  lgSignalEvent(this->pushedEvent);
+  lgJoinThread(this->thread, NULL);
+
+  bool ok = !atomic_load(&this->failed);
+  if (fclose(this->file) != 0)
+  {
+    DEBUG_ERROR("Failed to close the capture stream: %s", this->path);
+    ok = false;
+  }
+
+  lgFreeEvent(this->writtenEvent);
+  lgFreeEvent(this->pushedEvent);
+  free(this);
+  *stream = NULL;
+  return ok;
+}
+
+bool captureStream_push(CaptureStream * this,
+    const LG_TestCaptureHeader * header, const void * data)
+{
+  if (atomic_load_explicit(&this->failed, memory_order_acquire))
+    return false;
+
+  const uint64_t pushed =
+    atomic_load_explicit(&this->pushed, memory_order_relaxed);
+  if (pushed - atomic_load_explicit(&this->written, memory_order_acquire) ==
+      CAPTURE_STREAM_DEPTH)
+    return false;
+
+  this->frames[pushed % CAPTURE_STREAM_DEPTH] = (struct CaptureStreamFrame) {
+    .header = *header,
+    .data   = data,
+  };
+  atomic_store_explicit(&this->pushed, pushed + 1, memory_order_release);
+  lgSignalEvent(this->pushedEvent);
+  return true;
+}
+
+uint64_t captureStream_written(CaptureStream * this)
+{
+  return atomic_load_explicit(&this->written, memory_order_acquire);
+}
+
+bool captureStream_wait(CaptureStream * this)
+{
+  const uint64_t written =
+    atomic_load_explicit(&this->written, memory_order_acquire);
+  if (written == atomic_load_explicit(&this->pushed, memory_order_relaxed))
+    return false;
+
+  while (atomic_load_explicit(&this->written, memory_order_acquire) == written)
+    lgWaitEvent(this->writtenEvent, TIMEOUT_INFINITE);
+
+  return !atomic_load_explicit(&this->failed, memory_order_acquire);
+}
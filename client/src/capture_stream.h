@@ -0,0 +1,65 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef _H_LG_CAPTURE_STREAM_
+#define _H_LG_CAPTURE_STREAM_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "interface/test_capture.h"
+
+/*
+ * Writes a stream of test captures, each an LG_TestCaptureHeader followed by
+ * its pixels, to a file or pipe from a thread of its own so the render thread
+ * never waits on the output. Frames are written in the order they are pushed
+ * and their pixels are only borrowed, the caller keeps them alive until
+ * captureStream_written has counted them.
+ */
+
+#define CAPTURE_STREAM_DEPTH 8
+
+typedef struct CaptureStream CaptureStream;
+
+bool captureStream_open(CaptureStream ** stream, const char * path);
+
+/**
+ * Wait for every pushed frame to be written and close the stream. Returns
+ * false if any of the writes failed.
+ */
+bool captureStream_close(CaptureStream ** stream);
+
+/**
+ * Queue a frame for writing. Returns false if CAPTURE_STREAM_DEPTH frames are
+ * already waiting or a write has failed.
+ */
+bool captureStream_push(CaptureStream * stream,
+    const LG_TestCaptureHeader * header, const void * data);
+
+/* the number of pushed frames that have been written out */
+uint64_t captureStream_written(CaptureStream * stream);
+
+/**
+ * Block until at least one more pushed frame has been written. Returns false
+ * if there is nothing left to write or a write has failed.
+ */
+bool captureStream_wait(CaptureStream * stream);
+
+#endif
@@ -24,8 +24,10 @@
 
 #include "common/option.h"
 #include "common/debug.h"
+#include "common/framebuffer.h"
 #include "common/paths.h"
 #include "common/stringutils.h"
+#include "common/util.h"
 
 #include <errno.h>
 #include <limits.h>
@@ -50,6 +52,8 @@ static bool       optScancodeValidate  (struct Option * opt, const char ** error
 static char *     optScancodeToString  (struct Option * opt);
 static bool       optRotateValidate    (struct Option * opt, const char ** error);
 static bool       optTransportValidate (struct Option * opt, const char ** error);
+static bool       optImportThreadsValidate(struct Option * opt,
+    const char ** error);
 static bool       optMicDefaultParse   (struct Option * opt, const char * str);
 static StringList optMicDefaultValues  (struct Option * opt);
 static char *     optMicDefaultToString(struct Option * opt);
@@ -97,6 +101,21 @@ static struct Option options[] =
     .value.x_string = "lgmp",
     .validator      = optTransportValidate,
   },
+  {
+    .module         = "app",
+    .name           = "importThreads",
+    .description    = "Number of threads used to copy large frames out of shared memory (0 or 1 to disable)",
+    .type           = OPTION_TYPE_INT,
+    .validator      = optImportThreadsValidate,
+    .value.x_int    = 0,
+  },
+  {
+    .module         = "app",
+    .name           = "importKernel",
+    .description    = "The kernel used to copy frames out of shared memory (memcpy, sse4_1, avx2, avx512 or auto)",
+    .type           = OPTION_TYPE_STRING,
+    .value.x_string = "memcpy",
+  },
 
   // window options
   {
@@ -304,6 +323,13 @@ static struct Option options[] =
     .type           = OPTION_TYPE_BOOL,
     .value.x_bool   = false,
   },
+  {
+    .module         = "win",
+    .name           = "jitRenderDeadline",
+    .description    = "Delay just-in-time renders until shortly before the vblank",
+    .type           = OPTION_TYPE_BOOL,
+    .value.x_bool   = false,
+  },
   {
     .module         = "win",
     .name           = "requestActivation",
@@ -653,6 +679,8 @@ bool config_load(int argc, char * argv[])
 
   // setup the application params for the basic types
   g_params.transport            = option_get_string("app", "transport"         );
+  g_params.importThreads        = option_get_int   ("app", "importThreads"     );
+  g_params.importKernel         = option_get_string("app", "importKernel"      );
 
   g_params.windowTitle            = option_get_string("win", "title"             );
   g_params.appId                  = option_get_string("win", "appId"             );
@@ -676,6 +704,7 @@ bool config_load(int argc, char * argv[])
   g_params.uiFont                 = option_get_string("win", "uiFont"            );
   g_params.uiSize                 = option_get_int   ("win", "uiSize"            );
   g_params.jitRender              = option_get_bool  ("win", "jitRender"         );
+  g_params.jitRenderDeadline      = option_get_bool  ("win", "jitRenderDeadline" );
   g_params.requestActivation      = option_get_bool  ("win", "requestActivation" );
   g_params.disableWaitingMessage  = option_get_bool  ("win", "disableWaitingMessage");
 
@@ -1019,6 +1048,16 @@ static bool optTransportValidate(struct Option * opt, const char ** error)
   return true;
 }
 
+static bool optImportThreadsValidate(struct Option * opt, const char ** error)
+{
+  if (opt->value.x_int >= 0 && opt->value.x_int <= FB_MAX_READ_THREADS)
+    return true;
+
+  *error = "The number of threads must be between 0 and "
+    STR(FB_MAX_READ_THREADS);
+  return false;
+}
+
 static bool optMicDefaultParse(struct Option * opt, const char * str)
 {
   if (!str)
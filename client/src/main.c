@@ -47,6 +47,7 @@
 #include "common/locking.h"
 #include "common/event.h"
 #include "common/time.h"
+#include "common/framebuffer.h"
 #include "common/version.h"
 #include "common/paths.h"
 #include "common/cpuinfo.h"
@@ -69,10 +70,13 @@
 #include "render_queue.h"
 #include "evdev.h"
 #include "frame_scheduler.h"
+#include "render_deadline.h"
 #include "input.h"
 #include "sw_surface.h"
 
 #ifdef ENABLE_TESTS
+#include "bench.h"
+#include "capture_stream.h"
 #include "interface/test_capture.h"
 _Static_assert((int)LG_CAPTURE_RGBA8 == (int)LG_TEST_CAPTURE_RGBA8,
     "capture format mismatch");
@@ -167,8 +171,30 @@ static struct
 }
 l_testCapture;
 
+static struct
+{
+  const char    * path;
+  CaptureStream * stream;
+  uint64_t        targetSerial;
+  uint64_t        frames; // frames to stream, zero to stream until exit
+  uint64_t        begun;
+  uint64_t        mapped;
+  uint64_t        released;
+  bool            failed;
+  struct
+  {
+    uint64_t  serial;
+    FrameType sourceType;
+  }
+  pending[LG_RENDERER_MAX_CAPTURES];
+}
+l_testStream;
+
 static atomic_uint_least64_t l_testFrameSerial;
 static _Atomic(FrameType)    l_testFrameType;
+
+// the per-stage timings of the test transport's benchmark cases
+static Bench * l_bench = NULL;
 #endif
 
 static void lgInit(void)
@@ -306,6 +332,10 @@ struct FrameTimingRecord
   uint64_t swapTime;
   uint64_t presentTime;
   uint64_t presentDeadline;
+  uint64_t swapEnd;
+
+  RenderDeadline renderDeadline;
+  const char *   benchCase;
 };
 
 static struct
@@ -375,6 +405,9 @@ void main_framePresented(uint64_t frameToken, uint64_t presentTime,
   if (!frameToken)
     return;
 
+  RenderDeadline deadline = {};
+  uint64_t       swapEnd  = 0;
+
   INTERLOCKED_SECTION(l_frameTiming.lock, {
     struct FrameTimingRecord * record = frameTimingRecord(frameToken);
     if (record->token == frameToken)
@@ -382,8 +415,14 @@ void main_framePresented(uint64_t frameToken, uint64_t presentTime,
       record->presentTime  = presentTime;
       record->presentValid = valid;
       record->readyMask   |= FRAME_TIMING_PRESENT_READY;
+      deadline             = record->renderDeadline;
+      swapEnd              = record->swapEnd;
     }
   });
+
+  /* the presentation time is relative to the swap */
+  if (valid && swapEnd)
+    renderDeadline_presented(&deadline, swapEnd + presentTime);
 }
 
 static LG_RendererFrameToken frameTimingReserve(void)
@@ -480,6 +519,7 @@ static void frameTimingFinishFrame(LG_RendererFrameToken token,
         record->providerValid   = timing->providerValid;
         record->receiveTime     = timing->receiveTime;
         record->providerPrepareTime = timing->prepareTime;
+        record->benchCase       = timing->benchCase;
         if (record->timestamp < timestamp)
           record->timestamp = timestamp;
         record->readyMask      |= FRAME_TIMING_FRAME_READY;
@@ -490,7 +530,7 @@ static void frameTimingFinishFrame(LG_RendererFrameToken token,
 
 static void frameTimingFinishRender(const LG_RendererFrameTiming * timing,
     uint64_t prepareStart, uint64_t prepareTime, uint64_t timestamp,
-    LG_RendererFrameToken cadenceToken)
+    LG_RendererFrameToken cadenceToken, const RenderDeadline * deadline)
 {
   uint64_t feedbackFrameSerial = 0;
   uint64_t feedbackQueueStart  = 0;
@@ -515,6 +555,8 @@ static void frameTimingFinishRender(const LG_RendererFrameTiming * timing,
     record->desktopTime     = timing->desktopTime;
     record->composeTime     = timing->composeTime;
     record->swapTime        = timing->swapTime;
+    record->swapEnd         = timing->swapEnd ? timing->swapEnd : timestamp;
+    record->renderDeadline  = *deadline;
     record->presentDeadline = timestamp + FRAME_TIMING_PRESENT_TIMEOUT_NS;
     if (!timing->presentTracked &&
         !(record->readyMask & FRAME_TIMING_PRESENT_READY))
@@ -661,14 +703,146 @@ static void frameTimingPublishReady(void)
       .present     = record->presentTime     * 1e-6f,
     };
     ringbuffer_push(g_state.frameLatency, &timing);
+
+#ifdef ENABLE_TESTS
+    if (l_bench && record->benchCase)
+      bench_sample(l_bench, record->benchCase, &timing);
+#endif
   }
 }
 
+#ifdef ENABLE_TESTS
+static LG_TestCaptureHeader testCaptureHeader(
+    const LG_RendererCapture * capture, uint64_t serial, FrameType sourceType)
+{
+  return (LG_TestCaptureHeader) {
+    .magic         = LG_TEST_CAPTURE_MAGIC,
+    .version       = LG_TEST_CAPTURE_VERSION,
+    .headerSize    = sizeof(LG_TestCaptureHeader),
+    .frameSerial   = serial,
+    .sourceType    = sourceType,
+    .captureFormat = capture->format,
+    .width         = capture->width,
+    .height        = capture->height,
+    .stride        = capture->stride,
+    .flags         = (capture->hdr       ? LG_TEST_CAPTURE_HDR        : 0) |
+                     (capture->hdrPQ     ? LG_TEST_CAPTURE_HDR_PQ     : 0) |
+                     (capture->nativeHDR ? LG_TEST_CAPTURE_NATIVE_HDR : 0) |
+                     LG_TEST_CAPTURE_BOTTOM_UP,
+    .dataSize      = capture->dataSize,
+  };
+}
+
+// unmap the captures the stream has finished writing
+static void testStreamRelease(void)
+{
+  const uint64_t written = captureStream_written(l_testStream.stream);
+  for(; l_testStream.released < written; ++l_testStream.released)
+    RENDERER(captureRelease);
+}
+
+// hand the oldest finished capture to the stream
+static bool testStreamCollect(bool wait)
+{
+  if (l_testStream.mapped == l_testStream.begun)
+    return false;
+
+  LG_RendererCapture capture;
+  if (!RENDERER(captureMap, wait, &capture))
+    return false;
+
+  const uint64_t index = l_testStream.mapped++ % LG_RENDERER_MAX_CAPTURES;
+  const LG_TestCaptureHeader header = testCaptureHeader(&capture,
+      l_testStream.pending[index].serial,
+      l_testStream.pending[index].sourceType);
+
+  if (!captureStream_push(l_testStream.stream, &header, capture.data))
+  {
+    l_testStream.failed = true;
+    return false;
+  }
+  return true;
+}
+
+static bool testStreamFrame(uint64_t serial)
+{
+  if (!g_state.lgr->ops.captureBegin)
+  {
+    DEBUG_ERROR("The selected renderer cannot stream its framebuffer");
+    return false;
+  }
+
+  testStreamRelease();
+  while (testStreamCollect(false))
+    ;
+
+  /* rather than drop this frame when every buffer is busy, wait for the oldest
+   * transfer or write to finish */
+  while (!l_testStream.failed && !RENDERER(captureBegin))
+  {
+    if (testStreamCollect(true))
+      continue;
+
+    if (l_testStream.failed || !captureStream_wait(l_testStream.stream))
+      return false;
+    testStreamRelease();
+  }
+
+  if (l_testStream.failed)
+    return false;
+
+  const uint64_t index = l_testStream.begun++ % LG_RENDERER_MAX_CAPTURES;
+  l_testStream.pending[index].serial     = serial;
+  l_testStream.pending[index].sourceType =
+    atomic_load_explicit(&l_testFrameType, memory_order_acquire);
+  return true;
+}
+
+// must be called on the render thread while the renderer is still alive
+static void testStreamStop(void)
+{
+  if (!l_testStream.stream)
+    return;
+
+  while (!l_testStream.failed && testStreamCollect(true))
+    ;
+
+  const bool written = captureStream_close(&l_testStream.stream) &&
+    !l_testStream.failed && l_testStream.mapped == l_testStream.begun;
+
+  for(; l_testStream.released < l_testStream.mapped; ++l_testStream.released)
+    RENDERER(captureRelease);
+
+  if (!written)
+    DEBUG_ERROR("Failed to write the capture stream to: %s",
+        l_testStream.path);
+  else
+    DEBUG_INFO("Streamed %lu frames to: %s",
+        l_testStream.begun, l_testStream.path);
+}
+#endif
+
 static void preSwapCallback(void * udata)
 {
   (void)udata;
 
 #ifdef ENABLE_TESTS
+  if (l_testStream.stream)
+  {
+    const uint64_t serial =
+      atomic_load_explicit(&l_testFrameSerial, memory_order_acquire);
+    if (serial < l_testStream.targetSerial)
+      return;
+
+    if (!testStreamFrame(serial) ||
+        l_testStream.begun == l_testStream.frames)
+    {
+      testStreamStop();
+      app_setState(APP_STATE_SHUTDOWN);
+    }
+    return;
+  }
+
   if (!l_testCapture.enabled || l_testCapture.complete)
     return;
 
@@ -697,24 +871,8 @@ static void preSwapCallback(void * udata)
     return;
   }
 
-  const FrameType sourceType =
-    atomic_load_explicit(&l_testFrameType, memory_order_acquire);
-  const LG_TestCaptureHeader header = {
-    .magic         = LG_TEST_CAPTURE_MAGIC,
-    .version       = LG_TEST_CAPTURE_VERSION,
-    .headerSize    = sizeof(header),
-    .frameSerial   = serial,
-    .sourceType    = sourceType,
-    .captureFormat = capture.format,
-    .width         = capture.width,
-    .height        = capture.height,
-    .stride        = capture.stride,
-    .flags         = (capture.hdr       ? LG_TEST_CAPTURE_HDR        : 0) |
-                     (capture.hdrPQ     ? LG_TEST_CAPTURE_HDR_PQ     : 0) |
-                     (capture.nativeHDR ? LG_TEST_CAPTURE_NATIVE_HDR : 0) |
-                     LG_TEST_CAPTURE_BOTTOM_UP,
-    .dataSize      = capture.dataSize,
-  };
+  const LG_TestCaptureHeader header = testCaptureHeader(&capture, serial,
+      atomic_load_explicit(&l_testFrameType, memory_order_acquire));
 
   FILE * file = fopen(l_testCapture.path, "wb");
   bool written = false;
@@ -947,6 +1105,7 @@ static int renderThread(void * unused)
   while(likely(app_getState() != APP_STATE_SHUTDOWN))
   {
     LG_RendererFrameToken cadenceToken = LG_RENDERER_FRAME_TOKEN_NONE;
+    RenderDeadline        deadline     = {};
 
     if (g_state.jitRender)
     {
@@ -990,6 +1149,22 @@ static int renderThread(void * unused)
         if (!clientWake)
           cadenceToken = queuedAtWake;
       }
+
+      /* hold the render back until just before the vblank so it picks up
+       * the newest frame and input */
+      if (g_params.jitRenderDeadline)
+      {
+        uint64_t period = 0;
+        if (g_state.ds->getFramePeriod &&
+            g_state.ds->getFramePeriod(&period))
+        {
+          const uint64_t now   = nanotime();
+          const uint64_t start =
+            renderDeadline_target(now, period, &deadline);
+          if (start > now)
+            nsleep(start - now);
+        }
+      }
     }
     else if (g_params.fpsMin != 0)
     {
@@ -1089,6 +1264,9 @@ static int renderThread(void * unused)
     }
     const uint64_t renderEnd = nanotime();
     LG_UNLOCK(g_state.lgrLock);
+    if (g_state.jitRender && g_params.jitRenderDeadline)
+      renderDeadline_rendered((rendererTiming.swapEnd ?
+            rendererTiming.swapEnd : renderEnd) - renderStart);
     renderQueue_presented();
     cursorRepaintRenderEnd(cursorSerial, renderStart, true,
         cursorWake &&
@@ -1100,9 +1278,15 @@ static int renderThread(void * unused)
     if (rendererTiming.frameToken != LG_RENDERER_FRAME_TOKEN_NONE)
       frameTimingFinishRender(
           &rendererTiming, prepareStart, prepareTime, renderEnd,
-          cadenceToken);
+          cadenceToken, &deadline);
     frameTimingPublishReady();
 
+    if (rendererTiming.cursorLatchTime)
+    {
+      const float latch = rendererTiming.cursorLatchTime * 1e-6f;
+      ringbuffer_push(g_state.cursorLatchTimings, &latch);
+    }
+
     const uint64_t t     = nanotime();
     const uint64_t delta = t - g_state.lastRenderTime;
 
@@ -1172,6 +1356,10 @@ static int renderThread(void * unused)
     g_state.videoOps->swSurface->detach(g_state.transport.handle);
   }
 
+#ifdef ENABLE_TESTS
+  testStreamStop();
+#endif
+
   RENDERER(deinitialize);
   g_state.lgr = NULL;
   LG_LOCK_FREE(g_state.lgrLock);
@@ -1469,6 +1657,8 @@ int main_frameThread(void * unused)
       rendererFormat.frameHeight   = format->frameHeight;
       rendererFormat.stride        = format->stride;
       rendererFormat.pitch         = format->pitch;
+      rendererFormat.compressed    = format->compressed;
+      rendererFormat.bufferSize    = format->bufferSize;
       rendererFormat.hdr           = format->hdr;
       rendererFormat.hdrPQ         = format->hdrPQ;
       rendererFormat.hdrMetadata   = format->hdrMetadata;
@@ -1543,11 +1733,11 @@ int main_frameThread(void * unused)
     }
     if (formatChanged)
     {
-      DEBUG_INFO("Format: %s %ux%u (%ux%u) stride:%u pitch:%u rotation:%d hdr:%d pq:%d sdrWhite:%u nits",
+      DEBUG_INFO("Format: %s %ux%u (%ux%u) stride:%u pitch:%u rotation:%d hdr:%d pq:%d sdrWhite:%u nits compressed:%d",
           FrameTypeStr[format->type], format->frameWidth, format->frameHeight,
           format->dataWidth, format->dataHeight, format->stride, format->pitch,
           format->rotation, format->hdr ? 1 : 0, format->hdrPQ ? 1 : 0,
-          rendererFormat.sdrWhiteLevel);
+          rendererFormat.sdrWhiteLevel, format->compressed ? 1 : 0);
 
       LG_LOCK(g_state.lgrLock);
       if (!RENDERER(onFrameFormat, rendererFormat))
@@ -1560,6 +1750,9 @@ int main_frameThread(void * unused)
         primaryWorkerFailed();
         break;
       }
+
+      // the render cost and landing lag learned for the old mode no longer apply
+      renderDeadline_reset();
       rendererSupportsNativeHDR = !rendererFormat.hdr ||
         !g_state.lgr->ops.supports || RENDERER(supports,
           rendererFormat.hdrPQ ? LG_SUPPORTS_HDR_PQ : LG_SUPPORTS_HDR_SCRGB);
@@ -1596,6 +1789,10 @@ int main_frameThread(void * unused)
     g_state.frameImportTime     = 0;
     g_state.frameImportWaitTime = 0;
 
+    /* discard wait phases accumulated outside of the import */
+    FrameBufferWaitStats waitStats;
+    framebuffer_take_wait_stats(&waitStats);
+
     const bool rendererOwnsFrame = frame.dmaFD >= 0 && frame.releaseFn;
     if (!RENDERER(onFrame, frame.framebuffer, frame.dmaFD,
           frame.damageRects, damageCount, frameToken,
@@ -1612,6 +1809,14 @@ int main_frameThread(void * unused)
       primaryWorkerFailed();
       break;
     }
+    framebuffer_take_wait_stats(&waitStats);
+    {
+      const float spin  = waitStats.spinNs  * 1e-6f;
+      const float block = waitStats.blockNs * 1e-6f;
+      ringbuffer_push(g_state.importSpinTimings , &spin );
+      ringbuffer_push(g_state.importBlockTimings, &block);
+    }
+
     /* A DMA snapshot can complete on the render thread immediately after it
      * is signalled below, so sample producer timing while this lease is still
      * unambiguously owned by the frame thread. */
@@ -3505,6 +3710,7 @@ static int lg_run(void)
 
 #ifdef ENABLE_TESTS
   memset(&l_testCapture, 0, sizeof(l_testCapture));
+  memset(&l_testStream , 0, sizeof(l_testStream ));
   atomic_store_explicit(&l_testFrameSerial, 0, memory_order_relaxed);
   atomic_store_explicit(&l_testFrameType, FRAME_TYPE_INVALID,
       memory_order_relaxed);
@@ -3526,6 +3732,27 @@ static int lg_run(void)
       l_testCapture.delay        = captureDelay;
       l_testCapture.enabled      = true;
     }
+
+    const char * streamPath = option_get_string("test", "captureStream");
+    const int streamFrames  = option_get_int("test", "captureStreamFrames");
+    if (streamPath)
+    {
+      if (capturePath || captureFrame < 0 || streamFrames < 0)
+      {
+        DEBUG_ERROR("test:captureStream excludes captureFile and requires "
+            "captureFrame >= 0 and captureStreamFrames >= 0");
+        return -1;
+      }
+      l_testStream.path         = streamPath;
+      l_testStream.targetSerial = max(captureFrame, 1);
+      l_testStream.frames       = streamFrames;
+      if (!captureStream_open(&l_testStream.stream, streamPath))
+        return -1;
+    }
+
+    if (option_get_int("test", "bench") > 0 &&
+        !bench_create(&l_bench, option_get_string("test", "benchFile")))
+      return -1;
   }
 #endif
 
@@ -3559,12 +3786,28 @@ static int lg_run(void)
   }
   DEBUG_INFO("Using font: %s", g_state.fontName);
 
+  if (g_params.importThreads > 1 &&
+      !framebuffer_set_read_threads(g_params.importThreads))
+    DEBUG_WARN("Failed to start the import threads, using a single thread");
+
+  if (!framebuffer_set_read_kernel(g_params.importKernel))
+    DEBUG_WARN("Falling back to the memcpy import kernel");
+
   // initialize metrics ringbuffers
   g_state.renderTimings = ringbuffer_new(256, sizeof(float));
   g_state.frameLatency  = ringbuffer_new(4096, sizeof(OverlayFrameTiming));
   overlayGraph_setCompact(overlayGraph_register(
         "FRAME", g_state.renderTimings, 0.0f, 50.0f, NULL), true);
   overlayGraph_registerFrameTiming("FRAME LATENCY", g_state.frameLatency);
+  g_state.importSpinTimings  = ringbuffer_new(256, sizeof(float));
+  g_state.importBlockTimings = ringbuffer_new(256, sizeof(float));
+  g_state.cursorLatchTimings = ringbuffer_new(256, sizeof(float));
+  overlayGraph_setCompact(overlayGraph_register(
+        "IMPORT SPIN", g_state.importSpinTimings, 0.0f, 1.0f, NULL), true);
+  overlayGraph_setCompact(overlayGraph_register(
+        "IMPORT BLOCK", g_state.importBlockTimings, 0.0f, 10.0f, NULL), true);
+  overlayGraph_setCompact(overlayGraph_register(
+        "CURSOR LATCH", g_state.cursorLatchTimings, 0.0f, 20.0f, NULL), true);
 
   // unknown guest OS at this time
   g_state.guestOS = LG_TRANSPORT_OS_OTHER;
@@ -3675,6 +3918,7 @@ static int lg_run(void)
     g_state.videoOps->type == LG_VIDEO_TYPE_SW_SURFACE;
   g_state.videoSource[LG_VIDEO_SOURCE_FALLBACK].swSurface = true;
   frameScheduler_init();
+  renderDeadline_init();
 
   g_state.micDefaultState = g_params.micDefaultState;
 
@@ -4159,6 +4403,14 @@ static void lg_shutdown(void)
     lgJoinThread(t_render, NULL);
   }
 
+#ifdef ENABLE_TESTS
+  // nothing is published once the render thread has stopped
+  bench_free(&l_bench);
+
+  // only left open if the renderer never started, nothing is mapped
+  captureStream_close(&l_testStream.stream);
+#endif
+
   // Stop external input callbacks before tearing down shared client state
   evdev_stop();
   if (g_state.ds && g_state.dsInitialized)
@@ -4242,10 +4494,15 @@ static void lg_shutdown(void)
   LG_LOCK_FREE(g_state.videoSourceLock);
   LG_LOCK_FREE(g_state.videoSplashLock);
   frameScheduler_free();
+  renderDeadline_free();
 
   // free metrics ringbuffers
+  framebuffer_set_read_threads(0);
   ringbuffer_free(&g_state.renderTimings);
   ringbuffer_free(&g_state.frameLatency);
+  ringbuffer_free(&g_state.importSpinTimings);
+  ringbuffer_free(&g_state.importBlockTimings);
+  ringbuffer_free(&g_state.cursorLatchTimings);
   LG_LOCK_FREE(l_frameTiming.lock);
 
   free(g_state.fontName);
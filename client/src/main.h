@@ -174,6 +174,9 @@ struct AppState
   bool                  lastRenderTimeValid;
   RingBuffer            renderTimings;
   RingBuffer            frameLatency;
+  RingBuffer            importSpinTimings;
+  RingBuffer            importBlockTimings;
+  RingBuffer            cursorLatchTimings;
   uint64_t              frameImportTime;
   uint64_t              frameImportWaitTime;
 
@@ -235,10 +238,13 @@ struct AppParams
   const char *         uiFont;
   int                  uiSize;
   bool                 jitRender;
+  bool                 jitRenderDeadline;
   bool                 requestActivation;
   bool                 disableWaitingMessage;
 
   const char         * transport;
+  int                  importThreads;
+  const char         * importKernel;
 
   bool                 forceRenderer;
   unsigned int         forceRendererIndex;
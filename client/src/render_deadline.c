@@ -0,0 +1,222 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "render_deadline.h"
+
+#include "common/locking.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RENDER_DEADLINE_SAMPLES         128
+#define RENDER_DEADLINE_MIN_SAMPLES     16
+#define RENDER_DEADLINE_MIN_PERIOD_NS   2000000ULL
+#define RENDER_DEADLINE_MAX_PERIOD_NS   1000000000ULL
+#define RENDER_DEADLINE_STALE_NS        500000000ULL
+#define RENDER_DEADLINE_MIN_MARGIN_NS   1000000ULL
+#define RENDER_DEADLINE_MARGIN_STEP_NS  100000ULL
+#define RENDER_DEADLINE_HIT_RUN         60U
+#define RENDER_DEADLINE_HIT_RUN_MAX     3840U
+
+static struct
+{
+  LG_Lock lock;
+
+  uint32_t epoch;
+  uint64_t period;
+  uint64_t vblank;
+
+  uint64_t cost[RENDER_DEADLINE_SAMPLES];
+  unsigned costCount;
+  unsigned costPos;
+  uint64_t budget;
+  bool     budgetDirty;
+
+  uint64_t margin;
+  int64_t  baseLag;
+  bool     baseLagValid;
+  unsigned hits;
+  unsigned hitRun;
+}
+l_renderDeadline;
+
+static int costCompare(const void * a, const void * b)
+{
+  const uint64_t left  = *(const uint64_t *)a;
+  const uint64_t right = *(const uint64_t *)b;
+  return left < right ? -1 : left > right;
+}
+
+static void updateBudget(void)
+{
+  uint64_t sorted[RENDER_DEADLINE_SAMPLES];
+  const unsigned count = l_renderDeadline.costCount;
+  memcpy(sorted, l_renderDeadline.cost, count * sizeof(*sorted));
+  qsort(sorted, count, sizeof(*sorted), costCompare);
+
+  l_renderDeadline.budget      = sorted[(count * 99 + 99) / 100 - 1];
+  l_renderDeadline.budgetDirty = false;
+}
+
+/* Start over with the margin wide enough that no render is delayed. */
+static void resetLearning(uint64_t period)
+{
+  ++l_renderDeadline.epoch;
+  l_renderDeadline.period       = period;
+  l_renderDeadline.margin       = period;
+  l_renderDeadline.baseLagValid = false;
+  l_renderDeadline.hits         = 0;
+  l_renderDeadline.hitRun       = RENDER_DEADLINE_HIT_RUN;
+}
+
+void renderDeadline_init(void)
+{
+  memset(&l_renderDeadline, 0, sizeof(l_renderDeadline));
+  LG_LOCK_INIT(l_renderDeadline.lock);
+}
+
+void renderDeadline_free(void)
+{
+  LG_LOCK_FREE(l_renderDeadline.lock);
+}
+
+void renderDeadline_reset(void)
+{
+  LG_LOCK(l_renderDeadline.lock);
+  resetLearning(0);
+  l_renderDeadline.vblank    = 0;
+  l_renderDeadline.costCount = 0;
+  l_renderDeadline.costPos   = 0;
+  LG_UNLOCK(l_renderDeadline.lock);
+}
+
+uint64_t renderDeadline_target(uint64_t now, uint64_t period,
+    RenderDeadline * deadline)
+{
+  *deadline = (RenderDeadline) {};
+  if (period < RENDER_DEADLINE_MIN_PERIOD_NS ||
+      period > RENDER_DEADLINE_MAX_PERIOD_NS)
+    return now;
+
+  LG_LOCK(l_renderDeadline.lock);
+  const uint64_t vblank = l_renderDeadline.vblank;
+  if (!vblank || (now > vblank && now - vblank > RENDER_DEADLINE_STALE_NS) ||
+      l_renderDeadline.costCount < RENDER_DEADLINE_MIN_SAMPLES)
+  {
+    LG_UNLOCK(l_renderDeadline.lock);
+    return now;
+  }
+
+  const uint64_t delta = l_renderDeadline.period > period ?
+    l_renderDeadline.period - period : period - l_renderDeadline.period;
+  if (delta > l_renderDeadline.period / 20)
+    resetLearning(period);
+
+  if (l_renderDeadline.budgetDirty)
+    updateBudget();
+
+  /* Only ever hold a render back within the current period. Aiming at a
+   * later vblank instead would present the frame later than rendering now. */
+  uint64_t next = vblank;
+  if (next <= now)
+    next += ((now - next) / period + 1) * period;
+  else
+    next -= ((next - now - 1) / period) * period;
+
+  const uint64_t lead  = l_renderDeadline.budget + l_renderDeadline.margin;
+  const uint64_t start = next - now > lead ? next - lead : now;
+
+  deadline->vblank  = next;
+  deadline->epoch   = l_renderDeadline.epoch;
+  deadline->delayed = start > now;
+  LG_UNLOCK(l_renderDeadline.lock);
+  return start;
+}
+
+void renderDeadline_rendered(uint64_t cost)
+{
+  LG_LOCK(l_renderDeadline.lock);
+  l_renderDeadline.cost[l_renderDeadline.costPos] = cost;
+  l_renderDeadline.costPos =
+    (l_renderDeadline.costPos + 1) % RENDER_DEADLINE_SAMPLES;
+  if (l_renderDeadline.costCount < RENDER_DEADLINE_SAMPLES)
+    ++l_renderDeadline.costCount;
+  l_renderDeadline.budgetDirty = true;
+  LG_UNLOCK(l_renderDeadline.lock);
+}
+
+void renderDeadline_presented(const RenderDeadline * deadline,
+    uint64_t presentTime)
+{
+  LG_LOCK(l_renderDeadline.lock);
+  if (presentTime > l_renderDeadline.vblank)
+    l_renderDeadline.vblank = presentTime;
+
+  const int64_t period = (int64_t)l_renderDeadline.period;
+  if (!deadline->vblank || !period ||
+      deadline->epoch != l_renderDeadline.epoch)
+  {
+    LG_UNLOCK(l_renderDeadline.lock);
+    return;
+  }
+
+  /* the number of whole periods the frame landed after the aimed vblank */
+  const int64_t offset = (int64_t)(presentTime - deadline->vblank);
+  const int64_t lag    = offset >= -period / 2 ?
+    (offset + period / 2) / period : -((-offset + period / 2) / period);
+
+  if (!l_renderDeadline.baseLagValid || lag < l_renderDeadline.baseLag)
+  {
+    l_renderDeadline.baseLag      = lag;
+    l_renderDeadline.baseLagValid = true;
+  }
+
+  if (lag == l_renderDeadline.baseLag)
+  {
+    if (++l_renderDeadline.hits >= l_renderDeadline.hitRun)
+    {
+      uint64_t step = l_renderDeadline.margin / 8;
+      if (step < RENDER_DEADLINE_MARGIN_STEP_NS)
+        step = RENDER_DEADLINE_MARGIN_STEP_NS;
+
+      l_renderDeadline.margin =
+        l_renderDeadline.margin > RENDER_DEADLINE_MIN_MARGIN_NS + step ?
+          l_renderDeadline.margin - step : RENDER_DEADLINE_MIN_MARGIN_NS;
+      l_renderDeadline.hits = 0;
+    }
+  }
+  else if (deadline->delayed)
+  {
+    /* The delay cost this frame a vblank. Back off quickly and wait longer
+     * before trying to tighten the margin again. */
+    l_renderDeadline.hits = 0;
+    l_renderDeadline.margin *= 2;
+    if (l_renderDeadline.margin >= (uint64_t)period)
+    {
+      /* the base lag may have changed, learn it again */
+      l_renderDeadline.margin       = period;
+      l_renderDeadline.baseLagValid = false;
+    }
+
+    if (l_renderDeadline.hitRun < RENDER_DEADLINE_HIT_RUN_MAX)
+      l_renderDeadline.hitRun *= 2;
+  }
+  LG_UNLOCK(l_renderDeadline.lock);
+}
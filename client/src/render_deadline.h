@@ -0,0 +1,66 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef _H_LG_RENDER_DEADLINE_
+#define _H_LG_RENDER_DEADLINE_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Schedules just-in-time renders against the predicted vblank. The vblank
+ * phase comes from presentation feedback and the render cost is the p99 of
+ * the recent render to swap times. A render that lands on a later vblank than
+ * the earlier ones did while it was delayed widens the safety margin, which
+ * then shrinks again slowly while frames keep landing on time.
+ */
+
+typedef struct RenderDeadline
+{
+  uint64_t vblank;  /* the vblank the render is aimed at, zero if none */
+  uint32_t epoch;   /* the learning state the aim was made with */
+  bool     delayed; /* the render was held back to meet it */
+}
+RenderDeadline;
+
+void renderDeadline_init(void);
+void renderDeadline_free(void);
+
+/* forget everything learned, call when the source format changes */
+void renderDeadline_reset(void);
+
+/**
+ * Returns the time to start the next render at for an output of `period`,
+ * which is `now` if it should not be delayed.
+ */
+uint64_t renderDeadline_target(uint64_t now, uint64_t period,
+    RenderDeadline * deadline);
+
+/* record the render start to swap return time of a render */
+void renderDeadline_rendered(uint64_t cost);
+
+/**
+ * Record the time a render aimed at `deadline` was presented at. The
+ * presentation time must be on the nanotime clock.
+ */
+void renderDeadline_presented(const RenderDeadline * deadline,
+    uint64_t presentTime);
+
+#endif
@@ -91,6 +91,7 @@ typedef struct RenderCommand
       int               width;
       int               height;
       int               pitch;
+      int               slab;
       uint8_t         * data;
     }
     cursorImage;
@@ -124,11 +125,31 @@ typedef enum RenderQueueInvalidate
 }
 RenderQueueInvalidate;
 
-static RenderCommand        * l_renderQueueHead;
-static RenderCommand        * l_renderQueueTail;
-static LG_Lock                l_renderQueueLock;
-static bool                   l_renderQueueInitialized;
-static RenderQueueInvalidate l_renderQueueInvalidate;
+/* Commands are passed to the render thread through a bounded MPSC ring of
+ * preallocated slots, each with a sequence that says whether it is free for
+ * the position a producer reserved or holds a command for the consumer. If
+ * the ring fills, because the render thread is stalled, commands spill into
+ * a locked overflow list and all producers use it until it has been drained
+ * after the ring, so that ordering is kept. */
+#define RENDER_QUEUE_LENGTH 256
+
+typedef struct RenderQueueSlot
+{
+  _Atomic(uint64_t) sequence;
+  RenderCommand     cmd;
+}
+RenderQueueSlot;
+
+static RenderQueueSlot   l_renderQueue[RENDER_QUEUE_LENGTH];
+static _Atomic(uint64_t) l_renderQueueHead;
+static uint64_t          l_renderQueueTail;
+static atomic_int        l_renderQueueInvalidate;
+static bool              l_renderQueueInitialized;
+
+static RenderCommand * l_overflowHead;
+static RenderCommand * l_overflowTail;
+static atomic_bool     l_overflowActive;
+static LG_Lock         l_overflowLock;
 
 typedef struct RenderQueueSwSurface
 {
@@ -148,8 +169,7 @@ typedef struct RenderQueueSwSurface
   int             damageCount;
   FrameDamageRect damage[LG_MAX_FRAME_DAMAGE_RECTS];
 
-  bool          updateQueued;
-  RenderCommand updateCommand;
+  bool updateQueued;
 }
 RenderQueueSwSurface;
 
@@ -158,16 +178,6 @@ static RenderQueueSource    l_swSurfaceResidentSource;
 static uint64_t             l_swSurfaceResidentGeneration;
 static uint64_t             l_swSurfaceResidentEpoch;
 
-static RenderQueueSwSurface * swSurfaceFromUpdateCommand(
-    const RenderCommand * cmd)
-{
-  for (int i = 0; i < RENDER_QUEUE_SOURCE_COUNT; ++i)
-    if (cmd == &l_swSurface[i].updateCommand)
-      return &l_swSurface[i];
-
-  return NULL;
-}
-
 static bool              l_showSwSurface;
 static bool              l_surfaceFormatValid;
 static bool              l_rendererSupportsNativeHDR;
@@ -216,6 +226,7 @@ typedef struct RenderQueueCursor
   int               width;
   int               height;
   int               pitch;
+  int               slab;
   uint8_t         * data;
 
   uint64_t         colorGeneration;
@@ -237,8 +248,59 @@ typedef struct RenderQueueFormat
 }
 RenderQueueFormat;
 
-static RenderQueueCursor l_cursor[RENDER_QUEUE_SOURCE_COUNT];
-static RenderQueueFormat l_format[RENDER_QUEUE_SOURCE_COUNT];
+typedef struct RenderQueueCursorState
+{
+  uint64_t generation;
+  uint64_t cursorGeneration;
+  bool     visible;
+  int      x;
+  int      y;
+  int      hx;
+  int      hy;
+}
+RenderQueueCursorState;
+
+/* Cursor movement is the bulk of the traffic, so successive states from the
+ * same generations collapse into the one queued command and the render thread
+ * takes the latest position from here. Writers hold the lock, the state is
+ * also published through a seqlock so that the render thread can late latch
+ * it while drawing without waiting on a producer. */
+typedef struct RenderQueueCursorUpdate
+{
+  LG_Lock lock;
+  bool    queued;
+
+  atomic_uint       sequence;
+  _Atomic(uint64_t) generation;
+  _Atomic(uint64_t) cursorGeneration;
+  atomic_bool       visible;
+  atomic_int        x;
+  atomic_int        y;
+  atomic_int        hx;
+  atomic_int        hy;
+}
+RenderQueueCursorUpdate;
+
+#define RENDER_QUEUE_LATCH_RETRIES 16
+
+/* Cursor images are copied into per-source slabs that are handed to the render
+ * thread and returned once the image has been replaced. A shape that arrives
+ * while every slab is in use gets its own allocation (slab -1). */
+#define RENDER_QUEUE_CURSOR_SLABS 4
+
+typedef struct RenderQueueCursorSlab
+{
+  size_t    size;
+  uint8_t * data;
+}
+RenderQueueCursorSlab;
+
+static RenderQueueCursor       l_cursor      [RENDER_QUEUE_SOURCE_COUNT];
+static RenderQueueCursorUpdate l_cursorUpdate[RENDER_QUEUE_SOURCE_COUNT];
+static RenderQueueCursorSlab   l_cursorSlab  [RENDER_QUEUE_SOURCE_COUNT]
+                                             [RENDER_QUEUE_CURSOR_SLABS];
+static atomic_uint             l_cursorSlabFree[RENDER_QUEUE_SOURCE_COUNT];
+static RenderQueueFormat       l_format      [RENDER_QUEUE_SOURCE_COUNT];
 static const LGColorTransform l_identityColorTransform;
 
 static bool sourceValid(RenderQueueSource source)
@@ -397,51 +459,137 @@ static void swSurfaceDamageAdd(RenderQueueSwSurface * surface,
   }
 }
 
-static void freeCommand(RenderCommand * cmd)
+static void releaseCursorSlab(RenderQueueSource source, int slab)
 {
-  if (cmd->op == SW_SURFACE_OP_UPDATE)
+  atomic_fetch_or_explicit(&l_cursorSlabFree[source], 1u << slab,
+      memory_order_release);
+}
+
+static void releaseCursorImage(RenderQueueSource source, int slab,
+    uint8_t * data)
+{
+  if (!data)
     return;
 
+  if (slab < 0)
+    free(data);
+  else
+    releaseCursorSlab(source, slab);
+}
+
+/* Releases the payload of a command that was consumed or dropped. */
+static void releaseCommand(RenderCommand * cmd)
+{
   switch (cmd->op)
   {
     case CURSOR_OP_IMAGE:
-      free(cmd->cursorImage.data);
+      releaseCursorImage(cmd->source, cmd->cursorImage.slab,
+          cmd->cursorImage.data);
+      cmd->cursorImage.data = NULL;
       break;
 
     case CURSOR_OP_COLOR_TRANSFORM:
       free(cmd->cursorColorTransform.data);
+      cmd->cursorColorTransform.data = NULL;
       break;
 
     default:
       break;
   }
+}
+
+static bool ringPush(const RenderCommand * cmd)
+{
+  uint64_t pos = atomic_load_explicit(
+      &l_renderQueueHead, memory_order_relaxed);
+  for (;;)
+  {
+    RenderQueueSlot * slot = &l_renderQueue[pos % RENDER_QUEUE_LENGTH];
+    const uint64_t sequence = atomic_load_explicit(
+        &slot->sequence, memory_order_acquire);
+    const int64_t diff = (int64_t)(sequence - pos);
+    if (diff < 0)
+      return false;
+
+    if (diff > 0)
+    {
+      pos = atomic_load_explicit(&l_renderQueueHead, memory_order_relaxed);
+      continue;
+    }
 
-  free(cmd);
+    if (atomic_compare_exchange_weak_explicit(&l_renderQueueHead,
+          &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+    {
+      slot->cmd = *cmd;
+      atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+      return true;
+    }
+  }
 }
 
-static bool queueCommand(RenderCommand * cmd,
-    RenderQueueInvalidate invalidate)
+/* Only called on the render thread. */
+static bool ringPop(RenderCommand * cmd)
 {
-  bool wake = false;
-  cmd->next = NULL;
+  RenderQueueSlot * slot =
+    &l_renderQueue[l_renderQueueTail % RENDER_QUEUE_LENGTH];
+  if (atomic_load_explicit(&slot->sequence, memory_order_acquire) !=
+      l_renderQueueTail + 1)
+    return false;
 
-  LG_LOCK(l_renderQueueLock);
-  if (l_renderQueueTail)
-    l_renderQueueTail->next = cmd;
-  else
-    l_renderQueueHead = cmd;
-  l_renderQueueTail = cmd;
+  *cmd = slot->cmd;
+  atomic_store_explicit(&slot->sequence,
+      l_renderQueueTail + RENDER_QUEUE_LENGTH, memory_order_release);
+  ++l_renderQueueTail;
+  return true;
+}
+
+static bool raiseInvalidate(RenderQueueInvalidate invalidate)
+{
+  int current = atomic_load_explicit(
+      &l_renderQueueInvalidate, memory_order_relaxed);
+  while ((int)invalidate > current)
+    if (atomic_compare_exchange_weak_explicit(&l_renderQueueInvalidate,
+          &current, invalidate, memory_order_acq_rel, memory_order_relaxed))
+      return true;
+
+  return false;
+}
 
-  if (invalidate > l_renderQueueInvalidate)
+/* Returns false if the command could not be queued, in which case its payload
+ * has been released. */
+static bool queueCommand(RenderCommand * cmd,
+    RenderQueueInvalidate invalidate, bool * wake)
+{
+  *wake = false;
+  if (atomic_load_explicit(&l_overflowActive, memory_order_acquire) ||
+      !ringPush(cmd))
   {
-    l_renderQueueInvalidate = invalidate;
-    wake = true;
+    RenderCommand * copy = malloc(sizeof(*copy));
+    if (!copy)
+    {
+      DEBUG_ERROR("Failed to allocate a render queue overflow command");
+      releaseCommand(cmd);
+      return false;
+    }
+
+    *copy      = *cmd;
+    copy->next = NULL;
+
+    LG_LOCK(l_overflowLock);
+    if (l_overflowTail)
+      l_overflowTail->next = copy;
+    else
+      l_overflowHead = copy;
+    l_overflowTail = copy;
+    atomic_store_explicit(&l_overflowActive, true, memory_order_release);
+    LG_UNLOCK(l_overflowLock);
   }
-  LG_UNLOCK(l_renderQueueLock);
-  return wake;
+
+  *wake = raiseInvalidate(invalidate);
+  return true;
 }
 
-/* The surface lock must be held while its embedded command is queued. */
+/* The surface lock must be held while its update command is queued. */
 static bool queueSwSurfaceUpdate(RenderQueueSource source,
     RenderQueueSwSurface * surface)
 {
@@ -449,13 +597,18 @@ static bool queueSwSurfaceUpdate(RenderQueueSource source,
       !swSurfaceDamagePending(surface))
     return false;
 
-  RenderCommand * cmd = &surface->updateCommand;
-  cmd->source                = source;
-  cmd->generation            = surface->generation;
-  cmd->op                    = SW_SURFACE_OP_UPDATE;
-  cmd->swSurfaceUpdate.epoch = surface->epoch;
-  surface->updateQueued      = true;
-  return queueCommand(cmd, RENDER_QUEUE_INVALIDATE_PARTIAL);
+  RenderCommand cmd =
+  {
+    .source                = source,
+    .generation            = surface->generation,
+    .op                    = SW_SURFACE_OP_UPDATE,
+    .swSurfaceUpdate.epoch = surface->epoch,
+  };
+
+  bool wake;
+  surface->updateQueued =
+    queueCommand(&cmd, RENDER_QUEUE_INVALIDATE_PARTIAL, &wake);
+  return wake;
 }
 
 static void wakeQueue(bool wake)
@@ -467,19 +620,29 @@ static void wakeQueue(bool wake)
 static void enqueueCommand(RenderCommand * cmd,
     RenderQueueInvalidate invalidate)
 {
-  wakeQueue(queueCommand(cmd, invalidate));
+  bool wake;
+  queueCommand(cmd, invalidate, &wake);
+  wakeQueue(wake);
 }
 
-static RenderCommand * detachCommands(RenderQueueInvalidate * invalidate)
+/* Overflow commands were queued after everything in the ring, so they are only
+ * taken once the ring has been drained. */
+static RenderCommand * detachOverflow(void)
 {
-  LG_LOCK(l_renderQueueLock);
-  RenderCommand * head    = l_renderQueueHead;
-  if (invalidate)
-    *invalidate = l_renderQueueInvalidate;
-  l_renderQueueHead       = NULL;
-  l_renderQueueTail       = NULL;
-  l_renderQueueInvalidate = RENDER_QUEUE_INVALIDATE_NONE;
-  LG_UNLOCK(l_renderQueueLock);
+  if (!atomic_load_explicit(&l_overflowActive, memory_order_acquire))
+    return NULL;
+
+  RenderCommand * head = NULL;
+  LG_LOCK(l_overflowLock);
+  if (l_renderQueueTail == atomic_load_explicit(
+        &l_renderQueueHead, memory_order_acquire))
+  {
+    head           = l_overflowHead;
+    l_overflowHead = NULL;
+    l_overflowTail = NULL;
+    atomic_store_explicit(&l_overflowActive, false, memory_order_release);
+  }
+  LG_UNLOCK(l_overflowLock);
   return head;
 }
 
@@ -492,6 +655,22 @@ static void setCommandSource(RenderCommand * cmd, RenderQueueSource source,
       &l_cursorGeneration[source], memory_order_acquire) : 0;
 }
 
+static int claimCursorSlab(RenderQueueSource source)
+{
+  unsigned int mask = atomic_load_explicit(
+      &l_cursorSlabFree[source], memory_order_relaxed);
+  while (mask)
+  {
+    const int slab = __builtin_ctz(mask);
+    if (atomic_compare_exchange_weak_explicit(&l_cursorSlabFree[source],
+          &mask, mask & ~(1u << slab), memory_order_acquire,
+          memory_order_relaxed))
+      return slab;
+  }
+
+  return -1;
+}
+
 static bool copyCursorImage(RenderCommand * cmd, const void * data)
 {
   if (!data || cmd->cursorImage.width <= 0 ||
@@ -504,11 +683,30 @@ static bool copyCursorImage(RenderCommand * cmd, const void * data)
 
   const size_t size =
     (size_t)cmd->cursorImage.height * (size_t)cmd->cursorImage.pitch;
-  cmd->cursorImage.data = malloc(size);
-  if (!cmd->cursorImage.data)
+  const int slab = claimCursorSlab(cmd->source);
+  uint8_t * buffer;
+  if (slab < 0)
+    buffer = malloc(size);
+  else
+  {
+    RenderQueueCursorSlab * cursorSlab = &l_cursorSlab[cmd->source][slab];
+    if (cursorSlab->size < size)
+    {
+      free(cursorSlab->data);
+      cursorSlab->data = malloc(size);
+      cursorSlab->size = cursorSlab->data ? size : 0;
+    }
+    buffer = cursorSlab->data;
+    if (!buffer)
+      releaseCursorSlab(cmd->source, slab);
+  }
+
+  if (!buffer)
     return false;
 
-  memcpy(cmd->cursorImage.data, data, size);
+  memcpy(buffer, data, size);
+  cmd->cursorImage.slab = slab;
+  cmd->cursorImage.data = buffer;
   return true;
 }
 
@@ -559,11 +757,115 @@ static void updateSurfaceFormat(void)
     atomic_store(&g_state.hdrDescFailed, false);
 }
 
+/* The update lock must be held. */
+static void writeCursorUpdate(RenderQueueCursorUpdate * update,
+    const RenderQueueCursorState * state)
+{
+  const unsigned int sequence = atomic_load_explicit(
+      &update->sequence, memory_order_relaxed);
+  atomic_store_explicit(&update->sequence, sequence + 1,
+      memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  atomic_store_explicit(&update->generation, state->generation,
+      memory_order_relaxed);
+  atomic_store_explicit(&update->cursorGeneration, state->cursorGeneration,
+      memory_order_relaxed);
+  atomic_store_explicit(&update->visible, state->visible,
+      memory_order_relaxed);
+  atomic_store_explicit(&update->x , state->x , memory_order_relaxed);
+  atomic_store_explicit(&update->y , state->y , memory_order_relaxed);
+  atomic_store_explicit(&update->hx, state->hx, memory_order_relaxed);
+  atomic_store_explicit(&update->hy, state->hy, memory_order_relaxed);
+
+  atomic_store_explicit(&update->sequence, sequence + 2,
+      memory_order_release);
+}
+
+/* Gives up rather than wait on a writer that was preempted mid update. */
+static bool readCursorUpdate(RenderQueueCursorUpdate * update,
+    RenderQueueCursorState * state)
+{
+  for (int i = 0; i < RENDER_QUEUE_LATCH_RETRIES; ++i)
+  {
+    const unsigned int sequence = atomic_load_explicit(
+        &update->sequence, memory_order_acquire);
+    if (sequence & 1)
+      continue;
+
+    state->generation = atomic_load_explicit(
+        &update->generation, memory_order_relaxed);
+    state->cursorGeneration = atomic_load_explicit(
+        &update->cursorGeneration, memory_order_relaxed);
+    state->visible = atomic_load_explicit(
+        &update->visible, memory_order_relaxed);
+    state->x  = atomic_load_explicit(&update->x , memory_order_relaxed);
+    state->y  = atomic_load_explicit(&update->y , memory_order_relaxed);
+    state->hx = atomic_load_explicit(&update->hx, memory_order_relaxed);
+    state->hy = atomic_load_explicit(&update->hy, memory_order_relaxed);
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&update->sequence, memory_order_relaxed) ==
+        sequence)
+      return true;
+  }
+
+  return false;
+}
+
+/* Fills in the latest position for a queued CURSOR_OP_STATE. Returns false if
+ * the state was replaced by a later command. */
+static bool takeCursorState(RenderCommand * cmd)
+{
+  RenderQueueCursorUpdate * update = &l_cursorUpdate[cmd->source];
+  RenderQueueCursorState    state;
+  LG_LOCK(update->lock);
+  const bool current = update->queued &&
+    readCursorUpdate(update, &state) &&
+    state.generation       == cmd->generation &&
+    state.cursorGeneration == cmd->cursorGeneration;
+  if (current)
+  {
+    update->queued           = false;
+    cmd->cursorState.visible = state.visible;
+    cmd->cursorState.x       = state.x;
+    cmd->cursorState.y       = state.y;
+    cmd->cursorState.hx      = state.hx;
+    cmd->cursorState.hy      = state.hy;
+  }
+  LG_UNLOCK(update->lock);
+  return current;
+}
+
+/* Discards a command without applying it. */
+static void dropCommand(RenderCommand * cmd)
+{
+  if (cmd->op == SW_SURFACE_OP_UPDATE)
+  {
+    RenderQueueSwSurface * surface = &l_swSurface[cmd->source];
+    LG_LOCK(surface->lock);
+    surface->updateQueued = false;
+    LG_UNLOCK(surface->lock);
+  }
+  else if (cmd->op == CURSOR_OP_STATE && sourceValid(cmd->source))
+    takeCursorState(cmd);
+
+  releaseCommand(cmd);
+}
+
 void renderQueue_init(void)
 {
-  l_renderQueueHead           = NULL;
-  l_renderQueueTail           = NULL;
-  l_renderQueueInvalidate     = RENDER_QUEUE_INVALIDATE_NONE;
+  for (int i = 0; i < RENDER_QUEUE_LENGTH; ++i)
+    atomic_store_explicit(&l_renderQueue[i].sequence, i,
+        memory_order_relaxed);
+  atomic_store_explicit(&l_renderQueueHead, 0, memory_order_relaxed);
+  l_renderQueueTail = 0;
+  atomic_store_explicit(&l_renderQueueInvalidate,
+      RENDER_QUEUE_INVALIDATE_NONE, memory_order_relaxed);
+  l_overflowHead = NULL;
+  l_overflowTail = NULL;
+  atomic_store_explicit(&l_overflowActive, false, memory_order_relaxed);
+
   l_showSwSurface             = false;
   l_surfaceFormatValid        = false;
   l_rendererSupportsNativeHDR = false;
@@ -582,6 +884,8 @@ void renderQueue_init(void)
   l_pendingTransition         = (RenderQueueTransition) {};
   memset(&l_surfaceFormat, 0, sizeof(l_surfaceFormat));
   memset(l_cursor, 0, sizeof(l_cursor));
+  memset(l_cursorUpdate, 0, sizeof(l_cursorUpdate));
+  memset(l_cursorSlab, 0, sizeof(l_cursorSlab));
   memset(l_format, 0, sizeof(l_format));
   memset(l_swSurface, 0, sizeof(l_swSurface));
 
@@ -589,10 +893,13 @@ void renderQueue_init(void)
   {
     atomic_store_explicit(&l_sourceGeneration[i], 0, memory_order_relaxed);
     atomic_store_explicit(&l_cursorGeneration[i], 1, memory_order_relaxed);
+    atomic_store_explicit(&l_cursorSlabFree[i],
+        (1u << RENDER_QUEUE_CURSOR_SLABS) - 1, memory_order_relaxed);
     LG_LOCK_INIT(l_swSurface[i].lock);
+    LG_LOCK_INIT(l_cursorUpdate[i].lock);
   }
   atomic_store_explicit(&l_transitionSerial, 0, memory_order_relaxed);
-  LG_LOCK_INIT(l_renderQueueLock);
+  LG_LOCK_INIT(l_overflowLock);
   LG_LOCK_INIT(l_sourceLock);
   LG_LOCK_INIT(l_transitionLock);
   l_renderQueueInitialized = true;
@@ -607,35 +914,45 @@ void renderQueue_free(void)
 
   for (int i = 0; i < RENDER_QUEUE_SOURCE_COUNT; ++i)
   {
-    free(l_cursor[i].data);
+    releaseCursorImage(i, l_cursor[i].slab, l_cursor[i].data);
     l_cursor[i].data = NULL;
+    for (int j = 0; j < RENDER_QUEUE_CURSOR_SLABS; ++j)
+    {
+      free(l_cursorSlab[i][j].data);
+      l_cursorSlab[i][j].data = NULL;
+      l_cursorSlab[i][j].size = 0;
+    }
     free(l_swSurface[i].data);
     l_swSurface[i].data = NULL;
     LG_LOCK_FREE(l_swSurface[i].lock);
+    LG_LOCK_FREE(l_cursorUpdate[i].lock);
   }
 
   l_renderQueueInitialized = false;
-  LG_LOCK_FREE(l_renderQueueLock);
+  LG_LOCK_FREE(l_overflowLock);
   LG_LOCK_FREE(l_sourceLock);
   LG_LOCK_FREE(l_transitionLock);
 }
 
 void renderQueue_clear(void)
 {
-  RenderCommand * cmd = detachCommands(NULL);
-  while(cmd)
+  RenderCommand cmd;
+  while (ringPop(&cmd))
+    dropCommand(&cmd);
+
+  LG_LOCK(l_overflowLock);
+  RenderCommand * overflow = l_overflowHead;
+  l_overflowHead = NULL;
+  l_overflowTail = NULL;
+  atomic_store_explicit(&l_overflowActive, false, memory_order_release);
+  LG_UNLOCK(l_overflowLock);
+
+  while (overflow)
   {
-    RenderCommand * next = cmd->next;
-    RenderQueueSwSurface * surface = swSurfaceFromUpdateCommand(cmd);
-    if (surface)
-    {
-      LG_LOCK(surface->lock);
-      surface->updateQueued = false;
-      LG_UNLOCK(surface->lock);
-    }
-    else
-      freeCommand(cmd);
-    cmd = next;
+    RenderCommand * next = overflow->next;
+    dropCommand(overflow);
+    free(overflow);
+    overflow = next;
   }
 }
 
@@ -714,18 +1031,15 @@ void renderQueue_sourceClearCursor(RenderQueueSource source)
     ++cursorGeneration;
   atomic_store_explicit(&l_cursorGeneration[source], cursorGeneration,
       memory_order_release);
-  free(l_cursor[source].data);
+  releaseCursorImage(source, l_cursor[source].slab, l_cursor[source].data);
   memset(&l_cursor[source], 0, sizeof(l_cursor[source]));
   const uint64_t sourceGeneration = atomic_load_explicit(
       &l_sourceGeneration[source], memory_order_acquire);
-  RenderCommand * cmd = malloc(sizeof(*cmd));
-  bool wake = false;
-  if (cmd)
-  {
-    setCommandSource(cmd, source, sourceGeneration);
-    cmd->op = CURSOR_OP_CLEAR;
-    wake = queueCommand(cmd, RENDER_QUEUE_INVALIDATE_PARTIAL);
-  }
+  RenderCommand cmd;
+  setCommandSource(&cmd, source, sourceGeneration);
+  cmd.op = CURSOR_OP_CLEAR;
+  bool wake;
+  queueCommand(&cmd, RENDER_QUEUE_INVALIDATE_PARTIAL, &wake);
   LG_UNLOCK(l_sourceLock);
   wakeQueue(wake);
 }
@@ -830,7 +1144,12 @@ static uint64_t enqueueTransition(RenderCommand * cmd,
   const uint64_t serial = atomic_load_explicit(
       &l_transitionSerial, memory_order_relaxed) + 1;
   cmd->transitionSerial = serial;
-  const bool wake = queueCommand(cmd, RENDER_QUEUE_INVALIDATE_FULL);
+  bool wake;
+  if (!queueCommand(cmd, RENDER_QUEUE_INVALIDATE_FULL, &wake))
+  {
+    LG_UNLOCK(l_transitionLock);
+    return 0;
+  }
   atomic_store_explicit(
       &l_transitionSerial, serial, memory_order_release);
   if (publishedSerial)
@@ -854,14 +1173,11 @@ uint64_t renderQueue_sourceTransition(RenderQueueSource source,
     swSurface  = false;
   }
 
-  RenderCommand * cmd = malloc(sizeof(*cmd));
-  if (!cmd)
-    return 0;
-
-  setCommandSource(cmd, source, generation);
-  cmd->op                         = SOURCE_OP_TRANSITION;
-  cmd->sourceTransition.swSurface = swSurface;
-  return enqueueTransition(cmd, publishedSerial);
+  RenderCommand cmd;
+  setCommandSource(&cmd, source, generation);
+  cmd.op                         = SOURCE_OP_TRANSITION;
+  cmd.sourceTransition.swSurface = swSurface;
+  return enqueueTransition(&cmd, publishedSerial);
 }
 
 uint64_t renderQueue_sourceSwSurfaceConfigureTransition(
@@ -871,25 +1187,19 @@ uint64_t renderQueue_sourceSwSurfaceConfigureTransition(
   if (!generationValid(source, generation))
     return 0;
 
-  RenderCommand * cmd = malloc(sizeof(*cmd));
-  if (!cmd)
-    return 0;
-
   uint64_t epoch;
   if (!getSwSurfaceConfiguration(
         source, generation, width, height, &epoch))
-  {
-    free(cmd);
     return 0;
-  }
 
-  setCommandSource(cmd, source, generation);
-  cmd->op                                  =
+  RenderCommand cmd;
+  setCommandSource(&cmd, source, generation);
+  cmd.op                                  =
     SW_SURFACE_OP_CONFIGURE_TRANSITION;
-  cmd->swSurfaceConfigureTransition.width  = width;
-  cmd->swSurfaceConfigureTransition.height = height;
-  cmd->swSurfaceConfigureTransition.epoch  = epoch;
-  return enqueueTransition(cmd, publishedSerial);
+  cmd.swSurfaceConfigureTransition.width  = width;
+  cmd.swSurfaceConfigureTransition.height = height;
+  cmd.swSurfaceConfigureTransition.epoch  = epoch;
+  return enqueueTransition(&cmd, publishedSerial);
 }
 
 static bool clipSwSurfaceRect(const RenderQueueSwSurface * surface,
@@ -1040,16 +1350,13 @@ void renderQueue_sourceSurfaceFormat(RenderQueueSource source,
   if (!generationValid(source, generation))
     return;
 
-  RenderCommand * cmd = malloc(sizeof(*cmd));
-  if (!cmd)
-    return;
-
-  setCommandSource(cmd, source, generation);
-  cmd->op                                      = SURFACE_OP_FORMAT;
-  cmd->surfaceFormat.format                    = format;
-  cmd->surfaceFormat.rendererSupportsNativeHDR =
+  RenderCommand cmd;
+  setCommandSource(&cmd, source, generation);
+  cmd.op                                      = SURFACE_OP_FORMAT;
+  cmd.surfaceFormat.format                    = format;
+  cmd.surfaceFormat.rendererSupportsNativeHDR =
     rendererSupportsNativeHDR;
-  enqueueCommand(cmd, RENDER_QUEUE_INVALIDATE_FULL);
+  enqueueCommand(&cmd, RENDER_QUEUE_INVALIDATE_FULL);
 }
 
 void renderQueue_sourceCursorState(RenderQueueSource source,
@@ -1058,18 +1365,36 @@ void renderQueue_sourceCursorState(RenderQueueSource source,
   if (!generationValid(source, generation))
     return;
 
-  RenderCommand * cmd = malloc(sizeof(*cmd));
-  if (!cmd)
-    return;
+  RenderCommand cmd;
+  setCommandSource(&cmd, source, generation);
+  cmd.op = CURSOR_OP_STATE;
+
+  const RenderQueueCursorState state =
+  {
+    .generation       = cmd.generation,
+    .cursorGeneration = cmd.cursorGeneration,
+    .visible          = visible,
+    .x                = x,
+    .y                = y,
+    .hx               = hx,
+    .hy               = hy,
+  };
 
-  setCommandSource(cmd, source, generation);
-  cmd->op                  = CURSOR_OP_STATE;
-  cmd->cursorState.visible = visible;
-  cmd->cursorState.x       = x;
-  cmd->cursorState.y       = y;
-  cmd->cursorState.hx      = hx;
-  cmd->cursorState.hy      = hy;
-  enqueueCommand(cmd, RENDER_QUEUE_INVALIDATE_NONE);
+  RenderQueueCursorUpdate * update = &l_cursorUpdate[source];
+  RenderQueueCursorState    queued;
+  LG_LOCK(update->lock);
+  const bool collapse = update->queued &&
+    readCursorUpdate(update, &queued) &&
+    queued.generation       == cmd.generation &&
+    queued.cursorGeneration == cmd.cursorGeneration;
+  writeCursorUpdate(update, &state);
+
+  bool wake = false;
+  if (!collapse)
+    update->queued =
+      queueCommand(&cmd, RENDER_QUEUE_INVALIDATE_NONE, &wake);
+  LG_UNLOCK(update->lock);
+  wakeQueue(wake);
 }
 
 void renderQueue_sourceCursorImage(RenderQueueSource source,
@@ -1079,21 +1404,16 @@ void renderQueue_sourceCursorImage(RenderQueueSource source,
   if (!generationValid(source, generation))
     return;
 
-  RenderCommand * cmd = malloc(sizeof(*cmd));
-  if (!cmd)
-    return;
-
-  setCommandSource(cmd, source, generation);
-  cmd->op                 = CURSOR_OP_IMAGE;
-  cmd->cursorImage.type   = type;
-  cmd->cursorImage.width  = width;
-  cmd->cursorImage.height = height;
-  cmd->cursorImage.pitch  = pitch;
-  cmd->cursorImage.data   = NULL;
-  if (!copyCursorImage(cmd, data))
-    freeCommand(cmd);
-  else
-    enqueueCommand(cmd, RENDER_QUEUE_INVALIDATE_NONE);
+  RenderCommand cmd;
+  setCommandSource(&cmd, source, generation);
+  cmd.op                 = CURSOR_OP_IMAGE;
+  cmd.cursorImage.type   = type;
+  cmd.cursorImage.width  = width;
+  cmd.cursorImage.height = height;
+  cmd.cursorImage.pitch  = pitch;
+  cmd.cursorImage.data   = NULL;
+  if (copyCursorImage(&cmd, data))
+    enqueueCommand(&cmd, RENDER_QUEUE_INVALIDATE_NONE);
 }
 
 void renderQueue_sourceCursorColorTransform(RenderQueueSource source,
@@ -1102,22 +1422,16 @@ void renderQueue_sourceCursorColorTransform(RenderQueueSource source,
   if (!generationValid(source, generation) || !transform)
     return;
 
-  RenderCommand * cmd = malloc(sizeof(*cmd));
-  if (!cmd)
-    return;
-
   LGColorTransform * copy = malloc(sizeof(*copy));
   if (!copy)
-  {
-    free(cmd);
     return;
-  }
   *copy = *transform;
 
-  setCommandSource(cmd, source, generation);
-  cmd->op                        = CURSOR_OP_COLOR_TRANSFORM;
-  cmd->cursorColorTransform.data = copy;
-  enqueueCommand(cmd, RENDER_QUEUE_INVALIDATE_NONE);
+  RenderCommand cmd;
+  setCommandSource(&cmd, source, generation);
+  cmd.op                        = CURSOR_OP_COLOR_TRANSFORM;
+  cmd.cursorColorTransform.data = copy;
+  enqueueCommand(&cmd, RENDER_QUEUE_INVALIDATE_NONE);
 }
 
 void renderQueue_sourceCursorWhiteLevel(RenderQueueSource source,
@@ -1126,14 +1440,11 @@ void renderQueue_sourceCursorWhiteLevel(RenderQueueSource source,
   if (!generationValid(source, generation))
     return;
 
-  RenderCommand * cmd = malloc(sizeof(*cmd));
-  if (!cmd)
-    return;
-
-  setCommandSource(cmd, source, generation);
-  cmd->op                     = CURSOR_OP_WHITE_LEVEL;
-  cmd->cursorWhiteLevel.value = sdrWhiteLevel;
-  enqueueCommand(cmd, RENDER_QUEUE_INVALIDATE_NONE);
+  RenderCommand cmd;
+  setCommandSource(&cmd, source, generation);
+  cmd.op                     = CURSOR_OP_WHITE_LEVEL;
+  cmd.cursorWhiteLevel.value = sdrWhiteLevel;
+  enqueueCommand(&cmd, RENDER_QUEUE_INVALIDATE_NONE);
 }
 
 static bool swSurfaceCommandMatches(const RenderQueueSwSurface * surface,
@@ -1232,8 +1543,8 @@ static bool swSurfaceTransitionReady(const RenderCommand * cmd,
   return ready;
 }
 
-/* Called with l_sourceLock held. The marker may be recycled into the live
- * queue after an older generation was detached from it. */
+/* Called with l_sourceLock held. A stale update may queue a fresh one for the
+ * surface's current generation. */
 static bool processSwSurfaceUpdate(RenderCommand * cmd, bool commandValid)
 {
   RenderQueueSwSurface * surface = &l_swSurface[cmd->source];
@@ -1331,6 +1642,26 @@ static void applySourceTransition(const RenderCommand * cmd,
   l_pendingTransition.valid      = true;
 }
 
+/* Called with l_sourceLock held. */
+static void setCursorState(RenderQueueSource source, uint64_t generation,
+    bool visible, int x, int y, int hx, int hy)
+{
+  RenderQueueCursor * cursor = &l_cursor[source];
+  cursor->stateGeneration = generation;
+  cursor->stateValid      = true;
+  cursor->visible         = visible;
+  cursor->x               = x;
+  cursor->y               = y;
+  cursor->hx              = hx;
+  cursor->hy              = hy;
+
+  if (l_appliedSource == source && l_appliedGeneration == generation)
+    RENDERER(onMouseEvent,
+        cursor->imageValid && cursor->imageGeneration == generation &&
+          cursor->visible,
+        cursor->x, cursor->y, cursor->hx, cursor->hy);
+}
+
 static bool prepareSourceTransition(const RenderCommand * cmd)
 {
   return !l_sourcePrepareFn || l_sourcePrepareFn(l_sourceCallbackOpaque,
@@ -1344,201 +1675,242 @@ static void rejectSourceTransition(const RenderCommand * cmd)
         cmd->source, cmd->transitionSerial);
 }
 
-bool renderQueue_process(void)
+static void processCommand(RenderCommand * cmd)
 {
-  RenderQueueInvalidate invalidate;
-  RenderCommand * cmd = detachCommands(&invalidate);
-  while(cmd)
+  const bool transition = transitionCommand(cmd);
+  bool wake = false;
+  if (transition)
+    LG_LOCK(l_transitionLock);
+  LG_LOCK(l_sourceLock);
+
+  bool validCommand = commandValid(cmd);
+  if (cmd->op == CURSOR_OP_STATE && !takeCursorState(cmd))
+    validCommand = false;
+
+  if (!validCommand)
   {
-    RenderCommand * next = cmd->next;
-    const bool transition = transitionCommand(cmd);
-    bool wake = false;
+    if (cmd->op == SW_SURFACE_OP_UPDATE)
+      wake = processSwSurfaceUpdate(cmd, false);
+    LG_UNLOCK(l_sourceLock);
     if (transition)
-      LG_LOCK(l_transitionLock);
-    LG_LOCK(l_sourceLock);
-
-    const bool validCommand = commandValid(cmd);
-    if (!validCommand)
-    {
-      if (cmd->op == SW_SURFACE_OP_UPDATE)
-        wake = processSwSurfaceUpdate(cmd, false);
-      LG_UNLOCK(l_sourceLock);
-      if (transition)
-        LG_UNLOCK(l_transitionLock);
-      freeCommand(cmd);
-      wakeQueue(wake);
-      cmd = next;
-      continue;
-    }
+      LG_UNLOCK(l_transitionLock);
+    releaseCommand(cmd);
+    wakeQueue(wake);
+    return;
+  }
 
-    switch(cmd->op)
-    {
-      case SW_SURFACE_OP_CONFIGURE_TRANSITION:
-        if (!swSurfaceTransitionReady(cmd, true))
-        {
-          DEBUG_ERROR("Software surface configuration is unavailable");
-          rejectSourceTransition(cmd);
-          break;
-        }
-        if (!prepareSourceTransition(cmd))
-          break;
-        if (!prepareSwSurfaceTransition(cmd, true))
-        {
-          rejectSourceTransition(cmd);
-          break;
-        }
-        applySourceTransition(cmd, true);
+  switch(cmd->op)
+  {
+    case SW_SURFACE_OP_CONFIGURE_TRANSITION:
+      if (!swSurfaceTransitionReady(cmd, true))
+      {
+        DEBUG_ERROR("Software surface configuration is unavailable");
+        rejectSourceTransition(cmd);
         break;
-
-      case SW_SURFACE_OP_UPDATE:
-        wake = processSwSurfaceUpdate(cmd, true);
+      }
+      if (!prepareSourceTransition(cmd))
         break;
-
-      case SURFACE_OP_FORMAT:
+      if (!prepareSwSurfaceTransition(cmd, true))
       {
-        RenderQueueFormat * format = &l_format[cmd->source];
-        format->generation                = cmd->generation;
-        format->valid                     = true;
-        format->format                    = cmd->surfaceFormat.format;
-        format->rendererSupportsNativeHDR =
-          cmd->surfaceFormat.rendererSupportsNativeHDR;
-
-        if (l_appliedSource == cmd->source &&
-            l_appliedGeneration == cmd->generation &&
-            !l_appliedSwSurface)
-        {
-          l_surfaceFormat             = format->format;
-          l_surfaceFormatValid        = true;
-          l_rendererSupportsNativeHDR =
-            format->rendererSupportsNativeHDR;
-          updateSurfaceFormat();
-        }
+        rejectSourceTransition(cmd);
         break;
       }
+      applySourceTransition(cmd, true);
+      break;
 
-      case CURSOR_OP_STATE:
+    case SW_SURFACE_OP_UPDATE:
+      wake = processSwSurfaceUpdate(cmd, true);
+      break;
+
+    case SURFACE_OP_FORMAT:
+    {
+      RenderQueueFormat * format = &l_format[cmd->source];
+      format->generation                = cmd->generation;
+      format->valid                     = true;
+      format->format                    = cmd->surfaceFormat.format;
+      format->rendererSupportsNativeHDR =
+        cmd->surfaceFormat.rendererSupportsNativeHDR;
+
+      if (l_appliedSource == cmd->source &&
+          l_appliedGeneration == cmd->generation &&
+          !l_appliedSwSurface)
       {
-        RenderQueueCursor * cursor = &l_cursor[cmd->source];
-        cursor->stateGeneration = cmd->generation;
-        cursor->stateValid      = true;
-        cursor->visible         = cmd->cursorState.visible;
-        cursor->x               = cmd->cursorState.x;
-        cursor->y               = cmd->cursorState.y;
-        cursor->hx              = cmd->cursorState.hx;
-        cursor->hy              = cmd->cursorState.hy;
-
-        if (l_appliedSource == cmd->source &&
-            l_appliedGeneration == cmd->generation)
-          RENDERER(onMouseEvent,
-              cursor->imageValid &&
-                cursor->imageGeneration == cmd->generation &&
-                cursor->visible,
-              cursor->x, cursor->y, cursor->hx, cursor->hy);
-        break;
+        l_surfaceFormat             = format->format;
+        l_surfaceFormatValid        = true;
+        l_rendererSupportsNativeHDR =
+          format->rendererSupportsNativeHDR;
+        updateSurfaceFormat();
       }
+      break;
+    }
 
-      case CURSOR_OP_IMAGE:
+    case CURSOR_OP_STATE:
+      setCursorState(cmd->source, cmd->generation,
+          cmd->cursorState.visible,
+          cmd->cursorState.x , cmd->cursorState.y,
+          cmd->cursorState.hx, cmd->cursorState.hy);
+      break;
+
+    case CURSOR_OP_IMAGE:
+    {
+      RenderQueueCursor * cursor = &l_cursor[cmd->source];
+      releaseCursorImage(cmd->source, cursor->slab, cursor->data);
+      cursor->imageGeneration = cmd->generation;
+      cursor->imageValid      = true;
+      cursor->type            = cmd->cursorImage.type;
+      cursor->width           = cmd->cursorImage.width;
+      cursor->height          = cmd->cursorImage.height;
+      cursor->pitch           = cmd->cursorImage.pitch;
+      cursor->slab            = cmd->cursorImage.slab;
+      cursor->data            = cmd->cursorImage.data;
+      cmd->cursorImage.data   = NULL;
+
+      if (l_appliedSource == cmd->source &&
+          l_appliedGeneration == cmd->generation)
       {
-        RenderQueueCursor * cursor = &l_cursor[cmd->source];
-        free(cursor->data);
-        cursor->imageGeneration = cmd->generation;
-        cursor->imageValid      = true;
-        cursor->type            = cmd->cursorImage.type;
-        cursor->width           = cmd->cursorImage.width;
-        cursor->height          = cmd->cursorImage.height;
-        cursor->pitch           = cmd->cursorImage.pitch;
-        cursor->data            = cmd->cursorImage.data;
-        cmd->cursorImage.data   = NULL;
-
-        if (l_appliedSource == cmd->source &&
-            l_appliedGeneration == cmd->generation)
-        {
-          RENDERER(onMouseShape, cursor->type, cursor->width,
-              cursor->height, cursor->pitch, cursor->data);
-          if (cursor->stateValid &&
-              cursor->stateGeneration == cmd->generation)
-            RENDERER(onMouseEvent, cursor->visible, cursor->x, cursor->y,
-                cursor->hx, cursor->hy);
-        }
-        break;
+        RENDERER(onMouseShape, cursor->type, cursor->width,
+            cursor->height, cursor->pitch, cursor->data);
+        if (cursor->stateValid &&
+            cursor->stateGeneration == cmd->generation)
+          RENDERER(onMouseEvent, cursor->visible, cursor->x, cursor->y,
+              cursor->hx, cursor->hy);
       }
+      break;
+    }
+
+    case CURSOR_OP_COLOR_TRANSFORM:
+    {
+      RenderQueueCursor * cursor = &l_cursor[cmd->source];
+      cursor->colorGeneration = cmd->generation;
+      cursor->colorValid      = true;
+      cursor->colorTransform  = *cmd->cursorColorTransform.data;
+
+      if (l_appliedSource == cmd->source &&
+          l_appliedGeneration == cmd->generation &&
+          g_state.lgr->ops.onMouseColorTransform)
+        g_state.lgr->ops.onMouseColorTransform(g_state.lgr,
+            &cursor->colorTransform);
+      break;
+    }
 
-      case CURSOR_OP_COLOR_TRANSFORM:
+    case CURSOR_OP_WHITE_LEVEL:
+    {
+      RenderQueueCursor * cursor = &l_cursor[cmd->source];
+      cursor->whiteGeneration = cmd->generation;
+      cursor->whiteValid      = true;
+      cursor->sdrWhiteLevel   = cmd->cursorWhiteLevel.value;
+
+      if (l_appliedSource == cmd->source &&
+          l_appliedGeneration == cmd->generation &&
+          g_state.lgr->ops.onMouseWhiteLevel)
+        g_state.lgr->ops.onMouseWhiteLevel(g_state.lgr,
+            cursor->sdrWhiteLevel);
+      break;
+    }
+
+    case CURSOR_OP_CLEAR:
+      if (l_appliedSource == cmd->source)
       {
-        RenderQueueCursor * cursor = &l_cursor[cmd->source];
-        cursor->colorGeneration = cmd->generation;
-        cursor->colorValid      = true;
-        cursor->colorTransform  = *cmd->cursorColorTransform.data;
-
-        if (l_appliedSource == cmd->source &&
-            l_appliedGeneration == cmd->generation &&
-            g_state.lgr->ops.onMouseColorTransform)
-          g_state.lgr->ops.onMouseColorTransform(g_state.lgr,
-              &cursor->colorTransform);
-        break;
+        RENDERER(onMouseEvent, false, 0, 0, 0, 0);
+        if (g_state.lgr->ops.onMouseColorTransform)
+          g_state.lgr->ops.onMouseColorTransform(
+              g_state.lgr, &l_identityColorTransform);
+        if (g_state.lgr->ops.onMouseWhiteLevel)
+          g_state.lgr->ops.onMouseWhiteLevel(
+              g_state.lgr, LG_SDR_WHITE_LEVEL_DEFAULT);
       }
+      break;
 
-      case CURSOR_OP_WHITE_LEVEL:
+    case SOURCE_OP_TRANSITION:
+    {
+      const bool swSurface =
+        cmd->source != RENDER_QUEUE_SOURCE_NONE &&
+        cmd->sourceTransition.swSurface;
+      if (swSurface && !swSurfaceTransitionReady(cmd, false))
       {
-        RenderQueueCursor * cursor = &l_cursor[cmd->source];
-        cursor->whiteGeneration = cmd->generation;
-        cursor->whiteValid      = true;
-        cursor->sdrWhiteLevel   = cmd->cursorWhiteLevel.value;
-
-        if (l_appliedSource == cmd->source &&
-            l_appliedGeneration == cmd->generation &&
-            g_state.lgr->ops.onMouseWhiteLevel)
-          g_state.lgr->ops.onMouseWhiteLevel(g_state.lgr,
-              cursor->sdrWhiteLevel);
+        DEBUG_ERROR("Software surface source is unavailable");
+        rejectSourceTransition(cmd);
         break;
       }
-
-      case CURSOR_OP_CLEAR:
-        if (l_appliedSource == cmd->source)
-        {
-          RENDERER(onMouseEvent, false, 0, 0, 0, 0);
-          if (g_state.lgr->ops.onMouseColorTransform)
-            g_state.lgr->ops.onMouseColorTransform(
-                g_state.lgr, &l_identityColorTransform);
-          if (g_state.lgr->ops.onMouseWhiteLevel)
-            g_state.lgr->ops.onMouseWhiteLevel(
-                g_state.lgr, LG_SDR_WHITE_LEVEL_DEFAULT);
-        }
+      if (!prepareSourceTransition(cmd))
         break;
-
-      case SOURCE_OP_TRANSITION:
+      if (swSurface && !prepareSwSurfaceTransition(cmd, false))
       {
-        const bool swSurface =
-          cmd->source != RENDER_QUEUE_SOURCE_NONE &&
-          cmd->sourceTransition.swSurface;
-        if (swSurface && !swSurfaceTransitionReady(cmd, false))
-        {
-          DEBUG_ERROR("Software surface source is unavailable");
-          rejectSourceTransition(cmd);
-          break;
-        }
-        if (!prepareSourceTransition(cmd))
-          break;
-        if (swSurface && !prepareSwSurfaceTransition(cmd, false))
-        {
-          rejectSourceTransition(cmd);
-          break;
-        }
-        applySourceTransition(cmd, swSurface);
+        rejectSourceTransition(cmd);
         break;
       }
+      applySourceTransition(cmd, swSurface);
+      break;
     }
-    LG_UNLOCK(l_sourceLock);
-    if (transition)
-      LG_UNLOCK(l_transitionLock);
-    freeCommand(cmd);
-    wakeQueue(wake);
-    cmd = next;
+
+  }
+  LG_UNLOCK(l_sourceLock);
+  if (transition)
+    LG_UNLOCK(l_transitionLock);
+  releaseCommand(cmd);
+  wakeQueue(wake);
+}
+
+bool renderQueue_process(void)
+{
+  const RenderQueueInvalidate invalidate = atomic_exchange_explicit(
+      &l_renderQueueInvalidate, RENDER_QUEUE_INVALIDATE_NONE,
+      memory_order_acq_rel);
+
+  /* Only take what was queued before this pass, commands queued while it runs
+   * are left for the next one. */
+  const uint64_t end = atomic_load_explicit(
+      &l_renderQueueHead, memory_order_acquire);
+  RenderCommand cmd;
+  while (l_renderQueueTail != end && ringPop(&cmd))
+    processCommand(&cmd);
+
+  RenderCommand * overflow = detachOverflow();
+  while (overflow)
+  {
+    RenderCommand * next = overflow->next;
+    cmd = *overflow;
+    free(overflow);
+    processCommand(&cmd);
+    overflow = next;
   }
 
+  /* A producer was still writing into the ring, so the overflow has to wait
+   * for the next pass. */
+  if (atomic_load_explicit(&l_overflowActive, memory_order_acquire))
+    wakeQueue(raiseInvalidate(RENDER_QUEUE_INVALIDATE_PARTIAL));
+
   return invalidate == RENDER_QUEUE_INVALIDATE_FULL;
 }
 
+bool renderQueue_latchCursor(void)
+{
+  const RenderQueueSource source = l_appliedSource;
+  if (!sourceValid(source))
+    return false;
+
+  RenderQueueCursorState state;
+  if (!readCursorUpdate(&l_cursorUpdate[source], &state) ||
+      state.generation != l_appliedGeneration)
+    return false;
+
+  LG_LOCK(l_sourceLock);
+  const RenderQueueCursor * cursor = &l_cursor[source];
+  const bool latch =
+    generationValid(source, state.generation) &&
+    atomic_load_explicit(&l_cursorGeneration[source],
+        memory_order_acquire) == state.cursorGeneration &&
+    (!cursor->stateValid || cursor->stateGeneration != state.generation ||
+     cursor->visible != state.visible ||
+     cursor->x  != state.x  || cursor->y  != state.y ||
+     cursor->hx != state.hx || cursor->hy != state.hy);
+  if (latch)
+    setCursorState(source, state.generation, state.visible,
+        state.x, state.y, state.hx, state.hy);
+  LG_UNLOCK(l_sourceLock);
+  return latch;
+}
+
 void renderQueue_presented(void)
 {
   if (!l_pendingTransition.valid)
@@ -45,6 +45,11 @@ void renderQueue_clear(void);
 bool renderQueue_process(void);
 void renderQueue_presented(void);
 
+/* Applies the newest cursor state sent for the applied source, even if its
+ * command has not been processed yet. Called on the render thread just before
+ * the cursor is drawn, returns true if the cursor was updated. */
+bool renderQueue_latchCursor(void);
+
 void renderQueue_setSourceFns(RenderQueueSourcePrepareFn prepare,
     RenderQueueSourceRejectFn reject,
     RenderQueueSourceAppliedFn applied, void * opaque);
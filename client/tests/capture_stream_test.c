@@ -0,0 +1,215 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "capture_stream.h"
+#include "test.h"
+
+#include "common/debug.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FRAME_SIZE 4096
+
+static void fillFrame(uint8_t * data, uint64_t serial)
+{
+  for (unsigned i = 0; i < FRAME_SIZE; ++i)
+    data[i] = (uint8_t)(serial * 31 + i);
+}
+
+static LG_TestCaptureHeader makeHeader(uint64_t serial)
+{
+  return (LG_TestCaptureHeader) {
+    .magic       = LG_TEST_CAPTURE_MAGIC,
+    .version     = LG_TEST_CAPTURE_VERSION,
+    .headerSize  = sizeof(LG_TestCaptureHeader),
+    .frameSerial = serial,
+    .width       = FRAME_SIZE / 4,
+    .height      = 1,
+    .stride      = FRAME_SIZE,
+    .dataSize    = FRAME_SIZE,
+  };
+}
+
+/* read `count` frames from `file` and check they arrived in order, intact */
+static void readFrames(FILE * file, unsigned count)
+{
+  uint8_t want[FRAME_SIZE], got[FRAME_SIZE];
+  for (unsigned i = 0; i < count; ++i)
+  {
+    LG_TestCaptureHeader header;
+    CHECK(fread(&header, sizeof(header), 1, file) == 1);
+    CHECK(header.magic == LG_TEST_CAPTURE_MAGIC);
+    CHECK(header.frameSerial == i + 1);
+    CHECK(header.dataSize == FRAME_SIZE);
+    CHECK(fread(got, FRAME_SIZE, 1, file) == 1);
+    fillFrame(want, i + 1);
+    CHECK(memcmp(want, got, FRAME_SIZE) == 0);
+  }
+  CHECK(fgetc(file) == EOF);
+}
+
+static void testOrder(void)
+{
+  char path[] = "/tmp/lg-capture-stream-XXXXXX";
+  const int fd = mkstemp(path);
+  CHECK(fd >= 0);
+  close(fd);
+
+  const unsigned count = CAPTURE_STREAM_DEPTH * 4;
+  uint8_t (*frames)[FRAME_SIZE] = malloc(count * FRAME_SIZE);
+  CHECK(frames);
+
+  CaptureStream * stream;
+  CHECK(captureStream_open(&stream, path));
+  for (unsigned i = 0; i < count; ++i)
+  {
+    const LG_TestCaptureHeader header = makeHeader(i + 1);
+    fillFrame(frames[i], i + 1);
+    while (!captureStream_push(stream, &header, frames[i]))
+      CHECK(captureStream_wait(stream));
+  }
+  CHECK(captureStream_close(&stream));
+  CHECK(!stream);
+
+  FILE * file = fopen(path, "rb");
+  CHECK(file);
+  readFrames(file, count);
+  fclose(file);
+  unlink(path);
+  free(frames);
+}
+
+struct Reader
+{
+  const char * path;
+  atomic_bool  start;
+  unsigned     count;
+};
+
+static void * readerThread(void * opaque)
+{
+  struct Reader * reader = opaque;
+  FILE * file = fopen(reader->path, "rb");
+  CHECK(file);
+  while (!atomic_load(&reader->start))
+    usleep(1000);
+  readFrames(file, reader->count);
+  fclose(file);
+  return NULL;
+}
+
+static void testFull(void)
+{
+  char dir[] = "/tmp/lg-capture-stream-XXXXXX";
+  CHECK(mkdtemp(dir));
+  char path[sizeof(dir) + 8];
+  snprintf(path, sizeof(path), "%s/fifo", dir);
+  CHECK(mkfifo(path, 0600) == 0);
+
+  const unsigned count = CAPTURE_STREAM_DEPTH + 1;
+  struct Reader reader = { .path = path, .count = count };
+  atomic_init(&reader.start, false);
+  pthread_t thread;
+  CHECK(pthread_create(&thread, NULL, readerThread, &reader) == 0);
+
+  uint8_t (*frames)[FRAME_SIZE] = malloc(count * FRAME_SIZE);
+  CHECK(frames);
+
+  CaptureStream * stream;
+  CHECK(captureStream_open(&stream, path));
+
+  /* the reader is stalled, the queue fills without blocking the producer */
+  for (unsigned i = 0; i < CAPTURE_STREAM_DEPTH; ++i)
+  {
+    const LG_TestCaptureHeader header = makeHeader(i + 1);
+    fillFrame(frames[i], i + 1);
+    CHECK(captureStream_push(stream, &header, frames[i]));
+  }
+
+  const LG_TestCaptureHeader last = makeHeader(count);
+  fillFrame(frames[count - 1], count);
+  CHECK(!captureStream_push(stream, &last, frames[count - 1]));
+  CHECK(captureStream_written(stream) < CAPTURE_STREAM_DEPTH);
+
+  atomic_store(&reader.start, true);
+  CHECK(captureStream_wait(stream));
+  CHECK(captureStream_push(stream, &last, frames[count - 1]));
+  CHECK(captureStream_close(&stream));
+
+  CHECK(pthread_join(thread, NULL) == 0);
+  unlink(path);
+  rmdir(dir);
+  free(frames);
+}
+
+static void testFail(void)
+{
+  uint8_t frame[FRAME_SIZE] = {};
+  const LG_TestCaptureHeader header = makeHeader(1);
+
+  CaptureStream * stream;
+  CHECK(captureStream_open(&stream, "/dev/full"));
+  CHECK(captureStream_push(stream, &header, frame));
+  CHECK(!captureStream_wait(stream));
+  CHECK(captureStream_written(stream) == 1);
+  CHECK(!captureStream_push(stream, &header, frame));
+  CHECK(!captureStream_wait(stream));
+  CHECK(!captureStream_close(&stream));
+}
+
+struct Test
+{
+  const char * name;
+  void (*run)(void);
+};
+
+static const struct Test tests[] =
+{
+  { "order", testOrder },
+  { "full" , testFull  },
+  { "fail" , testFail  },
+};
+
+int main(int argc, char ** argv)
+{
+  if (argc != 2)
+  {
+    fprintf(stderr, "usage: %s <case>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  debug_init();
+  for (unsigned int i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    if (strcmp(argv[1], tests[i].name) == 0)
+    {
+      tests[i].run();
+      return 0;
+    }
+
+  fprintf(stderr, "unknown test: %s\n", argv[1]);
+  return EXIT_FAILURE;
+}
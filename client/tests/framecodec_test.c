@@ -0,0 +1,219 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "common/framecodec.h"
+#include "common/thread.h"
+#include "test.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH  1920
+#define HEIGHT 1080
+#define PITCH  (WIDTH * 4)
+
+struct Producer
+{
+  FrameCodec     * codec;
+  FrameBuffer    * frame;
+  size_t           maxSize;
+  const uint32_t * src;
+  atomic_bool      go;
+};
+
+static uint32_t * makeDesktop(void)
+{
+  uint32_t * img = malloc(PITCH * HEIGHT);
+  CHECK(img);
+
+  /* flat background, a gradient title bar and some noisy "content" */
+  uint32_t seed = 1;
+  for(int y = 0; y < HEIGHT; ++y)
+    for(int x = 0; x < WIDTH; ++x)
+    {
+      uint32_t v = 0xff203040;
+      if (y < 32)
+        v = 0xff000000 | (x * 255 / WIDTH) << 8;
+      else if (x > 200 && x < 700 && y > 200 && y < 500)
+      {
+        seed = seed * 1103515245 + 12345;
+        v = seed;
+      }
+      img[y * WIDTH + x] = v;
+    }
+  return img;
+}
+
+static FrameBuffer * allocFrame(size_t size, uint8_t ** mem)
+{
+  /* like the host, keep the data aligned after the header */
+  *mem = aligned_alloc(64, size + 64);
+  CHECK(*mem);
+  return (FrameBuffer *)(*mem + 64 - sizeof(FrameBuffer));
+}
+
+static int producerThread(void * opaque)
+{
+  struct Producer * p = opaque;
+  while(!atomic_load(&p->go)) {}
+  size_t coded;
+  CHECK(frameCodec_encode(p->codec, p->frame, p->maxSize, p->src, PITCH,
+        HEIGHT, &coded));
+  CHECK(coded == HEIGHT);
+  return 0;
+}
+
+static void testRoundTrip(void)
+{
+  uint32_t * src = makeDesktop();
+  uint8_t  * mem;
+  const size_t maxSize = PITCH * HEIGHT;
+  FrameBuffer * frame = allocFrame(maxSize, &mem);
+  FrameCodec  * codec;
+  CHECK(frameCodec_create(&codec));
+
+  uint32_t * dst = calloc(WIDTH * HEIGHT, sizeof(*dst));
+  CHECK(dst);
+
+  /* the codec is reused, growing its state for the wider frame */
+  const size_t pitches[] = { PITCH / 2, PITCH };
+  for(int i = 0; i < 2; ++i)
+  {
+    const size_t pitch = pitches[i];
+    framebuffer_prepare(frame);
+    size_t coded;
+    CHECK(frameCodec_encode(codec, frame, maxSize, src, pitch, HEIGHT,
+          &coded));
+    CHECK(coded == HEIGHT);
+    CHECK(atomic_load(&frame->wp) < maxSize / 4);
+
+    CHECK(frameCodec_decode(frame, maxSize, dst, pitch, HEIGHT, pitch, NULL) ==
+      FRAMECODEC_RESULT_OK);
+    CHECK(memcmp(dst, src, pitch * HEIGHT) == 0);
+  }
+
+  frameCodec_free(&codec);
+  CHECK(!codec);
+  free(dst);
+  free(mem);
+  free(src);
+}
+
+static void testStreaming(void)
+{
+  uint32_t * src = makeDesktop();
+  uint8_t  * mem;
+  const size_t maxSize = PITCH * HEIGHT;
+  FrameBuffer * frame = allocFrame(maxSize, &mem);
+  uint32_t * dst = calloc(WIDTH * HEIGHT, sizeof(*dst));
+  CHECK(dst);
+
+  struct Producer p = { .frame = frame, .maxSize = maxSize, .src = src };
+  CHECK(frameCodec_create(&p.codec));
+  LGThread * thread;
+  framebuffer_prepare(frame);
+  CHECK(lgCreateThread("producer", producerThread, &p, &thread));
+  atomic_store(&p.go, true);
+  CHECK(frameCodec_decode(frame, maxSize, dst, PITCH, HEIGHT, PITCH, NULL) ==
+    FRAMECODEC_RESULT_OK);
+  CHECK(lgJoinThread(thread, NULL));
+  CHECK(memcmp(dst, src, PITCH * HEIGHT) == 0);
+
+  frameCodec_free(&p.codec);
+  free(dst);
+  free(mem);
+  free(src);
+}
+
+static void testTruncated(void)
+{
+  uint32_t * src = makeDesktop();
+  uint8_t  * mem;
+  const size_t maxSize = 256 * 1024;
+  FrameBuffer * frame = allocFrame(maxSize, &mem);
+  FrameCodec  * codec;
+  CHECK(frameCodec_create(&codec));
+
+  framebuffer_prepare(frame);
+  size_t coded;
+  CHECK(frameCodec_encode(codec, frame, maxSize, src, PITCH, HEIGHT, &coded));
+  CHECK(coded >= 32 && coded < HEIGHT);
+  CHECK(atomic_load(&frame->wp) <= maxSize);
+
+  /* the rows that were sent decode, the rest are cleared rather than keeping
+   * what the destination held before */
+  uint32_t * dst = malloc(PITCH * HEIGHT);
+  CHECK(dst);
+  memset(dst, 0xff, PITCH * HEIGHT);
+  CHECK(frameCodec_decode(frame, maxSize, dst, PITCH, HEIGHT, PITCH, NULL) ==
+    FRAMECODEC_RESULT_OK);
+  CHECK(memcmp(dst, src, PITCH * coded) == 0);
+  for(size_t i = coded * WIDTH; i < WIDTH * HEIGHT; ++i)
+    CHECK(dst[i] == 0);
+
+  frameCodec_free(&codec);
+  free(dst);
+  free(mem);
+  free(src);
+}
+
+static void testCorrupt(void)
+{
+  uint32_t * src = makeDesktop();
+  uint8_t  * mem;
+  const size_t maxSize = PITCH * HEIGHT;
+  FrameBuffer * frame = allocFrame(maxSize, &mem);
+  FrameCodec  * codec;
+  CHECK(frameCodec_create(&codec));
+
+  framebuffer_prepare(frame);
+  size_t coded;
+  CHECK(frameCodec_encode(codec, frame, maxSize, src, PITCH, HEIGHT, &coded));
+  frameCodec_free(&codec);
+
+  /* a block claiming to extend past the buffer must be rejected */
+  uint32_t size = maxSize;
+  memcpy(framebuffer_get_data(frame), &size, sizeof(size));
+
+  uint32_t * dst = calloc(WIDTH * HEIGHT, sizeof(*dst));
+  CHECK(dst);
+  CHECK(frameCodec_decode(frame, maxSize, dst, PITCH, HEIGHT, PITCH, NULL) ==
+    FRAMECODEC_RESULT_ERROR);
+
+  /* a producer that never writes is a stall, not a corrupt frame */
+  framebuffer_prepare(frame);
+  CHECK(frameCodec_decode(frame, maxSize, dst, PITCH, HEIGHT, PITCH, NULL) ==
+    FRAMECODEC_RESULT_TIMEOUT);
+
+  free(dst);
+  free(mem);
+  free(src);
+}
+
+int main(int argc, char * argv[])
+{
+  testRoundTrip();
+  testStreaming();
+  testTruncated();
+  testCorrupt();
+  return EXIT_SUCCESS;
+}
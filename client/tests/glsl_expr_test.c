@@ -0,0 +1,246 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "glsl_expr.h"
+#include "test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+struct Sizes
+{
+  unsigned int lookups;
+};
+
+#define LUMA_INDEX 3
+
+static int resolveFn(void * opaque, const char * name)
+{
+  return strcmp(name, "LUMA") ? -1 : LUMA_INDEX;
+}
+
+static bool sizeFn(void * opaque, EGL_GLSLExprSource source,
+    unsigned int index, unsigned int * width, unsigned int * height)
+{
+  struct Sizes * sizes = opaque;
+  ++sizes->lookups;
+
+  switch(source)
+  {
+    case EGL_GLSL_EXPR_OUTPUT: *width = 3840; *height = 2160; return true;
+    case EGL_GLSL_EXPR_MAIN  : *width = 1920; *height = 1080; return true;
+    case EGL_GLSL_EXPR_NATIVE: *width = 1280; *height =  720; return true;
+    case EGL_GLSL_EXPR_SAVED :
+      if (index != LUMA_INDEX)
+        return false;
+      *width = 640; *height = 360;
+      return true;
+  }
+  return false;
+}
+
+static double eval(const char * expression, unsigned int * lookups)
+{
+  EGL_GLSLExpr * expr;
+  const char * unknown;
+  CHECK(egl_glslExprCompile(&expr, expression));
+  CHECK(egl_glslExprResolve(expr, resolveFn, NULL, &unknown));
+
+  struct Sizes sizes = { 0 };
+  double value;
+  CHECK(egl_glslExprEval(expr, 0.0, sizeFn, &sizes, &value));
+  if (lookups)
+    *lookups = sizes.lookups;
+
+  egl_glslExprFree(&expr);
+  CHECK(!expr);
+  return value;
+}
+
+static void testConstant(void)
+{
+  static const struct
+  {
+    const char * expression;
+    double value;
+  }
+  cases[] =
+  {
+    { "2"              , 2.0 },
+    { "1 2 +"          , 3.0 },
+    { "7 2 %"          , 1.0 },
+    { "1 2 3 * + 4 -"  , 3.0 },
+    { "2 1 > !"        , 0.0 },
+    { "1 1 = 3 2 < +"  , 1.0 },
+  };
+
+  for (size_t i = 0; i < ARRAY_LENGTH(cases); ++i)
+  {
+    EGL_GLSLExpr * expr;
+    CHECK(egl_glslExprCompile(&expr, cases[i].expression));
+
+    double value;
+    CHECK(egl_glslExprConstant(expr, &value));
+    CHECK(value == cases[i].value);
+    egl_glslExprFree(&expr);
+
+    unsigned int lookups;
+    CHECK(eval(cases[i].expression, &lookups) == cases[i].value);
+    CHECK(lookups == 0);
+  }
+}
+
+static void testSizes(void)
+{
+  unsigned int lookups;
+  CHECK(eval("HOOKED.w 2 *", &lookups) == 3840.0);
+  CHECK(lookups == 1);
+  CHECK(eval("MAIN.height", NULL) == 1080.0);
+  CHECK(eval("NATIVE_CROPPED.h NATIVE.width +", NULL) == 2000.0);
+  CHECK(eval("OUTPUT.w HOOKED.w >", NULL) == 1.0);
+  CHECK(eval("LUMA.w", NULL) == 640.0);
+
+  // the constant part is folded, the lookup is not
+  EGL_GLSLExpr * expr;
+  double value;
+  CHECK(egl_glslExprCompile(&expr, "HOOKED.w 1 2 / *"));
+  CHECK(!egl_glslExprConstant(expr, &value));
+  struct Sizes sizes = { 0 };
+  CHECK(egl_glslExprEval(expr, 0.0, sizeFn, &sizes, &value));
+  CHECK(value == 960.0 && sizes.lookups == 1);
+  egl_glslExprFree(&expr);
+
+  // a saved texture can not be read until the names are resolved
+  const char * unknown;
+  CHECK(egl_glslExprCompile(&expr, "LUMA.w"));
+  CHECK(!egl_glslExprEval(expr, 0.0, sizeFn, &sizes, &value));
+  CHECK(egl_glslExprResolve(expr, resolveFn, NULL, &unknown));
+  CHECK(egl_glslExprEval(expr, 0.0, sizeFn, &sizes, &value));
+  CHECK(value == 640.0);
+  egl_glslExprFree(&expr);
+
+  // no expression evaluates to the fallback
+  CHECK(egl_glslExprEval(NULL, 42.0, sizeFn, &sizes, &value));
+  CHECK(value == 42.0);
+}
+
+static void testInvalid(void)
+{
+  static const char * invalid[] =
+  {
+    "",
+    "+",
+    "1 +",
+    "!",
+    "1 2",
+    "HOOKED",
+    "HOOKED.x",
+    "1 foo",
+  };
+
+  EGL_GLSLExpr * expr;
+  for (size_t i = 0; i < ARRAY_LENGTH(invalid); ++i)
+  {
+    CHECK(!egl_glslExprCompile(&expr, invalid[i]));
+    CHECK(!expr);
+  }
+
+  // a texture that is never saved fails to resolve
+  const char * unknown = NULL;
+  CHECK(egl_glslExprCompile(&expr, "LUMA.w CHROMA.h +"));
+  CHECK(!egl_glslExprResolve(expr, resolveFn, NULL, &unknown));
+  CHECK(unknown && !strcmp(unknown, "CHROMA"));
+  egl_glslExprFree(&expr);
+
+  // these fail when evaluated
+  static const char * failing[] =
+  {
+    "1 0 /",
+    "HOOKED.w 0 %",
+    "1e308 10 *",
+  };
+
+  for (size_t i = 0; i < ARRAY_LENGTH(failing); ++i)
+  {
+    CHECK(egl_glslExprCompile(&expr, failing[i]));
+    CHECK(egl_glslExprResolve(expr, resolveFn, NULL, &unknown));
+    struct Sizes sizes = { 0 };
+    double value;
+    CHECK(!egl_glslExprEval(expr, 0.0, sizeFn, &sizes, &value));
+    egl_glslExprFree(&expr);
+  }
+}
+
+static void testStack(void)
+{
+  char expression[EGL_GLSL_EXPR_STACK * 4 + 8];
+  char * write = expression;
+  for (int i = 0; i < EGL_GLSL_EXPR_STACK; ++i)
+    write += sprintf(write, "1 ");
+  for (int i = 1; i < EGL_GLSL_EXPR_STACK; ++i)
+    write += sprintf(write, "+ ");
+
+  CHECK(eval(expression, NULL) == EGL_GLSL_EXPR_STACK);
+
+  // one operand too many
+  sprintf(expression, "1 ");
+  write = expression + 2;
+  for (int i = 0; i < EGL_GLSL_EXPR_STACK; ++i)
+    write += sprintf(write, "1 ");
+
+  EGL_GLSLExpr * expr;
+  CHECK(!egl_glslExprCompile(&expr, expression));
+}
+
+struct Test
+{
+  const char * name;
+  void (*run)(void);
+};
+
+static const struct Test tests[] =
+{
+  { "constant", testConstant },
+  { "sizes"   , testSizes    },
+  { "invalid" , testInvalid  },
+  { "stack"   , testStack    },
+};
+
+int main(int argc, char ** argv)
+{
+  if (argc != 2)
+  {
+    fprintf(stderr, "usage: %s <case>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  for (size_t i = 0; i < ARRAY_LENGTH(tests); ++i)
+    if (strcmp(argv[1], tests[i].name) == 0)
+    {
+      tests[i].run();
+      return 0;
+    }
+
+  fprintf(stderr, "unknown test: %s\n", argv[1]);
+  return EXIT_FAILURE;
+}
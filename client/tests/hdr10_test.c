@@ -0,0 +1,207 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+#include "common/hdr10.h"
+#include "common/debug.h"
+#include "test.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH  203
+#define HEIGHT 24
+#define PITCH  (WIDTH * 8)
+#define DPITCH (WIDTH * 4)
+
+static uint16_t * makeImage(void)
+{
+  uint16_t * img = malloc(PITCH * HEIGHT);
+  CHECK(img);
+
+  uint32_t seed = 1;
+  for(int i = 0; i < WIDTH * HEIGHT * 4; ++i)
+  {
+    seed = seed * 1103515245 + 12345;
+    img[i] = seed >> 16;
+  }
+
+  // some well known values, scRGB 1.0 is 80 nits and 125.0 is 10000 nits
+  static const uint16_t known[][4] =
+  {
+    { 0x0000, 0x0000, 0x0000, 0x3c00 }, // black
+    { 0x3c00, 0x3c00, 0x3c00, 0x3c00 }, // 80 nit white
+    { 0x57d0, 0x57d0, 0x57d0, 0x3c00 }, // 10000 nit white
+    { 0x7c00, 0xfc00, 0x7e00, 0x3800 }, // infinities and NaN
+    { 0xbc00, 0x0001, 0x03ff, 0x0000 }  // negative and subnormals
+  };
+  memcpy(img, known, sizeof(known));
+  return img;
+}
+
+static double decode(uint16_t h)
+{
+  const int exp  = (h >> 10) & 0x1f;
+  const int mant = h & 0x3ff;
+  if (exp == 0x1f)
+    return 0.0;
+
+  const double v = exp ? ldexp(mant + 1024, exp - 25) : ldexp(mant, -24);
+  return (h & 0x8000) ? -v : v;
+}
+
+static uint32_t convertReference(const uint16_t * px)
+{
+  static const double m[3][3] =
+  {
+    { 0.6274039, 0.3292830, 0.0433131 },
+    { 0.0690973, 0.9195404, 0.0113623 },
+    { 0.0163914, 0.0880133, 0.8955953 }
+  };
+
+  const double a = fmin(fmax(decode(px[3]), 0.0), 1.0);
+  uint32_t out = (uint32_t)lrint(a * 3.0) << 30;
+  for(int c = 0; c < 3; ++c)
+  {
+    double v = (decode(px[0]) * m[c][0] + decode(px[1]) * m[c][1] +
+        decode(px[2]) * m[c][2]) * (80.0 / 10000.0);
+    v = fmin(fmax(v, 0.0), 1.0);
+
+    const double p  = pow(v, 0.1593017578125);
+    const double pq = pow((0.8359375 + 18.8515625 * p) /
+        (1.0 + 18.6875 * p), 78.84375);
+    out |= (uint32_t)lrint(pq * 1023.0) << (c * 10);
+  }
+  return out;
+}
+
+static bool nearlyEqual(uint32_t a, uint32_t b)
+{
+  if ((a >> 30) != (b >> 30))
+    return false;
+
+  for(int c = 0; c < 3; ++c)
+  {
+    const int ca = (a >> (c * 10)) & 0x3ff;
+    const int cb = (b >> (c * 10)) & 0x3ff;
+    if (abs(ca - cb) > 1)
+      return false;
+  }
+  return true;
+}
+
+static void testKernels(void)
+{
+  static const char * kernels[] = { "scalar", "f16c" };
+  uint16_t * src = makeImage();
+  uint32_t   want[WIDTH + 2];
+  uint32_t   got [WIDTH + 2];
+
+  for(unsigned x = 0; x < WIDTH; ++x)
+    want[x + 1] = convertReference(src + x * 4);
+
+  // spot check the well known values
+  CHECK((want[1] & 0x3fffffff) == 0);
+  CHECK((want[2] & 0x3ff) == 497 && want[2] >> 30 == 3);
+  CHECK((want[3] & 0x3fffffff) == 0x3fffffff);
+  CHECK((want[4] & 0x3fffffff) == 0 && want[4] >> 30 == 2);
+
+  for(unsigned k = 0; k < sizeof(kernels) / sizeof(*kernels); ++k)
+  {
+    if (!hdr10_setKernel(kernels[k]))
+      continue;
+
+    for(unsigned width = 0; width <= WIDTH; width += width < 40 ? 1 : 41)
+    {
+      memset(got, 0xaa, sizeof(got));
+      hdr10_convertRow(got + 1, src, width);
+
+      // nothing may be written outside of the row
+      CHECK(got[0] == 0xaaaaaaaa && got[width + 1] == 0xaaaaaaaa);
+      for(unsigned x = 0; x < width; ++x)
+        CHECK(nearlyEqual(got[x + 1], want[x + 1]));
+    }
+  }
+
+  CHECK(!hdr10_setKernel("bogus"));
+  CHECK(hdr10_setKernel("auto"));
+  free(src);
+}
+
+static void testRects(void)
+{
+  uint16_t * src  = makeImage();
+  uint8_t  * mem  = aligned_alloc(64, (DPITCH * HEIGHT + 127) & ~63);
+  uint32_t * want = malloc(DPITCH * HEIGHT);
+  CHECK(mem && want);
+  FrameBuffer * frame = (FrameBuffer *)(mem + 64 - sizeof(FrameBuffer));
+  uint32_t    * data  = (uint32_t *)framebuffer_get_data(frame);
+
+  memset(want, 0x55, DPITCH * HEIGHT);
+  memcpy(data, want, DPITCH * HEIGHT);
+
+  // overlapping and clipped rects
+  const FrameDamageRect rects[] =
+  {
+    { .x =   1, .y =  2, .width =  17, .height =  5 },
+    { .x =  10, .y =  4, .width =  40, .height = 10 },
+    { .x = 190, .y = 20, .width = 100, .height = 100 }
+  };
+
+  for(unsigned i = 0; i < sizeof(rects) / sizeof(*rects); ++i)
+  {
+    const FrameDamageRect * r = rects + i;
+    for(unsigned y = r->y; y < r->y + r->height && y < HEIGHT; ++y)
+      for(unsigned x = r->x; x < r->x + r->width && x < WIDTH; ++x)
+        want[y * WIDTH + x] = convertReference(src + (y * WIDTH + x) * 4);
+  }
+
+  framebuffer_prepare(frame);
+  hdr10_convert(frame, rects, sizeof(rects) / sizeof(*rects), src, PITCH,
+      WIDTH, HEIGHT, DPITCH);
+  CHECK(atomic_load(&frame->wp) == DPITCH * HEIGHT);
+  for(unsigned i = 0; i < WIDTH * HEIGHT; ++i)
+    CHECK(nearlyEqual(data[i], want[i]));
+
+  // a full conversion
+  for(unsigned i = 0; i < WIDTH * HEIGHT; ++i)
+    want[i] = convertReference(src + i * 4);
+
+  framebuffer_prepare(frame);
+  hdr10_convert(frame, NULL, 0, src, PITCH, WIDTH, HEIGHT, DPITCH);
+  CHECK(atomic_load(&frame->wp) == DPITCH * HEIGHT);
+  for(unsigned i = 0; i < WIDTH * HEIGHT; ++i)
+    CHECK(nearlyEqual(data[i], want[i]));
+
+  free(want);
+  free(mem);
+  free(src);
+}
+
+int main(int argc, char * argv[])
+{
+  debug_init();
+  testKernels();
+  testRects();
+  return EXIT_SUCCESS;
+}
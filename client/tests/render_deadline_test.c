@@ -0,0 +1,248 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "render_deadline.h"
+#include "test.h"
+
+#include "common/debug.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NS_MS(x) ((uint64_t)(x) * UINT64_C(1000000))
+#define NS_US(x) ((uint64_t)(x) * UINT64_C(1000))
+
+#define PERIOD_60HZ UINT64_C(16666667)
+#define PERIOD_50HZ NS_MS(20)
+
+struct Sim
+{
+  uint64_t now;
+  uint64_t period;
+  uint64_t need;   /* lead a frame needs to make the aimed vblank */
+  unsigned frames;
+  unsigned delayed;
+  unsigned missed;
+};
+
+static void init(struct Sim * sim, uint64_t period, uint64_t need)
+{
+  renderDeadline_init();
+  *sim = (struct Sim) {
+    .now    = NS_MS(1000),
+    .period = period,
+    .need   = need,
+  };
+
+  /* one slow render in the window is above the p99 */
+  for (int i = 0; i < 128; ++i)
+    renderDeadline_rendered(i == 7 ? NS_MS(10) : NS_MS(2));
+
+  const RenderDeadline none = {};
+  renderDeadline_presented(&none, sim->now);
+}
+
+/* wake shortly after a vblank, render and present, returns the lead used */
+static uint64_t frame(struct Sim * sim)
+{
+  sim->now += sim->period;
+  const uint64_t wake = sim->now + NS_US(500);
+
+  RenderDeadline deadline;
+  const uint64_t start = renderDeadline_target(wake, sim->period, &deadline);
+  CHECK(start >= wake);
+  CHECK(deadline.vblank == sim->now + sim->period);
+  CHECK(deadline.delayed == (start > wake));
+
+  const uint64_t lead    = deadline.vblank - start;
+  const bool     onTime  = lead >= sim->need;
+  const uint64_t present = deadline.vblank + (onTime ? 0 : sim->period);
+
+  ++sim->frames;
+  if (deadline.delayed)
+    ++sim->delayed;
+  if (deadline.delayed && !onTime)
+    ++sim->missed;
+
+  renderDeadline_rendered(NS_MS(2));
+  renderDeadline_presented(&deadline, present);
+  return lead;
+}
+
+static void testIdle(void)
+{
+  renderDeadline_init();
+
+  // no presentation feedback yet
+  RenderDeadline deadline;
+  CHECK(renderDeadline_target(NS_MS(5), PERIOD_60HZ, &deadline) == NS_MS(5));
+  CHECK(deadline.vblank == 0);
+  CHECK(!deadline.delayed);
+
+  // no render cost history yet
+  const RenderDeadline none = {};
+  renderDeadline_presented(&none, NS_MS(10));
+  CHECK(renderDeadline_target(NS_MS(12), PERIOD_60HZ, &deadline) ==
+      NS_MS(12));
+  CHECK(deadline.vblank == 0);
+
+  for (int i = 0; i < 16; ++i)
+    renderDeadline_rendered(NS_MS(2));
+
+  // an unusable period
+  CHECK(renderDeadline_target(NS_MS(12), NS_MS(1), &deadline) == NS_MS(12));
+  CHECK(deadline.vblank == 0);
+
+  // the first aimed render is never delayed
+  CHECK(renderDeadline_target(NS_MS(12), PERIOD_60HZ, &deadline) ==
+      NS_MS(12));
+  CHECK(deadline.vblank == NS_MS(10) + PERIOD_60HZ);
+  CHECK(!deadline.delayed);
+
+  // stale presentation feedback
+  CHECK(renderDeadline_target(NS_MS(1000), PERIOD_60HZ, &deadline) ==
+      NS_MS(1000));
+  CHECK(deadline.vblank == 0);
+
+  renderDeadline_free();
+}
+
+static void testBudget(void)
+{
+  struct Sim sim;
+  init(&sim, PERIOD_60HZ, NS_MS(2));
+
+  uint64_t lead = 0;
+  for (int i = 0; i < 4000; ++i)
+    lead = frame(&sim);
+
+  // settled on the p99 render cost plus the minimum margin
+  CHECK(lead == NS_MS(3));
+  CHECK(sim.delayed > 3000);
+  CHECK(sim.missed == 0);
+
+  // the slow sample ages out and a run of slow renders raises the budget
+  for (int i = 0; i < 128; ++i)
+    renderDeadline_rendered(NS_MS(4));
+  RenderDeadline deadline;
+  const uint64_t wake  = sim.now + sim.period + NS_US(500);
+  const uint64_t start = renderDeadline_target(wake, sim.period, &deadline);
+  CHECK(deadline.vblank - start == NS_MS(5));
+
+  renderDeadline_free();
+}
+
+static void testMiss(void)
+{
+  struct Sim sim;
+  init(&sim, PERIOD_60HZ, NS_MS(6));
+
+  for (int i = 0; i < 8000; ++i)
+    frame(&sim);
+
+  const unsigned missed = sim.missed;
+  CHECK(missed > 0);
+  CHECK(missed < 12);
+
+  // misses back the margin off and get rarer
+  uint64_t minLead = UINT64_MAX;
+  for (int i = 0; i < 2000; ++i)
+  {
+    const uint64_t lead = frame(&sim);
+    if (lead < minLead)
+      minLead = lead;
+  }
+  CHECK(sim.missed - missed <= 1);
+  CHECK(minLead < NS_MS(10));
+
+  renderDeadline_free();
+}
+
+static void testPeriod(void)
+{
+  struct Sim sim;
+  init(&sim, PERIOD_60HZ, NS_MS(2));
+
+  for (int i = 0; i < 4000; ++i)
+    frame(&sim);
+  CHECK(frame(&sim) == NS_MS(3));
+
+  // a new refresh rate starts over without a delay
+  sim.now   += sim.period;
+  sim.period = PERIOD_50HZ;
+  const unsigned delayed = sim.delayed;
+  for (int i = 0; i < 30; ++i)
+    frame(&sim);
+  CHECK(sim.delayed == delayed);
+
+  // an aim from before the change is ignored
+  RenderDeadline deadline;
+  const uint64_t wake = sim.now + sim.period + NS_US(500);
+  CHECK(renderDeadline_target(wake, sim.period, &deadline) == wake);
+  RenderDeadline old = deadline;
+  --old.epoch;
+  renderDeadline_presented(&old, deadline.vblank + NS_MS(100));
+
+  const uint64_t aim = deadline.vblank;
+  CHECK(renderDeadline_target(wake, sim.period, &deadline) == wake);
+  CHECK(deadline.vblank == aim);
+
+  renderDeadline_reset();
+  CHECK(renderDeadline_target(wake, sim.period, &deadline) == wake);
+  CHECK(deadline.vblank == 0);
+
+  renderDeadline_free();
+}
+
+struct Test
+{
+  const char * name;
+  void (*run)(void);
+};
+
+static const struct Test tests[] =
+{
+  { "idle"  , testIdle   },
+  { "budget", testBudget },
+  { "miss"  , testMiss   },
+  { "period", testPeriod },
+};
+
+int main(int argc, char ** argv)
+{
+  if (argc != 2)
+  {
+    fprintf(stderr, "usage: %s <case>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  debug_init();
+  for (unsigned int i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    if (strcmp(argv[1], tests[i].name) == 0)
+    {
+      tests[i].run();
+      return 0;
+    }
+
+  fprintf(stderr, "unknown test: %s\n", argv[1]);
+  return EXIT_FAILURE;
+}
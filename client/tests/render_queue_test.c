@@ -734,6 +734,144 @@ static void testCursorReplacement(void)
   stop();
 }
 
+static void testCursorCollapse(void)
+{
+  start();
+
+  const uint64_t generation =
+    renderQueue_sourceBegin(RENDER_QUEUE_SOURCE_PRIMARY);
+  const uint8_t shape[] = { 1, 2, 3, 4 };
+  CHECK(renderQueue_sourceTransition(RENDER_QUEUE_SOURCE_PRIMARY,
+        generation, false, NULL) != 0);
+  renderQueue_sourceCursorImage(RENDER_QUEUE_SOURCE_PRIMARY, generation,
+      LG_CURSOR_COLOR, 1, 1, 4, shape);
+  renderQueue_process();
+  f.cursorCount = 0;
+
+  // successive positions only reach the renderer once, with the latest
+  for (int i = 0; i < 1000; ++i)
+    renderQueue_sourceCursorState(RENDER_QUEUE_SOURCE_PRIMARY, generation,
+        true, i, i + 1, 1, 2);
+  renderQueue_process();
+  CHECK(f.cursorCount == 1);
+  CHECK(f.cursorVisible);
+  CHECK(f.cursorX == 999);
+  CHECK(f.cursorY == 1000);
+
+  // a cleared cursor does not take the state queued before it
+  f.cursorCount = 0;
+  renderQueue_sourceCursorState(RENDER_QUEUE_SOURCE_PRIMARY, generation,
+      true, 5, 6, 1, 2);
+  renderQueue_sourceClearCursor(RENDER_QUEUE_SOURCE_PRIMARY);
+  renderQueue_sourceCursorState(RENDER_QUEUE_SOURCE_PRIMARY, generation,
+      true, 7, 8, 1, 2);
+  renderQueue_process();
+  CHECK(f.cursorCount == 2);
+  CHECK(!f.cursorVisible);
+  CHECK(f.cursorX == 7);
+  CHECK(f.cursorY == 8);
+
+  f.cursorCount = 0;
+  renderQueue_sourceCursorState(RENDER_QUEUE_SOURCE_PRIMARY, generation,
+      true, 9, 10, 1, 2);
+  renderQueue_process();
+  CHECK(f.cursorCount == 1);
+  CHECK(f.cursorX == 9);
+
+  stop();
+}
+
+static void testLatch(void)
+{
+  start();
+
+  const uint64_t generation =
+    renderQueue_sourceBegin(RENDER_QUEUE_SOURCE_PRIMARY);
+  const uint8_t shape[] = { 1, 2, 3, 4 };
+  CHECK(renderQueue_sourceTransition(RENDER_QUEUE_SOURCE_PRIMARY,
+        generation, false, NULL) != 0);
+  renderQueue_sourceCursorImage(RENDER_QUEUE_SOURCE_PRIMARY, generation,
+      LG_CURSOR_COLOR, 1, 1, 4, shape);
+  renderQueue_sourceCursorState(RENDER_QUEUE_SOURCE_PRIMARY, generation,
+      true, 1, 2, 1, 2);
+  renderQueue_process();
+  f.cursorCount = 0;
+
+  // nothing has moved since the last process
+  CHECK(!renderQueue_latchCursor());
+  CHECK(f.cursorCount == 0);
+
+  // a queued position is applied before the queue is processed
+  renderQueue_sourceCursorState(RENDER_QUEUE_SOURCE_PRIMARY, generation,
+      true, 3, 4, 1, 2);
+  CHECK(renderQueue_latchCursor());
+  CHECK(f.cursorCount == 1);
+  CHECK(f.cursorVisible);
+  CHECK(f.cursorX == 3);
+  CHECK(f.cursorY == 4);
+  CHECK(!renderQueue_latchCursor());
+  renderQueue_process();
+  CHECK(f.cursorX == 3);
+  CHECK(f.cursorY == 4);
+
+  // a position from a replaced generation is never latched
+  const uint64_t next =
+    renderQueue_sourceBegin(RENDER_QUEUE_SOURCE_PRIMARY);
+  renderQueue_sourceCursorState(RENDER_QUEUE_SOURCE_PRIMARY, next,
+      true, 5, 6, 1, 2);
+  f.cursorCount = 0;
+  CHECK(!renderQueue_latchCursor());
+  CHECK(f.cursorCount == 0);
+
+  stop();
+}
+
+static void testOverflow(void)
+{
+  start();
+
+  const uint64_t generation =
+    renderQueue_sourceBegin(RENDER_QUEUE_SOURCE_PRIMARY);
+  CHECK(renderQueue_sourceTransition(RENDER_QUEUE_SOURCE_PRIMARY,
+        generation, false, NULL) != 0);
+  renderQueue_process();
+  f.shapeCount = 0;
+  f.whiteCount = 0;
+
+  // more commands than the ring holds, and more shapes than there are slabs
+  for (int i = 0; i < 1000; ++i)
+  {
+    const uint8_t shape[] = { i, i >> 8, 3, 4 };
+    renderQueue_sourceCursorImage(RENDER_QUEUE_SOURCE_PRIMARY, generation,
+        LG_CURSOR_COLOR, 1, 1, 4, shape);
+    renderQueue_sourceCursorWhiteLevel(RENDER_QUEUE_SOURCE_PRIMARY,
+        generation, i);
+  }
+  renderQueue_process();
+  CHECK(f.shapeCount == 1000);
+  CHECK(f.shape[0] == (999 & 0xff));
+  CHECK(f.shape[1] == 999 >> 8);
+  CHECK(f.whiteCount == 1000);
+  CHECK(f.whiteLevel == 999);
+
+  // the ring is used again once the overflow has drained
+  renderQueue_sourceCursorWhiteLevel(RENDER_QUEUE_SOURCE_PRIMARY,
+      generation, 80);
+  renderQueue_process();
+  CHECK(f.whiteCount == 1001);
+  CHECK(f.whiteLevel == 80);
+
+  // queued shapes are released without being applied
+  for (int i = 0; i < 300; ++i)
+  {
+    const uint8_t shape[] = { 1, 2, 3, 4 };
+    renderQueue_sourceCursorImage(RENDER_QUEUE_SOURCE_PRIMARY, generation,
+        LG_CURSOR_COLOR, 1, 1, 4, shape);
+  }
+
+  stop();
+}
+
 struct Test
 {
   const char * name;
@@ -750,6 +888,9 @@ static const struct Test tests[] =
   { "validation", testValidation },
   { "cache"     , testCache      },
   { "cursor-replacement", testCursorReplacement },
+  { "cursor-collapse"   , testCursorCollapse    },
+  { "latch"             , testLatch             },
+  { "overflow"          , testOverflow          },
 };
 
 int main(int argc, char ** argv)
@@ -0,0 +1,148 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "common/rgb24.h"
+#include "common/debug.h"
+#include "test.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH  333
+#define HEIGHT 40
+#define PITCH  (WIDTH * 4)
+#define DPITCH (rgb24_texels(WIDTH) * 4)
+
+static uint8_t * makeImage(void)
+{
+  uint8_t * img = malloc(PITCH * HEIGHT);
+  CHECK(img);
+
+  uint32_t seed = 1;
+  for(int i = 0; i < PITCH * HEIGHT; ++i)
+  {
+    seed = seed * 1103515245 + 12345;
+    img[i] = seed >> 16;
+  }
+  return img;
+}
+
+static void packReference(uint8_t * dst, const uint8_t * src, unsigned width,
+    bool swap)
+{
+  for(unsigned x = 0; x < width; ++x)
+  {
+    dst[x * 3 + 0] = src[x * 4 + (swap ? 2 : 0)];
+    dst[x * 3 + 1] = src[x * 4 + 1];
+    dst[x * 3 + 2] = src[x * 4 + (swap ? 0 : 2)];
+  }
+}
+
+static void testKernels(void)
+{
+  static const char * kernels[] = { "scalar", "ssse3", "avx2" };
+  uint8_t * src = makeImage();
+  uint8_t   want[WIDTH * 3 + 16];
+  uint8_t   got [WIDTH * 3 + 16];
+
+  for(unsigned k = 0; k < sizeof(kernels) / sizeof(*kernels); ++k)
+  {
+    if (!rgb24_setKernel(kernels[k]))
+      continue;
+
+    for(int swap = 0; swap < 2; ++swap)
+      for(unsigned width = 0; width <= 70; ++width)
+        for(unsigned offset = 0; offset < 3; ++offset)
+        {
+          memset(want, 0xaa, sizeof(want));
+          memset(got , 0xaa, sizeof(got ));
+          packReference(want + offset, src + offset * 4, width, swap);
+          rgb24_packRow(got + offset, src + offset * 4, width, swap);
+          // nothing may be written outside of the row
+          CHECK(memcmp(want, got, sizeof(want)) == 0);
+        }
+  }
+
+  CHECK(!rgb24_setKernel("bogus"));
+  CHECK(rgb24_setKernel("auto"));
+  free(src);
+}
+
+static void testRects(void)
+{
+  uint8_t * src  = makeImage();
+  uint8_t * mem  = aligned_alloc(64, DPITCH * HEIGHT + 64);
+  uint8_t * want = malloc(DPITCH * HEIGHT);
+  CHECK(mem && want);
+  FrameBuffer * frame = (FrameBuffer *)(mem + 64 - sizeof(FrameBuffer));
+
+  memset(want, 0x55, DPITCH * HEIGHT);
+  memcpy(framebuffer_get_data(frame), want, DPITCH * HEIGHT);
+
+  // overlapping and clipped rects
+  const FrameDamageRect rects[] =
+  {
+    { .x =   1, .y =  2, .width =  17, .height =  5 },
+    { .x =  10, .y =  4, .width =  40, .height = 10 },
+    { .x = 300, .y = 30, .width = 100, .height = 100 }
+  };
+
+  for(unsigned i = 0; i < sizeof(rects) / sizeof(*rects); ++i)
+  {
+    const FrameDamageRect * r = rects + i;
+    for(unsigned y = r->y; y < r->y + r->height && y < HEIGHT; ++y)
+    {
+      const unsigned w = r->x + r->width > WIDTH ? WIDTH - r->x : r->width;
+      packReference(want + y * DPITCH + r->x * 3,
+          src + y * PITCH + r->x * 4, w, true);
+    }
+  }
+
+  framebuffer_prepare(frame);
+  rgb24_pack(frame, rects, sizeof(rects) / sizeof(*rects), src, PITCH, WIDTH,
+      HEIGHT, DPITCH, true);
+  CHECK(atomic_load(&frame->wp) == DPITCH * HEIGHT);
+  CHECK(memcmp(framebuffer_get_data(frame), want, DPITCH * HEIGHT) == 0);
+
+  // a full pack
+  for(unsigned y = 0; y < HEIGHT; ++y)
+    packReference(want + y * DPITCH, src + y * PITCH, WIDTH, false);
+
+  framebuffer_prepare(frame);
+  rgb24_pack(frame, NULL, 0, src, PITCH, WIDTH, HEIGHT, DPITCH, false);
+  CHECK(atomic_load(&frame->wp) == DPITCH * HEIGHT);
+  for(unsigned y = 0; y < HEIGHT; ++y)
+    CHECK(memcmp(framebuffer_get_data(frame) + y * DPITCH, want + y * DPITCH,
+          WIDTH * 3) == 0);
+
+  free(want);
+  free(mem);
+  free(src);
+}
+
+int main(int argc, char * argv[])
+{
+  debug_init();
+  testKernels();
+  testRects();
+  return EXIT_SUCCESS;
+}
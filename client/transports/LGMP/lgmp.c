@@ -1721,10 +1721,12 @@ static bool lgmp_validateFrameMessage(struct LGMPFrameMessage * message)
 
   const KVMFRFrame * frame = (const KVMFRFrame *)message->message.mem;
   const size_t frameDataSize = (size_t)frame->dataHeight * frame->pitch;
+
+  /* the decoder bounds its reads of compressed frames itself */
   if (frame->type <= FRAME_TYPE_INVALID || frame->type >= FRAME_TYPE_MAX ||
       frame->offset > message->message.size - sizeof(FrameBuffer) ||
-      frameDataSize >
-        message->message.size - frame->offset - sizeof(FrameBuffer))
+      (!(frame->flags & FRAME_FLAG_COMPRESSED) && frameDataSize >
+        message->message.size - frame->offset - sizeof(FrameBuffer)))
   {
     DEBUG_ERROR("LGMP frame payload contains invalid dimensions or offsets");
     return false;
@@ -1996,6 +1998,9 @@ static LG_TransportStatus lgmp_nextFrameLocked(LG_Transport * this,
     format->hdr           = frame->flags & FRAME_FLAG_HDR;
     format->hdrPQ         = frame->flags & FRAME_FLAG_HDR_PQ;
     format->hdrMetadata   = frame->flags & FRAME_FLAG_HDR_METADATA;
+    format->compressed    = frame->flags & FRAME_FLAG_COMPRESSED;
+    format->bufferSize    = selected->message.size - frame->offset -
+      sizeof(FrameBuffer);
     format->sdrWhiteLevel = frame->sdrWhiteLevel ? frame->sdrWhiteLevel :
       KVMFR_SDR_WHITE_LEVEL_DEFAULT;
     if (format->hdrMetadata)
@@ -2019,7 +2024,7 @@ static LG_TransportStatus lgmp_nextFrameLocked(LG_Transport * this,
   result->framebuffer = (const FrameBuffer *)((const uint8_t *)frame +
       frame->offset);
   result->dmaFD       = -1;
-  if (useDMA)
+  if (useDMA && !format->compressed)
   {
     const size_t dataSize = (size_t)format->dataHeight * format->pitch;
     result->dmaFD = lgmp_getDMA(this, frame, dataSize);
@@ -27,6 +27,7 @@
 
 #include <math.h>
 #include <stdatomic.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -45,6 +46,25 @@ enum TestDamageMode
   TEST_DAMAGE_ZERO,
 };
 
+static const char * testDamageNames[] =
+{
+  [TEST_DAMAGE_MOVING]  = "moving",
+  [TEST_DAMAGE_FULL]    = "full",
+  [TEST_DAMAGE_OVERLAP] = "overlap",
+  [TEST_DAMAGE_MAX]     = "max",
+  [TEST_DAMAGE_INVALID] = "invalid",
+  [TEST_DAMAGE_NULL]    = "null",
+  [TEST_DAMAGE_ZERO]    = "zero",
+};
+
+// the damage modes each format is benchmarked with
+static const enum TestDamageMode testBenchDamage[] =
+{
+  TEST_DAMAGE_MOVING,
+  TEST_DAMAGE_FULL,
+  TEST_DAMAGE_OVERLAP,
+};
+
 struct TestFormat
 {
   const char * name;
@@ -67,6 +87,8 @@ static const struct TestFormat testFormats[] =
 struct TestBuffer
 {
   FrameBuffer * framebuffer;
+  // the format version the contents were generated for
+  uint32_t      formatVersion;
 };
 
 struct LG_Transport
@@ -82,6 +104,14 @@ struct LG_Transport
   enum TestDamageMode     damageMode;
   unsigned                formatIndex;
 
+  // measured and warmup frames per benchmark case, zero if not benchmarking
+  unsigned                benchFrames;
+  unsigned                benchWarmup;
+  bool                    benchAllFormats;
+  const char            * benchCase;
+  char                    benchNames[ARRAY_LENGTH(testFormats) *
+                            ARRAY_LENGTH(testBenchDamage)][32];
+
   bool                    connected;
   bool                    framePending;
   uint64_t                serial;
@@ -165,6 +195,30 @@ static void test_setup(void)
       .type         = OPTION_TYPE_BOOL,
       .value.x_bool = false,
     },
+    {
+      .module      = "test",
+      .name        = "bench",
+      .description = "Benchmark the format, or every format with cycle, in "
+                     "each damage mode for this many frames as fast as "
+                     "possible",
+      .type        = OPTION_TYPE_INT,
+      .value.x_int = 0,
+    },
+    {
+      .module      = "test",
+      .name        = "benchWarmup",
+      .description = "Unmeasured frames at the start of each benchmark case",
+      .type        = OPTION_TYPE_INT,
+      .value.x_int = 30,
+    },
+    {
+      .module         = "test",
+      .name           = "benchFile",
+      .description    = "Write the benchmark results to this file instead "
+                        "of stdout",
+      .type           = OPTION_TYPE_STRING,
+      .value.x_string = NULL,
+    },
     {
       .module         = "test",
       .name           = "captureFile",
@@ -186,6 +240,22 @@ static void test_setup(void)
       .type        = OPTION_TYPE_INT,
       .value.x_int = 4,
     },
+    {
+      .module         = "test",
+      .name           = "captureStream",
+      .description    = "Stream every composed frame from captureFrame on to "
+                        "this file or pipe",
+      .type           = OPTION_TYPE_STRING,
+      .value.x_string = NULL,
+    },
+    {
+      .module      = "test",
+      .name        = "captureStreamFrames",
+      .description = "Exit after streaming this many frames, 0 streams until "
+                     "exit",
+      .type        = OPTION_TYPE_INT,
+      .value.x_int = 0,
+    },
     {0}
   };
 
@@ -203,19 +273,8 @@ static int test_findFormat(const char * name)
 
 static int test_findDamageMode(const char * name)
 {
-  static const char * names[] =
-  {
-    [TEST_DAMAGE_MOVING]  = "moving",
-    [TEST_DAMAGE_FULL]    = "full",
-    [TEST_DAMAGE_OVERLAP] = "overlap",
-    [TEST_DAMAGE_MAX]     = "max",
-    [TEST_DAMAGE_INVALID] = "invalid",
-    [TEST_DAMAGE_NULL]    = "null",
-    [TEST_DAMAGE_ZERO]    = "zero",
-  };
-
-  for (unsigned i = 0; i < ARRAY_LENGTH(names); ++i)
-    if (strcmp(name, names[i]) == 0)
+  for (unsigned i = 0; i < ARRAY_LENGTH(testDamageNames); ++i)
+    if (strcmp(name, testDamageNames[i]) == 0)
       return (int)i;
   return -1;
 }
@@ -335,6 +394,8 @@ static bool test_create(LG_Transport ** result)
   const int      stride       = option_get_int("test", "stride");
   const int      frameRate    = option_get_int("test", "frameRate");
   const int      frameCount   = option_get_int("test", "frameCount");
+  const int      benchFrames  = option_get_int("test", "bench");
+  const int      benchWarmup  = option_get_int("test", "benchWarmup");
   const char *   format       = option_get_string("test", "format");
   const char *   damage       = option_get_string("test", "damage");
   const int      damageMode   = damage ? test_findDamageMode(damage) : -1;
@@ -348,6 +409,7 @@ static bool test_create(LG_Transport ** result)
       stride < 0 || (stride && stride < width) ||
       bufferStride > UINT32_MAX / maxBytesPerPixel ||
       frameRate < 1 || frameRate > 1000000000 || frameCount < 0 ||
+      benchFrames < 0 || benchWarmup < 0 ||
       bufferStride > (SIZE_MAX - sizeof(FrameBuffer)) /
         maxBytesPerPixel / (size_t)height)
   {
@@ -369,6 +431,28 @@ static bool test_create(LG_Transport ** result)
   this->formatIndex  = (unsigned)formatIndex;
   test_initPQLUT(this);
 
+  if (benchFrames)
+  {
+    // the cases run back to back, format cycling is per case instead
+    const unsigned formats = cycleFormats ? ARRAY_LENGTH(testFormats) : 1;
+    const unsigned cases   = formats * ARRAY_LENGTH(testBenchDamage);
+    this->benchFrames     = benchFrames;
+    this->benchWarmup     = benchWarmup;
+    this->benchAllFormats = cycleFormats;
+    this->cycleFormats    = false;
+    this->realtime        = false;
+    this->frameCount      = cases * (benchFrames + benchWarmup);
+
+    for (unsigned i = 0; i < cases; ++i)
+    {
+      const unsigned format = cycleFormats ?
+        i / ARRAY_LENGTH(testBenchDamage) : this->formatIndex;
+      snprintf(this->benchNames[i], sizeof(this->benchNames[i]), "%s/%s",
+          testFormats[format].name,
+          testDamageNames[testBenchDamage[i % ARRAY_LENGTH(testBenchDamage)]]);
+    }
+  }
+
   const size_t dataSize =
     bufferStride * this->height * maxBytesPerPixel;
   for (unsigned i = 0; i < TEST_BUFFER_COUNT; ++i)
@@ -413,6 +497,8 @@ static LG_TransportStatus test_connect(LG_Transport * this,
   this->bufferIndex    = 0;
   this->nextFrameTime  = nanotime();
   this->format.version = 0;
+  for (unsigned i = 0; i < TEST_BUFFER_COUNT; ++i)
+    this->buffers[i].formatVersion = 0;
   test_setFormat(this, this->formatIndex);
   return LG_TRANSPORT_OK;
 }
@@ -596,6 +682,20 @@ static void test_generateFrame(struct LG_Transport * this, FrameBuffer * fb)
   framebuffer_set_write_ptr(fb, (size_t)this->format.pitch * this->height);
 }
 
+/* select the benchmark case of the next frame, true if the format changed */
+static bool test_benchCase(struct LG_Transport * this)
+{
+  const unsigned perCase = this->benchWarmup + this->benchFrames;
+  const unsigned index   = this->serial / perCase;
+  const unsigned format  = this->benchAllFormats ?
+    index / ARRAY_LENGTH(testBenchDamage) : this->formatIndex;
+
+  this->damageMode = testBenchDamage[index % ARRAY_LENGTH(testBenchDamage)];
+  this->benchCase  = this->serial % perCase < this->benchWarmup ?
+    NULL : this->benchNames[index];
+  return test_setFormat(this, format);
+}
+
 static LG_TransportStatus test_nextFrame(LG_Transport * this, bool useDMA,
     LG_TransportFrame * frame)
 {
@@ -623,13 +723,23 @@ static LG_TransportStatus test_nextFrame(LG_Transport * this, bool useDMA,
     }
   }
 
-  const bool formatChanged = this->cycleFormats && test_setFormat(this,
+  const bool formatChanged = this->benchFrames ? test_benchCase(this) :
+    this->cycleFormats && test_setFormat(this,
       this->serial % ARRAY_LENGTH(testFormats));
   ++this->serial;
   struct TestBuffer * buffer = &this->buffers[this->bufferIndex];
   this->bufferIndex = (this->bufferIndex + 1) % TEST_BUFFER_COUNT;
-  framebuffer_prepare(buffer->framebuffer);
-  test_generateFrame(this, buffer->framebuffer);
+
+  /* the cost of importing a frame does not depend on its contents, so a
+   * benchmark only generates each buffer once per format to not be limited by
+   * how fast frames can be drawn on the CPU */
+  if (!this->benchFrames ||
+      buffer->formatVersion != this->format.version)
+  {
+    framebuffer_prepare(buffer->framebuffer);
+    test_generateFrame(this, buffer->framebuffer);
+    buffer->formatVersion = this->format.version;
+  }
 
   memset(frame, 0, sizeof(*frame));
   frame->serial    = this->serial;
@@ -722,6 +832,7 @@ static void test_getFrameTiming(LG_Transport * this,
 
   timing->providerValid = true;
   timing->prepareTime   = this->framePrepareTime;
+  timing->benchCase     = this->benchCase;
 }
 
 static void test_releaseFrame(LG_Transport * this, LG_TransportFrame * frame)
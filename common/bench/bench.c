@@ -0,0 +1,40 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int compareDouble(const void * a_, const void * b_)
+{
+  const double a = *(const double *)a_;
+  const double b = *(const double *)b_;
+  return (a > b) - (a < b);
+}
+
+double bench_median(const double * values, int count, double * scratch)
+{
+  if (scratch != values)
+    memcpy(scratch, values, count * sizeof(*values));
+  qsort(scratch, count, sizeof(*scratch), compareDouble);
+  return count & 1 ? scratch[count / 2] :
+    (scratch[count / 2 - 1] + scratch[count / 2]) / 2.0;
+}
@@ -0,0 +1,528 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * Microbenchmarks of the common code every frame goes through.
+ *
+ * Each case is calibrated so one sample takes at least SAMPLE_NS, warmed up,
+ * then sampled until the median absolute deviation is within STABLE_PCT of
+ * the median or MAX_SAMPLES is reached. Copies are reported in GB/s, anything
+ * else in ns per operation, followed by the deviation.
+ *
+ * To compare two builds save the output of one and pass it to the other with
+ * -c, a speedup column is added where higher is better for every unit:
+ *
+ *   common-bench > base.txt
+ *   common-bench -c base.txt
+ *
+ * Usage: common-bench [-c baseline] [filter...]
+ *
+ * Only the cases whose name contains one of the filters are run.
+ */
+
+#include "bench.h"
+#include "common/framebuffer.h"
+#include "common/rects.h"
+#include "common/ringbuffer.h"
+#include "common/runningavg.h"
+#include "common/array.h"
+#include "common/debug.h"
+#include "common/time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_NS   20000000ULL
+#define WARMUP      3
+#define MIN_SAMPLES 10
+#define MAX_SAMPLES 50
+#define STABLE_PCT  1.0
+#define MAX_RECTS   256
+
+struct Resolution
+{
+  const char * name;
+  unsigned     width;
+  unsigned     height;
+};
+
+static const struct Resolution resolutions[] =
+{
+  { "1080p", 1920, 1080 },
+  { "1440p", 2560, 1440 },
+  { "4K"   , 3840, 2160 },
+  { "8K"   , 7680, 4320 },
+};
+
+/* extra bytes per destination row, 256 matches the client texture alignment */
+static const unsigned pads[] = { 0, 256 };
+
+static const unsigned rectCounts[] = { 1, 4, 16, 64, 256 };
+
+struct Baseline
+{
+  char   name[64];
+  char   unit[8];
+  double value;
+};
+
+static struct
+{
+  const char     ** filters;
+  int               filterCount;
+  struct Baseline * baseline;
+  int               baselineCount;
+
+  uint8_t         * mem;
+  FrameBuffer     * frame;
+  uint8_t         * src;
+  uint8_t         * dst;
+}
+state;
+
+typedef void (*BenchFn)(void * opaque, unsigned iterations);
+
+static bool selected(const char * name)
+{
+  if (!state.filterCount)
+    return true;
+
+  for(int i = 0; i < state.filterCount; ++i)
+    if (strstr(name, state.filters[i]))
+      return true;
+  return false;
+}
+
+static uint64_t timeRun(BenchFn fn, void * opaque, unsigned iterations)
+{
+  const uint64_t start = nanotime();
+  fn(opaque, iterations);
+  return nanotime() - start;
+}
+
+static const struct Baseline * findBaseline(const char * name)
+{
+  for(int i = 0; i < state.baselineCount; ++i)
+    if (strcmp(state.baseline[i].name, name) == 0)
+      return &state.baseline[i];
+  return NULL;
+}
+
+/* run a case and print its result, `bytes` is the data moved per operation or
+ * zero to report the time per operation */
+static void measure(const char * name, double bytes, BenchFn fn,
+    void * opaque)
+{
+  if (!selected(name))
+    return;
+
+  unsigned iterations = 1;
+  while(timeRun(fn, opaque, iterations) < SAMPLE_NS && iterations < 1U << 30)
+    iterations *= 2;
+
+  for(int i = 0; i < WARMUP; ++i)
+    timeRun(fn, opaque, iterations);
+
+  double samples[MAX_SAMPLES];
+  double scratch[MAX_SAMPLES];
+  double med = 0.0, dev = 0.0;
+  int    count;
+
+  for(count = 0; count < MAX_SAMPLES;)
+  {
+    samples[count++] =
+      (double)timeRun(fn, opaque, iterations) / iterations;
+    if (count < MIN_SAMPLES)
+      continue;
+
+    med = bench_median(samples, count, scratch);
+    double deviations[MAX_SAMPLES];
+    for(int i = 0; i < count; ++i)
+      deviations[i] = samples[i] > med ? samples[i] - med : med - samples[i];
+    dev = bench_median(deviations, count, scratch) / med * 100.0;
+
+    if (dev <= STABLE_PCT)
+      break;
+  }
+
+  const char * unit  = bytes > 0.0 ? "GB/s" : "ns/op";
+  const double value = bytes > 0.0 ? bytes / med : med;
+
+  printf("%-32s %12.3f %-5s %5.1f%%", name, value, unit, dev);
+
+  const struct Baseline * base = findBaseline(name);
+  if (base && strcmp(base->unit, unit) == 0 && base->value > 0.0)
+    printf(" %7.2fx", bytes > 0.0 ? value / base->value : base->value / value);
+
+  putchar('\n');
+  fflush(stdout);
+}
+
+static bool loadBaseline(const char * path)
+{
+  FILE * file = fopen(path, "r");
+  if (!file)
+  {
+    DEBUG_ERROR("Failed to open the baseline: %s", path);
+    return false;
+  }
+
+  char line[256];
+  while(fgets(line, sizeof(line), file))
+  {
+    if (line[0] == '#')
+      continue;
+
+    struct Baseline b;
+    if (sscanf(line, "%63s %lf %7s", b.name, &b.value, b.unit) != 3)
+      continue;
+
+    struct Baseline * grown = realloc(state.baseline,
+        (state.baselineCount + 1) * sizeof(*grown));
+    if (!grown)
+    {
+      DEBUG_ERROR("out of memory");
+      fclose(file);
+      return false;
+    }
+
+    state.baseline = grown;
+    state.baseline[state.baselineCount++] = b;
+  }
+
+  fclose(file);
+  return true;
+}
+
+struct CopyCase
+{
+  unsigned width;
+  unsigned height;
+  size_t   dstPitch;
+};
+
+static void benchWrite(void * opaque, unsigned iterations)
+{
+  const struct CopyCase * c = opaque;
+  while(iterations--)
+  {
+    framebuffer_prepare(state.frame);
+    framebuffer_write(state.frame, state.src, (size_t)c->width * 4 * c->height);
+  }
+}
+
+static void benchRead(void * opaque, unsigned iterations)
+{
+  const struct CopyCase * c = opaque;
+  uint64_t waitTime = 0;
+  while(iterations--)
+    if (!framebuffer_read_timed(state.frame, state.dst, c->dstPitch, c->height,
+          c->width, 4, c->width * 4, &waitTime))
+      abort();
+}
+
+static void benchFramebuffer(void)
+{
+  static const char * writeKernels[] = { "sse4_1", "avx2" };
+  static const char * readKernels [] = { "memcpy", "sse4_1", "avx2", "avx512" };
+  char name[64];
+
+  for(unsigned k = 0; k < ARRAY_LENGTH(writeKernels); ++k)
+  {
+    if (!framebuffer_set_write_kernel(writeKernels[k]))
+      continue;
+
+    for(unsigned r = 0; r < ARRAY_LENGTH(resolutions); ++r)
+    {
+      const struct Resolution * res = &resolutions[r];
+      struct CopyCase c = { .width = res->width, .height = res->height };
+      snprintf(name, sizeof(name), "fb_write/%s/%s",
+          writeKernels[k], res->name);
+      measure(name, (double)res->width * 4 * res->height, benchWrite, &c);
+    }
+  }
+  framebuffer_set_write_kernel("auto");
+
+  for(unsigned r = 0; r < ARRAY_LENGTH(resolutions); ++r)
+  {
+    const struct Resolution * res = &resolutions[r];
+    const size_t size = (size_t)res->width * 4 * res->height;
+    framebuffer_prepare(state.frame);
+    framebuffer_write(state.frame, state.src, size);
+
+    for(unsigned k = 0; k < ARRAY_LENGTH(readKernels); ++k)
+    {
+      if (!framebuffer_set_read_kernel(readKernels[k]))
+        continue;
+
+      for(unsigned p = 0; p < ARRAY_LENGTH(pads); ++p)
+      {
+        struct CopyCase c =
+        {
+          .width    = res->width,
+          .height   = res->height,
+          .dstPitch = res->width * 4 + pads[p]
+        };
+        snprintf(name, sizeof(name), "fb_read/%s/%s/pad%u",
+            readKernels[k], res->name, pads[p]);
+        measure(name, (double)size, benchRead, &c);
+      }
+    }
+  }
+  framebuffer_set_read_kernel("memcpy");
+}
+
+struct RectCase
+{
+  const struct Resolution * res;
+  FrameDamageRect           rects[MAX_RECTS];
+  int                       count;
+};
+
+/* scattered rects of 16 to 271 pixels a side, some of them overlapping */
+static void makeRects(struct RectCase * c, const struct Resolution * res,
+    int count)
+{
+  uint32_t seed = 1;
+  c->res   = res;
+  c->count = count;
+  for(int i = 0; i < count; ++i)
+  {
+    FrameDamageRect * r = &c->rects[i];
+    seed = seed * 1103515245 + 12345;
+    r->width  = 16 + (seed >> 16) % 256;
+    seed = seed * 1103515245 + 12345;
+    r->height = 16 + (seed >> 16) % 256;
+    seed = seed * 1103515245 + 12345;
+    r->x      = (seed >> 8) % (res->width  - r->width );
+    seed = seed * 1103515245 + 12345;
+    r->y      = (seed >> 8) % (res->height - r->height);
+  }
+}
+
+/* the bytes the union of the rects covers, what the copies actually move */
+static double rectBytes(const struct RectCase * c)
+{
+  const unsigned width  = c->res->width;
+  const unsigned height = c->res->height;
+  uint8_t * mask = calloc((size_t)width, height);
+  if (!mask)
+    abort();
+
+  for(int i = 0; i < c->count; ++i)
+  {
+    const FrameDamageRect * r = &c->rects[i];
+    for(unsigned y = r->y; y < r->y + r->height; ++y)
+      memset(mask + (size_t)y * width + r->x, 1, r->width);
+  }
+
+  size_t pixels = 0;
+  for(size_t i = 0; i < (size_t)width * height; ++i)
+    pixels += mask[i];
+
+  free(mask);
+  return pixels * 4.0;
+}
+
+static void benchRectsRead(void * opaque, unsigned iterations)
+{
+  struct RectCase * c = opaque;
+  const int pitch = c->res->width * 4;
+  uint64_t waitTime = 0;
+  while(iterations--)
+    if (!rectsFramebufferToBufferTimed(c->rects, c->count, 4, state.dst, pitch,
+          c->res->height, state.frame, pitch, &waitTime))
+      abort();
+}
+
+static void benchRectsWrite(void * opaque, unsigned iterations)
+{
+  struct RectCase * c = opaque;
+  const int pitch = c->res->width * 4;
+  while(iterations--)
+  {
+    framebuffer_prepare(state.frame);
+    rectsBufferToFramebuffer(c->rects, c->count, 4, state.frame, pitch,
+        c->res->height, state.src, pitch);
+  }
+}
+
+static void benchRectsMerge(void * opaque, unsigned iterations)
+{
+  struct RectCase * c = opaque;
+  FrameDamageRect rects[MAX_RECTS];
+  while(iterations--)
+  {
+    memcpy(rects, c->rects, c->count * sizeof(*rects));
+    const int count = rectsMergeOverlapping(rects, c->count);
+    rectsRejectContained(rects, count);
+  }
+}
+
+static void benchRects(void)
+{
+  static struct RectCase c;
+  char name[64];
+
+  for(unsigned r = 0; r < ARRAY_LENGTH(resolutions); ++r)
+  {
+    const struct Resolution * res = &resolutions[r];
+    const size_t size = (size_t)res->width * 4 * res->height;
+
+    for(unsigned n = 0; n < ARRAY_LENGTH(rectCounts); ++n)
+    {
+      makeRects(&c, res, rectCounts[n]);
+      const double bytes = rectBytes(&c);
+
+      framebuffer_prepare(state.frame);
+      framebuffer_write(state.frame, state.src, size);
+      snprintf(name, sizeof(name), "rects_read/%s/%u", res->name,
+          rectCounts[n]);
+      measure(name, bytes, benchRectsRead, &c);
+
+      snprintf(name, sizeof(name), "rects_write/%s/%u", res->name,
+          rectCounts[n]);
+      measure(name, bytes, benchRectsWrite, &c);
+    }
+  }
+
+  // the merge only depends on the rect count
+  for(unsigned n = 0; n < ARRAY_LENGTH(rectCounts); ++n)
+  {
+    makeRects(&c, &resolutions[0], rectCounts[n]);
+    snprintf(name, sizeof(name), "rects_merge/%u", rectCounts[n]);
+    measure(name, 0.0, benchRectsMerge, &c);
+  }
+}
+
+struct RingCase
+{
+  RingBuffer rb;
+  int        count;
+  float      values[2048 * 2];
+};
+
+static void benchRingBuffer(void * opaque, unsigned iterations)
+{
+  struct RingCase * c = opaque;
+  while(iterations--)
+  {
+    ringbuffer_append (c->rb, c->values, c->count);
+    ringbuffer_consume(c->rb, c->values, c->count);
+  }
+}
+
+struct AvgCase
+{
+  RunningAvg ra;
+  bool       calc;
+  double     sink;
+};
+
+static void benchRunningAvg(void * opaque, unsigned iterations)
+{
+  struct AvgCase * c = opaque;
+  while(iterations--)
+  {
+    runningavg_push(c->ra, iterations);
+    if (c->calc)
+      c->sink += runningavg_calc(c->ra);
+  }
+}
+
+static void benchMisc(void)
+{
+  // stereo float frames as the audio path uses, 480 is 10ms at 48kHz
+  static const int ringCounts[] = { 64, 480, 2048 };
+  static struct RingCase ring;
+  char name[64];
+
+  for(unsigned i = 0; i < ARRAY_LENGTH(ringCounts); ++i)
+  {
+    ring.rb    = ringbuffer_newUnbounded(8192, sizeof(float) * 2);
+    ring.count = ringCounts[i];
+    if (!ring.rb)
+      abort();
+
+    snprintf(name, sizeof(name), "ringbuffer/%d", ringCounts[i]);
+    measure(name, 0.0, benchRingBuffer, &ring);
+    ringbuffer_free(&ring.rb);
+  }
+
+  for(int calc = 0; calc < 2; ++calc)
+  {
+    struct AvgCase avg = { .ra = runningavg_new(120), .calc = calc };
+    if (!avg.ra)
+      abort();
+
+    measure(calc ? "runningavg/push+calc" : "runningavg/push", 0.0,
+        benchRunningAvg, &avg);
+    runningavg_free(&avg.ra);
+  }
+}
+
+int main(int argc, char * argv[])
+{
+  debug_init();
+
+  int arg = 1;
+  if (arg + 1 < argc && strcmp(argv[arg], "-c") == 0)
+  {
+    if (!loadBaseline(argv[arg + 1]))
+      return EXIT_FAILURE;
+    arg += 2;
+  }
+  state.filters     = (const char **)argv + arg;
+  state.filterCount = argc - arg;
+
+  const struct Resolution * largest =
+    &resolutions[ARRAY_LENGTH(resolutions) - 1];
+  const size_t maxSize = ((size_t)largest->width * 4 + pads[1]) *
+    largest->height;
+
+  /* like the host, place the data on an aligned boundary after the header */
+  state.mem = aligned_alloc(64, maxSize + 64);
+  state.src = aligned_alloc(64, maxSize);
+  state.dst = aligned_alloc(64, maxSize);
+  if (!state.mem || !state.src || !state.dst)
+  {
+    fprintf(stderr, "out of memory\n");
+    return EXIT_FAILURE;
+  }
+  state.frame = (FrameBuffer *)(state.mem + 64 - sizeof(FrameBuffer));
+
+  for(size_t i = 0; i < maxSize; ++i)
+    state.src[i] = i * 2654435761U >> 24;
+  memset(state.dst, 0, maxSize);
+
+  printf("# %-30s %12s %-5s %6s%s\n", "case", "value", "unit", "dev",
+      state.baselineCount ? "  speedup" : "");
+
+  benchFramebuffer();
+  benchRects();
+  benchMisc();
+
+  free(state.baseline);
+  free(state.mem);
+  free(state.src);
+  free(state.dst);
+  return EXIT_SUCCESS;
+}
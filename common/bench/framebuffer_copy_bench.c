@@ -0,0 +1,129 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * Compares the framebuffer read kernels against memcpy.
+ *
+ * "frame" copies a whole 4K BGRA frame in chunk sized pieces as
+ * framebuffer_read_linear does, "rows" copies it row by row as the padded
+ * path does, and "rows+12" does the same from a misaligned source as happens
+ * with 24-bit formats.
+ *
+ * Usage: framebuffer-copy-bench
+ */
+
+#include "bench.h"
+#include "common/framebuffer.h"
+#include "common/debug.h"
+#include "common/time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ITERATIONS 20
+#define WARMUP     3
+#define WIDTH      3840
+#define HEIGHT     2160
+#define BPP        4
+
+static const char * kernels[] = { "memcpy", "sse4_1", "avx2", "avx512" };
+
+struct Case
+{
+  const char * name;
+  size_t       offset;
+  size_t       piece;
+};
+
+static const struct Case cases[] =
+{
+  { "frame"  ,  0, FB_CHUNK_SIZE },
+  { "rows"   ,  0, WIDTH * BPP   },
+  { "rows+12", 12, WIDTH * BPP   },
+};
+
+static double run(const struct Case * c, const uint8_t * src, uint8_t * dst,
+    size_t size)
+{
+  double samples[ITERATIONS];
+  for(int i = 0; i < WARMUP + ITERATIONS; ++i)
+  {
+    const uint64_t start = nanotime();
+    for(size_t pos = 0; pos < size; pos += c->piece)
+      framebuffer_copy(dst + pos, src + c->offset + pos,
+          size - pos < c->piece ? size - pos : c->piece);
+    const uint64_t elapsed = nanotime() - start;
+
+    if (i >= WARMUP)
+      samples[i - WARMUP] = elapsed;
+  }
+
+  return size / bench_median(samples, ITERATIONS, samples);
+}
+
+int main(int argc, char * argv[])
+{
+  debug_init();
+
+  const size_t size = (size_t)WIDTH * HEIGHT * BPP;
+  uint8_t * src = aligned_alloc(64, size + 64);
+  uint8_t * dst = aligned_alloc(64, size);
+  if (!src || !dst)
+  {
+    fprintf(stderr, "out of memory\n");
+    return EXIT_FAILURE;
+  }
+
+  for(size_t i = 0; i < size + 64; ++i)
+    src[i] = i * 2654435761U >> 24;
+  memset(dst, 0, size);
+
+  printf("%-8s %-8s %10s %8s\n", "case", "kernel", "GB/s", "memcpy");
+
+  for(unsigned c = 0; c < sizeof(cases) / sizeof(*cases); ++c)
+  {
+    double base = 0.0;
+    for(unsigned k = 0; k < sizeof(kernels) / sizeof(*kernels); ++k)
+    {
+      if (!framebuffer_set_read_kernel(kernels[k]))
+        continue;
+
+      const double gbps = run(&cases[c], src, dst, size);
+      if (k == 0)
+        base = gbps;
+
+      if (memcmp(dst, src + cases[c].offset, size) != 0)
+      {
+        fprintf(stderr, "%s: %s produced a bad copy\n",
+            cases[c].name, kernels[k]);
+        return EXIT_FAILURE;
+      }
+
+      printf("%-8s %-8s %10.2f %7.2fx\n",
+          cases[c].name, kernels[k], gbps, gbps / base);
+      memset(dst, 0, size);
+    }
+  }
+
+  free(src);
+  free(dst);
+  return EXIT_SUCCESS;
+}
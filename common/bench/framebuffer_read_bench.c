@@ -0,0 +1,194 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * Measures framebuffer_read throughput with and without the read worker pool.
+ *
+ * "ready" reads a frame that has already been fully written, which shows the
+ * raw copy bandwidth available to the pool. "stream" starts the producer and
+ * the reader together, as a client does when a new frame arrives, and reports
+ * the time from the start of the producer's copy to the end of ours.
+ *
+ * Usage: framebuffer-read-bench [threads...]
+ */
+
+#include "bench.h"
+#include "common/framebuffer.h"
+#include "common/debug.h"
+#include "common/thread.h"
+#include "common/time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define ITERATIONS 20
+#define WARMUP     3
+
+struct Format
+{
+  const char * name;
+  unsigned     width;
+  unsigned     height;
+  unsigned     bpp;
+};
+
+static const struct Format formats[] =
+{
+  { "1080p BGRA"   , 1920, 1080, 4 },
+  { "4K BGRA"      , 3840, 2160, 4 },
+  { "4K RGBA16F"   , 3840, 2160, 8 },
+  { "8K BGRA"      , 7680, 4320, 4 },
+};
+
+struct Producer
+{
+  FrameBuffer   * frame;
+  const uint8_t * src;
+  size_t          size;
+  atomic_bool     go;
+};
+
+static int producerThread(void * opaque)
+{
+  struct Producer * p = opaque;
+  while(!atomic_load_explicit(&p->go, memory_order_acquire)) {}
+  framebuffer_write(p->frame, p->src, p->size);
+  return 0;
+}
+
+static double run(const struct Format * fmt, FrameBuffer * frame,
+    const uint8_t * src, uint8_t * dst, bool stream, bool padded)
+{
+  const size_t pitch    = (size_t)fmt->width * fmt->bpp;
+  const size_t size     = pitch * fmt->height;
+  const size_t dstpitch = padded ? pitch + 256 : pitch;
+  double samples[ITERATIONS];
+
+  for(int i = 0; i < WARMUP + ITERATIONS; ++i)
+  {
+    uint64_t elapsed;
+    if (stream)
+    {
+      struct Producer p = { .frame = frame, .src = src, .size = size };
+      LGThread * thread;
+      framebuffer_prepare(frame);
+      if (!lgCreateThread("producer", producerThread, &p, &thread))
+        abort();
+
+      const uint64_t start = nanotime();
+      atomic_store_explicit(&p.go, true, memory_order_release);
+      if (!framebuffer_read(frame, dst, dstpitch, fmt->height, fmt->width,
+            fmt->bpp, pitch))
+        abort();
+      elapsed = nanotime() - start;
+      lgJoinThread(thread, NULL);
+    }
+    else
+    {
+      const uint64_t start = nanotime();
+      if (!framebuffer_read(frame, dst, dstpitch, fmt->height, fmt->width,
+            fmt->bpp, pitch))
+        abort();
+      elapsed = nanotime() - start;
+    }
+
+    if (i >= WARMUP)
+      samples[i - WARMUP] = elapsed;
+  }
+
+  return size / bench_median(samples, ITERATIONS, samples);
+}
+
+int main(int argc, char * argv[])
+{
+  debug_init();
+
+  unsigned threads[16] = { 1, 2, 4 };
+  int      threadCount = 3;
+  if (argc > 1)
+  {
+    threadCount = 0;
+    for(int i = 1; i < argc && threadCount < 16; ++i)
+      threads[threadCount++] = strtoul(argv[i], NULL, 10);
+  }
+
+  const struct Format * largest = &formats[0];
+  for(unsigned i = 1; i < sizeof(formats) / sizeof(*formats); ++i)
+    if ((size_t)formats[i].width * formats[i].height * formats[i].bpp >
+        (size_t)largest->width * largest->height * largest->bpp)
+      largest = &formats[i];
+
+  const size_t maxSize = ((size_t)largest->width * largest->bpp + 256) *
+    largest->height;
+  /* like the host, place the data on an aligned boundary after the header */
+  uint8_t * mem = aligned_alloc(64, maxSize + 64);
+  uint8_t * src = aligned_alloc(64, maxSize);
+  uint8_t * dst = aligned_alloc(64, maxSize);
+  if (!mem || !src || !dst)
+  {
+    fprintf(stderr, "out of memory\n");
+    return EXIT_FAILURE;
+  }
+  FrameBuffer * frame = (FrameBuffer *)(mem + 64 - sizeof(FrameBuffer));
+
+  for(size_t i = 0; i < maxSize; ++i)
+    src[i] = i * 2654435761U >> 24;
+  memset(dst, 0, maxSize);
+
+  printf("%-12s %-6s %-6s %7s %10s\n",
+      "format", "mode", "pitch", "threads", "GB/s");
+
+  for(unsigned f = 0; f < sizeof(formats) / sizeof(*formats); ++f)
+  {
+    const struct Format * fmt = &formats[f];
+    framebuffer_prepare(frame);
+    framebuffer_write(frame, src,
+        (size_t)fmt->width * fmt->bpp * fmt->height);
+
+    for(int mode = 0; mode < 2; ++mode)
+      for(int padded = 0; padded < 2; ++padded)
+        for(int t = 0; t < threadCount; ++t)
+        {
+          if (!framebuffer_set_read_threads(threads[t]))
+            return EXIT_FAILURE;
+
+          const double gbps = run(fmt, frame, src, dst, mode, padded);
+          printf("%-12s %-6s %-6s %7u %10.2f\n",
+              fmt->name, mode ? "stream" : "ready",
+              padded ? "row" : "linear", threads[t], gbps);
+
+          if (mode == 0)
+          {
+            // leave the frame complete for the next ready pass
+            framebuffer_prepare(frame);
+            framebuffer_write(frame, src,
+                (size_t)fmt->width * fmt->bpp * fmt->height);
+          }
+        }
+  }
+
+  framebuffer_set_read_threads(0);
+  free(mem);
+  free(src);
+  free(dst);
+  return EXIT_SUCCESS;
+}
@@ -32,7 +32,7 @@
 #include "KVMFRInput.h"
 
 #define KVMFR_MAGIC   "KVMFR---"
-#define KVMFR_VERSION 34
+#define KVMFR_VERSION 35
 
 // Fallback used by producers that cannot report the source display's SDR
 // white level. IDD frames override this with IDDCX_METADATA2::SdrWhiteLevel.
@@ -165,7 +165,8 @@ enum
   FRAME_FLAG_TRUNCATED          = 0x4 , // ivshmem was too small for the frame
   FRAME_FLAG_HDR                = 0x8 , // RGBA10 may not be HDR
   FRAME_FLAG_HDR_PQ             = 0x10, // HDR PQ has been applied to the frame
-  FRAME_FLAG_HDR_METADATA       = 0x20  // HDR static metadata fields are valid
+  FRAME_FLAG_HDR_METADATA       = 0x20, // HDR static metadata fields are valid
+  FRAME_FLAG_COMPRESSED         = 0x40  // the data is coded with framecodec
 };
 
 typedef uint32_t KVMFRFrameFlags;
@@ -194,8 +195,8 @@ typedef struct KVMFRFrame
   uint32_t        frameWidth;         // the unpacked frame width
   uint32_t        frameHeight;        // the unpacked frame height
   FrameRotation   rotation;           // the frame rotation
-  uint32_t        stride;             // the row stride (zero if compressed data)
-  uint32_t        pitch;              // the row pitch  (stride in bytes or the compressed frame size)
+  uint32_t        stride;             // the row stride
+  uint32_t        pitch;              // the row pitch in bytes (of the decoded rows if compressed)
   uint32_t        offset;             // offset from the start of this header to the FrameBuffer header
   KVMFRFrameFlags flags;              // bit field combination of FRAME_FLAG_*
   uint32_t        damageRectsCount;   // the number of damage rectangles (zero for full-frame damage)
@@ -38,6 +38,8 @@ typedef struct
   bool aes;
   bool xsave, osxsave;
   bool avx, avx2;
+  bool f16c;
+  bool avx512f;
   bool bmi1, bmi2;
 }
 CPUInfoFeatures;
@@ -26,17 +26,33 @@
 #include <stdint.h>
 #include <stdatomic.h>
 
+#include "common/types.h"
+
 #define FB_CHUNK_SIZE           1048576 // 1MB
-#define FB_SPIN_LIMIT           10000   // 10ms
+#define FB_SPIN_MIN_NS          1000ULL      // 1μs
+#define FB_SPIN_MAX_NS          50000ULL     // 50μs
+#define FB_BLOCK_SLICE_NS       50000ULL     // 50μs
+#define FB_WAIT_TIMEOUT_NS      500000000ULL // 500ms
+#define FB_MAX_READ_THREADS     16
+#define FB_PARALLEL_MIN_SIZE    (8 * FB_CHUNK_SIZE)
+#define FB_READ_FN_STAGING      65536 // 64KB
 #define FB_WP_TYPE              atomic_uint_least32_t
 #define FB_WP_SIZE              sizeof(FB_WP_TYPE)
 
 typedef struct stFrameBuffer
 {
   FB_WP_TYPE wp;
+  FB_WP_TYPE waiters; // readers blocked on wp, the writer only wakes if set
   uint8_t    data[0];
 } FrameBuffer;
 
+typedef struct FrameBufferWaitStats
+{
+  uint64_t spinNs;
+  uint64_t blockNs;
+}
+FrameBufferWaitStats;
+
 typedef bool (*FrameBufferReadFn)(void * opaque, const void * src, size_t size);
 
 /**
@@ -51,6 +67,33 @@ bool framebuffer_wait(const FrameBuffer * frame, size_t size);
 bool framebuffer_wait_timed(const FrameBuffer * frame, size_t size,
     uint64_t * waitTimeNs);
 
+/**
+ * Return the nanoseconds all threads have spent busy-spinning and blocking on
+ * producers since the previous call, and reset the counters.
+ */
+void framebuffer_take_wait_stats(FrameBufferWaitStats * stats);
+
+/**
+ * Split reads of large frames across `threads` threads, including the calling
+ * thread. Zero or one disables the worker pool.
+ */
+bool framebuffer_set_read_threads(unsigned threads);
+
+/**
+ * Select the kernel used to copy out of the framebuffer, one of "memcpy",
+ * "sse4_1", "avx2", "avx512" or "auto" for the widest streaming kernel the CPU
+ * supports. Fails if the name is unknown or the CPU does not support the
+ * kernel. memcpy is used if this is never called.
+ */
+bool framebuffer_set_read_kernel(const char * name);
+
+/**
+ * Copy from the framebuffer data using the selected read kernel.
+ * For custom read routines only.
+ */
+extern void (*framebuffer_copy)(void * restrict dst,
+    const void * restrict src, size_t size);
+
 /**
  * Read `size` bytes from the KVMFRFrame into the dst buffer
  */
@@ -88,6 +131,22 @@ void framebuffer_prepare(FrameBuffer * frame);
 extern bool (*framebuffer_write)(FrameBuffer * frame,
     const void * restrict src, size_t size);
 
+/**
+ * Select the kernel used by framebuffer_write, one of "sse4_1", "avx2" or
+ * "auto" for the widest the CPU supports. Fails if the name is unknown or the
+ * CPU does not support the kernel. "auto" is used if this is never called.
+ */
+bool framebuffer_set_write_kernel(const char * name);
+
+/**
+ * Write only the damaged areas of the src buffer into the KVMFRFrame, the
+ * rest of the frame must already hold the previous contents. A `count` of
+ * zero writes the whole frame.
+ */
+bool framebuffer_write_rects(FrameBuffer * frame,
+    const FrameDamageRect * rects, int count, int bpp,
+    const void * restrict src, size_t pitch, size_t height);
+
 /**
  * Gets the underlying data buffer of the framebuffer.
  * For custom read routines only.
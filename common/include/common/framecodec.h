@@ -0,0 +1,95 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef _H_LG_COMMON_FRAMECODEC_
+#define _H_LG_COMMON_FRAMECODEC_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/framebuffer.h"
+
+/*
+ * A fast lossless codec for frames sent with FRAME_FLAG_COMPRESSED.
+ *
+ * Rows are coded as 32-bit words, each row a sequence of operations that
+ * either repeat the words of the row above, repeat a single word, or carry
+ * literal words. The rows are grouped into blocks of roughly
+ * FRAMECODEC_BLOCK_SIZE bytes that are published as they are written, so the
+ * consumer can decode a block while the producer is still coding the next:
+ *
+ *   block     : uint32_t size, uint32_t rows, uint8_t ops[size], 0-3 pad bytes
+ *   op        : uint8_t type, LEB128 count, payload
+ *   UP        : no payload, copy count words from the row above
+ *   RUN       : uint32_t value, repeated count times
+ *   LITERAL   : uint32_t words[count]
+ *
+ * A block with zero rows ends the stream, which may be before the last row if
+ * the frame did not fit in the available space.
+ */
+
+#define FRAMECODEC_BLOCK_SIZE 65536 // 64KB
+
+typedef enum FrameCodecResult
+{
+  FRAMECODEC_RESULT_OK     ,
+  FRAMECODEC_RESULT_TIMEOUT, // the producer stalled before the frame was sent
+  FRAMECODEC_RESULT_ERROR
+}
+FrameCodecResult;
+
+/* the encoder state, kept across frames so nothing is allocated per frame */
+typedef struct FrameCodec FrameCodec;
+
+bool frameCodec_create(FrameCodec ** codec);
+void frameCodec_free(FrameCodec ** codec);
+
+/* true if rows of `pitch` bytes can be coded */
+bool frameCodec_supported(size_t pitch);
+
+/**
+ * Code `height` rows of `pitch` bytes from `src` into the framebuffer, using at
+ * most `maxSize` bytes. `coded` is set to the number of rows sent, which is
+ * less than `height` if the frame was cut short to fit.
+ */
+bool frameCodec_encode(FrameCodec * codec, FrameBuffer * frame,
+    size_t maxSize, const void * src, size_t pitch, size_t height,
+    size_t * coded);
+
+/**
+ * Decode the frame one row at a time as the blocks arrive, calling `fn` with
+ * the first `linewidth` bytes of each row. `maxSize` bounds how much of the
+ * framebuffer may be read. Rows past the end of a stream that was cut short are
+ * passed as zeros, so the destination never keeps an older frame's rows.
+ */
+FrameCodecResult frameCodec_decodeFn(const FrameBuffer * frame,
+    size_t maxSize, size_t height, size_t linewidth, size_t pitch,
+    FrameBufferReadFn fn, void * opaque, uint64_t * waitTimeNs);
+
+/**
+ * Decode the frame into `dst`, accumulating the nanoseconds spent waiting for
+ * the producer in `waitTimeNs`.
+ */
+FrameCodecResult frameCodec_decode(const FrameBuffer * frame,
+    size_t maxSize, void * dst, size_t dstpitch, size_t height, size_t pitch,
+    uint64_t * waitTimeNs);
+
+#endif
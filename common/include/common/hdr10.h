@@ -0,0 +1,63 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+#ifndef _H_LG_COMMON_HDR10_
+#define _H_LG_COMMON_HDR10_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/types.h"
+#include "common/framebuffer.h"
+
+/*
+ * Conversion of scRGB RGBA16F pixels, linear BT.709 with 1.0 at 80 nits, into
+ * PQ encoded BT.2020 RGB10A2 with red in the low bits, the same as the D12
+ * HDR16to10 effect. This halves the size of a HDR frame.
+ */
+
+/* convert `width` pixels from `src` to `dst` */
+extern void (*hdr10_convertRow)(uint32_t * restrict dst,
+    const uint16_t * restrict src, unsigned width);
+
+/**
+ * Select the kernel used by hdr10_convertRow, one of "scalar", "f16c" or
+ * "auto" for the fastest the CPU supports. Fails if the name is unknown or the
+ * CPU does not support the kernel. "auto" is used if this is never called.
+ */
+bool hdr10_setKernel(const char * name);
+
+/* true if the CPU has the F16C and AVX2 extensions the fast kernel needs */
+bool hdr10_accelerated(void);
+
+/**
+ * Convert `height` rows of `width` pixels, `srcPitch` bytes apart, into the
+ * framebuffer at `dstPitch` bytes per row, publishing the write pointer as the
+ * rows are written. With a non-zero `count` only the pixels covered by the
+ * damage `rects` are converted, the rest of the frame must already hold the
+ * previous contents.
+ */
+void hdr10_convert(FrameBuffer * frame, const FrameDamageRect * rects,
+    int count, const void * restrict src, size_t srcPitch, unsigned width,
+    unsigned height, size_t dstPitch);
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef _H_LG_COMMON_RGB24_
+#define _H_LG_COMMON_RGB24_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/types.h"
+#include "common/framebuffer.h"
+
+/*
+ * Packing of 32-bit BGRA/RGBA pixels into the 24-bit FRAME_TYPE_BGR_32
+ * layout, three bytes per pixel in B, G, R order with the alpha dropped. The
+ * packed rows are carried in 32-bit texels, see rgb24_texels.
+ */
+
+/* the number of 32-bit texels a row of `width` packed pixels occupies */
+static inline unsigned rgb24_texels(unsigned width)
+{
+  return (width * 3 + 3) / 4;
+}
+
+/**
+ * Pack `width` pixels from `src` to `dst`, swapping the red and blue channels
+ * if `swap` is set so RGBA sources produce the same byte order as BGRA.
+ */
+extern void (*rgb24_packRow)(uint8_t * restrict dst,
+    const uint8_t * restrict src, unsigned width, bool swap);
+
+/**
+ * Select the kernel used by rgb24_packRow, one of "scalar", "ssse3", "avx2"
+ * or "auto" for the widest the CPU supports. Fails if the name is unknown or
+ * the CPU does not support the kernel. "auto" is used if this is never called.
+ */
+bool rgb24_setKernel(const char * name);
+
+/**
+ * Pack `height` rows of `width` pixels, `srcPitch` bytes apart, into the
+ * framebuffer at `dstPitch` bytes per row, publishing the write pointer as the
+ * rows are written. With a non-zero `count` only the pixels covered by the
+ * damage `rects` are packed, the rest of the frame must already hold the
+ * previous contents.
+ */
+void rgb24_pack(FrameBuffer * frame, const FrameDamageRect * rects, int count,
+    const void * restrict src, size_t srcPitch, unsigned width,
+    unsigned height, size_t dstPitch, bool swap);
+
+#endif
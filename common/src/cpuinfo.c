@@ -72,6 +72,7 @@ const CPUInfoFeatures * cpuInfo_getFeatures(void)
   features.xsave   = cpuid[2] & (1 << 26);
   features.osxsave = cpuid[2] & (1 << 27);
   features.avx     = cpuid[2] & (1 << 28);
+  features.f16c    = cpuid[2] & (1 << 29);
 
   // leaf7
   asm volatile
@@ -84,9 +85,10 @@ const CPUInfoFeatures * cpuInfo_getFeatures(void)
     : "a" (7), "c" (0)
   );
 
-  features.avx2 = cpuid[1] & (1 << 5);
-  features.bmi1 = cpuid[2] & (1 << 3);
-  features.bmi2 = cpuid[2] & (1 << 8);
+  features.avx2    = cpuid[1] & (1 <<  5);
+  features.avx512f = cpuid[1] & (1 << 16);
+  features.bmi1    = cpuid[2] & (1 <<  3);
+  features.bmi2    = cpuid[2] & (1 <<  8);
 
   if (features.osxsave && features.avx)
   {
@@ -101,10 +103,18 @@ const CPUInfoFeatures * cpuInfo_getFeatures(void)
 
     if (!(xgetbv & 0x6))
     {
-      features.avx  = false;
-      features.avx2 = false;
+      features.avx     = false;
+      features.avx2    = false;
+      features.f16c    = false;
+      features.avx512f = false;
     }
+
+    // the OS must also preserve the opmask and upper ZMM state
+    if ((xgetbv & 0xe0) != 0xe0)
+      features.avx512f = false;
   }
+  else
+    features.avx512f = false;
 
   return &features;
 };
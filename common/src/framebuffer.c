@@ -22,6 +22,11 @@
 #include "common/cpuinfo.h"
 #include "common/debug.h"
 #include "common/time.h"
+#include "common/util.h"
+#include "common/array.h"
+#include "common/thread.h"
+#include "common/event.h"
+#include "common/rects.h"
 
 //#define FB_PROFILE
 #ifdef FB_PROFILE
@@ -34,33 +39,144 @@
 #include <immintrin.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+/* adaptive busy-spin budget, shared by all readers */
+static _Atomic(uint32_t) fbSpinBudget = FB_SPIN_MIN_NS;
+
+/* wait phase accounting for framebuffer_take_wait_stats, waits happen on the
+ * frame thread, the renderer and the read workers so these are shared */
+static struct
+{
+  _Atomic(uint64_t) spinNs;
+  _Atomic(uint64_t) blockNs;
+}
+fbWaitStats;
+
+/**
+ * Sleep until the write pointer moves away from `wp` or `ns` elapses.
+ *
+ * The producer is usually on the other side of a VM boundary and can never
+ * wake us, so this must always be bounded. When both ends share a kernel (ie,
+ * the test transport or a local producer) the futex lets the producer's chunk
+ * publication end the sleep early. The waiter count tells the producer that
+ * someone is asleep, so it only pays for the wake syscall when it matters.
+ */
+static void framebuffer_block(const FrameBuffer * frame, uint32_t wp,
+    uint64_t ns)
+{
+#if defined(__linux__)
+  const struct timespec ts =
+  {
+    .tv_sec  = ns / 1000000000,
+    .tv_nsec = ns % 1000000000,
+  };
+
+  FB_WP_TYPE * waiters = (FB_WP_TYPE *)&frame->waiters;
+  atomic_fetch_add(waiters, 1);
+  const long ret = syscall(SYS_futex, (uint32_t *)&frame->wp, FUTEX_WAIT, wp,
+      &ts, NULL, 0);
+  atomic_fetch_sub(waiters, 1);
+
+  if (ret == 0 || errno == EAGAIN || errno == ETIMEDOUT || errno == EINTR)
+    return;
+
+  // futexes are not supported on device memory, fall back to sleeping
+#endif
+  nsleep(ns);
+}
+
+static inline void framebuffer_publish(FrameBuffer * frame, size_t wp)
+{
+#if defined(__linux__)
+  /* sequentially consistent so the waiter check can not be ordered before the
+   * store, a reader that registers after it will see the new wp in the futex
+   * and not sleep */
+  atomic_store(&frame->wp, wp);
+  if (atomic_load(&frame->waiters))
+    syscall(SYS_futex, (uint32_t *)&frame->wp, FUTEX_WAKE, INT32_MAX,
+        NULL, NULL, 0);
+#else
+  atomic_store_explicit(&frame->wp, wp, memory_order_release);
+#endif
+}
+
 bool framebuffer_wait_timed(const FrameBuffer * frame, size_t size,
     uint64_t * waitTimeNs)
 {
   if (atomic_load_explicit(&frame->wp, memory_order_acquire) >= size)
     return true;
 
-  const uint64_t waitStart = waitTimeNs ? nanotime() : 0;
+  const uint64_t waitStart = nanotime();
+  const uint32_t budget    =
+    atomic_load_explicit(&fbSpinBudget, memory_order_relaxed);
 
-  while(atomic_load_explicit(&frame->wp, memory_order_acquire) < size)
+  /* phase 1, busy-spin for the adaptive budget, most chunks land in here */
+  uint64_t now = waitStart;
+  for(unsigned spin = 1;; ++spin)
   {
-    int spinCount = 0;
-    while(frame->wp < size)
+    _mm_pause();
+    if (atomic_load_explicit(&frame->wp, memory_order_acquire) >= size)
     {
-      if (++spinCount == FB_SPIN_LIMIT)
-      {
-        if (waitTimeNs)
-          *waitTimeNs += nanotime() - waitStart;
-        return false;
-      }
-      usleep(1);
+      now = nanotime();
+      const uint64_t spent  = now - waitStart;
+      const uint64_t target = min(spent * 2, FB_SPIN_MAX_NS);
+      atomic_store_explicit(&fbSpinBudget,
+          (uint32_t)max((budget * 7 + target) / 8, FB_SPIN_MIN_NS),
+          memory_order_relaxed);
+
+      atomic_fetch_add_explicit(&fbWaitStats.spinNs, spent,
+          memory_order_relaxed);
+      if (waitTimeNs)
+        *waitTimeNs += spent;
+      return true;
     }
+
+    // only sample the clock periodically, it is far slower than a pause
+    if ((spin & 0x3f) == 0 && (now = nanotime()) - waitStart >= budget)
+      break;
   }
 
+  /* the spin did not pay off, shorten it for the next wait */
+  atomic_store_explicit(&fbSpinBudget,
+      (uint32_t)max(budget * 3 / 4, FB_SPIN_MIN_NS), memory_order_relaxed);
+
+  /* phase 2, block in short bounded slices until the data arrives */
+  const uint64_t blockStart = now;
+  bool ready;
+  for(;;)
+  {
+    const uint32_t wp = atomic_load_explicit(&frame->wp, memory_order_acquire);
+    if ((ready = wp >= size))
+      break;
+
+    if ((now = nanotime()) - waitStart >= FB_WAIT_TIMEOUT_NS)
+      break;
+
+    framebuffer_block(frame, wp, FB_BLOCK_SLICE_NS);
+  }
+
+  now = nanotime();
+  atomic_fetch_add_explicit(&fbWaitStats.spinNs, blockStart - waitStart,
+      memory_order_relaxed);
+  atomic_fetch_add_explicit(&fbWaitStats.blockNs, now - blockStart,
+      memory_order_relaxed);
   if (waitTimeNs)
-    *waitTimeNs += nanotime() - waitStart;
+    *waitTimeNs += now - waitStart;
 
-  return true;
+  return ready;
+}
+
+void framebuffer_take_wait_stats(FrameBufferWaitStats * stats)
+{
+  stats->spinNs  = atomic_exchange_explicit(&fbWaitStats.spinNs , 0,
+      memory_order_relaxed);
+  stats->blockNs = atomic_exchange_explicit(&fbWaitStats.blockNs, 0,
+      memory_order_relaxed);
 }
 
 bool framebuffer_wait(const FrameBuffer * frame, size_t size)
@@ -68,20 +184,278 @@ bool framebuffer_wait(const FrameBuffer * frame, size_t size)
   return framebuffer_wait_timed(frame, size, NULL);
 }
 
-static bool framebuffer_read_linear_timed(const FrameBuffer * frame,
-    void * restrict dst, size_t size, uint64_t * waitTimeNs)
+/**
+ * Read kernels for copying out of the framebuffer. The shared memory may be
+ * mapped write-combining in which case ordinary loads are uncached and very
+ * slow, the streaming loads fetch a whole line at a time into the fill
+ * buffers instead. On write-back memory they behave as ordinary loads and
+ * memcpy is usually faster, so memcpy remains the default.
+ *
+ * The streaming loads require an aligned source, so the head is copied with
+ * memcpy up to the first aligned address, as is any tail.
+ */
+static void framebuffer_copy_memcpy(void * restrict dst,
+    const void * restrict src, size_t size)
 {
-#ifdef FB_PROFILE
-  static RunningAvg ra = NULL;
-  static int raCount = 0;
-  const uint64_t ts = microtime();
-  if (!ra)
-    ra = runningavg_new(100);
+  memcpy(dst, src, size);
+}
+
+static void framebuffer_copy_sse4_1(void * restrict dst,
+    const void * restrict src, size_t size)
+{
+  uint8_t       * restrict d = dst;
+  const uint8_t * restrict s = src;
+
+  const size_t head = min(-(uintptr_t)s & 15, size);
+  if (head)
+  {
+    memcpy(d, s, head);
+    d    += head;
+    s    += head;
+    size -= head;
+  }
+
+  // streaming loads are weakly ordered against the write pointer load
+  _mm_lfence();
+
+  if (((uintptr_t)d & 15) == 0)
+  {
+    // bypass the cache on the way out too, as memcpy does for large copies
+    for(; size > 63; size -= 64, s += 64, d += 64)
+    {
+      __m128i v1 = _mm_stream_load_si128((__m128i *)s + 0);
+      __m128i v2 = _mm_stream_load_si128((__m128i *)s + 1);
+      __m128i v3 = _mm_stream_load_si128((__m128i *)s + 2);
+      __m128i v4 = _mm_stream_load_si128((__m128i *)s + 3);
+
+      _mm_stream_si128((__m128i *)d + 0, v1);
+      _mm_stream_si128((__m128i *)d + 1, v2);
+      _mm_stream_si128((__m128i *)d + 2, v3);
+      _mm_stream_si128((__m128i *)d + 3, v4);
+    }
+    _mm_sfence();
+  }
+  else
+  {
+    for(; size > 63; size -= 64, s += 64, d += 64)
+    {
+      __m128i v1 = _mm_stream_load_si128((__m128i *)s + 0);
+      __m128i v2 = _mm_stream_load_si128((__m128i *)s + 1);
+      __m128i v3 = _mm_stream_load_si128((__m128i *)s + 2);
+      __m128i v4 = _mm_stream_load_si128((__m128i *)s + 3);
+
+      _mm_storeu_si128((__m128i *)d + 0, v1);
+      _mm_storeu_si128((__m128i *)d + 1, v2);
+      _mm_storeu_si128((__m128i *)d + 2, v3);
+      _mm_storeu_si128((__m128i *)d + 3, v4);
+    }
+  }
+
+  if (size)
+    memcpy(d, s, size);
+}
+
+#ifdef __clang__
+  #pragma clang attribute push (__attribute__((target("avx2"))), apply_to=function)
+#else
+  #pragma GCC push_options
+  #pragma GCC target ("avx2")
 #endif
+static void framebuffer_copy_avx2(void * restrict dst,
+    const void * restrict src, size_t size)
+{
+  uint8_t       * restrict d = dst;
+  const uint8_t * restrict s = src;
 
-  uint8_t * restrict d     = (uint8_t*)dst;
-  uint_least32_t rp        = 0;
+  const size_t head = min(-(uintptr_t)s & 31, size);
+  if (head)
+  {
+    memcpy(d, s, head);
+    d    += head;
+    s    += head;
+    size -= head;
+  }
+
+  _mm_lfence();
+
+  if (((uintptr_t)d & 31) == 0)
+  {
+    // bypass the cache on the way out too, as memcpy does for large copies
+    for(; size > 127; size -= 128, s += 128, d += 128)
+    {
+      __m256i v1 = _mm256_stream_load_si256((__m256i *)s + 0);
+      __m256i v2 = _mm256_stream_load_si256((__m256i *)s + 1);
+      __m256i v3 = _mm256_stream_load_si256((__m256i *)s + 2);
+      __m256i v4 = _mm256_stream_load_si256((__m256i *)s + 3);
+
+      _mm256_stream_si256((__m256i *)d + 0, v1);
+      _mm256_stream_si256((__m256i *)d + 1, v2);
+      _mm256_stream_si256((__m256i *)d + 2, v3);
+      _mm256_stream_si256((__m256i *)d + 3, v4);
+    }
+    _mm_sfence();
+  }
+  else
+  {
+    for(; size > 127; size -= 128, s += 128, d += 128)
+    {
+      __m256i v1 = _mm256_stream_load_si256((__m256i *)s + 0);
+      __m256i v2 = _mm256_stream_load_si256((__m256i *)s + 1);
+      __m256i v3 = _mm256_stream_load_si256((__m256i *)s + 2);
+      __m256i v4 = _mm256_stream_load_si256((__m256i *)s + 3);
+
+      _mm256_storeu_si256((__m256i *)d + 0, v1);
+      _mm256_storeu_si256((__m256i *)d + 1, v2);
+      _mm256_storeu_si256((__m256i *)d + 2, v3);
+      _mm256_storeu_si256((__m256i *)d + 3, v4);
+    }
+  }
+
+  if (size)
+    memcpy(d, s, size);
+}
+#ifdef __clang__
+  #pragma clang attribute pop
+#else
+  #pragma GCC pop_options
+#endif
+
+#ifdef __clang__
+  #pragma clang attribute push (__attribute__((target("avx512f"))), apply_to=function)
+#else
+  #pragma GCC push_options
+  #pragma GCC target ("avx512f")
+#endif
+static void framebuffer_copy_avx512(void * restrict dst,
+    const void * restrict src, size_t size)
+{
+  uint8_t       * restrict d = dst;
+  const uint8_t * restrict s = src;
+
+  const size_t head = min(-(uintptr_t)s & 63, size);
+  if (head)
+  {
+    memcpy(d, s, head);
+    d    += head;
+    s    += head;
+    size -= head;
+  }
+
+  _mm_lfence();
+
+  if (((uintptr_t)d & 63) == 0)
+  {
+    // bypass the cache on the way out too, as memcpy does for large copies
+    for(; size > 255; size -= 256, s += 256, d += 256)
+    {
+      __m512i v1 = _mm512_stream_load_si512((__m512i *)s + 0);
+      __m512i v2 = _mm512_stream_load_si512((__m512i *)s + 1);
+      __m512i v3 = _mm512_stream_load_si512((__m512i *)s + 2);
+      __m512i v4 = _mm512_stream_load_si512((__m512i *)s + 3);
+
+      _mm512_stream_si512((__m512i *)d + 0, v1);
+      _mm512_stream_si512((__m512i *)d + 1, v2);
+      _mm512_stream_si512((__m512i *)d + 2, v3);
+      _mm512_stream_si512((__m512i *)d + 3, v4);
+    }
+    _mm_sfence();
+  }
+  else
+  {
+    for(; size > 255; size -= 256, s += 256, d += 256)
+    {
+      __m512i v1 = _mm512_stream_load_si512((__m512i *)s + 0);
+      __m512i v2 = _mm512_stream_load_si512((__m512i *)s + 1);
+      __m512i v3 = _mm512_stream_load_si512((__m512i *)s + 2);
+      __m512i v4 = _mm512_stream_load_si512((__m512i *)s + 3);
+
+      _mm512_storeu_si512((__m512i *)d + 0, v1);
+      _mm512_storeu_si512((__m512i *)d + 1, v2);
+      _mm512_storeu_si512((__m512i *)d + 2, v3);
+      _mm512_storeu_si512((__m512i *)d + 3, v4);
+    }
+  }
+
+  if (size)
+    memcpy(d, s, size);
+}
+#ifdef __clang__
+  #pragma clang attribute pop
+#else
+  #pragma GCC pop_options
+#endif
+
+static const struct
+{
+  const char * name;
+  void (*fn)(void * restrict dst, const void * restrict src, size_t size);
+}
+fbReadKernels[] =
+{
+  { "memcpy", framebuffer_copy_memcpy },
+  { "sse4_1", framebuffer_copy_sse4_1 },
+  { "avx2"  , framebuffer_copy_avx2   },
+  { "avx512", framebuffer_copy_avx512 }
+};
 
+static bool framebuffer_kernel_supported(unsigned index)
+{
+  const CPUInfoFeatures * features = cpuInfo_getFeatures();
+  switch(index)
+  {
+    case 0: return true;
+    case 1: return features->sse4_1;
+    case 2: return features->avx2;
+    case 3: return features->avx512f;
+  }
+  return false;
+}
+
+/* true if reads should be staged through the kernel, see framebuffer_read_fn */
+static bool fbCopyStaged = false;
+
+bool framebuffer_set_read_kernel(const char * name)
+{
+  unsigned index;
+  if (strcmp(name, "auto") == 0)
+  {
+    for(index = ARRAY_LENGTH(fbReadKernels) - 1; index > 0; --index)
+      if (framebuffer_kernel_supported(index))
+        break;
+  }
+  else
+  {
+    for(index = 0; index < ARRAY_LENGTH(fbReadKernels); ++index)
+      if (strcmp(name, fbReadKernels[index].name) == 0)
+        break;
+
+    if (index == ARRAY_LENGTH(fbReadKernels))
+    {
+      DEBUG_ERROR("Unknown framebuffer read kernel: %s", name);
+      return false;
+    }
+
+    if (!framebuffer_kernel_supported(index))
+    {
+      DEBUG_ERROR("The CPU does not support the %s read kernel", name);
+      return false;
+    }
+  }
+
+  DEBUG_INFO("Using the %s framebuffer read kernel", fbReadKernels[index].name);
+  fbCopyStaged     = index > 0;
+  framebuffer_copy = fbReadKernels[index].fn;
+  return true;
+}
+
+/* libc's memcpy wins on write-back memory, which is the common case */
+void (*framebuffer_copy)(void * restrict dst, const void * restrict src,
+    size_t size) = &framebuffer_copy_memcpy;
+
+/* copy `size` bytes starting at `rp`, both must start on a chunk boundary */
+static bool framebuffer_read_range(const FrameBuffer * frame,
+    uint8_t * restrict d, size_t rp, size_t size, uint64_t * waitTimeNs)
+{
   // copy in large 1MB chunks if the pitches match
   while(size)
   {
@@ -89,19 +463,270 @@ static bool framebuffer_read_linear_timed(const FrameBuffer * frame,
     if (!framebuffer_wait_timed(frame, rp + copy, waitTimeNs))
       return false;
 
-    memcpy(d, frame->data + rp, copy);
+    framebuffer_copy(d, frame->data + rp, copy);
     size -= copy;
     rp   += copy;
     d    += copy;
   }
 
+  return true;
+}
+
+/* copy the rows [y, yend) to match the pitch of the destination buffer */
+static bool framebuffer_read_rows(const FrameBuffer * frame,
+    uint8_t * restrict d, size_t dstpitch, size_t y, size_t yend,
+    size_t linewidth, size_t pitch, uint64_t * waitTimeNs)
+{
+  size_t rp = y * pitch;
+  d += y * dstpitch;
+
+  for(; y < yend; ++y)
+  {
+    if (!framebuffer_wait_timed(frame, rp + linewidth, waitTimeNs))
+      return false;
+
+    framebuffer_copy(d, frame->data + rp, dstpitch);
+    rp += pitch;
+    d  += dstpitch;
+  }
+
+  return true;
+}
+
+typedef struct FBReadJob
+{
+  const FrameBuffer * frame;
+  uint8_t           * dst;
+  bool                linear;
+  size_t              start, end;
+  size_t              dstpitch, linewidth, pitch;
+  uint64_t            waitTimeNs;
+  bool                result;
+}
+FBReadJob;
+
+typedef struct FBReadWorker
+{
+  LGThread * thread;
+  LGEvent  * start;
+  LGEvent  * done;
+  FBReadJob  job;
+}
+FBReadWorker;
+
+static struct
+{
+  atomic_flag    busy;
+  _Atomic(bool)  running;
+  unsigned       count;
+  FBReadWorker * workers;
+}
+fbPool = { .busy = ATOMIC_FLAG_INIT };
+
+static void framebuffer_run_job(FBReadJob * job)
+{
+  job->waitTimeNs = 0;
+  if (job->linear)
+    job->result = framebuffer_read_range(job->frame, job->dst + job->start,
+        job->start, job->end - job->start, &job->waitTimeNs);
+  else
+    job->result = framebuffer_read_rows(job->frame, job->dst, job->dstpitch,
+        job->start, job->end, job->linewidth, job->pitch, &job->waitTimeNs);
+}
+
+static int framebuffer_worker(void * opaque)
+{
+  FBReadWorker * worker = opaque;
+  for(;;)
+  {
+    lgWaitEvent(worker->start, TIMEOUT_INFINITE);
+    if (!atomic_load(&fbPool.running))
+      break;
+
+    framebuffer_run_job(&worker->job);
+    lgSignalEvent(worker->done);
+  }
+
+  return 0;
+}
+
+static void framebuffer_free_workers(void)
+{
+  atomic_store(&fbPool.running, false);
+  for(unsigned i = 0; i < fbPool.count; ++i)
+  {
+    FBReadWorker * worker = fbPool.workers + i;
+    if (worker->thread)
+    {
+      lgSignalEvent(worker->start);
+      lgJoinThread(worker->thread, NULL);
+    }
+
+    if (worker->start)
+      lgFreeEvent(worker->start);
+    if (worker->done)
+      lgFreeEvent(worker->done);
+  }
+
+  free(fbPool.workers);
+  fbPool.workers = NULL;
+  fbPool.count   = 0;
+}
+
+bool framebuffer_set_read_threads(unsigned threads)
+{
+  while(atomic_flag_test_and_set_explicit(&fbPool.busy, memory_order_acquire))
+    _mm_pause();
+
+  framebuffer_free_workers();
+
+  // the calling thread always takes one of the bands
+  if (threads > FB_MAX_READ_THREADS)
+    threads = FB_MAX_READ_THREADS;
+
+  if (threads < 2)
+  {
+    atomic_flag_clear_explicit(&fbPool.busy, memory_order_release);
+    return true;
+  }
+
+  fbPool.workers = calloc(threads - 1, sizeof(*fbPool.workers));
+  if (!fbPool.workers)
+  {
+    DEBUG_ERROR("out of memory");
+    goto fail;
+  }
+
+  atomic_store(&fbPool.running, true);
+  for(fbPool.count = 0; fbPool.count < threads - 1; ++fbPool.count)
+  {
+    FBReadWorker * worker = fbPool.workers + fbPool.count;
+    if (!(worker->start = lgCreateEvent(true, 0)) ||
+        !(worker->done  = lgCreateEvent(true, 0)))
+    {
+      DEBUG_ERROR("Failed to create the framebuffer worker events");
+      ++fbPool.count;
+      goto fail;
+    }
+
+    if (!lgCreateThread("FBReadWorker", framebuffer_worker, worker,
+          &worker->thread))
+    {
+      DEBUG_ERROR("Failed to create the framebuffer worker thread");
+      ++fbPool.count;
+      goto fail;
+    }
+  }
+
+  DEBUG_INFO("Using %u threads to read large frames", threads);
+  atomic_flag_clear_explicit(&fbPool.busy, memory_order_release);
+  return true;
+
+fail:
+  framebuffer_free_workers();
+  atomic_flag_clear_explicit(&fbPool.busy, memory_order_release);
+  return false;
+}
+
+/**
+ * Split the copy into bands across the worker pool. Each band waits on the
+ * write pointer for its own range, and this returns only after every band has
+ * completed. Returns false without copying anything if the pool is not
+ * available, in which case the caller must do the copy itself.
+ */
+static bool framebuffer_read_parallel(const FrameBuffer * frame,
+    uint8_t * dst, bool linear, size_t total, size_t dstpitch,
+    size_t linewidth, size_t pitch, uint64_t * waitTimeNs, bool * result)
+{
+  if (!fbPool.count ||
+      (linear ? total : total * pitch) < FB_PARALLEL_MIN_SIZE ||
+      atomic_flag_test_and_set_explicit(&fbPool.busy, memory_order_acquire))
+    return false;
+
+  if (!fbPool.count)
+  {
+    atomic_flag_clear_explicit(&fbPool.busy, memory_order_release);
+    return false;
+  }
+
+  /* linear bands are whole chunks so each band waits on chunk boundaries */
+  const unsigned bands = fbPool.count + 1;
+  const size_t   unit  = linear ? FB_CHUNK_SIZE : 1;
+  const size_t   units = (total + unit - 1) / unit;
+  const size_t   per   = (units + bands - 1) / bands;
+
+  FBReadJob local;
+  size_t    start = 0;
+  unsigned  used  = 0;
+  for(unsigned i = 0; i < bands && start < total; ++i)
+  {
+    const size_t end = min(start + per * unit, total);
+    FBReadJob * job  = i == 0 ? &local : &fbPool.workers[i - 1].job;
+    *job = (FBReadJob)
+    {
+      .frame     = frame,
+      .dst       = dst,
+      .linear    = linear,
+      .start     = start,
+      .end       = end,
+      .dstpitch  = dstpitch,
+      .linewidth = linewidth,
+      .pitch     = pitch
+    };
+
+    if (i > 0)
+      lgSignalEvent(fbPool.workers[i - 1].start);
+
+    start = end;
+    ++used;
+  }
+
+  framebuffer_run_job(&local);
+
+  /* the bands run concurrently so the longest wait is what the caller saw */
+  bool     ok      = local.result;
+  uint64_t maxWait = local.waitTimeNs;
+  for(unsigned i = 1; i < used; ++i)
+  {
+    FBReadWorker * worker = fbPool.workers + i - 1;
+    lgWaitEvent(worker->done, TIMEOUT_INFINITE);
+    ok     &= worker->job.result;
+    maxWait = max(maxWait, worker->job.waitTimeNs);
+  }
+
+  atomic_flag_clear_explicit(&fbPool.busy, memory_order_release);
+
+  /* each band's waits were already added to fbWaitStats as they happened */
+  if (waitTimeNs)
+    *waitTimeNs += maxWait;
+
+  *result = ok;
+  return true;
+}
+
+static bool framebuffer_read_linear_timed(const FrameBuffer * frame,
+    void * restrict dst, size_t size, uint64_t * waitTimeNs)
+{
+#ifdef FB_PROFILE
+  static RunningAvg ra = NULL;
+  static int raCount = 0;
+  const uint64_t ts = microtime();
+  if (!ra)
+    ra = runningavg_new(100);
+#endif
+
+  bool result;
+  if (!framebuffer_read_parallel(frame, dst, true, size, 0, 0, 0,
+        waitTimeNs, &result))
+    result = framebuffer_read_range(frame, dst, 0, size, waitTimeNs);
+
 #ifdef FB_PROFILE
   runningavg_push(ra, microtime() - ts);
   if (++raCount % 100 == 0)
     DEBUG_INFO("Average Copy Time: %.2fμs", runningavg_calc(ra));
 #endif
 
-  return true;
+  return result;
 }
 
 bool framebuffer_read_linear(const FrameBuffer * frame, void * restrict dst,
@@ -126,20 +751,12 @@ bool framebuffer_read_timed(const FrameBuffer * frame, void * restrict dst,
     ra = runningavg_new(100);
 #endif
 
-  uint8_t * restrict d     = (uint8_t*)dst;
-  uint_least32_t rp        = 0;
-
-  // copy per line to match the pitch of the destination buffer
   const size_t linewidth = width * bpp;
-  for(size_t y = 0; y < height; ++y)
-  {
-    if (!framebuffer_wait_timed(frame, rp + linewidth, waitTimeNs))
-      return false;
-
-    memcpy(d, frame->data + rp, dstpitch);
-    rp += pitch;
-    d  += dstpitch;
-  }
+  bool result;
+  if (!framebuffer_read_parallel(frame, dst, false, height, dstpitch,
+        linewidth, pitch, waitTimeNs, &result))
+    result = framebuffer_read_rows(frame, dst, dstpitch, 0, height,
+        linewidth, pitch, waitTimeNs);
 
 #ifdef FB_PROFILE
   runningavg_push(ra, microtime() - ts);
@@ -147,7 +764,7 @@ bool framebuffer_read_timed(const FrameBuffer * frame, void * restrict dst,
     DEBUG_INFO("Average Copy Time: %.2fμs", runningavg_calc(ra));
 #endif
 
-  return true;
+  return result;
 }
 
 bool framebuffer_read(const FrameBuffer * frame, void * restrict dst,
@@ -172,6 +789,32 @@ bool framebuffer_read_fn(const FrameBuffer * frame, size_t height, size_t width,
   size_t         y         = 0;
   const size_t   linewidth = width * bpp;
 
+  /* the callback consumes the rows as a packed stream, so when a streaming
+   * kernel is selected batch rows through a cached staging buffer rather than
+   * have the callback read the shared memory with ordinary loads */
+  const size_t batch = fbCopyStaged ? FB_READ_FN_STAGING / linewidth : 0;
+  if (batch > 0)
+  {
+    _Alignas(64) uint8_t staging[FB_READ_FN_STAGING];
+    while(y < height)
+    {
+      const size_t rows = min(batch, height - y);
+      uint8_t * d = staging;
+      for(size_t i = 0; i < rows; ++i, rp += pitch, d += linewidth)
+      {
+        if (!framebuffer_wait(frame, rp + linewidth))
+          return false;
+
+        framebuffer_copy(d, frame->data + rp, linewidth);
+      }
+
+      if (!fn(opaque, staging, rows * linewidth))
+        return false;
+
+      y += rows;
+    }
+  }
+
   while(y < height)
   {
     if (!framebuffer_wait(frame, rp + linewidth))
@@ -239,7 +882,7 @@ static bool framebuffer_write_sse4_1(FrameBuffer * frame,
     wp   += 64;
 
     if (wp % FB_CHUNK_SIZE == 0)
-      atomic_store_explicit(&frame->wp, wp, memory_order_release);
+      framebuffer_publish(frame, wp);
   }
 
   if(size)
@@ -248,7 +891,7 @@ static bool framebuffer_write_sse4_1(FrameBuffer * frame,
     wp += size;
   }
 
-  atomic_store_explicit(&frame->wp, wp, memory_order_release);
+  framebuffer_publish(frame, wp);
 
 #ifdef FB_PROFILE
   runningavg_push(ra, microtime() - ts);
@@ -301,7 +944,7 @@ bool framebuffer_write_avx2(FrameBuffer * frame,
     wp   += 128;
 
     if (wp % FB_CHUNK_SIZE == 0)
-      atomic_store_explicit(&frame->wp, wp, memory_order_release);
+      framebuffer_publish(frame, wp);
   }
 
   if (size > 63)
@@ -318,7 +961,7 @@ bool framebuffer_write_avx2(FrameBuffer * frame,
     wp   += 64;
 
     if (wp % FB_CHUNK_SIZE == 0)
-      atomic_store_explicit(&frame->wp, wp, memory_order_release);
+      framebuffer_publish(frame, wp);
   }
 
   if (size)
@@ -327,7 +970,7 @@ bool framebuffer_write_avx2(FrameBuffer * frame,
     wp += size;
   }
 
-  atomic_store_explicit(&frame->wp, wp, memory_order_release);
+  framebuffer_publish(frame, wp);
 
 #ifdef FB_PROFILE
   runningavg_push(ra, microtime() - ts);
@@ -357,6 +1000,48 @@ static bool _framebuffer_write(FrameBuffer * frame,
 bool (*framebuffer_write)(FrameBuffer * frame,
   const void * restrict src, size_t size) = &_framebuffer_write;
 
+bool framebuffer_set_write_kernel(const char * name)
+{
+  const CPUInfoFeatures * features = cpuInfo_getFeatures();
+  bool avx2;
+
+  if (strcmp(name, "auto") == 0)
+    avx2 = features->avx2;
+  else if (strcmp(name, "sse4_1") == 0)
+    avx2 = false;
+  else if (strcmp(name, "avx2") == 0)
+  {
+    if (!features->avx2)
+    {
+      DEBUG_ERROR("The CPU does not support the %s write kernel", name);
+      return false;
+    }
+    avx2 = true;
+  }
+  else
+  {
+    DEBUG_ERROR("Unknown framebuffer write kernel: %s", name);
+    return false;
+  }
+
+  framebuffer_write = avx2 ?
+    &framebuffer_write_avx2 : &framebuffer_write_sse4_1;
+  return true;
+}
+
+bool framebuffer_write_rects(FrameBuffer * frame,
+    const FrameDamageRect * rects, int count, int bpp,
+    const void * restrict src, size_t pitch, size_t height)
+{
+  if (count <= 0)
+    return framebuffer_write(frame, src, pitch * height);
+
+  // the rects are only read, rectsBufferCopy just lacks the const qualifier
+  rectsBufferToFramebuffer((FrameDamageRect *)rects, count, bpp, frame,
+      pitch, height, src, pitch);
+  return true;
+}
+
 const uint8_t * framebuffer_get_buffer(const FrameBuffer * frame)
 {
   return frame->data;
@@ -369,5 +1054,5 @@ uint8_t * framebuffer_get_data(FrameBuffer * frame)
 
 void framebuffer_set_write_ptr(FrameBuffer * frame, size_t size)
 {
-  atomic_store_explicit(&frame->wp, size, memory_order_release);
+  framebuffer_publish(frame, size);
 }
@@ -0,0 +1,446 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "common/framecodec.h"
+#include "common/debug.h"
+#include "common/util.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <emmintrin.h>
+
+enum
+{
+  FRAMECODEC_OP_UP,
+  FRAMECODEC_OP_RUN,
+  FRAMECODEC_OP_LITERAL
+};
+
+/* shorter matches cost more to code than the literal words */
+#define FRAMECODEC_MIN_MATCH 4 // the literal scan in encodeRow assumes 4
+
+typedef struct FrameCodecBlock
+{
+  uint32_t size;
+  uint32_t rows;
+}
+FrameCodecBlock;
+
+struct FrameCodec
+{
+  // a single coded row, grown to fit the widest row seen
+  uint8_t * scratch;
+  size_t    scratchSize;
+};
+
+bool frameCodec_create(FrameCodec ** codec)
+{
+  *codec = calloc(1, sizeof(**codec));
+  if (!*codec)
+  {
+    DEBUG_ERROR("out of memory");
+    return false;
+  }
+  return true;
+}
+
+void frameCodec_free(FrameCodec ** codec)
+{
+  if (!*codec)
+    return;
+
+  free((*codec)->scratch);
+  free(*codec);
+  *codec = NULL;
+}
+
+bool frameCodec_supported(size_t pitch)
+{
+  return pitch > 0 && (pitch & 3) == 0;
+}
+
+/* the number of leading words that are equal in `a` and `b` */
+static inline size_t matchLen(const uint32_t * a, const uint32_t * b, size_t n)
+{
+  size_t i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    const __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    const __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+    const int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, vb)));
+    if (mask != 0xf)
+      return i + __builtin_ctz(~mask);
+  }
+
+  while(i < n && a[i] == b[i])
+    ++i;
+  return i;
+}
+
+/* the number of leading words that are equal to the first */
+static inline size_t runLen(const uint32_t * a, size_t n)
+{
+  const __m128i v = _mm_set1_epi32(a[0]);
+  size_t i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    const __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    const int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, v)));
+    if (mask != 0xf)
+      return i + __builtin_ctz(~mask);
+  }
+
+  while(i < n && a[i] == a[0])
+    ++i;
+  return i;
+}
+
+static inline uint8_t * putOp(uint8_t * p, uint8_t type, size_t count)
+{
+  *p++ = type;
+  do
+  {
+    *p++ = (count & 0x7f) | (count > 0x7f ? 0x80 : 0);
+    count >>= 7;
+  }
+  while(count);
+  return p;
+}
+
+/* the worst case is a literal op for every word, plus the op headers */
+static inline size_t rowBound(size_t words)
+{
+  return words * 8 + 8;
+}
+
+static size_t encodeRow(uint8_t * out, const uint32_t * row,
+    const uint32_t * prev, size_t words)
+{
+  uint8_t * p = out;
+  for(size_t i = 0; i < words;)
+  {
+    const size_t left = words - i;
+    if (prev)
+    {
+      const size_t up = matchLen(row + i, prev + i, left);
+      if (up >= FRAMECODEC_MIN_MATCH)
+      {
+        p  = putOp(p, FRAMECODEC_OP_UP, up);
+        i += up;
+        continue;
+      }
+    }
+
+    const size_t run = runLen(row + i, left);
+    if (run >= FRAMECODEC_MIN_MATCH)
+    {
+      p = putOp(p, FRAMECODEC_OP_RUN, run);
+      memcpy(p, row + i, sizeof(uint32_t));
+      p += sizeof(uint32_t);
+      i += run;
+      continue;
+    }
+
+    // extend the literal up to the next position worth matching, the first
+    // word test rejects most positions in busy content
+    size_t end = i + run;
+    for(; end + FRAMECODEC_MIN_MATCH <= words; ++end)
+    {
+      const uint32_t * r = row + end;
+      if (prev && r[0] == prev[end] && r[1] == prev[end + 1] &&
+          r[2] == prev[end + 2] && r[3] == prev[end + 3])
+        break;
+
+      if (r[0] == r[1] && r[1] == r[2] && r[2] == r[3])
+        break;
+    }
+
+    if (end + FRAMECODEC_MIN_MATCH > words)
+      end = words;
+
+    p = putOp(p, FRAMECODEC_OP_LITERAL, end - i);
+    memcpy(p, row + i, (end - i) * sizeof(uint32_t));
+    p += (end - i) * sizeof(uint32_t);
+    i  = end;
+  }
+
+  return p - out;
+}
+
+bool frameCodec_encode(FrameCodec * codec, FrameBuffer * frame,
+    size_t maxSize, const void * src, size_t pitch, size_t height,
+    size_t * coded)
+{
+  DEBUG_ASSERT(frameCodec_supported(pitch));
+
+  *coded = 0;
+
+  const size_t words = pitch / sizeof(uint32_t);
+  if (codec->scratchSize < rowBound(words))
+  {
+    uint8_t * scratch = realloc(codec->scratch, rowBound(words));
+    if (!scratch)
+    {
+      DEBUG_ERROR("out of memory");
+      return false;
+    }
+    codec->scratch     = scratch;
+    codec->scratchSize = rowBound(words);
+  }
+
+  uint8_t * scratch = codec->scratch;
+
+  uint8_t        * data    = framebuffer_get_data(frame);
+  const uint32_t * prev    = NULL;
+  size_t           block   = 0; // offset of the open block's header
+  size_t           wp      = sizeof(FrameCodecBlock);
+  uint32_t         rows    = 0;
+  size_t           y       = 0;
+
+  for(; y < height; ++y)
+  {
+    const uint32_t * row  = (const uint32_t *)((const uint8_t *)src + y * pitch);
+    const size_t     size = encodeRow(scratch, row, prev, words);
+
+    // leave room to close this block and terminate the stream
+    if (wp + size + 3 + 2 * sizeof(FrameCodecBlock) > maxSize)
+      break;
+
+    memcpy(data + wp, scratch, size);
+    wp  += size;
+    prev = row;
+    ++rows;
+
+    if (wp - block - sizeof(FrameCodecBlock) >= FRAMECODEC_BLOCK_SIZE)
+    {
+      const FrameCodecBlock hdr =
+        { .size = wp - block - sizeof(hdr), .rows = rows };
+      memcpy(data + block, &hdr, sizeof(hdr));
+
+      wp = (wp + 3) & ~(size_t)3;
+      framebuffer_set_write_ptr(frame, wp);
+
+      block = wp;
+      wp   += sizeof(FrameCodecBlock);
+      rows  = 0;
+    }
+  }
+
+  if (rows)
+  {
+    const FrameCodecBlock hdr =
+      { .size = wp - block - sizeof(hdr), .rows = rows };
+    memcpy(data + block, &hdr, sizeof(hdr));
+
+    block = (wp + 3) & ~(size_t)3;
+  }
+
+  const FrameCodecBlock end = { 0 };
+  memcpy(data + block, &end, sizeof(end));
+  framebuffer_set_write_ptr(frame, block + sizeof(end));
+  *coded = y;
+  return true;
+}
+
+static inline bool getCount(const uint8_t ** p, const uint8_t * end,
+    size_t * count)
+{
+  *count = 0;
+  for(unsigned shift = 0; shift < 32; shift += 7)
+  {
+    if (*p == end)
+      return false;
+
+    const uint8_t b = *(*p)++;
+    *count |= (size_t)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static bool decodeRow(uint32_t * out, const uint32_t * prev, size_t words,
+    const uint8_t ** data, const uint8_t * end)
+{
+  const uint8_t * p = *data;
+  for(size_t x = 0; x < words;)
+  {
+    if (p == end)
+      return false;
+
+    const uint8_t type = *p++;
+    size_t count;
+    if (!getCount(&p, end, &count) || count == 0 || count > words - x)
+      return false;
+
+    switch(type)
+    {
+      case FRAMECODEC_OP_UP:
+        memcpy(out + x, prev + x, count * sizeof(uint32_t));
+        break;
+
+      case FRAMECODEC_OP_RUN:
+      {
+        if ((size_t)(end - p) < sizeof(uint32_t))
+          return false;
+
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+
+        const __m128i v = _mm_set1_epi32(value);
+        size_t i = 0;
+        for(; i + 4 <= count; i += 4)
+          _mm_storeu_si128((__m128i *)(out + x + i), v);
+        for(; i < count; ++i)
+          out[x + i] = value;
+        break;
+      }
+
+      case FRAMECODEC_OP_LITERAL:
+        if ((size_t)(end - p) / sizeof(uint32_t) < count)
+          return false;
+
+        memcpy(out + x, p, count * sizeof(uint32_t));
+        p += count * sizeof(uint32_t);
+        break;
+
+      default:
+        return false;
+    }
+
+    x += count;
+  }
+
+  *data = p;
+  return true;
+}
+
+FrameCodecResult frameCodec_decodeFn(const FrameBuffer * frame,
+    size_t maxSize, size_t height, size_t linewidth, size_t pitch,
+    FrameBufferReadFn fn, void * opaque, uint64_t * waitTimeNs)
+{
+  if (!frameCodec_supported(pitch) || linewidth > pitch)
+  {
+    DEBUG_ERROR("Invalid compressed frame layout");
+    return FRAMECODEC_RESULT_ERROR;
+  }
+
+  const size_t words = pitch / sizeof(uint32_t);
+
+  // decode through cached rows, the destination may be slow to read back
+  uint32_t * rows = calloc(2 * words, sizeof(uint32_t));
+  if (!rows)
+  {
+    DEBUG_ERROR("out of memory");
+    return FRAMECODEC_RESULT_ERROR;
+  }
+
+  const uint8_t  * data   = framebuffer_get_buffer(frame);
+  uint32_t       * prev   = rows;
+  uint32_t       * cur    = rows + words;
+  size_t           rp     = 0;
+  size_t           y      = 0;
+  FrameCodecResult result = FRAMECODEC_RESULT_ERROR;
+
+  while(y < height)
+  {
+    FrameCodecBlock hdr;
+    if (maxSize - rp < sizeof(hdr))
+      goto out;
+
+    if (!framebuffer_wait_timed(frame, rp + sizeof(hdr), waitTimeNs))
+    {
+      result = FRAMECODEC_RESULT_TIMEOUT;
+      goto out;
+    }
+
+    memcpy(&hdr, data + rp, sizeof(hdr));
+    rp += sizeof(hdr);
+
+    // the producer ran out of space, the remaining rows were not sent
+    if (hdr.rows == 0)
+    {
+      memset(cur, 0, linewidth);
+      for(; y < height; ++y)
+        if (!fn(opaque, cur, linewidth))
+          goto out;
+      break;
+    }
+
+    if (hdr.size > maxSize - rp || hdr.rows > height - y)
+      goto out;
+
+    if (!framebuffer_wait_timed(frame, rp + hdr.size, waitTimeNs))
+    {
+      result = FRAMECODEC_RESULT_TIMEOUT;
+      goto out;
+    }
+
+    const uint8_t * p   = data + rp;
+    const uint8_t * end = p + hdr.size;
+    for(uint32_t i = 0; i < hdr.rows; ++i, ++y)
+    {
+      if (!decodeRow(cur, prev, words, &p, end))
+      {
+        DEBUG_ERROR("Corrupt compressed frame at row %zu", y);
+        goto out;
+      }
+
+      if (!fn(opaque, cur, linewidth))
+        goto out;
+
+      uint32_t * tmp = prev;
+      prev = cur;
+      cur  = tmp;
+    }
+
+    rp = (rp + hdr.size + 3) & ~(size_t)3;
+  }
+
+  result = FRAMECODEC_RESULT_OK;
+
+out:
+  free(rows);
+  return result;
+}
+
+struct DecodeToBuffer
+{
+  uint8_t * dst;
+  size_t    dstpitch;
+};
+
+static bool decodeToBuffer(void * opaque, const void * src, size_t size)
+{
+  struct DecodeToBuffer * data = opaque;
+  memcpy(data->dst, src, size);
+  data->dst += data->dstpitch;
+  return true;
+}
+
+FrameCodecResult frameCodec_decode(const FrameBuffer * frame,
+    size_t maxSize, void * dst, size_t dstpitch, size_t height, size_t pitch,
+    uint64_t * waitTimeNs)
+{
+  struct DecodeToBuffer data = { .dst = dst, .dstpitch = dstpitch };
+  return frameCodec_decodeFn(frame, maxSize, height, min(dstpitch, pitch),
+      pitch, decodeToBuffer, &data, waitTimeNs);
+}
@@ -0,0 +1,335 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+#include "common/hdr10.h"
+#include "common/cpuinfo.h"
+#include "common/debug.h"
+#include "common/util.h"
+#include "common/array.h"
+
+#include <math.h>
+#include <string.h>
+#include <immintrin.h>
+
+// the halves from 0.0 to 1.0 inclusive, the indices into pqTable
+#define PQ_TABLE_SIZE 0x3c01
+
+/* the 10-bit PQ code for each half, padded so the 32-bit gathers of the last
+ * entry stay inside the table */
+static uint16_t pqTable[PQ_TABLE_SIZE + 1];
+static bool     pqTableReady = false;
+
+/* BT.709 to BT.2020, scaled from 80 nit scRGB units to the 10000 nit PQ range,
+ * see the D12 HDR16to10 effect */
+#define M(x) ((x) * (80.0f / 10000.0f))
+static const float toBT2020[3][3] =
+{
+  { M(0.6274039f), M(0.3292830f), M(0.0433131f) },
+  { M(0.0690973f), M(0.9195404f), M(0.0113623f) },
+  { M(0.0163914f), M(0.0880133f), M(0.8955953f) }
+};
+#undef M
+
+static float hdr10_halfToFloat(uint16_t h)
+{
+  const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  const uint32_t exp  = (h >> 10) & 0x1f;
+  const uint32_t mant = h & 0x3ff;
+
+  // infinities and NaNs are treated as black
+  if (exp == 0x1f)
+    return 0.0f;
+
+  if (exp == 0)
+  {
+    const float v = mant * (1.0f / 16777216.0f);
+    return sign ? -v : v;
+  }
+
+  const uint32_t bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+  float v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+/* the nearest half to `v`, clamped to 0.0 - 1.0, as F16C rounds it */
+static unsigned hdr10_tableIndex(float v)
+{
+  if (!(v > 0.0f))
+    return 0;
+
+  if (v >= 1.0f)
+    return PQ_TABLE_SIZE - 1;
+
+  // below the smallest normal half the steps are 2^-24
+  if (v < 6.103515625e-05f)
+    return lrintf(v * 16777216.0f);
+
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+
+  unsigned h = (bits >> 13) - ((127 - 15) << 10);
+  const uint32_t rem = bits & 0x1fff;
+  if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+    ++h;
+  return h;
+}
+
+static void hdr10_buildTable(void)
+{
+  if (pqTableReady)
+    return;
+
+  const double m1 = 0.1593017578125;
+  const double m2 = 78.84375;
+  const double c1 = 0.8359375;
+  const double c2 = 18.8515625;
+  const double c3 = 18.6875;
+
+  for(unsigned i = 0; i < PQ_TABLE_SIZE; ++i)
+  {
+    const double p  = pow(hdr10_halfToFloat(i), m1);
+    const double pq = pow((c1 + c2 * p) / (1.0 + c3 * p), m2);
+    pqTable[i] = lrint(min(max(pq, 0.0), 1.0) * 1023.0);
+  }
+  pqTable[PQ_TABLE_SIZE] = 0;
+  pqTableReady = true;
+}
+
+static uint32_t hdr10_alpha(float a)
+{
+  if (!(a > 0.0f))
+    return 0;
+  if (a >= 1.0f)
+    return 3;
+  return lrintf(a * 3.0f);
+}
+
+static void hdr10_convertRow_scalar(uint32_t * restrict dst,
+    const uint16_t * restrict src, unsigned width)
+{
+  for(; width; --width, src += 4, ++dst)
+  {
+    const float r = hdr10_halfToFloat(src[0]);
+    const float g = hdr10_halfToFloat(src[1]);
+    const float b = hdr10_halfToFloat(src[2]);
+
+    uint32_t out = hdr10_alpha(hdr10_halfToFloat(src[3])) << 30;
+    for(int c = 0; c < 3; ++c)
+    {
+      const float * m = toBT2020[c];
+      const float   v = r * m[0] + g * m[1] + b * m[2];
+      out |= (uint32_t)pqTable[hdr10_tableIndex(v)] << (c * 10);
+    }
+    *dst = out;
+  }
+}
+
+#ifdef __clang__
+  #pragma clang attribute push (__attribute__((target("avx2,f16c"))), apply_to=function)
+#else
+  #pragma GCC push_options
+  #pragma GCC target ("avx2,f16c")
+#endif
+static void hdr10_convertRow_f16c(uint32_t * restrict dst,
+    const uint16_t * restrict src, unsigned width)
+{
+  const __m128i expMask = _mm_set1_epi16(0x7c00);
+  const __m256  zero    = _mm256_setzero_ps();
+  const __m256  one     = _mm256_set1_ps(1.0f);
+  const __m256  three   = _mm256_set1_ps(3.0f);
+  const __m256i codeMask = _mm256_set1_epi32(0x3ff);
+
+  // the transpose leaves the pixels in the order 0 2 4 6 1 3 5 7
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+  __m256 m[3][3];
+  for(int c = 0; c < 3; ++c)
+    for(int i = 0; i < 3; ++i)
+      m[c][i] = _mm256_set1_ps(toBT2020[c][i]);
+
+  // 8 pixels per pass, each register holds two RGBA pixels
+  for(; width > 7; width -= 8, src += 32, dst += 8)
+  {
+    __m256 v[4];
+    for(int i = 0; i < 4; ++i)
+    {
+      // infinities and NaNs are treated as black
+      __m128i h = _mm_loadu_si128((const __m128i *)src + i);
+      h = _mm_andnot_si128(
+          _mm_cmpeq_epi16(_mm_and_si128(h, expMask), expMask), h);
+      v[i] = _mm256_cvtph_ps(h);
+    }
+
+    const __m256 t0 = _mm256_unpacklo_ps(v[0], v[1]);
+    const __m256 t1 = _mm256_unpackhi_ps(v[0], v[1]);
+    const __m256 t2 = _mm256_unpacklo_ps(v[2], v[3]);
+    const __m256 t3 = _mm256_unpackhi_ps(v[2], v[3]);
+    const __m256 r  = _mm256_shuffle_ps(t0, t2, 0x44);
+    const __m256 g  = _mm256_shuffle_ps(t0, t2, 0xee);
+    const __m256 b  = _mm256_shuffle_ps(t1, t3, 0x44);
+    const __m256 a  = _mm256_shuffle_ps(t1, t3, 0xee);
+
+    __m256i out = _mm256_slli_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(
+            _mm256_min_ps(_mm256_max_ps(a, zero), one), three)), 30);
+
+    for(int c = 0; c < 3; ++c)
+    {
+      __m256 x = _mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(r, m[c][0]),
+            _mm256_mul_ps(g, m[c][1])),
+            _mm256_mul_ps(b, m[c][2]));
+      x = _mm256_min_ps(_mm256_max_ps(x, zero), one);
+
+      // the half is the index of the PQ code
+      const __m256i index = _mm256_cvtepu16_epi32(
+          _mm256_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT));
+      const __m256i code = _mm256_and_si256(codeMask,
+          _mm256_i32gather_epi32((const int *)pqTable, index, 2));
+      out = _mm256_or_si256(out, _mm256_slli_epi32(code, c * 10));
+    }
+
+    _mm256_storeu_si256((__m256i *)dst,
+        _mm256_permutevar8x32_epi32(out, order));
+  }
+
+  hdr10_convertRow_scalar(dst, src, width);
+}
+#ifdef __clang__
+  #pragma clang attribute pop
+#else
+  #pragma GCC pop_options
+#endif
+
+static const struct
+{
+  const char * name;
+  void (*fn)(uint32_t * restrict dst, const uint16_t * restrict src,
+      unsigned width);
+}
+hdr10Kernels[] =
+{
+  { "scalar", hdr10_convertRow_scalar },
+  { "f16c"  , hdr10_convertRow_f16c   }
+};
+
+bool hdr10_accelerated(void)
+{
+  const CPUInfoFeatures * features = cpuInfo_getFeatures();
+  return features->f16c && features->avx2;
+}
+
+static bool hdr10_kernelSupported(unsigned index)
+{
+  switch(index)
+  {
+    case 0: return true;
+    case 1: return hdr10_accelerated();
+  }
+  return false;
+}
+
+static unsigned hdr10_bestKernel(void)
+{
+  unsigned index;
+  for(index = ARRAY_LENGTH(hdr10Kernels) - 1; index > 0; --index)
+    if (hdr10_kernelSupported(index))
+      break;
+  return index;
+}
+
+bool hdr10_setKernel(const char * name)
+{
+  unsigned index;
+  if (strcmp(name, "auto") == 0)
+    index = hdr10_bestKernel();
+  else
+  {
+    for(index = 0; index < ARRAY_LENGTH(hdr10Kernels); ++index)
+      if (strcmp(name, hdr10Kernels[index].name) == 0)
+        break;
+
+    if (index == ARRAY_LENGTH(hdr10Kernels))
+    {
+      DEBUG_ERROR("Unknown HDR10 conversion kernel: %s", name);
+      return false;
+    }
+
+    if (!hdr10_kernelSupported(index))
+    {
+      DEBUG_ERROR("The CPU does not support the %s conversion kernel", name);
+      return false;
+    }
+  }
+
+  hdr10_buildTable();
+  hdr10_convertRow = hdr10Kernels[index].fn;
+  return true;
+}
+
+static void _hdr10_convertRow(uint32_t * restrict dst,
+    const uint16_t * restrict src, unsigned width)
+{
+  hdr10_buildTable();
+  hdr10_convertRow = hdr10Kernels[hdr10_bestKernel()].fn;
+  hdr10_convertRow(dst, src, width);
+}
+
+void (*hdr10_convertRow)(uint32_t * restrict dst,
+    const uint16_t * restrict src, unsigned width) = &_hdr10_convertRow;
+
+void hdr10_convert(FrameBuffer * frame, const FrameDamageRect * rects,
+    int count, const void * restrict src, size_t srcPitch, unsigned width,
+    unsigned height, size_t dstPitch)
+{
+  uint8_t       * dst       = framebuffer_get_data(frame);
+  const uint8_t * s         = src;
+  size_t          published = 0;
+
+  for(unsigned y = 0; y < height; ++y)
+  {
+    uint32_t       * d  = (uint32_t *)(dst + y * dstPitch);
+    const uint16_t * sp = (const uint16_t *)(s + y * srcPitch);
+
+    if (count <= 0)
+      hdr10_convertRow(d, sp, width);
+    else
+      for(int i = 0; i < count; ++i)
+      {
+        const FrameDamageRect * r = rects + i;
+        if (y < r->y || y - r->y >= r->height || r->x >= width)
+          continue;
+
+        const unsigned w = min(r->width, width - r->x);
+        hdr10_convertRow(d + r->x, sp + r->x * 4, w);
+      }
+
+    // let the consumer start on the rows written so far
+    const size_t wp = (y + 1) * dstPitch;
+    if (wp - published >= FB_CHUNK_SIZE)
+    {
+      framebuffer_set_write_ptr(frame, wp);
+      published = wp;
+    }
+  }
+
+  framebuffer_set_write_ptr(frame, height * dstPitch);
+}
@@ -0,0 +1,236 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "common/rgb24.h"
+#include "common/cpuinfo.h"
+#include "common/debug.h"
+#include "common/util.h"
+#include "common/array.h"
+
+#include <string.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+
+static void rgb24_packRow_scalar(uint8_t * restrict dst,
+    const uint8_t * restrict src, unsigned width, bool swap)
+{
+  const int r = swap ? 0 : 2;
+  const int b = swap ? 2 : 0;
+  for(; width; --width, src += 4, dst += 3)
+  {
+    dst[0] = src[b];
+    dst[1] = src[1];
+    dst[2] = src[r];
+  }
+}
+
+#ifdef __clang__
+  #pragma clang attribute push (__attribute__((target("ssse3"))), apply_to=function)
+#else
+  #pragma GCC push_options
+  #pragma GCC target ("ssse3")
+#endif
+static void rgb24_packRow_ssse3(uint8_t * restrict dst,
+    const uint8_t * restrict src, unsigned width, bool swap)
+{
+  // pack four pixels into the low 12 bytes of each register
+  const __m128i mask = swap ?
+    _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1) :
+    _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+  // 16 pixels in, three full registers out
+  for(; width > 15; width -= 16, src += 64, dst += 48)
+  {
+    __m128i a = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *)src + 0), mask);
+    __m128i b = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *)src + 1), mask);
+    __m128i c = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *)src + 2), mask);
+    __m128i d = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *)src + 3), mask);
+
+    _mm_storeu_si128((__m128i *)dst + 0,
+        _mm_or_si128(a, _mm_slli_si128(b, 12)));
+    _mm_storeu_si128((__m128i *)dst + 1,
+        _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+    _mm_storeu_si128((__m128i *)dst + 2,
+        _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+  }
+
+  rgb24_packRow_scalar(dst, src, width, swap);
+}
+#ifdef __clang__
+  #pragma clang attribute pop
+#else
+  #pragma GCC pop_options
+#endif
+
+#ifdef __clang__
+  #pragma clang attribute push (__attribute__((target("avx2"))), apply_to=function)
+#else
+  #pragma GCC push_options
+  #pragma GCC target ("avx2")
+#endif
+static void rgb24_packRow_avx2(uint8_t * restrict dst,
+    const uint8_t * restrict src, unsigned width, bool swap)
+{
+  // the shuffle is per lane, leaving 12 bytes at the bottom of each
+  const __m256i mask = swap ?
+    _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1) :
+    _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+  // close the gap between the lanes, the packed 24 bytes end up contiguous
+  const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+  // 16 pixels in, 48 bytes out, no stores past the end of the row
+  for(; width > 15; width -= 16, src += 64, dst += 48)
+  {
+    __m256i a = _mm256_loadu_si256((__m256i *)src + 0);
+    __m256i b = _mm256_loadu_si256((__m256i *)src + 1);
+    a = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(a, mask), join);
+    b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(b, mask), join);
+
+    // a[0:24] b[0:24] as 32 + 16 bytes
+    const __m128i bLo = _mm256_castsi256_si128(b);
+    _mm256_storeu_si256((__m256i *)dst,
+        _mm256_blend_epi32(a, _mm256_permute4x64_epi64(
+            _mm256_castsi128_si256(bLo), 0x00), 0xc0));
+    _mm_storeu_si128((__m128i *)(dst + 32),
+        _mm_alignr_epi8(_mm256_extracti128_si256(b, 1), bLo, 8));
+  }
+
+  rgb24_packRow_scalar(dst, src, width, swap);
+}
+#ifdef __clang__
+  #pragma clang attribute pop
+#else
+  #pragma GCC pop_options
+#endif
+
+static const struct
+{
+  const char * name;
+  void (*fn)(uint8_t * restrict dst, const uint8_t * restrict src,
+      unsigned width, bool swap);
+}
+rgb24Kernels[] =
+{
+  { "scalar", rgb24_packRow_scalar },
+  { "ssse3" , rgb24_packRow_ssse3  },
+  { "avx2"  , rgb24_packRow_avx2   }
+};
+
+static bool rgb24_kernelSupported(unsigned index)
+{
+  const CPUInfoFeatures * features = cpuInfo_getFeatures();
+  switch(index)
+  {
+    case 0: return true;
+    case 1: return features->ssse3;
+    case 2: return features->avx2;
+  }
+  return false;
+}
+
+static unsigned rgb24_bestKernel(void)
+{
+  unsigned index;
+  for(index = ARRAY_LENGTH(rgb24Kernels) - 1; index > 0; --index)
+    if (rgb24_kernelSupported(index))
+      break;
+  return index;
+}
+
+bool rgb24_setKernel(const char * name)
+{
+  unsigned index;
+  if (strcmp(name, "auto") == 0)
+    index = rgb24_bestKernel();
+  else
+  {
+    for(index = 0; index < ARRAY_LENGTH(rgb24Kernels); ++index)
+      if (strcmp(name, rgb24Kernels[index].name) == 0)
+        break;
+
+    if (index == ARRAY_LENGTH(rgb24Kernels))
+    {
+      DEBUG_ERROR("Unknown RGB24 pack kernel: %s", name);
+      return false;
+    }
+
+    if (!rgb24_kernelSupported(index))
+    {
+      DEBUG_ERROR("The CPU does not support the %s pack kernel", name);
+      return false;
+    }
+  }
+
+  rgb24_packRow = rgb24Kernels[index].fn;
+  return true;
+}
+
+static void _rgb24_packRow(uint8_t * restrict dst,
+    const uint8_t * restrict src, unsigned width, bool swap)
+{
+  rgb24_packRow = rgb24Kernels[rgb24_bestKernel()].fn;
+  rgb24_packRow(dst, src, width, swap);
+}
+
+void (*rgb24_packRow)(uint8_t * restrict dst, const uint8_t * restrict src,
+    unsigned width, bool swap) = &_rgb24_packRow;
+
+void rgb24_pack(FrameBuffer * frame, const FrameDamageRect * rects, int count,
+    const void * restrict src, size_t srcPitch, unsigned width,
+    unsigned height, size_t dstPitch, bool swap)
+{
+  uint8_t       * dst       = framebuffer_get_data(frame);
+  const uint8_t * s         = src;
+  size_t          published = 0;
+
+  for(unsigned y = 0; y < height; ++y)
+  {
+    uint8_t       * d  = dst + y * dstPitch;
+    const uint8_t * sp = s   + y * srcPitch;
+
+    if (count <= 0)
+      rgb24_packRow(d, sp, width, swap);
+    else
+      for(int i = 0; i < count; ++i)
+      {
+        const FrameDamageRect * r = rects + i;
+        if (y < r->y || y - r->y >= r->height || r->x >= width)
+          continue;
+
+        const unsigned w = min(r->width, width - r->x);
+        rgb24_packRow(d + r->x * 3, sp + r->x * 4, w, swap);
+      }
+
+    // let the consumer start on the rows written so far
+    const size_t wp = (y + 1) * dstPitch;
+    if (wp - published >= FB_CHUNK_SIZE)
+    {
+      framebuffer_set_write_ptr(frame, wp);
+      published = wp;
+    }
+  }
+
+  framebuffer_set_write_ptr(frame, height * dstPitch);
+}
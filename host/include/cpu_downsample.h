@@ -0,0 +1,69 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef _H_LG_HOST_CPU_DOWNSAMPLE_
+#define _H_LG_HOST_CPU_DOWNSAMPLE_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "common/types.h"
+#include "common/vector.h"
+#include "interface/capture.h"
+
+/*
+ * Applies the `downsample` rules on the CPU for backends that have no GPU to
+ * do it, see downsample_parser.h. Integer ratios are reduced with a box
+ * filter, anything else is sampled bilinearly like the D12 effect. The rows are
+ * split into bands that are reduced in parallel.
+ */
+
+#define CPU_DOWNSAMPLE_MAX_THREADS 4
+
+typedef struct CPUDownsample CPUDownsample;
+
+bool cpuDownsample_create(CPUDownsample ** ds);
+void cpuDownsample_free(CPUDownsample ** ds);
+
+/**
+ * Find the rule for a `width` x `height` source of `format`. Returns false if
+ * the frame should be sent as is, otherwise the size to reduce it to.
+ */
+bool cpuDownsample_match(Vector * rules, CaptureFormat format,
+    unsigned width, unsigned height, unsigned * dstWidth, unsigned * dstHeight);
+
+/* scale damage rects from the source size to the reduced size */
+void cpuDownsample_adjustDamage(FrameDamageRect * rects, uint32_t count,
+    unsigned srcWidth, unsigned srcHeight,
+    unsigned dstWidth, unsigned dstHeight);
+
+/**
+ * Reduce `src` into a buffer of `dstWidth` x `dstHeight` pixels, rows
+ * `dstWidth * 4` bytes apart, that is returned. Only the pixels covered by the
+ * reduced damage `rects` are updated unless `count` is zero or the sizes have
+ * changed since the last call. The buffer is valid until the next call.
+ */
+const uint8_t * cpuDownsample_run(CPUDownsample * ds,
+    const void * src, size_t srcPitch, unsigned srcWidth, unsigned srcHeight,
+    unsigned dstWidth, unsigned dstHeight,
+    const FrameDamageRect * rects, int count);
+
+#endif
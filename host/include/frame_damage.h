@@ -0,0 +1,105 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef _H_LG_HOST_FRAME_DAMAGE_
+#define _H_LG_HOST_FRAME_DAMAGE_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "common/KVMFR.h"
+#include "common/LGMPConfig.h"
+#include "common/framebuffer.h"
+#include "common/framecodec.h"
+#include "interface/capture.h"
+
+/**
+ * Tracks, for each frame buffer slot, the damage accumulated since that slot
+ * was last written. Each slot keeps the frame it last held, so only the areas
+ * that changed since then need to be copied to bring it up to date.
+ */
+typedef struct FrameDamage
+{
+  // rects per slot, -1 if the whole slot must be rewritten
+  int             count[LGMP_Q_FRAME_LEN];
+  FrameDamageRect rects[LGMP_Q_FRAME_LEN][KVMFR_MAX_DAMAGE_RECTS];
+
+  // the layout the slots were written with
+  unsigned      pitch, height;
+  CaptureFormat format;
+
+  // set by frameDamage_invalidate, the next write resets the slots
+  atomic_bool invalid;
+
+  /* the cost of plain and 24-bit packed writes, used to decide if packing
+   * pays for itself, kept across resets */
+  bool              packDecided, packWins;
+  _Atomic(uint64_t) copyNs, copyBytes, copyWrites;
+  _Atomic(uint64_t) packNs, packBytes, packWrites;
+
+  // created with the first compressed frame, kept across resets
+  FrameCodec * codec;
+
+  /* the pitch and height of the last source that was too big to code, those
+   * are sent raw and truncated instead, see frameDamage_setupFrame */
+  _Atomic(uint64_t) codecOverflow;
+}
+FrameDamage;
+
+/* forget all slot contents, call when the capture restarts */
+void frameDamage_reset(FrameDamage * damage);
+
+/**
+ * Forget all slot contents at the next frameDamage_write. Unlike
+ * frameDamage_reset this is safe to call while another thread may be writing a
+ * frame.
+ */
+void frameDamage_invalidate(FrameDamage * damage);
+
+/* release the resources held by `damage`, call before it is freed */
+void frameDamage_free(FrameDamage * damage);
+
+/**
+ * Fill in the data layout of `frame` for a `width` x `height` source of
+ * `format` with rows `pitch` bytes apart, given `maxFrameSize` bytes to write
+ * it into. If `allowRGB24` is set 8-bit sources are packed to
+ * CAPTURE_FMT_BGR_32 unless packing has proven slower than a plain copy, and
+ * `frame->compressed` is cleared if the rows can not be coded, or a frame of
+ * this size has already failed to fit once coded.
+ */
+void frameDamage_setupFrame(FrameDamage * damage, CaptureFrame * frame,
+    size_t maxFrameSize, CaptureFormat format, unsigned width,
+    unsigned height, unsigned pitch, bool allowRGB24);
+
+/**
+ * Write the frame described by `capture` from `src`, a `srcFormat` image with
+ * rows `srcPitch` bytes apart, into the slot `index`, copying only the damage
+ * the slot has missed, then fold the frame's damage into the other slots. A
+ * frame without damage rects rewrites the whole slot, and a compressed frame is
+ * coded into at most `maxSize` bytes. A coded frame that does not fit is cut
+ * short, and later frames of its size are set up to be sent raw. A
+ * CAPTURE_FMT_RGBA16F source is converted if the frame was set up as
+ * CAPTURE_FMT_RGBA10, see hdr10.h.
+ */
+bool frameDamage_write(FrameDamage * damage, unsigned index,
+    FrameBuffer * frame, size_t maxSize, const CaptureFrame * capture,
+    const void * src, CaptureFormat srcFormat, size_t srcPitch);
+
+#endif
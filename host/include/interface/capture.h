@@ -86,6 +86,7 @@ typedef struct CaptureFrame
   bool            hdrPQ;        // true if the frame format is PQ transformed
   bool            hdrMetadata;  // true if the HDR static metadata is valid
   CaptureRotation rotation;     // output rotation of the frame
+  bool            compressed;   // in: compression wanted, out: getFrame will code the frame
 
   uint16_t        hdrDisplayPrimary[3][2];
   uint16_t        hdrWhitePoint[2];
@@ -131,6 +132,12 @@ typedef struct CaptureInterface
   const char * shortName;
   const bool   asyncCapture;
   const bool   deprecated;
+  const bool   manual;      // only used when selected with app:capture
+  const bool   canCompress; // getFrame honours CaptureFrame::compressed
+
+  /* getFrame may run on the copy thread while the next frame is captured into
+   * another frameBufferIndex, each index must have its own source buffer */
+  const bool   pipelined;
 
   const char * (*getName        )(void);
   void         (*initOptions    )(void);
@@ -0,0 +1,649 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "interface/capture.h"
+#include "frame_damage.h"
+#include "common/util.h"
+#include "common/array.h"
+#include "common/option.h"
+#include "common/debug.h"
+#include "common/thread.h"
+#include "common/time.h"
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+
+/*
+ * Produces generated frames without a display so clients can be load tested
+ * without a VM, select it with `app:capture=synthetic`.
+ *
+ * The image is rendered once, PERIOD rows taller than the screen. Each frame
+ * starts `scrollStep` rows further down it, which scrolls the content of the
+ * window while the desktop on either side, that only varies horizontally,
+ * stays put. No frame is generated on the CPU, the cost per frame is the copy
+ * into shared memory alone, as with a real capture.
+ */
+
+#define PERIOD       512
+#define CURSOR_SIZE  32
+
+enum SyntheticDamage
+{
+  // every pixel changes, like full screen video
+  SYNTHETIC_DAMAGE_FULL,
+  // a full height window in the middle of the screen scrolls
+  SYNTHETIC_DAMAGE_SCROLL,
+  // the frame never changes, only the cursor moves
+  SYNTHETIC_DAMAGE_CURSOR
+};
+
+static const char * damageNames[] =
+{
+  [SYNTHETIC_DAMAGE_FULL  ] = "full",
+  [SYNTHETIC_DAMAGE_SCROLL] = "scroll",
+  [SYNTHETIC_DAMAGE_CURSOR] = "cursor",
+};
+
+static const struct
+{
+  const char  * name;
+  CaptureFormat format;
+  unsigned      bpp;
+}
+formats[] =
+{
+  { "bgra"   , CAPTURE_FMT_BGRA   , 4 },
+  { "rgba"   , CAPTURE_FMT_RGBA   , 4 },
+  { "rgba10" , CAPTURE_FMT_RGBA10 , 4 },
+  { "rgba16f", CAPTURE_FMT_RGBA16F, 8 },
+};
+
+struct synthetic
+{
+  bool                 initialized;
+  bool                 stop;
+
+  unsigned             width, height, pitch;
+  unsigned             formatIndex;
+  unsigned             formatVer;
+  enum SyntheticDamage damage;
+  unsigned             scrollStep;
+  uint64_t             interval;
+  bool                 allowRGB24;
+  bool                 hdrMetadata;
+  unsigned             maxLuminance, minLuminance, maxCLL, maxFALL;
+
+  uint8_t            * image;
+  FrameDamage          frameDamage;
+  FrameDamageRect      window;
+
+  uint64_t             nextFrame;
+  unsigned             frameCount;
+  // the image row each frame buffer starts at
+  unsigned             offset[LGMP_Q_FRAME_LEN];
+
+  CaptureGetPointerBuffer  getPointerBufferFn;
+  CapturePostPointerBuffer postPointerBufferFn;
+  LGThread               * pointerThread;
+};
+
+static struct synthetic * this = NULL;
+
+static const char * synthetic_getName(void)
+{
+  return "Synthetic";
+}
+
+static void synthetic_initOptions(void)
+{
+  struct Option options[] =
+  {
+    {
+      .module         = "synthetic",
+      .name           = "width",
+      .description    = "The width of the generated frames",
+      .type           = OPTION_TYPE_INT,
+      .value.x_int    = 1920
+    },
+    {
+      .module         = "synthetic",
+      .name           = "height",
+      .description    = "The height of the generated frames",
+      .type           = OPTION_TYPE_INT,
+      .value.x_int    = 1080
+    },
+    {
+      .module         = "synthetic",
+      .name           = "format",
+      .description    = "The frame format (bgra, rgba, rgba10 or rgba16f)",
+      .type           = OPTION_TYPE_STRING,
+      .value.x_string = "bgra"
+    },
+    {
+      .module         = "synthetic",
+      .name           = "fps",
+      .description    = "The frame rate to produce (0 for as fast as possible)",
+      .type           = OPTION_TYPE_INT,
+      .value.x_int    = 60
+    },
+    {
+      .module         = "synthetic",
+      .name           = "damage",
+      .description    = "What changes each frame (full, scroll or cursor)",
+      .type           = OPTION_TYPE_STRING,
+      .value.x_string = "full"
+    },
+    {
+      .module         = "synthetic",
+      .name           = "scrollStep",
+      .description    = "The rows the content scrolls by each frame",
+      .type           = OPTION_TYPE_INT,
+      .value.x_int    = 4
+    },
+    {
+      .module         = "synthetic",
+      .name           = "allowRGB24",
+      .description    = "Losslessly pack 32-bit RGBA8 into 24-bit RGB (saves bandwidth)",
+      .type           = OPTION_TYPE_BOOL,
+      .value.x_bool   = true
+    },
+    {
+      .module         = "synthetic",
+      .name           = "hdrMetadata",
+      .description    = "Send HDR static metadata with rgba10 and rgba16f frames",
+      .type           = OPTION_TYPE_BOOL,
+      .value.x_bool   = true
+    },
+    {
+      .module         = "synthetic",
+      .name           = "maxLuminance",
+      .description    = "The mastering display maximum luminance in nits",
+      .type           = OPTION_TYPE_INT,
+      .value.x_int    = 1000
+    },
+    {
+      .module         = "synthetic",
+      .name           = "minLuminance",
+      .description    = "The mastering display minimum luminance in 0.0001 nits",
+      .type           = OPTION_TYPE_INT,
+      .value.x_int    = 50
+    },
+    {
+      .module         = "synthetic",
+      .name           = "maxCLL",
+      .description    = "The maximum content light level in nits",
+      .type           = OPTION_TYPE_INT,
+      .value.x_int    = 1000
+    },
+    {
+      .module         = "synthetic",
+      .name           = "maxFALL",
+      .description    = "The maximum frame average light level in nits",
+      .type           = OPTION_TYPE_INT,
+      .value.x_int    = 400
+    },
+    {0}
+  };
+
+  option_register(options);
+}
+
+static bool synthetic_create(
+  CaptureGetPointerBuffer getPointerBufferFn,
+  CapturePostPointerBuffer postPointerBufferFn,
+  unsigned                 frameBuffers
+)
+{
+  DEBUG_ASSERT(!this);
+
+  const int    width      = option_get_int   ("synthetic", "width"     );
+  const int    height     = option_get_int   ("synthetic", "height"    );
+  const int    fps        = option_get_int   ("synthetic", "fps"       );
+  const int    scrollStep = option_get_int   ("synthetic", "scrollStep");
+  const char * format     = option_get_string("synthetic", "format"    );
+  const char * damage     = option_get_string("synthetic", "damage"    );
+
+  if (width < CURSOR_SIZE || width > 16384 ||
+      height < CURSOR_SIZE || height > 16384)
+  {
+    DEBUG_ERROR("Invalid synthetic frame size: %dx%d", width, height);
+    return false;
+  }
+
+  if (fps < 0 || scrollStep < 0)
+  {
+    DEBUG_ERROR("The synthetic fps and scrollStep can not be negative");
+    return false;
+  }
+
+  unsigned formatIndex;
+  for(formatIndex = 0; formatIndex < ARRAY_LENGTH(formats); ++formatIndex)
+    if (strcasecmp(format, formats[formatIndex].name) == 0)
+      break;
+
+  if (formatIndex == ARRAY_LENGTH(formats))
+  {
+    DEBUG_ERROR("Unknown synthetic format: %s", format);
+    return false;
+  }
+
+  int damageMode;
+  for(damageMode = 0; damageMode < ARRAY_LENGTH(damageNames); ++damageMode)
+    if (strcasecmp(damage, damageNames[damageMode]) == 0)
+      break;
+
+  if (damageMode == ARRAY_LENGTH(damageNames))
+  {
+    DEBUG_ERROR("Unknown synthetic damage mode: %s", damage);
+    return false;
+  }
+
+  this = calloc(1, sizeof(*this));
+  if (!this)
+  {
+    DEBUG_ERROR("out of memory");
+    return false;
+  }
+
+  this->width        = width;
+  this->height       = height;
+  this->formatIndex  = formatIndex;
+  this->pitch        = width * formats[formatIndex].bpp;
+  this->damage       = damageMode;
+  this->scrollStep   = scrollStep;
+  this->interval     = fps ? 1000000000ULL / fps : 0;
+  this->allowRGB24   = option_get_bool("synthetic", "allowRGB24"  );
+  this->hdrMetadata  = option_get_bool("synthetic", "hdrMetadata" );
+  this->maxLuminance = option_get_int ("synthetic", "maxLuminance");
+  this->minLuminance = option_get_int ("synthetic", "minLuminance");
+  this->maxCLL       = option_get_int ("synthetic", "maxCLL"      );
+  this->maxFALL      = option_get_int ("synthetic", "maxFALL"     );
+
+  this->getPointerBufferFn  = getPointerBufferFn;
+  this->postPointerBufferFn = postPointerBufferFn;
+
+  /* the window is full height as anything above or below it would scroll
+   * too, rows outside the damage are only written when a slot is reset */
+  if (this->damage == SYNTHETIC_DAMAGE_FULL)
+    this->window = (FrameDamageRect)
+    {
+      .width  = width,
+      .height = height
+    };
+  else
+    this->window = (FrameDamageRect)
+    {
+      .x      = width / 8,
+      .width  = width - width / 4,
+      .height = height
+    };
+
+  return true;
+}
+
+static uint32_t hash(uint32_t x)
+{
+  x ^= x >> 16;
+  x *= 0x7feb352d;
+  x ^= x >> 15;
+  x *= 0x846ca68b;
+  x ^= x >> 16;
+  return x;
+}
+
+/* an 8-bit colour of the image at `x`, `y` */
+static void pixelColor(unsigned x, unsigned y, uint8_t rgb[3])
+{
+  const FrameDamageRect * w = &this->window;
+  if (x < w->x || x - w->x >= w->width)
+  {
+    // the desktop only varies horizontally so scrolling never shows
+    rgb[0] = 32 + x * 64 / this->width;
+    rgb[1] = 48;
+    rgb[2] = 96 + ((x / 64) & 1) * 16;
+    return;
+  }
+
+  // lines of text with the odd coloured picture, repeating every PERIOD rows
+  const unsigned cx   = x - w->x;
+  const unsigned cy   = y % PERIOD;
+  const unsigned line = cy / 16;
+  if (line % 8 == 7)
+  {
+    rgb[0] = cx * 255 / w->width;
+    rgb[1] = (cy % 128) * 2;
+    rgb[2] = 255 - rgb[0];
+    return;
+  }
+
+  const unsigned gx = cx % 8, gy = cy % 16;
+  const bool ink = gx > 0 && gx < 7 && gy > 2 && gy < 13 &&
+    (hash(line * 4099 + cx / 8) & 3) != 0 &&
+    (hash((line * 4099 + cx / 8) ^ ((gx / 2) << 24 | (gy / 3) << 28)) & 1);
+
+  rgb[0] = rgb[1] = rgb[2] = ink ? 20 : 240;
+}
+
+static uint16_t floatToHalf(float value)
+{
+  if (value < 6.1035156e-05f)
+    return 0;
+
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return ((bits >> 23) - 112) << 10 | ((bits >> 13) & 0x3ff);
+}
+
+static void writePixel(uint8_t * dst, const uint8_t rgb[3])
+{
+  switch(formats[this->formatIndex].format)
+  {
+    case CAPTURE_FMT_BGRA:
+      dst[0] = rgb[2];
+      dst[1] = rgb[1];
+      dst[2] = rgb[0];
+      dst[3] = 255;
+      break;
+
+    case CAPTURE_FMT_RGBA:
+      dst[0] = rgb[0];
+      dst[1] = rgb[1];
+      dst[2] = rgb[2];
+      dst[3] = 255;
+      break;
+
+    case CAPTURE_FMT_RGBA10:
+    {
+      // used as PQ code values, white is around 300 nits
+      uint32_t px = 3U << 30;
+      for(int c = 0; c < 3; ++c)
+        px |= (uint32_t)(rgb[c] * 640 / 255) << (c * 10);
+      memcpy(dst, &px, sizeof(px));
+      break;
+    }
+
+    case CAPTURE_FMT_RGBA16F:
+    {
+      // linear scRGB where 1.0 is 80 nits, white is around 200 nits
+      uint16_t px[4];
+      for(int c = 0; c < 3; ++c)
+        px[c] = floatToHalf(powf(rgb[c] / 255.0f, 2.2f) * 2.5f);
+      px[3] = 0x3c00;
+      memcpy(dst, px, sizeof(px));
+      break;
+    }
+
+    default:
+      DEBUG_UNREACHABLE();
+  }
+}
+
+static bool synthetic_init(void * ivshmemBase, unsigned * alignSize)
+{
+  DEBUG_ASSERT(this);
+  DEBUG_ASSERT(!this->initialized);
+
+  this->stop = false;
+  frameDamage_reset(&this->frameDamage);
+
+  const unsigned bpp  = formats[this->formatIndex].bpp;
+  const unsigned rows = this->height + PERIOD;
+  this->image = malloc((size_t)rows * this->pitch);
+  if (!this->image)
+  {
+    DEBUG_ERROR("out of memory");
+    return false;
+  }
+
+  for(unsigned y = 0; y < rows; ++y)
+  {
+    uint8_t * row = this->image + (size_t)y * this->pitch;
+    for(unsigned x = 0; x < this->width; ++x)
+    {
+      uint8_t rgb[3];
+      pixelColor(x, y, rgb);
+      writePixel(row + x * bpp, rgb);
+    }
+  }
+
+  DEBUG_INFO("Frame Size       : %u x %u", this->width, this->height);
+  DEBUG_INFO("Format           : %s", formats[this->formatIndex].name);
+  DEBUG_INFO("Damage           : %s", damageNames[this->damage]);
+
+  ++this->formatVer;
+  this->frameCount  = 0;
+  this->nextFrame   = 0;
+  this->initialized = true;
+  return true;
+}
+
+static int pointerThread(void * unused)
+{
+  void   * data;
+  uint32_t size;
+  if (!this->getPointerBufferFn(&data, &size) ||
+      size < CURSOR_SIZE * CURSOR_SIZE * 4)
+  {
+    DEBUG_ERROR("Failed to get a pointer buffer");
+    return 0;
+  }
+
+  // a white arrow with a black outline
+  uint32_t * px = data;
+  for(unsigned y = 0; y < CURSOR_SIZE; ++y)
+    for(unsigned x = 0; x < CURSOR_SIZE; ++x)
+      px[y * CURSOR_SIZE + x] = x > y || y - x > CURSOR_SIZE / 2 ? 0 :
+        x == 0 || x == y || y - x == CURSOR_SIZE / 2 ?
+        0xff000000 : 0xffffffff;
+
+  CapturePointer pointer =
+  {
+    .positionUpdate = true,
+    .visible        = true,
+    .shapeUpdate    = true,
+    .format         = CAPTURE_FMT_COLOR,
+    .width          = CURSOR_SIZE,
+    .height         = CURSOR_SIZE,
+    .pitch          = CURSOR_SIZE * 4
+  };
+
+  // circle the middle of the screen, once every four seconds
+  const uint64_t interval = this->interval ? this->interval : 1000000;
+  const uint64_t start    = nanotime();
+  const float    radius   = min(this->width, this->height) / 3.0f;
+  while(!this->stop)
+  {
+    const float angle = (nanotime() - start) / 4e9f * 2.0f * M_PI;
+    pointer.x = this->width  / 2 + cosf(angle) * radius;
+    pointer.y = this->height / 2 + sinf(angle) * radius;
+    this->postPointerBufferFn(&pointer);
+
+    if (pointer.shapeUpdate)
+    {
+      pointer.shapeUpdate = false;
+      if (!this->getPointerBufferFn(&data, &size))
+        break;
+    }
+
+    nsleep(interval);
+  }
+
+  return 0;
+}
+
+static bool synthetic_start(void)
+{
+  this->stop = false;
+  if (!lgCreateThread("SyntheticPointer", pointerThread, NULL,
+        &this->pointerThread))
+  {
+    DEBUG_ERROR("Failed to create the SyntheticPointer thread");
+    return false;
+  }
+
+  return true;
+}
+
+static void synthetic_stop(void)
+{
+  this->stop = true;
+  if (this->pointerThread)
+  {
+    lgJoinThread(this->pointerThread, NULL);
+    this->pointerThread = NULL;
+  }
+}
+
+static bool synthetic_deinit(void)
+{
+  DEBUG_ASSERT(this);
+
+  free(this->image);
+  this->image       = NULL;
+  this->initialized = false;
+  return true;
+}
+
+static void synthetic_free(void)
+{
+  frameDamage_free(&this->frameDamage);
+  free(this);
+  this = NULL;
+}
+
+static CaptureResult synthetic_capture(
+  unsigned frameBufferIndex,
+  FrameBuffer * frame)
+{
+  DEBUG_ASSERT(this);
+  DEBUG_ASSERT(this->initialized);
+
+  if (this->interval)
+  {
+    const uint64_t now = nanotime();
+    if (now < this->nextFrame)
+      nsleep(this->nextFrame - now);
+
+    // don't try to catch up on frames that were missed
+    this->nextFrame += this->interval;
+    if (this->nextFrame < now)
+      this->nextFrame = now + this->interval;
+  }
+
+  if (this->stop)
+    return CAPTURE_RESULT_REINIT;
+
+  if (this->damage == SYNTHETIC_DAMAGE_CURSOR && this->frameCount > 0)
+  {
+    if (!this->interval)
+      nsleep(1000000);
+    return CAPTURE_RESULT_TIMEOUT;
+  }
+
+  this->offset[frameBufferIndex] =
+    (this->frameCount++ * this->scrollStep) % PERIOD;
+  return CAPTURE_RESULT_OK;
+}
+
+static CaptureResult synthetic_waitFrame(
+  unsigned frameBufferIndex,
+  CaptureFrame * frame,
+  const size_t maxFrameSize)
+{
+  const CaptureFormat format = formats[this->formatIndex].format;
+  frameDamage_setupFrame(&this->frameDamage, frame, maxFrameSize, format,
+      this->width, this->height, this->pitch, this->allowRGB24);
+
+  frame->formatVer    = this->formatVer;
+  frame->screenWidth  = this->width;
+  frame->screenHeight = this->height;
+  frame->rotation     = CAPTURE_ROT_0;
+  frame->hdr          = format == CAPTURE_FMT_RGBA10 ||
+                        format == CAPTURE_FMT_RGBA16F;
+  frame->hdrPQ        = format == CAPTURE_FMT_RGBA10;
+
+  if (frame->hdr && this->hdrMetadata)
+  {
+    // BT.2020 primaries and a D65 white point in 0.00002 units
+    static const uint16_t primaries[3][2] =
+      { { 35400, 14600 }, { 8500, 39850 }, { 6550, 2300 } };
+
+    frame->hdrMetadata = true;
+    memcpy(frame->hdrDisplayPrimary, primaries, sizeof(primaries));
+    frame->hdrWhitePoint[0]             = 15635;
+    frame->hdrWhitePoint[1]             = 16450;
+    frame->hdrMaxDisplayLuminance       = this->maxLuminance;
+    frame->hdrMinDisplayLuminance       = this->minLuminance;
+    frame->hdrMaxContentLightLevel      = this->maxCLL;
+    frame->hdrMaxFrameAverageLightLevel = this->maxFALL;
+  }
+
+  // the first frame of a capture is always whole
+  if (this->damage == SYNTHETIC_DAMAGE_FULL || this->frameCount == 1)
+    frame->damageRectsCount = 0;
+  else
+  {
+    frame->damageRectsCount = 1;
+    frame->damageRects[0]   = this->window;
+  }
+
+  return CAPTURE_RESULT_OK;
+}
+
+static CaptureResult synthetic_getFrame(
+  unsigned       frameBufferIndex,
+  FrameBuffer  * frame,
+  const size_t   maxFrameSize,
+  CaptureFrame * captureFrame)
+{
+  DEBUG_ASSERT(this);
+  DEBUG_ASSERT(this->initialized);
+
+  const uint8_t * src = this->image +
+    (size_t)this->offset[frameBufferIndex] * this->pitch;
+
+  if (!frameDamage_write(&this->frameDamage, frameBufferIndex, frame,
+        maxFrameSize, captureFrame, src, formats[this->formatIndex].format,
+        this->pitch))
+    return CAPTURE_RESULT_ERROR;
+
+  return CAPTURE_RESULT_OK;
+}
+
+struct CaptureInterface Capture_Synthetic =
+{
+  .shortName       = "Synthetic",
+  .asyncCapture    = false,
+  .manual          = true,
+  .canCompress     = true,
+  .pipelined       = true,
+  .initOptions     = synthetic_initOptions,
+  .getName         = synthetic_getName,
+  .create          = synthetic_create,
+  .init            = synthetic_init,
+  .start           = synthetic_start,
+  .stop            = synthetic_stop,
+  .deinit          = synthetic_deinit,
+  .free            = synthetic_free,
+  .capture         = synthetic_capture,
+  .waitFrame       = synthetic_waitFrame,
+  .getFrame        = synthetic_getFrame
+};
@@ -20,6 +20,10 @@
 
 #include "interface/capture.h"
 #include "interface/platform.h"
+#include "frame_damage.h"
+#include "cpu_downsample.h"
+#include "downsample_parser.h"
+#include "common/rects.h"
 #include "common/util.h"
 #include "common/option.h"
 #include "common/debug.h"
@@ -29,44 +33,93 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <unistd.h>
+#include <stdatomic.h>
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
+#include <xcb/damage.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
 
+/* the most region rects merged down to KVMFR_MAX_DAMAGE_RECTS, a more
+ * fragmented region is sent as full damage */
+#define XCB_MAX_REGION_RECTS (KVMFR_MAX_DAMAGE_RECTS * 4)
+
+enum XCBBufferState
+{
+  XCB_BUFFER_FREE,    // can be grabbed into
+  XCB_BUFFER_GRABBED, // grabbed, waiting for waitFrame
+  XCB_BUFFER_READING  // taken by waitFrame, free again after getFrame
+};
+
+/* a SHM segment per frame buffer so the next grab can overlap the last copy.
+ * The segments are used in order as a ring, independent of the frame buffer
+ * index the app passes in, so a grab never depends on when the app advances
+ * its own index. */
+struct XCBBuffer
+{
+  uint32_t                    seg;
+  int                         shmID;
+  void                      * data;
+  _Atomic(int)                state;
+  xcb_shm_get_image_cookie_t  imgC;
+  int                         damageRectsCount;
+  FrameDamageRect             damageRects[KVMFR_MAX_DAMAGE_RECTS];
+};
+
 struct xcb
 {
   bool                        initialized;
   bool                        stop;
   xcb_connection_t          * xcb;
   xcb_screen_t              * xcbScreen;
-  uint32_t                    seg;
-  int                         shmID;
-  void                      * data;
+  struct XCBBuffer            buffers[LGMP_Q_FRAME_LEN];
+  unsigned                    frameBuffers;
   LGEvent                   * frameEvent;
 
+  // the next segment to grab into, only used by capture
+  unsigned                    grabIndex;
+  // the next segment waitFrame takes, only used by waitFrame
+  unsigned                    readIndex;
+  // the segment taken by waitFrame for each frame buffer index
+  unsigned                    frameSegment[LGMP_Q_FRAME_LEN];
+
   CaptureGetPointerBuffer     getPointerBufferFn;
   CapturePostPointerBuffer    postPointerBufferFn;
   LGThread                  * pointerThread;
 
   unsigned int width;
-  unsigned int height, dataHeight;
+  unsigned int height;
   unsigned int pitch;
+  bool         allowRGB24;
+  FrameDamage  damage;
+
+  // the size frames are reduced to if a downsample rule matched
+  CPUDownsample * downsample;
+  bool            downsampling;
+  unsigned int    dsWidth, dsHeight;
+
+  // XDamage tracking, if the extension is not present every frame is full
+  bool                 hasDamage;
+  uint8_t              damageEvent;
+  xcb_damage_damage_t  damageID;
+  xcb_xfixes_region_t  damageRegion;
+  bool                 damaged, fullDamage;
+  FrameDamageRect      regionRects[XCB_MAX_REGION_RECTS];
 
   int mouseX, mouseY, mouseHotX, mouseHotY;
 
-  bool                                 hasFrame;
-  xcb_shm_get_image_cookie_t           imgC;
   xcb_xfixes_get_cursor_image_cookie_t curC;
 };
 
 static struct xcb * this = NULL;
+static Vector downsampleRules = {0};
 
 static int pointerThread(void * unused);
 
 // forwards
 
 static bool xcb_deinit(void);
+static bool xcb_initDamage(void);
 
 // implementation
 
@@ -79,6 +132,14 @@ static void xcb_initOptions(void)
 {
   struct Option options[] =
   {
+    {
+      .module         = "xcb",
+      .name           = "allowRGB24",
+      .description    = "Losslessly pack 32-bit RGBA8 into 24-bit RGB (saves bandwidth)",
+      .type           = OPTION_TYPE_BOOL,
+      .value.x_bool   = true
+    },
+    DOWNSAMPLE_PARSER("xcb", &downsampleRules),
     {0}
   };
 
@@ -92,13 +153,18 @@ static bool xcb_create(
 )
 {
   DEBUG_ASSERT(!this);
-  this             = calloc(1, sizeof(*this));
-  this->shmID      = -1;
-  this->data       = (void *)-1;
-  this->frameEvent = lgCreateEvent(true, 20);
+  this               = calloc(1, sizeof(*this));
+  this->frameBuffers = min(frameBuffers, (unsigned)LGMP_Q_FRAME_LEN);
+  this->frameEvent   = lgCreateEvent(true, 20);
+  for(unsigned i = 0; i < LGMP_Q_FRAME_LEN; ++i)
+  {
+    this->buffers[i].shmID = -1;
+    this->buffers[i].data  = (void *)-1;
+  }
 
   this->getPointerBufferFn = getPointerBufferFn;
   this->postPointerBufferFn = postPointerBufferFn;
+  this->allowRGB24          = option_get_bool("xcb", "allowRGB24");
 
   if (!this->frameEvent)
   {
@@ -116,6 +182,7 @@ static bool xcb_init(void * ivshmemBase, unsigned * alignSize)
   DEBUG_ASSERT(!this->initialized);
 
   lgResetEvent(this->frameEvent);
+  frameDamage_reset(&this->damage);
 
   this->stop = false;
   this->xcb = xcb_connect(NULL, NULL);
@@ -139,23 +206,37 @@ static bool xcb_init(void * ivshmemBase, unsigned * alignSize)
   this->pitch     = this->width * 4;
   DEBUG_INFO("Frame Size       : %u x %u", this->width, this->height);
 
-  this->seg   = xcb_generate_id(this->xcb);
-  const size_t maxFrameSize = this->width * this->height * 4;
-  this->shmID = shmget(IPC_PRIVATE, maxFrameSize, IPC_CREAT | 0777);
-  if (this->shmID == -1)
-  {
-    DEBUG_ERROR("shmget failed");
+  this->downsampling = cpuDownsample_match(&downsampleRules, CAPTURE_FMT_BGRA,
+      this->width, this->height, &this->dsWidth, &this->dsHeight);
+  if (this->downsampling && !this->downsample &&
+      !cpuDownsample_create(&this->downsample))
     goto fail;
-  }
 
-  xcb_shm_attach(this->xcb, this->seg ,this->shmID, false);
-  this->data = shmat(this->shmID, NULL, 0);
-  if ((uintptr_t)this->data == -1)
+  const size_t maxFrameSize = this->width * this->height * 4;
+  this->grabIndex = 0;
+  this->readIndex = 0;
+  for(unsigned i = 0; i < this->frameBuffers; ++i)
   {
-    DEBUG_ERROR("shmat failed");
-    goto fail;
+    struct XCBBuffer * buf = this->buffers + i;
+    atomic_store(&buf->state, XCB_BUFFER_FREE);
+
+    buf->seg   = xcb_generate_id(this->xcb);
+    buf->shmID = shmget(IPC_PRIVATE, maxFrameSize, IPC_CREAT | 0777);
+    if (buf->shmID == -1)
+    {
+      DEBUG_ERROR("shmget failed");
+      goto fail;
+    }
+
+    xcb_shm_attach(this->xcb, buf->seg, buf->shmID, false);
+    buf->data = shmat(buf->shmID, NULL, 0);
+    if ((uintptr_t)buf->data == -1)
+    {
+      DEBUG_ERROR("shmat failed");
+      goto fail;
+    }
+    DEBUG_INFO("Frame Data %u    : 0x%" PRIXPTR, i, (uintptr_t)buf->data);
   }
-  DEBUG_INFO("Frame Data       : 0x%" PRIXPTR, (uintptr_t)this->data);
 
   xcb_query_extension_cookie_t extension_cookie =
 		xcb_query_extension(this->xcb, strlen("XFIXES"), "XFIXES");
@@ -181,6 +262,10 @@ static bool xcb_init(void * ivshmemBase, unsigned * alignSize)
   }
   free(version_reply);
 
+  this->hasDamage  = xcb_initDamage();
+  this->damaged    = true;
+  this->fullDamage = true;
+
   this->initialized = true;
   return true;
 fail:
@@ -188,6 +273,136 @@ fail:
   return false;
 }
 
+static bool xcb_initDamage(void)
+{
+  const xcb_query_extension_reply_t * ext =
+    xcb_get_extension_data(this->xcb, &xcb_damage_id);
+  if (!ext || !ext->present)
+  {
+    DEBUG_WARN("Missing the DAMAGE extension, every frame will be full");
+    return false;
+  }
+
+  xcb_damage_query_version_cookie_t version_cookie =
+    xcb_damage_query_version(this->xcb, XCB_DAMAGE_MAJOR_VERSION,
+        XCB_DAMAGE_MINOR_VERSION);
+  xcb_damage_query_version_reply_t * version_reply =
+    xcb_damage_query_version_reply(this->xcb, version_cookie, NULL);
+  if (!version_reply)
+  {
+    DEBUG_WARN("Failed to query the DAMAGE version, every frame will be full");
+    return false;
+  }
+  free(version_reply);
+
+  this->damageEvent  = ext->first_event + XCB_DAMAGE_NOTIFY;
+  this->damageID     = xcb_generate_id(this->xcb);
+  this->damageRegion = xcb_generate_id(this->xcb);
+
+  // only notify when the damage goes from empty to non-empty
+  xcb_damage_create(this->xcb, this->damageID, this->xcbScreen->root,
+      XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+  xcb_xfixes_create_region(this->xcb, this->damageRegion, 0, NULL);
+  xcb_flush(this->xcb);
+
+  DEBUG_INFO("Using XDamage for frame damage");
+  return true;
+}
+
+/**
+ * Move the damage accumulated since the last capture into the buffer's damage
+ * rects. Returns false if nothing has changed.
+ */
+static bool xcb_collectDamage(struct XCBBuffer * buf)
+{
+  xcb_generic_event_t * event;
+  while ((event = xcb_poll_for_event(this->xcb)))
+  {
+    if ((event->response_type & ~0x80) == this->damageEvent)
+      this->damaged = true;
+    free(event);
+  }
+
+  if (!this->damaged)
+    return false;
+
+  this->damaged = false;
+  xcb_damage_subtract(this->xcb, this->damageID, XCB_NONE,
+      this->damageRegion);
+
+  xcb_xfixes_fetch_region_reply_t * reply = xcb_xfixes_fetch_region_reply(
+      this->xcb, xcb_xfixes_fetch_region(this->xcb, this->damageRegion),
+      NULL);
+
+  if (this->fullDamage || !reply)
+  {
+    this->fullDamage      = false;
+    buf->damageRectsCount = 0;
+    free(reply);
+    return true;
+  }
+
+  const xcb_rectangle_t * src = xcb_xfixes_fetch_region_rectangles(reply);
+  int count = xcb_xfixes_fetch_region_rectangles_length(reply);
+  if (count == 0)
+  {
+    free(reply);
+    return false;
+  }
+
+  if (count > XCB_MAX_REGION_RECTS)
+  {
+    buf->damageRectsCount = 0;
+    free(reply);
+    return true;
+  }
+
+  FrameDamageRect * rects = this->regionRects;
+  for(int i = 0; i < count; ++i)
+    rects[i] = (FrameDamageRect)
+    {
+      .x      = src[i].x,
+      .y      = src[i].y,
+      .width  = src[i].width,
+      .height = src[i].height
+    };
+  free(reply);
+
+  /* the region is banded in y-x order, so neighbours are close together and
+   * merging them pairwise keeps the bounds tight */
+  while (count > KVMFR_MAX_DAMAGE_RECTS)
+  {
+    int out = 0;
+    for(int i = 0; i < count; i += 2, ++out)
+    {
+      if (i + 1 == count)
+      {
+        rects[out] = rects[i];
+        break;
+      }
+
+      const FrameDamageRect * a = rects + i;
+      const FrameDamageRect * b = rects + i + 1;
+      const uint32_t x1 = min(a->x, b->x);
+      const uint32_t y1 = min(a->y, b->y);
+      const uint32_t x2 = max(a->x + a->width , b->x + b->width );
+      const uint32_t y2 = max(a->y + a->height, b->y + b->height);
+      rects[out] = (FrameDamageRect)
+      {
+        .x      = x1,
+        .y      = y1,
+        .width  = x2 - x1,
+        .height = y2 - y1
+      };
+    }
+    count = rectsMergeOverlapping(rects, out + (count & 1));
+  }
+
+  memcpy(buf->damageRects, rects, count * sizeof(*rects));
+  buf->damageRectsCount = count;
+  return true;
+}
+
 static bool xcb_start(void)
 {
   this->stop = false;
@@ -216,16 +431,27 @@ static bool xcb_deinit(void)
 {
   DEBUG_ASSERT(this);
 
-  if ((uintptr_t)this->data != -1)
+  for(unsigned i = 0; i < LGMP_Q_FRAME_LEN; ++i)
   {
-    shmdt(this->data);
-    this->data = (void *)-1;
+    struct XCBBuffer * buf = this->buffers + i;
+    if ((uintptr_t)buf->data != -1)
+    {
+      shmdt(buf->data);
+      buf->data = (void *)-1;
+    }
+
+    if (buf->shmID != -1)
+    {
+      shmctl(buf->shmID, IPC_RMID, NULL);
+      buf->shmID = -1;
+    }
   }
 
-  if (this->shmID != -1)
+  if (this->hasDamage)
   {
-    shmctl(this->shmID, IPC_RMID, NULL);
-    this->shmID = -1;
+    xcb_damage_destroy(this->xcb, this->damageID);
+    xcb_xfixes_destroy_region(this->xcb, this->damageRegion);
+    this->hasDamage = false;
   }
 
   if (this->xcb)
@@ -240,6 +466,8 @@ static bool xcb_deinit(void)
 
 static void xcb_free(void)
 {
+  frameDamage_free(&this->damage);
+  cpuDownsample_free(&this->downsample);
   lgFreeEvent(this->frameEvent);
   free(this);
   this = NULL;
@@ -252,23 +480,44 @@ static CaptureResult xcb_capture(
   DEBUG_ASSERT(this);
   DEBUG_ASSERT(this->initialized);
 
-  if (!this->hasFrame)
+  /* the segment is in use until getFrame has copied it out, and there is no
+   * point grabbing again while the last grab has not been taken yet */
+  const unsigned last = (this->grabIndex ? this->grabIndex :
+      this->frameBuffers) - 1;
+  struct XCBBuffer * buf = this->buffers + this->grabIndex;
+  if (atomic_load_explicit(&buf->state, memory_order_acquire) !=
+      XCB_BUFFER_FREE ||
+      atomic_load(&this->buffers[last].state) == XCB_BUFFER_GRABBED)
+    return CAPTURE_RESULT_OK;
+
+  if (this->hasDamage)
   {
-    this->imgC = xcb_shm_get_image_unchecked(
-        this->xcb,
-        this->xcbScreen->root,
-        0, 0,
-        this->width,
-        this->height,
-        ~0,
-        XCB_IMAGE_FORMAT_Z_PIXMAP,
-        this->seg,
-        0);
-
-    this->hasFrame  = true;
-    lgSignalEvent(this->frameEvent);
+    // nothing changed, there is no need to grab the screen
+    if (!xcb_collectDamage(buf))
+    {
+      usleep(1000);
+      return CAPTURE_RESULT_TIMEOUT;
+    }
   }
-
+  else
+    buf->damageRectsCount = 0;
+
+  buf->imgC = xcb_shm_get_image_unchecked(
+      this->xcb,
+      this->xcbScreen->root,
+      0, 0,
+      this->width,
+      this->height,
+      ~0,
+      XCB_IMAGE_FORMAT_Z_PIXMAP,
+      buf->seg,
+      0);
+
+  atomic_store_explicit(&buf->state, XCB_BUFFER_GRABBED, memory_order_release);
+  if (++this->grabIndex == this->frameBuffers)
+    this->grabIndex = 0;
+
+  lgSignalEvent(this->frameEvent);
   return CAPTURE_RESULT_OK;
 }
 
@@ -277,24 +526,40 @@ static CaptureResult xcb_waitFrame(
   CaptureFrame * frame,
   const size_t maxFrameSize)
 {
-  lgWaitEvent(this->frameEvent, TIMEOUT_INFINITE);
-
-  const unsigned int maxHeight = maxFrameSize / this->pitch;
-  this->dataHeight = min(maxHeight, this->height);
-
+  /* time out so the last frame can be resent to new clients while the screen
+   * is idle */
+  struct XCBBuffer * buf = this->buffers + this->readIndex;
+  while(atomic_load_explicit(&buf->state, memory_order_acquire) !=
+      XCB_BUFFER_GRABBED)
+    if (!lgWaitEvent(this->frameEvent, 100))
+      return CAPTURE_RESULT_TIMEOUT;
+
+  atomic_store(&buf->state, XCB_BUFFER_READING);
+  this->frameSegment[frameBufferIndex] = this->readIndex;
+  if (++this->readIndex == this->frameBuffers)
+    this->readIndex = 0;
+
+  if (this->downsampling)
+    frameDamage_setupFrame(&this->damage, frame, maxFrameSize,
+        CAPTURE_FMT_BGRA, this->dsWidth, this->dsHeight, this->dsWidth * 4,
+        this->allowRGB24);
+  else
+    frameDamage_setupFrame(&this->damage, frame, maxFrameSize,
+        CAPTURE_FMT_BGRA, this->width, this->height, this->pitch,
+        this->allowRGB24);
 
   frame->screenWidth  = this->width;
   frame->screenHeight = this->height;
-  frame->dataWidth    = this->width;
-  frame->dataHeight   = this->dataHeight;
-  frame->frameWidth   = this->width;
-  frame->frameHeight  = this->height;
-  frame->truncated    = maxHeight < this->height;
-  frame->pitch        = this->pitch;
-  frame->stride       = this->width;
-  frame->format       = CAPTURE_FMT_BGRA;
   frame->rotation     = CAPTURE_ROT_0;
 
+  frame->damageRectsCount = buf->damageRectsCount;
+  memcpy(frame->damageRects, buf->damageRects,
+      buf->damageRectsCount * sizeof(*buf->damageRects));
+
+  if (this->downsampling)
+    cpuDownsample_adjustDamage(frame->damageRects, frame->damageRectsCount,
+        this->width, this->height, this->dsWidth, this->dsHeight);
+
   return CAPTURE_RESULT_OK;
 }
 
@@ -304,23 +569,44 @@ static CaptureResult xcb_getFrame(
   const size_t   maxFrameSize,
   CaptureFrame * captureFrame)
 {
-  (void)captureFrame;
   DEBUG_ASSERT(this);
   DEBUG_ASSERT(this->initialized);
 
+  struct XCBBuffer * buf =
+    this->buffers + this->frameSegment[frameBufferIndex];
+  DEBUG_ASSERT(atomic_load(&buf->state) == XCB_BUFFER_READING);
+
+  CaptureResult result = CAPTURE_RESULT_ERROR;
   xcb_shm_get_image_reply_t * img;
-  img = xcb_shm_get_image_reply(this->xcb, this->imgC, NULL);
+  img = xcb_shm_get_image_reply(this->xcb, buf->imgC, NULL);
   if (!img)
   {
     DEBUG_ERROR("Failed to get image reply");
-    return CAPTURE_RESULT_ERROR;
+    goto done;
   }
 
-  framebuffer_write(frame, this->data, this->pitch);
-  free(img);
+  const void * src      = buf->data;
+  size_t       srcPitch = this->pitch;
+  if (this->downsampling)
+  {
+    src = cpuDownsample_run(this->downsample, buf->data, this->pitch,
+        this->width, this->height, this->dsWidth, this->dsHeight,
+        captureFrame->damageRects, captureFrame->damageRectsCount);
+    srcPitch = this->dsWidth * 4;
+    if (!src)
+      goto done;
+  }
 
-  this->hasFrame = false;
-  return CAPTURE_RESULT_OK;
+  if (!frameDamage_write(&this->damage, frameBufferIndex, frame,
+        maxFrameSize, captureFrame, src, CAPTURE_FMT_BGRA, srcPitch))
+    goto done;
+
+  result = CAPTURE_RESULT_OK;
+
+done:
+  free(img);
+  atomic_store_explicit(&buf->state, XCB_BUFFER_FREE, memory_order_release);
+  return result;
 }
 
 static int pointerThread(void * unused)
@@ -398,6 +684,8 @@ struct CaptureInterface Capture_XCB =
 {
   .shortName       = "XCB",
   .asyncCapture    = true,
+  .canCompress     = true,
+  .pipelined       = true,
   .initOptions     = xcb_initOptions,
   .getName         = xcb_getName,
   .create          = xcb_create,
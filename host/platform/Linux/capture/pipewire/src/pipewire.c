@@ -21,17 +21,44 @@
 #include "portal.h"
 #include "interface/capture.h"
 #include "interface/platform.h"
+#include "frame_damage.h"
+#include "cpu_downsample.h"
+#include "downsample_parser.h"
+#include "common/array.h"
 #include "common/util.h"
+#include "common/option.h"
 #include "common/debug.h"
+#include "common/hdr10.h"
 #include "common/stringutils.h"
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/dma-buf.h>
 
 #include <pipewire/pipewire.h>
 #include <spa/pod/builder.h>
 #include <spa/param/format.h>
 #include <spa/param/video/format-utils.h>
+#include <spa/buffer/meta.h>
+
+/* the following comes from drm_fourcc.h and is included here to avoid the
+ * dependency on the kernel DRM or libdrm headers */
+#define DRM_FORMAT_MOD_LINEAR  0ULL
+#define DRM_FORMAT_MOD_INVALID 0x00ffffffffffffffULL
+
+/* a buffer taken from the stream for a frame buffer index, it is returned to
+ * the stream once getFrame has copied it out */
+struct PWFrame
+{
+  struct pw_buffer * buffer;
+  uint8_t          * data;
+  int                pitch;
+  int                dmaFd;
+  int                damageCount;
+  FrameDamageRect    damageRects[KVMFR_MAX_DAMAGE_RECTS];
+};
 
 struct pipewire
 {
@@ -47,15 +74,33 @@ struct pipewire
   bool          stop;
   bool          hasFormat;
   bool          formatChanged;
-  int           width, height, dataHeight, pitch;
+  bool          allowDmaBuf;
+  bool          unmappableLogged; // once per stream, it repeats every frame
+  int           width, height, pitch, bpp;
   CaptureFormat format;
   bool          hdr;
   bool          hdrPQ;
-  uint8_t     * frameData;
   unsigned int  formatVer;
+  bool          allowRGB24;
+  bool          hdr16to10;
+  FrameDamage   damage;
+
+  // the size frames are reduced to if a downsample rule matched
+  CPUDownsample * downsample;
+  bool            downsampling;
+  int             dsWidth, dsHeight;
+
+  // the latest buffer, waiting for capture to take it
+  struct pw_buffer * pending;
+  struct PWFrame     frames[LGMP_Q_FRAME_LEN];
+
+  // damage reported since the last frame, -1 if the whole frame changed
+  int             damageCount;
+  FrameDamageRect damageRects[KVMFR_MAX_DAMAGE_RECTS];
 };
 
 static struct pipewire * this = NULL;
+static Vector downsampleRules = {0};
 
 // forwards
 
@@ -68,6 +113,31 @@ static const char * pipewire_getName(void)
   return "PipeWire";
 }
 
+static void pipewire_initOptions(void)
+{
+  struct Option options[] =
+  {
+    {
+      .module         = "pipewire",
+      .name           = "allowRGB24",
+      .description    = "Losslessly pack 32-bit RGBA8 into 24-bit RGB (saves bandwidth)",
+      .type           = OPTION_TYPE_BOOL,
+      .value.x_bool   = true
+    },
+    {
+      .module         = "pipewire",
+      .name           = "HDR16to10",
+      .description    = "Convert HDR16/8bpp to HDR10/4bpp (saves bandwidth)",
+      .type           = OPTION_TYPE_BOOL,
+      .value.x_bool   = true
+    },
+    DOWNSAMPLE_PARSER("pipewire", &downsampleRules),
+    {0}
+  };
+
+  option_register(options);
+}
+
 static bool pipewire_create(
   CaptureGetPointerBuffer getPointerBufferFn,
   CapturePostPointerBuffer postPointerBufferFn,
@@ -77,6 +147,15 @@ static bool pipewire_create(
   DEBUG_ASSERT(!this);
   pw_init(NULL, NULL);
   this = calloc(1, sizeof(*this));
+  this->allowRGB24 = option_get_bool("pipewire", "allowRGB24");
+  this->hdr16to10  = option_get_bool("pipewire", "HDR16to10");
+
+  // the conversion is too slow to keep up without the SIMD kernel
+  if (this->hdr16to10 && !hdr10_accelerated())
+  {
+    DEBUG_INFO("HDR16to10 requires F16C and AVX2, HDR16 will be sent as is");
+    this->hdr16to10 = false;
+  }
   return true;
 }
 
@@ -91,12 +170,13 @@ static const struct pw_core_events coreEvents = {
   .error = coreErrorCallback,
 };
 
-static bool startStream(struct pw_stream * stream, uint32_t node)
+static const struct spa_pod * buildFormat(struct spa_pod_builder * builder,
+  bool dmaBuf)
 {
-  char buffer[1024];
-  struct spa_pod_builder builder = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
-  const struct spa_pod * param = spa_pod_builder_add_object(
-    &builder, SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat,
+  struct spa_pod_frame frame;
+  spa_pod_builder_push_object(builder, &frame,
+    SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat);
+  spa_pod_builder_add(builder,
     SPA_FORMAT_mediaType, SPA_POD_Id(SPA_MEDIA_TYPE_video),
     SPA_FORMAT_mediaSubtype, SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
     SPA_FORMAT_VIDEO_format, SPA_POD_CHOICE_ENUM_Id(6,
@@ -106,10 +186,89 @@ static bool startStream(struct pw_stream * stream, uint32_t node)
     SPA_FORMAT_VIDEO_size, SPA_POD_CHOICE_RANGE_Rectangle(
       &SPA_RECTANGLE(1920, 1080), &SPA_RECTANGLE(1, 1), &SPA_RECTANGLE(8192, 4320)),
     SPA_FORMAT_VIDEO_framerate, SPA_POD_CHOICE_RANGE_Fraction(
-      &SPA_FRACTION(60, 1), &SPA_FRACTION(0, 1), &SPA_FRACTION(360, 1)));
+      &SPA_FRACTION(60, 1), &SPA_FRACTION(0, 1), &SPA_FRACTION(360, 1)),
+    0);
+
+  /* DMA-BUFs are read through a CPU mapping, which is only meaningful for a
+   * linear or implicit layout. Tiled and compressed modifiers are never
+   * offered, a producer that needs one falls back to the format without. */
+  if (dmaBuf)
+  {
+    struct spa_pod_frame choice;
+    spa_pod_builder_prop(builder, SPA_FORMAT_VIDEO_modifier,
+      SPA_POD_PROP_FLAG_MANDATORY);
+    spa_pod_builder_push_choice(builder, &choice, SPA_CHOICE_Enum, 0);
+    spa_pod_builder_long(builder, DRM_FORMAT_MOD_LINEAR );
+    spa_pod_builder_long(builder, DRM_FORMAT_MOD_LINEAR );
+    spa_pod_builder_long(builder, DRM_FORMAT_MOD_INVALID);
+    spa_pod_builder_pop(builder, &choice);
+  }
+
+  return spa_pod_builder_pop(builder, &frame);
+}
+
+static bool startStream(struct pw_stream * stream, uint32_t node)
+{
+  char buffer[2048];
+  struct spa_pod_builder builder = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+  const struct spa_pod * params[] =
+  {
+    buildFormat(&builder, true ),
+    buildFormat(&builder, false)
+  };
 
   return pw_stream_connect(stream, PW_DIRECTION_INPUT, node,
-    PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS, &param, 1) >= 0;
+    PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS,
+    params, ARRAY_LENGTH(params)) >= 0;
+}
+
+/* fold the damage of a buffer into the damage since the last frame */
+static void accumulateDamage(struct spa_buffer * buffer)
+{
+  if (this->damageCount < 0)
+    return;
+
+  struct spa_meta * meta = spa_buffer_find_meta(buffer, SPA_META_VideoDamage);
+  if (!meta)
+  {
+    this->damageCount = -1;
+    return;
+  }
+
+  const int startCount = this->damageCount;
+  struct spa_meta_region * region;
+  spa_meta_for_each(region, meta)
+  {
+    if (!spa_meta_region_is_valid(region))
+      break;
+
+    if (this->damageCount == KVMFR_MAX_DAMAGE_RECTS)
+    {
+      this->damageCount = -1;
+      return;
+    }
+
+    const struct spa_rectangle size = region->region.size;
+    const struct spa_point     pos  = region->region.position;
+    const int x1 = clamp(pos.x                   , 0, this->width );
+    const int y1 = clamp(pos.y                   , 0, this->height);
+    const int x2 = clamp(pos.x + (int)size.width , 0, this->width );
+    const int y2 = clamp(pos.y + (int)size.height, 0, this->height);
+    if (x2 <= x1 || y2 <= y1)
+      continue;
+
+    this->damageRects[this->damageCount++] = (FrameDamageRect)
+    {
+      .x      = x1,
+      .y      = y1,
+      .width  = x2 - x1,
+      .height = y2 - y1
+    };
+  }
+
+  // a buffer without any regions tells us nothing, assume it all changed
+  if (this->damageCount == startCount)
+    this->damageCount = -1;
 }
 
 static void streamProcessCallback(void * opaque)
@@ -119,12 +278,16 @@ static void streamProcessCallback(void * opaque)
 
   struct pw_buffer * pwBuffer = NULL;
 
-  // dequeue all buffers to get the latest one
+  // dequeue all buffers to get the latest one, keeping the damage of each
   while (true)
   {
     struct pw_buffer * tmp = pw_stream_dequeue_buffer(this->stream);
     if (!tmp)
       break;
+
+    if (tmp->buffer->datas[0].chunk->size)
+      accumulateDamage(tmp->buffer);
+
     if (pwBuffer)
       pw_stream_queue_buffer(this->stream, pwBuffer);
     pwBuffer = tmp;
@@ -136,14 +299,43 @@ static void streamProcessCallback(void * opaque)
     return;
   }
 
-  struct spa_buffer * buffer = pwBuffer->buffer;
-  if (!buffer->datas[0].chunk->size)
+  struct spa_data * data = &pwBuffer->buffer->datas[0];
+  if (!data->chunk->size)
+  {
+    pw_stream_queue_buffer(this->stream, pwBuffer);
+    return;
+  }
+
+  if (!data->data ||
+      (data->type == SPA_DATA_DmaBuf && !this->allowDmaBuf))
+  {
+    if (!this->unmappableLogged)
+    {
+      DEBUG_ERROR("PipeWire buffer type %" PRIu32 " is not mappable, frames "
+          "will be dropped", data->type);
+      this->unmappableLogged = true;
+    }
+    this->damageCount = -1;
+    pw_stream_queue_buffer(this->stream, pwBuffer);
     return;
+  }
 
-  this->frameData = buffer->datas[0].data;
+  // the producer may pad rows, treat a new stride as a format change
+  const int stride = data->chunk->stride;
+  if (stride > 0 && stride != this->pitch)
+  {
+    this->pitch         = stride;
+    this->formatChanged = true;
+  }
 
+  // wait for capture to take the buffer, if it did not give it back now
+  this->pending = pwBuffer;
   pw_thread_loop_signal(this->threadLoop, true);
-  pw_stream_queue_buffer(this->stream, pwBuffer);
+  if (this->pending)
+  {
+    pw_stream_queue_buffer(this->stream, this->pending);
+    this->pending = NULL;
+  }
 }
 
 static CaptureFormat convertSpaFormat(enum spa_video_format spa)
@@ -181,7 +373,7 @@ static void streamParamChangedCallback(void * opaque, uint32_t id,
       mediaSubtype != SPA_MEDIA_SUBTYPE_raw)
     return;
 
-  struct spa_video_info_raw info;
+  struct spa_video_info_raw info = { .modifier = DRM_FORMAT_MOD_INVALID };
   if (spa_format_video_raw_parse(param, &info) < 0)
   {
     DEBUG_ERROR("Failed to parse video info");
@@ -196,25 +388,57 @@ static void streamParamChangedCallback(void * opaque, uint32_t id,
       SPA_VIDEO_FORMAT_RGBA_F16);
   this->hdrPQ  = true; // this is assumed and untested
 
-  const int bpp = this->format == CAPTURE_FMT_RGBA16F ? 8 : 4;
-  this->pitch = this->width * bpp;
+  this->bpp         = this->format == CAPTURE_FMT_RGBA16F ? 8 : 4;
+  this->pitch       = this->width * this->bpp;
+  this->damageCount = -1;
+
+  unsigned dsWidth, dsHeight;
+  this->downsampling = cpuDownsample_match(&downsampleRules, this->format,
+      this->width, this->height, &dsWidth, &dsHeight);
+  this->dsWidth  = dsWidth;
+  this->dsHeight = dsHeight;
+
+  // DMA-BUFs are only accepted with a modifier we offered in startStream
+  this->allowDmaBuf =
+    spa_pod_find_prop(param, NULL, SPA_FORMAT_VIDEO_modifier) &&
+    (info.modifier == DRM_FORMAT_MOD_LINEAR ||
+     info.modifier == DRM_FORMAT_MOD_INVALID);
 
   if (this->hasFormat)
-  {
     this->formatChanged = true;
-    return;
-  }
 
   char buffer[1024];
   struct spa_pod_builder builder = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
 
-  param = spa_pod_builder_add_object(
+  /* shared memory and DMA-BUF buffers are mapped by the stream, so they can
+   * be read in place just like MemPtr buffers. Each frame buffer index may
+   * hold a buffer while the compositor renders into another. The buffers are
+   * renegotiated with each format as the modifier may have changed. */
+  const struct spa_pod * params[2];
+  params[0] = spa_pod_builder_add_object(
     &builder, SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
-    SPA_PARAM_BUFFERS_dataType, SPA_POD_Int(1 << SPA_DATA_MemPtr));
-  pw_stream_update_params(this->stream, &param, 1);
+    SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(
+      LGMP_Q_FRAME_LEN + 2, LGMP_Q_FRAME_LEN + 1, 16),
+    SPA_PARAM_BUFFERS_dataType, SPA_POD_Int(
+      (1 << SPA_DATA_MemPtr) |
+      (1 << SPA_DATA_MemFd ) |
+      (this->allowDmaBuf ? 1 << SPA_DATA_DmaBuf : 0)));
+
+  params[1] = spa_pod_builder_add_object(
+    &builder, SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta,
+    SPA_PARAM_META_type, SPA_POD_Id(SPA_META_VideoDamage),
+    SPA_PARAM_META_size, SPA_POD_CHOICE_RANGE_Int(
+      sizeof(struct spa_meta_region) * KVMFR_MAX_DAMAGE_RECTS,
+      sizeof(struct spa_meta_region) * 1,
+      sizeof(struct spa_meta_region) * KVMFR_MAX_DAMAGE_RECTS));
+
+  pw_stream_update_params(this->stream, params, ARRAY_LENGTH(params));
 
-  this->hasFormat = true;
-  pw_thread_loop_signal(this->threadLoop, true);
+  if (!this->hasFormat)
+  {
+    this->hasFormat = true;
+    pw_thread_loop_signal(this->threadLoop, true);
+  }
 }
 
 static void streamStateChangedCallback(void * opaque,
@@ -239,6 +463,7 @@ static bool pipewire_init(void * ivshmemBase, unsigned * alignSize)
 {
   DEBUG_ASSERT(this);
   this->stop = false;
+  frameDamage_reset(&this->damage);
 
   this->portal = portal_create();
   if (!this->portal)
@@ -322,9 +547,12 @@ static bool pipewire_init(void * ivshmemBase, unsigned * alignSize)
     goto fail;
   }
 
-  this->hasFormat     = false;
-  this->formatChanged = false;
-  this->frameData     = NULL;
+  this->hasFormat        = false;
+  this->formatChanged    = false;
+  this->unmappableLogged = false;
+  this->pending          = NULL;
+  this->damageCount      = -1;
+  memset(this->frames, 0, sizeof(this->frames));
   pw_stream_add_listener(this->stream, &this->streamListener, &streamEvents, NULL);
 
   if (!startStream(this->stream, pipewireNode))
@@ -400,6 +628,8 @@ static void pipewire_free(void)
 {
   DEBUG_ASSERT(this);
   pw_deinit();
+  frameDamage_free(&this->damage);
+  cpuDownsample_free(&this->downsample);
   free(this);
   this = NULL;
 }
@@ -408,26 +638,64 @@ static CaptureResult pipewire_capture(
   unsigned frameBufferIndex,
   FrameBuffer * frame)
 {
-  int result;
+  struct PWFrame * pwFrame = this->frames + frameBufferIndex;
+  CaptureResult    result  = CAPTURE_RESULT_OK;
 
-restart:
-  result = pw_thread_loop_timed_wait(this->threadLoop, 1);
+  pw_thread_loop_lock(this->threadLoop);
 
-  if (this->stop)
-    return CAPTURE_RESULT_REINIT;
+  // the previous frame in this index is still being copied
+  if (pwFrame->buffer)
+  {
+    result = CAPTURE_RESULT_TIMEOUT;
+    goto out;
+  }
+
+  while (!this->pending && !this->stop)
+    if (pw_thread_loop_timed_wait(this->threadLoop, 1) == ETIMEDOUT)
+    {
+      result = CAPTURE_RESULT_TIMEOUT;
+      goto out;
+    }
 
-  if (result == ETIMEDOUT)
-    return CAPTURE_RESULT_TIMEOUT;
+  if (this->stop)
+  {
+    // let the stream thread go, it returns the pending buffer itself
+    if (this->pending)
+      pw_thread_loop_accept(this->threadLoop);
+    result = CAPTURE_RESULT_REINIT;
+    goto out;
+  }
 
   if (this->formatChanged)
   {
     ++this->formatVer;
     this->formatChanged = false;
-    pw_thread_loop_accept(this->threadLoop);
-    goto restart;
+    this->damageCount   = -1;
+
+    // the copy of the previous frame may still be using the damage
+    frameDamage_invalidate(&this->damage);
   }
 
-  return CAPTURE_RESULT_OK;
+  struct spa_data * data = &this->pending->buffer->datas[0];
+  pwFrame->buffer = this->pending;
+  pwFrame->data   = (uint8_t *)data->data + data->chunk->offset;
+  pwFrame->dmaFd  = data->type == SPA_DATA_DmaBuf ? data->fd : -1;
+
+  // the stream thread may change the pitch at any time, keep this frame's
+  pwFrame->pitch  = this->pitch;
+
+  pwFrame->damageCount = this->damageCount;
+  if (this->damageCount > 0)
+    memcpy(pwFrame->damageRects, this->damageRects,
+        this->damageCount * sizeof(*this->damageRects));
+  this->damageCount = 0;
+
+  this->pending = NULL;
+  pw_thread_loop_accept(this->threadLoop);
+
+out:
+  pw_thread_loop_unlock(this->threadLoop);
+  return result;
 }
 
 static CaptureResult pipewire_waitFrame(
@@ -438,26 +706,43 @@ static CaptureResult pipewire_waitFrame(
   if (this->stop)
     return CAPTURE_RESULT_REINIT;
 
-  const unsigned int maxHeight = maxFrameSize / this->pitch;
-  this->dataHeight = min(maxHeight, this->height);
+  const bool toHDR10 = this->hdr16to10 &&
+    this->format == CAPTURE_FMT_RGBA16F;
+  const struct PWFrame * pwFrame = this->frames + frameBufferIndex;
+
+  if (this->downsampling)
+    frameDamage_setupFrame(&this->damage, frame, maxFrameSize, this->format,
+        this->dsWidth, this->dsHeight, this->dsWidth * 4, this->allowRGB24);
+  else if (toHDR10)
+  {
+    // converted as it is copied, the codec would need the frame as sent
+    frame->compressed = false;
+    frameDamage_setupFrame(&this->damage, frame, maxFrameSize,
+        CAPTURE_FMT_RGBA10, this->width, this->height, this->width * 4, false);
+  }
+  else
+    frameDamage_setupFrame(&this->damage, frame, maxFrameSize, this->format,
+        this->width, this->height, pwFrame->pitch, this->allowRGB24);
 
   frame->formatVer    = this->formatVer;
-  frame->format       = this->format;
-  frame->hdr          = this->hdr;
-  frame->hdrPQ        = this->hdrPQ;
+  frame->hdr          = this->hdr   || toHDR10;
+  frame->hdrPQ        = this->hdrPQ || toHDR10;
   frame->screenWidth  = this->width;
   frame->screenHeight = this->height;
-  frame->dataWidth    = this->width;
-  frame->dataHeight   = this->dataHeight;
-  frame->frameWidth   = this->width;
-  frame->frameHeight  = this->height;
-  frame->truncated    = maxHeight < this->dataHeight;
-  frame->pitch        = this->pitch;
-  frame->stride       = this->width;
   frame->rotation     = CAPTURE_ROT_0;
 
-  // TODO: implement damage.
-  frame->damageRectsCount = 0;
+  if (pwFrame->damageCount > 0)
+  {
+    frame->damageRectsCount = pwFrame->damageCount;
+    memcpy(frame->damageRects, pwFrame->damageRects,
+        pwFrame->damageCount * sizeof(*pwFrame->damageRects));
+  }
+  else
+    frame->damageRectsCount = 0;
+
+  if (this->downsampling)
+    cpuDownsample_adjustDamage(frame->damageRects, frame->damageRectsCount,
+        this->width, this->height, this->dsWidth, this->dsHeight);
 
   return CAPTURE_RESULT_OK;
 }
@@ -468,22 +753,68 @@ static CaptureResult pipewire_getFrame(
   const size_t   maxFrameSize,
   CaptureFrame * captureFrame)
 {
-  (void)captureFrame;
-  if (this->stop || !this->frameData)
+  struct PWFrame * pwFrame = this->frames + frameBufferIndex;
+  if (!pwFrame->buffer)
+    return CAPTURE_RESULT_REINIT;
+
+  if (this->stop)
+  {
+    // the stream owns the buffers again once it is disconnected
+    pwFrame->buffer = NULL;
     return CAPTURE_RESULT_REINIT;
+  }
 
-  framebuffer_write(frame, this->frameData,
-      this->dataHeight * this->pitch);
+  // CPU reads of a DMA-BUF must be bracketed for coherency
+  struct dma_buf_sync sync = { .flags = DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ };
+  if (pwFrame->dmaFd >= 0 &&
+      ioctl(pwFrame->dmaFd, DMA_BUF_IOCTL_SYNC, &sync) < 0)
+    DEBUG_WARN("DMA_BUF_IOCTL_SYNC start failed: %s", strerror(errno));
+
+  // reduce to the size promised by waitFrame, from the size it was sent at
+  const void * src      = pwFrame->data;
+  size_t       srcPitch = pwFrame->pitch;
+  bool         ok       = true;
+  if (captureFrame->frameWidth  != captureFrame->screenWidth ||
+      captureFrame->frameHeight != captureFrame->screenHeight)
+  {
+    if (!this->downsample && !cpuDownsample_create(&this->downsample))
+      ok = false;
+    else
+    {
+      src = cpuDownsample_run(this->downsample, pwFrame->data, pwFrame->pitch,
+          captureFrame->screenWidth, captureFrame->screenHeight,
+          captureFrame->frameWidth , captureFrame->frameHeight,
+          captureFrame->damageRects, captureFrame->damageRectsCount);
+      srcPitch = captureFrame->frameWidth * 4;
+      ok       = src;
+    }
+  }
 
-  pw_thread_loop_accept(this->threadLoop);
-  return CAPTURE_RESULT_OK;
+  if (ok)
+    ok = frameDamage_write(&this->damage, frameBufferIndex, frame,
+        maxFrameSize, captureFrame, src, this->format, srcPitch);
+
+  if (pwFrame->dmaFd >= 0)
+  {
+    sync.flags = DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ;
+    ioctl(pwFrame->dmaFd, DMA_BUF_IOCTL_SYNC, &sync);
+  }
+
+  pw_thread_loop_lock(this->threadLoop);
+  pw_stream_queue_buffer(this->stream, pwFrame->buffer);
+  pwFrame->buffer = NULL;
+  pw_thread_loop_unlock(this->threadLoop);
+  return ok ? CAPTURE_RESULT_OK : CAPTURE_RESULT_ERROR;
 }
 
 struct CaptureInterface Capture_pipewire =
 {
   .shortName       = "pipewire",
   .asyncCapture    = false,
+  .canCompress     = true,
+  .pipelined       = true,
   .getName         = pipewire_getName,
+  .initOptions     = pipewire_initOptions,
   .create          = pipewire_create,
   .init            = pipewire_init,
   .stop            = pipewire_stop,
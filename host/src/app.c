@@ -29,6 +29,7 @@
 #include "common/LGMPConfig.h"
 #include "common/crash.h"
 #include "common/thread.h"
+#include "common/event.h"
 #include "common/ivshmem.h"
 #include "common/sysinfo.h"
 #include "common/time.h"
@@ -49,6 +50,9 @@
 #define CONFIG_FILE "looking-glass-host.ini"
 #define POINTER_SHAPE_BUFFERS 3
 
+// how often the frame queue backpressure statistics are reported
+#define BACKPRESSURE_REPORT_NS (10ULL * 1000000000ULL)
+
 static const struct LGMPQueueConfig FRAME_QUEUE_CONFIG =
 {
   .queueID     = LGMP_Q_FRAME,
@@ -104,16 +108,20 @@ struct app
   KVMFRFrame   * frame      [LGMP_Q_FRAME_LEN];
   FrameBuffer  * frameBuffer[LGMP_Q_FRAME_LEN];
 
-  unsigned int   captureIndex;
+  // advanced by the frame thread once a frame has been handed off
+  _Atomic(unsigned int) captureIndex;
   unsigned int   readIndex;
   bool           frameValid;
   uint32_t       frameSerial;
   uint32_t       formatVer;
   uint64_t       captureTime[LGMP_Q_FRAME_LEN];
   unsigned int   captureFormatVer;
+  CaptureFormat  captureFormat;
   bool           hdr;
   bool           hdrPQ;
   bool           hdrMetadata;
+  bool           compressFrames;
+  bool           compressed;
   uint16_t       hdrDisplayPrimary[3][2];
   uint16_t       hdrWhitePoint[2];
   uint32_t       hdrMaxDisplayLuminance;
@@ -130,6 +138,29 @@ struct app
   LGTimer  * lgmpTimer;
   LGThread * frameThread;
   bool threadsStarted;
+
+  // pipelined mode, getFrame runs on the copy thread
+  bool       pipeline;
+  LGThread * copyThread;
+  LGEvent  * copyStartEvent;
+  LGEvent  * copyDoneEvent;
+  _Atomic(bool) copyRun;
+  _Atomic(bool) copyBusy;
+  _Atomic(bool) copyFailed;
+  unsigned     copyIndex;
+  CaptureFrame copyFrame;
+
+  // signalled by the LGMP timer when the frame queue has room
+  LGEvent  * frameQueueEvent;
+
+  // time the frame thread spent waiting on the clients for queue space
+  struct
+  {
+    uint64_t windowStart;
+    unsigned frames, blocked;
+    uint64_t blockedTime, maxBlockedTime;
+  }
+  backpressure;
 };
 
 static struct app app;
@@ -176,6 +207,20 @@ static struct Option options[] =
     .type           = OPTION_TYPE_INT,
     .value.x_int    = 0,
   },
+  {
+    .module         = "app",
+    .name           = "pipelineCopy",
+    .description    = "Copy frames on a separate thread while the next frame is captured",
+    .type           = OPTION_TYPE_BOOL,
+    .value.x_bool   = false,
+  },
+  {
+    .module         = "app",
+    .name           = "compressFrames",
+    .description    = "Losslessly compress frames so they fit in a small IVSHMEM device",
+    .type           = OPTION_TYPE_BOOL,
+    .value.x_bool   = false,
+  },
   {0}
 };
 
@@ -223,28 +268,134 @@ static bool lgmpTimer(void * opaque)
     lgmpHostAckData(app.pointerQueue);
   }
 
+  // messages are only released by lgmpHostProcess, wake any waiting sender
+  if (lgmpHostQueuePending(app.frameQueue) < LGMP_Q_FRAME_LEN)
+    lgSignalEvent(app.frameQueueEvent);
+
   return true;
 }
 
+static void waitFrameQueue(void)
+{
+  const uint64_t now = nanotime();
+  if (!app.backpressure.windowStart)
+    app.backpressure.windowStart = now;
+
+  ++app.backpressure.frames;
+  if (lgmpHostQueuePending(app.frameQueue) == LGMP_Q_FRAME_LEN)
+  {
+    // the deadline lets a state change be noticed if the timer stops
+    while(app.state == APP_STATE_RUNNING &&
+        lgmpHostQueuePending(app.frameQueue) == LGMP_Q_FRAME_LEN)
+      lgWaitEvent(app.frameQueueEvent, 100);
+
+    const uint64_t blocked = nanotime() - now;
+    ++app.backpressure.blocked;
+    app.backpressure.blockedTime += blocked;
+    if (blocked > app.backpressure.maxBlockedTime)
+      app.backpressure.maxBlockedTime = blocked;
+  }
+
+  if (now - app.backpressure.windowStart < BACKPRESSURE_REPORT_NS)
+    return;
+
+  if (app.backpressure.blocked)
+    DEBUG_INFO("Frame queue full for %u of %u frames, blocked %.2f ms "
+        "(max %.2f ms) in the last %.0f s",
+        app.backpressure.blocked, app.backpressure.frames,
+        app.backpressure.blockedTime    / 1e6,
+        app.backpressure.maxBlockedTime / 1e6,
+        (now - app.backpressure.windowStart) / 1e9);
+
+  memset(&app.backpressure, 0, sizeof(app.backpressure));
+  app.backpressure.windowStart = now;
+}
+
+static bool copyFrame(unsigned index, CaptureFrame * frame)
+{
+  KVMFRFrame * fi = app.frame[index];
+
+  const uint64_t copyStart = nanotime();
+  const CaptureResult result = app.iface->getFrame(
+    index,
+    app.frameBuffer[index],
+    app.maxFrameSize,
+    frame);
+  const uint64_t copyEnd = nanotime();
+
+  if (result != CAPTURE_RESULT_OK)
+  {
+    DEBUG_ERROR("Failed to copy the frame");
+    return false;
+  }
+
+  fi->postProcessTime = frame->postProcessTime;
+  const uint64_t totalTime        = copyEnd - copyStart;
+  const bool     splitTimingValid = frame->copyTimingValid &&
+      frame->postProcessTime <= totalTime &&
+      frame->copyTime <= totalTime - frame->postProcessTime &&
+      frame->readyTime <= totalTime - frame->postProcessTime - frame->copyTime;
+  if (!splitTimingValid)
+  {
+    frame->copyTime  = totalTime > frame->postProcessTime ?
+      totalTime - frame->postProcessTime : 0;
+    frame->readyTime = 0;
+  }
+  fi->copyTime        = frame->copyTime;
+  fi->readyTime       = frame->readyTime;
+  fi->timingSerial    = fi->frameSerial;
+  __atomic_store_n(&fi->timingValid, 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+static void waitCopy(void)
+{
+  while(atomic_load(&app.copyBusy))
+    lgWaitEvent(app.copyDoneEvent, 100);
+}
+
+static int copyThread(void * opaque)
+{
+  DEBUG_INFO("Copy thread started");
+
+  // cleared by stopThreads once nothing can submit another copy
+  while(atomic_load(&app.copyRun) || atomic_load(&app.copyBusy))
+  {
+    if (!atomic_load(&app.copyBusy))
+    {
+      lgWaitEvent(app.copyStartEvent, 100);
+      continue;
+    }
+
+    if (!copyFrame(app.copyIndex, &app.copyFrame))
+      atomic_store(&app.copyFailed, true);
+    atomic_store(&app.copyBusy, false);
+    lgSignalEvent(app.copyDoneEvent);
+  }
+
+  DEBUG_INFO("Copy thread stopped");
+  return 0;
+}
+
 static bool sendFrame(CaptureResult result, bool * restart)
 {
   CaptureFrame frame = { 0 };
   bool repeatFrame = false;
+  const unsigned int index =
+    atomic_load_explicit(&app.captureIndex, memory_order_acquire);
 
   //wait until there is room in the queue
-  while(app.state == APP_STATE_RUNNING &&
-      lgmpHostQueuePending(app.frameQueue) == LGMP_Q_FRAME_LEN)
-  {
-    usleep(1);
-    continue;
-  }
+  waitFrameQueue();
 
   if (app.state != APP_STATE_RUNNING)
     return false;
 
   // only wait if the result from the capture was OK
   if (result == CAPTURE_RESULT_OK)
-    result = app.iface->waitFrame(app.captureIndex, &frame, app.maxFrameSize);
+  {
+    frame.compressed = app.compressFrames && app.iface->canCompress;
+    result = app.iface->waitFrame(index, &frame, app.maxFrameSize);
+  }
 
   switch(result)
   {
@@ -291,8 +442,8 @@ static bool sendFrame(CaptureResult result, bool * restart)
     return true;
   }
 
-  KVMFRFrame * fi = app.frame[app.captureIndex];
-  frame.captureTime = app.captureTime[app.captureIndex];
+  KVMFRFrame * fi = app.frame[index];
+  frame.captureTime = app.captureTime[index];
   const uint32_t sdrWhiteLevel = frame.sdrWhiteLevel ?
     frame.sdrWhiteLevel : KVMFR_SDR_WHITE_LEVEL_DEFAULT;
   const bool metadataChanged =
@@ -309,13 +460,17 @@ static bool sendFrame(CaptureResult result, bool * restart)
         frame.hdrMaxFrameAverageLightLevel));
 
   if (!app.frameValid || app.captureFormatVer != frame.formatVer ||
+      app.captureFormat != frame.format ||
       app.hdr != frame.hdr || app.hdrPQ != frame.hdrPQ ||
-      metadataChanged || atomic_load(&app.sdrWhiteLevel) != sdrWhiteLevel)
+      app.compressed != frame.compressed || metadataChanged ||
+      atomic_load(&app.sdrWhiteLevel) != sdrWhiteLevel)
     ++app.formatVer;
 
   app.captureFormatVer = frame.formatVer;
+  app.captureFormat    = frame.format;
   app.hdr              = frame.hdr;
   app.hdrPQ            = frame.hdrPQ;
+  app.compressed       = frame.compressed;
   app.hdrMetadata      = frame.hdrMetadata;
   memcpy(app.hdrDisplayPrimary, frame.hdrDisplayPrimary,
       sizeof(app.hdrDisplayPrimary));
@@ -330,7 +485,8 @@ static bool sendFrame(CaptureResult result, bool * restart)
   KVMFRFrameFlags flags =
     (frame.hdr         ? FRAME_FLAG_HDR          : 0) |
     (frame.hdrPQ       ? FRAME_FLAG_HDR_PQ       : 0) |
-    (frame.hdrMetadata ? FRAME_FLAG_HDR_METADATA : 0);
+    (frame.hdrMetadata ? FRAME_FLAG_HDR_METADATA : 0) |
+    (frame.compressed  ? FRAME_FLAG_COMPRESSED   : 0);
 
   switch(frame.format)
   {
@@ -438,44 +594,45 @@ static bool sendFrame(CaptureResult result, bool * restart)
 
   app.frameValid = true;
 
-  framebuffer_prepare(app.frameBuffer[app.captureIndex]);
+  framebuffer_prepare(app.frameBuffer[index]);
+
+  // the previous frame must be complete before the next is published
+  if (app.pipeline)
+  {
+    waitCopy();
+    if (atomic_exchange(&app.copyFailed, false))
+    {
+      app.frameValid = false;
+      *restart = true;
+      return false;
+    }
+  }
 
   /* we post and then get the frame, this is intentional! */
   if ((status = lgmpHostQueuePost(app.frameQueue, 0,
-    app.frameMemory[app.captureIndex])) != LGMP_OK)
+    app.frameMemory[index])) != LGMP_OK)
   {
     DEBUG_ERROR("%s", lgmpStatusString(status));
     return true;
   }
 
-  const uint64_t copyStart = nanotime();
-  app.iface->getFrame(
-    app.captureIndex,
-    app.frameBuffer[app.captureIndex],
-    app.maxFrameSize,
-    &frame);
-  const uint64_t copyEnd = nanotime();
-
-  fi->postProcessTime = frame.postProcessTime;
-  const uint64_t totalTime        = copyEnd - copyStart;
-  const bool     splitTimingValid = frame.copyTimingValid &&
-      frame.postProcessTime <= totalTime &&
-      frame.copyTime <= totalTime - frame.postProcessTime &&
-      frame.readyTime <= totalTime - frame.postProcessTime - frame.copyTime;
-  if (!splitTimingValid)
+  if (app.pipeline)
   {
-    frame.copyTime  = totalTime > frame.postProcessTime ?
-      totalTime - frame.postProcessTime : 0;
-    frame.readyTime = 0;
+    app.copyIndex = index;
+    memcpy(&app.copyFrame, &frame, sizeof(frame));
+    atomic_store(&app.copyBusy, true);
+    lgSignalEvent(app.copyStartEvent);
+  }
+  else if (!copyFrame(index, &frame))
+  {
+    app.frameValid = false;
+    *restart = true;
+    return false;
   }
-  fi->copyTime        = frame.copyTime;
-  fi->readyTime       = frame.readyTime;
-  fi->timingSerial    = fi->frameSerial;
-  __atomic_store_n(&fi->timingValid, 1, __ATOMIC_RELEASE);
 
-  app.readIndex = app.captureIndex;
-  if (++app.captureIndex == LGMP_Q_FRAME_LEN)
-    app.captureIndex = 0;
+  app.readIndex = index;
+  atomic_store_explicit(&app.captureIndex,
+      index + 1 == LGMP_Q_FRAME_LEN ? 0 : index + 1, memory_order_release);
   return true;
 }
 
@@ -510,6 +667,18 @@ bool startThreads(void)
       return false;
     }
 
+  if (app.pipeline)
+  {
+    atomic_store(&app.copyRun, true);
+    atomic_store(&app.copyBusy, false);
+    atomic_store(&app.copyFailed, false);
+    if (!lgCreateThread("CopyThread", copyThread, NULL, &app.copyThread))
+    {
+      DEBUG_ERROR("Failed to create the copy thread");
+      return false;
+    }
+  }
+
   app.threadsStarted = true;
   return true;
 }
@@ -519,7 +688,12 @@ bool stopThreads(void)
   if (!app.threadsStarted)
     return true;
 
-  app.iface->stop();
+  /* The copy in flight reads from the capture buffers, so it must complete
+   * before stop() releases them. Once the state has left running the frame
+   * thread exits as soon as its bounded waitFrame returns, after which nothing
+   * can start another copy. */
+  if (app.state == APP_STATE_RUNNING)
+    setAppState(APP_STATE_TRANSITION_TO_IDLE);
 
   if (app.iface->asyncCapture && app.frameThread)
   {
@@ -532,6 +706,21 @@ bool stopThreads(void)
     app.frameThread = NULL;
   }
 
+  // the copy thread finishes any frame in flight before it exits
+  if (app.copyThread)
+  {
+    atomic_store(&app.copyRun, false);
+    lgSignalEvent(app.copyStartEvent);
+    if (!lgJoinThread(app.copyThread, NULL))
+    {
+      DEBUG_WARN("Failed to join the copy thread");
+      app.copyThread = NULL;
+      return false;
+    }
+    app.copyThread = NULL;
+  }
+
+  app.iface->stop();
   app.threadsStarted = false;
   return true;
 }
@@ -1001,6 +1190,8 @@ int app_main(int argc, char * argv[])
   app.frameValid        = false;
   app.pointerShapeValid = false;
 
+  app.compressFrames = option_get_bool("app", "compressFrames");
+
   int throttleFps = option_get_int("app", "throttleFPS");
   int throttleUs = throttleFps ? 1000000 / throttleFps : 0;
   uint64_t previousFrameTime = 0;
@@ -1017,9 +1208,9 @@ int app_main(int argc, char * argv[])
       }
       else
       {
-        /* do not try to init deprecated interfaces unless they are explicity
-        selected in the host configuration */
-        if (CaptureInterfaces[i]->deprecated)
+        /* do not try to init deprecated or manual interfaces unless they are
+        explicity selected in the host configuration */
+        if (CaptureInterfaces[i]->deprecated || CaptureInterfaces[i]->manual)
           continue;
       }
 
@@ -1058,6 +1249,25 @@ int app_main(int argc, char * argv[])
     DEBUG_INFO("Using            : %s", iface->getName());
     DEBUG_INFO("Capture Method   : %s", iface->asyncCapture ?
         "Asynchronous" : "Synchronous");
+
+    if (option_get_bool("app", "pipelineCopy"))
+    {
+      if (iface->pipelined)
+        app.pipeline = true;
+      else
+        DEBUG_WARN("%s does not support pipelined copies", iface->getName());
+    }
+    DEBUG_INFO("Pipelined Copy   : %s", app.pipeline ? "Yes" : "No");
+  }
+
+  app.frameQueueEvent = lgCreateEvent(true, 0);
+  app.copyStartEvent  = lgCreateEvent(true, 0);
+  app.copyDoneEvent   = lgCreateEvent(true, 0);
+  if (!app.frameQueueEvent || !app.copyStartEvent || !app.copyDoneEvent)
+  {
+    DEBUG_ERROR("Failed to create the frame thread events");
+    exitcode = LG_HOST_EXIT_FATAL;
+    goto fail_ivshmem;
   }
 
   if (!lgmpSetup(&shmDev))
@@ -1144,11 +1354,13 @@ int app_main(int argc, char * argv[])
         }
 
         const uint64_t captureStartTime = nanotime();
+        const unsigned int captureIndex =
+          atomic_load_explicit(&app.captureIndex, memory_order_acquire);
 
         const CaptureResult result = app.iface->capture(
-          app.captureIndex, app.frameBuffer[app.captureIndex]);
+          captureIndex, app.frameBuffer[captureIndex]);
 
-        app.captureTime[app.captureIndex] = nanotime() - captureStartTime;
+        app.captureTime[captureIndex] = nanotime() - captureStartTime;
 
         if (likely(result == CAPTURE_RESULT_OK))
           previousFrameTime = captureStartTime / 1000;
@@ -1210,6 +1422,16 @@ fail_lgmp:
   lgmpShutdown();
 
 fail_ivshmem:
+  {
+    LGEvent ** events[] =
+      { &app.frameQueueEvent, &app.copyStartEvent, &app.copyDoneEvent };
+    for(unsigned i = 0; i < ARRAY_LENGTH(events); ++i)
+      if (*events[i])
+      {
+        lgFreeEvent(*events[i]);
+        *events[i] = NULL;
+      }
+  }
   ivshmemClose(&shmDev);
   ivshmemFree(&shmDev);
   DEBUG_INFO("Host application exited");
@@ -0,0 +1,476 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "cpu_downsample.h"
+#include "downsample_parser.h"
+#include "common/debug.h"
+#include "common/util.h"
+#include "common/cpuinfo.h"
+#include "common/thread.h"
+#include "common/event.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <emmintrin.h>
+
+// bilinear weights are 7-bit so the 16-bit products can not overflow
+#define WEIGHT_BITS 7
+#define WEIGHT_ONE  (1 << WEIGHT_BITS)
+
+typedef struct DSBand
+{
+  // the CPUDownsample the band belongs to
+  CPUDownsample * ds;
+
+  LGThread * thread;
+  LGEvent  * start;
+  LGEvent  * done;
+
+  unsigned   y0, y1;
+
+  // 16-bit row scratch, srcWidth * 4 entries
+  uint16_t * temp;
+}
+DSBand;
+
+struct CPUDownsample
+{
+  _Atomic(bool) running;
+  unsigned      bands;
+  DSBand        band[CPU_DOWNSAMPLE_MAX_THREADS];
+
+  // the current layout
+  unsigned srcWidth, srcHeight, dstWidth, dstHeight;
+  bool     box;
+  unsigned fx, fy;
+  float    boxScale;
+
+  // bilinear source column/row and weight per output column/row
+  unsigned * colX;
+  uint8_t  * colW;
+  unsigned * rowY;
+  uint8_t  * rowW;
+
+  uint8_t * dst;
+  bool      valid;
+
+  // the current job
+  const uint8_t         * src;
+  size_t                  srcPitch;
+  const FrameDamageRect * rects;
+  int                     count;
+};
+
+bool cpuDownsample_match(Vector * rules, CaptureFormat format,
+    unsigned width, unsigned height, unsigned * dstWidth, unsigned * dstHeight)
+{
+  DownsampleRule * rule = downsampleRule_match(rules, width, height);
+  if (!rule || (rule->targetX == width && rule->targetY == height))
+    return false;
+
+  if (!rule->targetX || !rule->targetY)
+  {
+    DEBUG_WARN("Ignoring the downsample rule with an empty target");
+    return false;
+  }
+
+  // the reducers treat the pixel as four independent 8-bit channels
+  if (format != CAPTURE_FMT_BGRA && format != CAPTURE_FMT_RGBA)
+  {
+    DEBUG_WARN("Downsampling is not supported for the %s format",
+        format == CAPTURE_FMT_RGBA10 ? "RGBA10" : "RGBA16F");
+    return false;
+  }
+
+  *dstWidth  = rule->targetX;
+  *dstHeight = rule->targetY;
+  return true;
+}
+
+void cpuDownsample_adjustDamage(FrameDamageRect * rects, uint32_t count,
+    unsigned srcWidth, unsigned srcHeight,
+    unsigned dstWidth, unsigned dstHeight)
+{
+  const double scaleX = (double)dstWidth  / srcWidth;
+  const double scaleY = (double)dstHeight / srcHeight;
+
+  for(FrameDamageRect * rect = rects; rect < rects + count; ++rect)
+  {
+    const unsigned width  = ceil(rect->width  * scaleX);
+    const unsigned height = ceil(rect->height * scaleY);
+    unsigned left   = floor(rect->x * scaleX);
+    unsigned top    = floor(rect->y * scaleY);
+    unsigned right  = min(dstWidth , left + width );
+    unsigned bottom = min(dstHeight, top  + height);
+
+    // enlarge the rect to cover the taps that reach into the neighbours
+    if (left   > 0        ) left   -= 1;
+    if (top    > 0        ) top    -= 1;
+    if (right  < dstWidth ) right  += 1;
+    if (bottom < dstHeight) bottom += 1;
+
+    rect->x      = left;
+    rect->y      = top;
+    rect->width  = right  - left;
+    rect->height = bottom - top;
+  }
+}
+
+/* average fx x fy blocks of the source into pixels x to x + w of row y */
+static void reduceBox(CPUDownsample * ds, uint16_t * acc,
+    unsigned y, unsigned x, unsigned w)
+{
+  const unsigned n    = w * ds->fx * 4;
+  const __m128i  zero = _mm_setzero_si128();
+  memset(acc, 0, n * sizeof(*acc));
+
+  // sum the rows of the blocks into 16-bit columns
+  const uint8_t * row = ds->src + (size_t)y * ds->fy * ds->srcPitch +
+    x * ds->fx * 4;
+  for(unsigned r = 0; r < ds->fy; ++r, row += ds->srcPitch)
+  {
+    unsigned i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+      const __m128i v  = _mm_loadu_si128((const __m128i *)(row + i));
+      __m128i     * a  = (__m128i *)(acc + i);
+      _mm_storeu_si128(a + 0, _mm_add_epi16(_mm_loadu_si128(a + 0),
+            _mm_unpacklo_epi8(v, zero)));
+      _mm_storeu_si128(a + 1, _mm_add_epi16(_mm_loadu_si128(a + 1),
+            _mm_unpackhi_epi8(v, zero)));
+    }
+    for(; i < n; ++i)
+      acc[i] += row[i];
+  }
+
+  // then the columns of each block, one pixel per register
+  const __m128 scale = _mm_set1_ps(ds->boxScale);
+  uint8_t * out = ds->dst + ((size_t)y * ds->dstWidth + x) * 4;
+  for(unsigned ox = 0; ox < w; ++ox, out += 4)
+  {
+    const uint16_t * a   = acc + ox * ds->fx * 4;
+    __m128i          sum = zero;
+    for(unsigned k = 0; k < ds->fx; ++k, a += 4)
+      sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(
+            _mm_loadl_epi64((const __m128i *)a), zero));
+
+    const __m128i v = _mm_cvtps_epi32(
+        _mm_mul_ps(_mm_cvtepi32_ps(sum), scale));
+    const __m128i p = _mm_packus_epi16(_mm_packs_epi32(v, zero), zero);
+    *(uint32_t *)out = (uint32_t)_mm_cvtsi128_si32(p);
+  }
+}
+
+/* sample pixels x to x + w of row y from the four nearest source pixels */
+static void reduceBilinear(CPUDownsample * ds, uint16_t * temp,
+    unsigned y, unsigned x, unsigned w)
+{
+  const unsigned c0 = ds->colX[x];
+  const unsigned c1 = min(ds->colX[x + w - 1] + 1, ds->srcWidth - 1);
+  const unsigned n  = (c1 - c0 + 1) * 4;
+
+  // blend the two source rows, a + (b - a) * w, into temp
+  const unsigned  sy = ds->rowY[y];
+  const uint8_t * a  = ds->src + (size_t)sy * ds->srcPitch + c0 * 4;
+  const uint8_t * b  = ds->src +
+    (size_t)min(sy + 1, ds->srcHeight - 1) * ds->srcPitch + c0 * 4;
+  const int       wy = ds->rowW[y];
+
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i vwy  = _mm_set1_epi16(wy);
+  unsigned i = 0;
+  for(; i + 16 <= n; i += 16)
+  {
+    const __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    const __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+    const __m128i al = _mm_unpacklo_epi8(va, zero);
+    const __m128i ah = _mm_unpackhi_epi8(va, zero);
+    const __m128i dl = _mm_sub_epi16(_mm_unpacklo_epi8(vb, zero), al);
+    const __m128i dh = _mm_sub_epi16(_mm_unpackhi_epi8(vb, zero), ah);
+
+    __m128i * t = (__m128i *)(temp + i);
+    _mm_storeu_si128(t + 0, _mm_add_epi16(al,
+          _mm_srai_epi16(_mm_mullo_epi16(dl, vwy), WEIGHT_BITS)));
+    _mm_storeu_si128(t + 1, _mm_add_epi16(ah,
+          _mm_srai_epi16(_mm_mullo_epi16(dh, vwy), WEIGHT_BITS)));
+  }
+  for(; i < n; ++i)
+    temp[i] = a[i] + (((b[i] - a[i]) * wy) >> WEIGHT_BITS);
+
+  // then the two columns of each output pixel
+  uint8_t * out = ds->dst + ((size_t)y * ds->dstWidth + x) * 4;
+  for(unsigned ox = x; ox < x + w; ++ox, out += 4)
+  {
+    const unsigned sx  = ds->colX[ox];
+    const unsigned sx1 = min(sx + 1, ds->srcWidth - 1);
+    const __m128i  p   =
+      _mm_loadl_epi64((const __m128i *)(temp + (sx  - c0) * 4));
+    const __m128i  q   =
+      _mm_loadl_epi64((const __m128i *)(temp + (sx1 - c0) * 4));
+    const __m128i  v   = _mm_add_epi16(p, _mm_srai_epi16(_mm_mullo_epi16(
+            _mm_sub_epi16(q, p), _mm_set1_epi16(ds->colW[ox])), WEIGHT_BITS));
+    *(uint32_t *)out = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(v, zero));
+  }
+}
+
+static void reduceBand(DSBand * band)
+{
+  CPUDownsample * ds = band->ds;
+  for(unsigned y = band->y0; y < band->y1; ++y)
+  {
+    if (ds->count <= 0)
+    {
+      if (ds->box)
+        reduceBox(ds, band->temp, y, 0, ds->dstWidth);
+      else
+        reduceBilinear(ds, band->temp, y, 0, ds->dstWidth);
+      continue;
+    }
+
+    for(int i = 0; i < ds->count; ++i)
+    {
+      const FrameDamageRect * r = ds->rects + i;
+      if (y < r->y || y - r->y >= r->height || r->x >= ds->dstWidth)
+        continue;
+
+      const unsigned w = min(r->width, ds->dstWidth - r->x);
+      if (!w)
+        continue;
+
+      if (ds->box)
+        reduceBox(ds, band->temp, y, r->x, w);
+      else
+        reduceBilinear(ds, band->temp, y, r->x, w);
+    }
+  }
+}
+
+static int bandThread(void * opaque)
+{
+  DSBand * band = opaque;
+  for(;;)
+  {
+    lgWaitEvent(band->start, TIMEOUT_INFINITE);
+    if (!atomic_load(&band->ds->running))
+      break;
+
+    reduceBand(band);
+    lgSignalEvent(band->done);
+  }
+
+  return 0;
+}
+
+bool cpuDownsample_create(CPUDownsample ** result)
+{
+  CPUDownsample * ds = calloc(1, sizeof(*ds));
+  if (!ds)
+  {
+    DEBUG_ERROR("out of memory");
+    return false;
+  }
+
+  // leave some cores for the capture and the guest
+  int cores = 0;
+  cpuInfo_get(NULL, 0, NULL, &cores, NULL);
+  ds->bands = min(max(cores / 2, 1), CPU_DOWNSAMPLE_MAX_THREADS);
+
+  atomic_store(&ds->running, true);
+  for(unsigned i = 0; i < ds->bands; ++i)
+  {
+    DSBand * band = ds->band + i;
+    band->ds = ds;
+
+    // the calling thread always takes the first band
+    if (i == 0)
+      continue;
+
+    if (!(band->start = lgCreateEvent(true, 0)) ||
+        !(band->done  = lgCreateEvent(true, 0)))
+    {
+      DEBUG_ERROR("Failed to create the downsample band events");
+      goto fail;
+    }
+
+    if (!lgCreateThread("DownsampleBand", bandThread, band, &band->thread))
+    {
+      DEBUG_ERROR("Failed to create the downsample band thread");
+      goto fail;
+    }
+  }
+
+  *result = ds;
+  return true;
+
+fail:
+  cpuDownsample_free(&ds);
+  return false;
+}
+
+void cpuDownsample_free(CPUDownsample ** ds)
+{
+  if (!*ds)
+    return;
+
+  CPUDownsample * this = *ds;
+  atomic_store(&this->running, false);
+  for(unsigned i = 0; i < this->bands; ++i)
+  {
+    DSBand * band = this->band + i;
+    if (band->thread)
+    {
+      lgSignalEvent(band->start);
+      lgJoinThread(band->thread, NULL);
+    }
+
+    if (band->start)
+      lgFreeEvent(band->start);
+    if (band->done)
+      lgFreeEvent(band->done);
+    free(band->temp);
+  }
+
+  free(this->colX);
+  free(this->colW);
+  free(this->rowY);
+  free(this->rowW);
+  free(this->dst);
+  free(this);
+  *ds = NULL;
+}
+
+/* position `i` of `dstSize` in a source of `srcSize`, split into the first of
+ * the two taps and the 7-bit weight of the second */
+static void bilinearTap(unsigned i, unsigned srcSize, unsigned dstSize,
+    unsigned * tap, uint8_t * weight)
+{
+  const double s = max((i + 0.5) * srcSize / dstSize - 0.5, 0.0);
+  *tap    = min((unsigned)s, srcSize - 1);
+  *weight = (uint8_t)lround((s - *tap) * WEIGHT_ONE);
+}
+
+static bool configure(CPUDownsample * ds, unsigned srcWidth,
+    unsigned srcHeight, unsigned dstWidth, unsigned dstHeight)
+{
+  free(ds->colX); free(ds->colW);
+  free(ds->rowY); free(ds->rowW);
+  free(ds->dst);
+  for(unsigned i = 0; i < ds->bands; ++i)
+  {
+    free(ds->band[i].temp);
+    ds->band[i].temp = NULL;
+  }
+
+  ds->srcWidth  = srcWidth;
+  ds->srcHeight = srcHeight;
+  ds->dstWidth  = dstWidth;
+  ds->dstHeight = dstHeight;
+  ds->valid     = false;
+
+  // whole blocks are averaged, as long as the column sums fit in 16 bits
+  ds->fx  = srcWidth  / dstWidth;
+  ds->fy  = srcHeight / dstHeight;
+  ds->box =
+    ds->fx && ds->fy &&
+    ds->fx * dstWidth  == srcWidth  &&
+    ds->fy * dstHeight == srcHeight &&
+    ds->fy * 255 <= UINT16_MAX;
+  ds->boxScale = ds->box ? 1.0f / (ds->fx * ds->fy) : 0.0f;
+
+  ds->colX = malloc(dstWidth  * sizeof(*ds->colX));
+  ds->colW = malloc(dstWidth  * sizeof(*ds->colW));
+  ds->rowY = malloc(dstHeight * sizeof(*ds->rowY));
+  ds->rowW = malloc(dstHeight * sizeof(*ds->rowW));
+  ds->dst  = malloc((size_t)dstWidth * dstHeight * 4);
+  if (!ds->colX || !ds->colW || !ds->rowY || !ds->rowW || !ds->dst)
+    goto fail;
+
+  for(unsigned i = 0; i < ds->bands; ++i)
+    if (!(ds->band[i].temp = malloc(srcWidth * 4 * sizeof(uint16_t))))
+      goto fail;
+
+  for(unsigned x = 0; x < dstWidth; ++x)
+    bilinearTap(x, srcWidth, dstWidth, ds->colX + x, ds->colW + x);
+  for(unsigned y = 0; y < dstHeight; ++y)
+    bilinearTap(y, srcHeight, dstHeight, ds->rowY + y, ds->rowW + y);
+
+  DEBUG_INFO("Downsampling %ux%u to %ux%u (%s, %u thread%s)",
+      srcWidth, srcHeight, dstWidth, dstHeight,
+      ds->box ? "box" : "bilinear", ds->bands, ds->bands > 1 ? "s" : "");
+  return true;
+
+fail:
+  DEBUG_ERROR("out of memory");
+  ds->srcWidth = 0;
+  return false;
+}
+
+const uint8_t * cpuDownsample_run(CPUDownsample * ds,
+    const void * src, size_t srcPitch, unsigned srcWidth, unsigned srcHeight,
+    unsigned dstWidth, unsigned dstHeight,
+    const FrameDamageRect * rects, int count)
+{
+  if (ds->srcWidth  != srcWidth  || ds->srcHeight != srcHeight ||
+      ds->dstWidth  != dstWidth  || ds->dstHeight != dstHeight)
+    if (!configure(ds, srcWidth, srcHeight, dstWidth, dstHeight))
+      return NULL;
+
+  ds->src      = src;
+  ds->srcPitch = srcPitch;
+  ds->rects    = rects;
+  ds->count    = ds->valid ? count : 0;
+
+  // only the rows with damage need to be split up
+  unsigned y0 = 0, y1 = dstHeight;
+  if (ds->count > 0)
+  {
+    y0 = dstHeight;
+    y1 = 0;
+    for(int i = 0; i < count; ++i)
+    {
+      y0 = min(y0, rects[i].y);
+      y1 = max(y1, min(rects[i].y + rects[i].height, dstHeight));
+    }
+    if (y0 >= y1)
+      return ds->dst;
+  }
+
+  const unsigned per  = (y1 - y0 + ds->bands - 1) / ds->bands;
+  unsigned       used = 0;
+  for(unsigned i = 0; i < ds->bands && y0 < y1; ++i, ++used)
+  {
+    DSBand * band = ds->band + i;
+    band->y0 = y0;
+    band->y1 = min(y0 + per, y1);
+    y0       = band->y1;
+
+    if (i > 0)
+      lgSignalEvent(band->start);
+  }
+
+  reduceBand(ds->band);
+  for(unsigned i = 1; i < used; ++i)
+    lgWaitEvent(ds->band[i].done, TIMEOUT_INFINITE);
+
+  ds->valid = true;
+  return ds->dst;
+}
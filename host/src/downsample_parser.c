@@ -110,7 +110,7 @@ DownsampleRule * downsampleRule_match(Vector * rules, int x, int y)
   }
 
   if (match)
-    DEBUG_INFO("Matched downsample rule %d", rule->id);
+    DEBUG_INFO("Matched downsample rule %d", match->id);
 
   return match;
 }
@@ -0,0 +1,250 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "frame_damage.h"
+#include "common/debug.h"
+#include "common/rgb24.h"
+#include "common/hdr10.h"
+#include "common/time.h"
+#include "common/util.h"
+
+#include <string.h>
+
+/* plain and packed writes timed before deciding if packing is worthwhile */
+#define FRAMEDAMAGE_PROBE_WRITES 60
+
+static inline uint64_t frameDamage_codecKey(unsigned pitch, unsigned height)
+{
+  return (uint64_t)pitch << 32 | height;
+}
+
+void frameDamage_reset(FrameDamage * damage)
+{
+  for(int i = 0; i < LGMP_Q_FRAME_LEN; ++i)
+    damage->count[i] = -1;
+  damage->pitch  = 0;
+  damage->height = 0;
+  damage->format = CAPTURE_FMT_MAX;
+}
+
+void frameDamage_invalidate(FrameDamage * damage)
+{
+  atomic_store(&damage->invalid, true);
+}
+
+void frameDamage_free(FrameDamage * damage)
+{
+  frameCodec_free(&damage->codec);
+}
+
+static bool frameDamage_shouldPack(FrameDamage * damage)
+{
+  if (damage->packDecided)
+    return damage->packWins;
+
+  // time some plain writes, then some packed ones
+  if (atomic_load(&damage->copyWrites) < FRAMEDAMAGE_PROBE_WRITES)
+    return false;
+
+  if (atomic_load(&damage->packWrites) < FRAMEDAMAGE_PROBE_WRITES)
+    return true;
+
+  // both are per byte of source, the packed writes output a quarter less
+  const double copyRate = atomic_load(&damage->copyNs) * 1048576.0 /
+    max(atomic_load(&damage->copyBytes), (uint64_t)1);
+  const double packRate = atomic_load(&damage->packNs) * 1048576.0 /
+    max(atomic_load(&damage->packBytes), (uint64_t)1);
+
+  damage->packDecided = true;
+  damage->packWins    = packRate <= copyRate;
+  if (damage->packWins)
+    DEBUG_INFO("Packing frames to 24-bit (%.0f vs %.0f ns/MiB)",
+        packRate, copyRate);
+  else
+    DEBUG_INFO("Packing to 24-bit is slower than copying "
+        "(%.0f vs %.0f ns/MiB), disabled", packRate, copyRate);
+
+  return damage->packWins;
+}
+
+void frameDamage_setupFrame(FrameDamage * damage, CaptureFrame * frame,
+    size_t maxFrameSize, CaptureFormat format, unsigned width,
+    unsigned height, unsigned pitch, bool allowRGB24)
+{
+  /* the frame header is sent before the rows are coded, so a coded frame that
+   * does not fit can not report the rows it is missing. Once a size has failed
+   * to fit send it raw, which is truncated up front */
+  frame->compressed = frame->compressed && frameCodec_supported(pitch) &&
+    atomic_load(&damage->codecOverflow) != frameDamage_codecKey(pitch, height);
+
+  const bool pack = allowRGB24 && !frame->compressed &&
+    (format == CAPTURE_FMT_BGRA || format == CAPTURE_FMT_RGBA) &&
+    frameDamage_shouldPack(damage);
+
+  if (pack)
+  {
+    // 24-bit pixels carried in 32-bit texels, the same layout as D12
+    frame->format    = CAPTURE_FMT_BGR_32;
+    frame->dataWidth = ALIGN_TO(rgb24_texels(width), 64);
+    frame->pitch     = frame->dataWidth * 4;
+    frame->stride    = frame->dataWidth;
+  }
+  else
+  {
+    frame->format    = format;
+    frame->dataWidth = width;
+    frame->pitch     = pitch;
+    frame->stride    = width;
+  }
+
+  // a compressed frame is expected to fit, frameDamage_write checks it did
+  const unsigned maxHeight = frame->compressed ?
+    height : maxFrameSize / frame->pitch;
+
+  frame->dataHeight  = min(maxHeight, height);
+  frame->frameWidth  = width;
+  frame->frameHeight = height;
+  frame->truncated   = maxHeight < height;
+}
+
+bool frameDamage_write(FrameDamage * damage, unsigned index,
+    FrameBuffer * frame, size_t maxSize, const CaptureFrame * capture,
+    const void * src, CaptureFormat srcFormat, size_t srcPitch)
+{
+  DEBUG_ASSERT(index < LGMP_Q_FRAME_LEN);
+
+  // any change of layout invalidates what the slots hold
+  if (atomic_exchange(&damage->invalid, false) ||
+      damage->pitch  != capture->pitch      ||
+      damage->height != capture->dataHeight ||
+      damage->format != capture->format)
+  {
+    frameDamage_reset(damage);
+    damage->pitch  = capture->pitch;
+    damage->height = capture->dataHeight;
+    damage->format = capture->format;
+  }
+
+  if (capture->compressed)
+  {
+    // a coded frame can not be patched, any raw write after it must be full
+    for(int i = 0; i < LGMP_Q_FRAME_LEN; ++i)
+      damage->count[i] = -1;
+
+    if (!damage->codec && !frameCodec_create(&damage->codec))
+      return false;
+
+    size_t coded;
+    if (!frameCodec_encode(damage->codec, frame, maxSize, src, srcPitch,
+          capture->dataHeight, &coded))
+      return false;
+
+    // the client clears the missing rows, only this frame is affected
+    const uint64_t key = frameDamage_codecKey(capture->pitch,
+        capture->dataHeight);
+    if (coded < capture->dataHeight &&
+        atomic_exchange(&damage->codecOverflow, key) != key)
+      DEBUG_WARN("A %ux%u compressed frame did not fit in %zu bytes, only %zu "
+          "rows were sent, frames of this size will be sent uncompressed",
+          capture->frameWidth, capture->dataHeight, maxSize, coded);
+    return true;
+  }
+
+  const int newCount = capture->damageRectsCount;
+  int *     count    = &damage->count[index];
+
+  if (newCount == 0 || *count < 0 ||
+      *count + newCount > KVMFR_MAX_DAMAGE_RECTS)
+    *count = 0;
+  else
+  {
+    memcpy(damage->rects[index] + *count, capture->damageRects,
+        newCount * sizeof(FrameDamageRect));
+    *count += newCount;
+  }
+
+  const int  bpp    = srcFormat == CAPTURE_FMT_RGBA16F ? 8 : 4;
+  const bool packed = capture->format == CAPTURE_FMT_BGR_32;
+  const bool timed  =
+    (srcFormat == CAPTURE_FMT_BGRA || srcFormat == CAPTURE_FMT_RGBA) &&
+    atomic_load(packed ? &damage->packWrites : &damage->copyWrites) <
+      FRAMEDAMAGE_PROBE_WRITES;
+  const uint64_t start = timed ? nanotime() : 0;
+
+  if (packed)
+    rgb24_pack(frame, damage->rects[index], *count, src, srcPitch,
+        capture->frameWidth, capture->dataHeight, capture->pitch,
+        srcFormat == CAPTURE_FMT_RGBA);
+  else if (srcFormat == CAPTURE_FMT_RGBA16F &&
+      capture->format == CAPTURE_FMT_RGBA10)
+    hdr10_convert(frame, damage->rects[index], *count, src, srcPitch,
+        capture->frameWidth, capture->dataHeight, capture->pitch);
+  else
+  {
+    DEBUG_ASSERT(srcPitch == capture->pitch);
+    if (!framebuffer_write_rects(frame, damage->rects[index], *count, bpp,
+          src, capture->pitch, capture->dataHeight))
+      return false;
+  }
+
+  if (timed)
+  {
+    const uint64_t ns = nanotime() - start;
+    uint64_t bytes = 0;
+    if (*count == 0)
+      bytes = (uint64_t)capture->frameWidth * capture->dataHeight * bpp;
+    else
+      for(int i = 0; i < *count; ++i)
+        bytes += (uint64_t)damage->rects[index][i].width *
+          damage->rects[index][i].height * bpp;
+
+    if (packed)
+    {
+      atomic_fetch_add(&damage->packNs   , ns   );
+      atomic_fetch_add(&damage->packBytes, bytes);
+      atomic_fetch_add(&damage->packWrites, 1   );
+    }
+    else
+    {
+      atomic_fetch_add(&damage->copyNs   , ns   );
+      atomic_fetch_add(&damage->copyBytes, bytes);
+      atomic_fetch_add(&damage->copyWrites, 1   );
+    }
+  }
+
+  // this slot is now current, the others have missed this frame's damage
+  for(int i = 0; i < LGMP_Q_FRAME_LEN; ++i)
+  {
+    int * other = &damage->count[i];
+    if (i == (int)index)
+      *other = 0;
+    else if (newCount > 0 && *other >= 0 &&
+        *other + newCount <= KVMFR_MAX_DAMAGE_RECTS)
+    {
+      memcpy(damage->rects[i] + *other, capture->damageRects,
+          newCount * sizeof(FrameDamageRect));
+      *other += newCount;
+    }
+    else
+      *other = -1;
+  }
+
+  return true;
+}
@@ -36,6 +36,7 @@
 struct LGMPBuffer
 {
   volatile uint32_t wp;
+  volatile uint32_t waiters; // Linux readers only, see common/framebuffer.h
   uint8_t data[0];
 };
 #pragma warning(pop)
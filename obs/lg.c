@@ -32,6 +32,7 @@
 #include <common/KVMFR.h>
 #include <common/LGMPConfig.h>
 #include <common/framebuffer.h>
+#include <common/framecodec.h>
 #include <lgmp/client.h>
 
 #include <stdio.h>
@@ -308,6 +309,15 @@ static bool lgFrameTimingReady(const KVMFRFrame * frame)
     frame->timingSerial == frame->frameSerial;
 }
 
+/* compressed frames have no known final size, the decoder waits per block */
+static bool lgFrameWait(const FrameBuffer * fb, const KVMFRFrame * frame)
+{
+  if (frame->flags & FRAME_FLAG_COMPRESSED)
+    return true;
+
+  return framebuffer_wait(fb, (size_t)frame->dataHeight * frame->pitch);
+}
+
 static bool lgFramePhaseIdentity(const LGFrameMessage * message,
     const KVMFRFrame * frame, uint32_t * generation)
 {
@@ -711,8 +721,7 @@ static void * frameThread(void * data)
       {
         const FrameBuffer * fb =
           (const FrameBuffer *)((const uint8_t *)frame + frame->offset);
-        if (framebuffer_wait(
-              fb, (size_t)frame->dataHeight * frame->pitch))
+        if (lgFrameWait(fb, frame))
         {
           now = os_gettime_ns();
           uint32_t generation;
@@ -1250,6 +1259,14 @@ static void lgFormatInit(LGPlugin * this, const KVMFRFrame * frame,
 
   this->dataWidth     = frame->dataWidth;
   this->unpack        = false;
+
+#if LIBOBS_API_MAJOR_VER >= 27
+  if (this->dmabuf && (frame->flags & FRAME_FLAG_COMPRESSED))
+  {
+    puts("Compressed frames can not be imported, falling back to CPU upload");
+    this->dmabuf = false;
+  }
+#endif
   this->hdr           = frame->flags & FRAME_FLAG_HDR;
   this->hdrPQ         = frame->flags & FRAME_FLAG_HDR_PQ;
   /* Keep the white level supplied with the cursor message. The frame value
@@ -1604,8 +1621,7 @@ static void lgVideoTick(void * data, float seconds)
   bool frameComplete = false;
   if (frameMessage.owner)
   {
-    frameComplete = framebuffer_wait(
-      fb, (size_t)frame->dataHeight * frame->pitch);
+    frameComplete = lgFrameWait(fb, frame);
     if (!frameComplete)
     {
       lgmpClientMessageDone(frameMessage.queue);
@@ -1702,15 +1718,26 @@ static void lgVideoTick(void * data, float seconds)
     return;
   }
 
-  framebuffer_read(
-      fb,
-      this->texData   , // dst
-      this->linesize  , // dstpitch
-      this->dataHeight, // height
-      this->dataWidth , // width
-      this->bpp       , // bpp
-      frame->pitch
-  );
+  if (frame->flags & FRAME_FLAG_COMPRESSED)
+    frameCodec_decode(
+        fb,
+        frameMessage.msg.size - frame->offset - sizeof(FrameBuffer),
+        this->texData   , // dst
+        this->linesize  , // dstpitch
+        this->dataHeight, // height
+        frame->pitch    ,
+        NULL
+    );
+  else
+    framebuffer_read(
+        fb,
+        this->texData   , // dst
+        this->linesize  , // dstpitch
+        this->dataHeight, // height
+        this->dataWidth , // width
+        this->bpp       , // bpp
+        frame->pitch
+    );
 
   lgmpClientMessageDone(frameMessage.queue);
   os_sem_post(this->frameSem);
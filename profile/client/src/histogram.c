@@ -0,0 +1,95 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include "histogram.h"
+
+#include <string.h>
+
+#define SUB_COUNT (1U << HISTOGRAM_SUB_BITS)
+
+static unsigned bucketIndex(uint64_t value)
+{
+  if (value < 2 * SUB_COUNT)
+    return value;
+
+  // keep the top HISTOGRAM_SUB_BITS + 1 bits, the leading one selects the half
+  const unsigned shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS;
+  return ((shift + 1) << HISTOGRAM_SUB_BITS) + (value >> shift) - SUB_COUNT;
+}
+
+/* the middle of the range of values a bucket holds */
+static uint64_t bucketValue(unsigned index)
+{
+  if (index < 2 * SUB_COUNT)
+    return index;
+
+  const unsigned shift = (index >> HISTOGRAM_SUB_BITS) - 1;
+  const uint64_t sub   = (index & (SUB_COUNT - 1)) | SUB_COUNT;
+  return (sub << shift) + ((1ULL << shift) >> 1);
+}
+
+void histogram_reset(Histogram * h)
+{
+  memset(h, 0, sizeof(*h));
+}
+
+void histogram_record(Histogram * h, uint64_t value)
+{
+  if (value >= 1ULL << HISTOGRAM_MAX_LOG2)
+    value = (1ULL << HISTOGRAM_MAX_LOG2) - 1;
+
+  if (!h->count || value < h->min)
+    h->min = value;
+  if (value > h->max)
+    h->max = value;
+
+  ++h->count;
+  h->total += value;
+  ++h->buckets[bucketIndex(value)];
+}
+
+uint64_t histogram_percentile(const Histogram * h, double percentile)
+{
+  if (!h->count)
+    return 0;
+
+  uint64_t rank = (uint64_t)(percentile / 100.0 * h->count + 0.5);
+  if (rank < 1)
+    rank = 1;
+
+  uint64_t seen = 0;
+  for(unsigned i = 0; i < HISTOGRAM_BUCKETS; ++i)
+  {
+    seen += h->buckets[i];
+    if (seen >= rank)
+    {
+      // never report beyond what was actually recorded
+      const uint64_t value = bucketValue(i);
+      return value < h->min ? h->min : value > h->max ? h->max : value;
+    }
+  }
+
+  return h->max;
+}
+
+double histogram_mean(const Histogram * h)
+{
+  return h->count ? h->total / h->count : 0.0;
+}
@@ -0,0 +1,57 @@
+/**
+ * Looking Glass
+ * Copyright © 2017-2026 The Looking Glass Authors
+ * https://looking-glass.io
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef _H_PROFILE_HISTOGRAM_
+#define _H_PROFILE_HISTOGRAM_
+
+#include <stdint.h>
+
+/*
+ * A log-linear histogram in the style of HdrHistogram. Values below 128 are
+ * exact, larger values are kept in 64 buckets per power of two, so any
+ * reported percentile is within 1.6% of the recorded value.
+ */
+
+#define HISTOGRAM_SUB_BITS 6
+#define HISTOGRAM_MAX_LOG2 40
+#define HISTOGRAM_BUCKETS \
+  ((HISTOGRAM_MAX_LOG2 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+typedef struct Histogram
+{
+  uint64_t count;
+  uint64_t min;
+  uint64_t max;
+  double   total;
+  uint64_t buckets[HISTOGRAM_BUCKETS];
+}
+Histogram;
+
+void histogram_reset(Histogram * h);
+
+/* values of 2^HISTOGRAM_MAX_LOG2 and above are clamped */
+void histogram_record(Histogram * h, uint64_t value);
+
+/* the value at or below which `percentile` percent of the values fall */
+uint64_t histogram_percentile(const Histogram * h, double percentile);
+
+double histogram_mean(const Histogram * h);
+
+#endif
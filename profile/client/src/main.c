@@ -27,7 +27,16 @@
 #include "common/stringutils.h"
 #include "common/ivshmem.h"
 #include "common/util.h"
+#include "common/array.h"
+#include "common/framebuffer.h"
+#include "common/time.h"
 
+#include "histogram.h"
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/stat.h>
@@ -39,14 +48,84 @@
 
 #include <lgmp/client.h>
 
+/* how long to observe the timing publication tail after the frame data, as
+ * the client does */
+#define TIMING_SPIN_COUNT 1000
+
+enum Stage
+{
+  STAGE_INTERVAL,
+  STAGE_CAPTURE,
+  STAGE_POST_PROCESS,
+  STAGE_COPY,
+  STAGE_READY,
+  STAGE_HOLD,
+  STAGE_READY_LEAD,
+  STAGE_HOST_TOTAL,
+  STAGE_READ_WAIT,
+  STAGE_READ,
+  STAGE_READ_RATE,
+
+  STAGE_COUNT
+};
+
+static const struct
+{
+  const char * name;
+  const char * unit;
+}
+stages[STAGE_COUNT] =
+{
+  [STAGE_INTERVAL    ] = { "interval"   , "ns"   },
+  [STAGE_CAPTURE     ] = { "capture"    , "ns"   },
+  [STAGE_POST_PROCESS] = { "postProcess", "ns"   },
+  [STAGE_COPY        ] = { "copy"       , "ns"   },
+  [STAGE_READY       ] = { "ready"      , "ns"   },
+  [STAGE_HOLD        ] = { "hold"       , "ns"   },
+  [STAGE_READY_LEAD  ] = { "readyLead"  , "ns"   },
+  [STAGE_HOST_TOTAL  ] = { "hostTotal"  , "ns"   },
+  // time spent waiting for the host to finish writing the frame
+  [STAGE_READ_WAIT   ] = { "readWait"   , "ns"   },
+  // time spent copying the frame out of shared memory, excluding the wait
+  [STAGE_READ        ] = { "read"       , "ns"   },
+  [STAGE_READ_RATE   ] = { "readRate"   , "MB/s" },
+};
+
 struct state
 {
-  bool           running;
+  atomic_bool    running;
   struct IVSHMEM shmDev;
+
+  Histogram      stages[STAGE_COUNT];
+  uint64_t       frames;
+  uint64_t       timingValid;
+  uint64_t       compressed;
+  uint64_t       readBytes;
+  uint64_t       readTime;
 };
 
 struct state state;
 
+static bool optImportThreadsValidate(struct Option * opt, const char ** error)
+{
+  if (opt->value.x_int >= 0 && opt->value.x_int <= FB_MAX_READ_THREADS)
+    return true;
+
+  *error = "The number of threads must be between 0 and "
+    STR(FB_MAX_READ_THREADS);
+  return false;
+}
+
+static bool optFormatValidate(struct Option * opt, const char ** error)
+{
+  if (strcmp(opt->value.x_string, "json") == 0 ||
+      strcmp(opt->value.x_string, "csv" ) == 0)
+    return true;
+
+  *error = "The format must be json or csv";
+  return false;
+}
+
 static struct Option options[] =
 {
   {
@@ -57,9 +136,58 @@ static struct Option options[] =
     .type           = OPTION_TYPE_STRING,
     .value.x_string = NULL
   },
+  {
+    .module         = "app",
+    .name           = "importThreads",
+    .description    = "Number of threads used to copy large frames out of shared memory (0 or 1 to disable)",
+    .type           = OPTION_TYPE_INT,
+    .validator      = optImportThreadsValidate,
+    .value.x_int    = 0,
+  },
+  {
+    .module         = "app",
+    .name           = "importKernel",
+    .description    = "The kernel used to copy frames out of shared memory (memcpy, sse4_1, avx2, avx512 or auto)",
+    .type           = OPTION_TYPE_STRING,
+    .value.x_string = "memcpy",
+  },
+  {
+    .module         = "profile",
+    .name           = "duration",
+    .description    = "The number of seconds to profile for (0 to run until interrupted)",
+    .type           = OPTION_TYPE_INT,
+    .value.x_int    = 30,
+  },
+  {
+    .module         = "profile",
+    .name           = "format",
+    .description    = "The format of the results (json or csv)",
+    .type           = OPTION_TYPE_STRING,
+    .validator      = optFormatValidate,
+    .value.x_string = "json",
+  },
+  {
+    .module         = "profile",
+    .name           = "output",
+    .description    = "Write the results to this file instead of stdout",
+    .type           = OPTION_TYPE_STRING,
+    .value.x_string = NULL,
+  },
+  {
+    .module         = "profile",
+    .name           = "read",
+    .description    = "Copy every frame out of shared memory as a client does",
+    .type           = OPTION_TYPE_BOOL,
+    .value.x_bool   = true,
+  },
   {0}
 };
 
+static void sigHandler(int signo)
+{
+  atomic_store(&state.running, false);
+}
+
 static bool config_load(int argc, char * argv[])
 {
   // load any global options first
@@ -104,6 +232,155 @@ static bool config_load(int argc, char * argv[])
   return true;
 }
 
+static bool frameTimingReady(const KVMFRFrame * frame)
+{
+  return __atomic_load_n(&frame->timingValid, __ATOMIC_ACQUIRE) &&
+    frame->timingSerial == frame->frameSerial;
+}
+
+/* copy the frame out of shared memory as a client would */
+static bool readFrame(const LGMPMessage * msg, const KVMFRFrame * frame,
+    uint8_t ** buffer, size_t * bufferSize)
+{
+  const size_t size = (size_t)frame->dataHeight * frame->pitch;
+  if (frame->offset > msg->size - sizeof(FrameBuffer) ||
+      size > msg->size - frame->offset - sizeof(FrameBuffer))
+  {
+    DEBUG_ERROR("The frame contains invalid dimensions or offsets");
+    return false;
+  }
+
+  if (size > *bufferSize)
+  {
+    uint8_t * grown = realloc(*buffer, size);
+    if (!grown)
+    {
+      DEBUG_ERROR("out of memory");
+      return false;
+    }
+    *buffer     = grown;
+    *bufferSize = size;
+  }
+
+  const FrameBuffer * fb =
+    (const FrameBuffer *)((const uint8_t *)frame + frame->offset);
+
+  uint64_t waitTime = 0;
+  const uint64_t start = nanotime();
+  if (!framebuffer_read_timed(fb, *buffer, frame->pitch, frame->dataHeight,
+        frame->pitch, 1, frame->pitch, &waitTime))
+  {
+    DEBUG_ERROR("Failed to read the frame");
+    return false;
+  }
+
+  const uint64_t elapsed  = nanotime() - start;
+  const uint64_t readTime = elapsed > waitTime ? elapsed - waitTime : 1;
+
+  histogram_record(&state.stages[STAGE_READ_WAIT], waitTime);
+  histogram_record(&state.stages[STAGE_READ     ], readTime);
+  // bytes per nanosecond to MB/s
+  histogram_record(&state.stages[STAGE_READ_RATE], size * 1000 / readTime);
+  state.readBytes += size;
+  state.readTime  += readTime;
+  return true;
+}
+
+static void recordTiming(const KVMFRFrame * frame)
+{
+  /* the host publishes the timing just after the frame data, observe the tail
+   * briefly as the client does */
+  for(unsigned i = 0; !frameTimingReady(frame) && i < TIMING_SPIN_COUNT; ++i)
+  {
+  }
+
+  if (!frameTimingReady(frame))
+    return;
+
+  ++state.timingValid;
+  histogram_record(&state.stages[STAGE_CAPTURE     ], frame->captureTime    );
+  histogram_record(&state.stages[STAGE_POST_PROCESS], frame->postProcessTime);
+  histogram_record(&state.stages[STAGE_COPY        ], frame->copyTime       );
+  histogram_record(&state.stages[STAGE_READY       ], frame->readyTime      );
+  histogram_record(&state.stages[STAGE_HOLD        ], frame->holdTime       );
+  histogram_record(&state.stages[STAGE_READY_LEAD  ], frame->readyLeadTime  );
+  histogram_record(&state.stages[STAGE_HOST_TOTAL  ],
+      frame->captureTime + frame->postProcessTime + frame->copyTime +
+      frame->readyTime   + frame->holdTime);
+}
+
+static bool writeResults(uint64_t elapsed)
+{
+  static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+  static const char * percentileNames[] = { "p50", "p90", "p99", "p99.9" };
+
+  const char * path = option_get_string("profile", "output");
+  FILE * file = path ? fopen(path, "w") : stdout;
+  if (!file)
+  {
+    DEBUG_ERROR("Failed to open %s", path);
+    return false;
+  }
+
+  const double readRate = state.readTime ?
+    state.readBytes * 1000.0 / state.readTime : 0.0;
+
+  DEBUG_INFO("%" PRIu64 " frames in %.1fs, %" PRIu64 " with timing, "
+      "%" PRIu64 " compressed, read %.1f MB/s",
+      state.frames, elapsed / 1e9, state.timingValid, state.compressed,
+      readRate);
+
+  if (strcmp(option_get_string("profile", "format"), "json") == 0)
+  {
+    fprintf(file, "{\"duration\":%.3f,\"frames\":%" PRIu64 ","
+        "\"timingValid\":%" PRIu64 ",\"compressed\":%" PRIu64 ","
+        "\"readRate\":%.1f,\"stages\":{",
+        elapsed / 1e9, state.frames, state.timingValid, state.compressed,
+        readRate);
+
+    for(int i = 0; i < STAGE_COUNT; ++i)
+    {
+      const Histogram * h = &state.stages[i];
+      fprintf(file, "%s\"%s\":{\"unit\":\"%s\",\"count\":%" PRIu64 ","
+          "\"min\":%" PRIu64 ",\"mean\":%.1f",
+          i ? "," : "", stages[i].name, stages[i].unit, h->count, h->min,
+          histogram_mean(h));
+
+      for(int p = 0; p < ARRAY_LENGTH(percentiles); ++p)
+        fprintf(file, ",\"%s\":%" PRIu64, percentileNames[p],
+            histogram_percentile(h, percentiles[p]));
+
+      fprintf(file, ",\"max\":%" PRIu64 "}", h->max);
+    }
+
+    fputs("}}\n", file);
+  }
+  else
+  {
+    fputs("stage,unit,count,min,mean", file);
+    for(int p = 0; p < ARRAY_LENGTH(percentiles); ++p)
+      fprintf(file, ",%s", percentileNames[p]);
+    fputs(",max\n", file);
+
+    for(int i = 0; i < STAGE_COUNT; ++i)
+    {
+      const Histogram * h = &state.stages[i];
+      fprintf(file, "%s,%s,%" PRIu64 ",%" PRIu64 ",%.1f",
+          stages[i].name, stages[i].unit, h->count, h->min,
+          histogram_mean(h));
+
+      for(int p = 0; p < ARRAY_LENGTH(percentiles); ++p)
+        fprintf(file, ",%" PRIu64, histogram_percentile(h, percentiles[p]));
+
+      fprintf(file, ",%" PRIu64 "\n", h->max);
+    }
+  }
+
+  if (file != stdout)
+    fclose(file);
+  return true;
+}
+
 static int run(void)
 {
   PLGMPClient      lgmp;
@@ -137,21 +414,22 @@ static int run(void)
     return -1;
   }
 
-  struct perf
-  {
-    uint64_t min, max, ttl;
-    unsigned int count;
-  };
+  const int      duration = option_get_int ("profile", "duration");
+  const bool     read     = option_get_bool("profile", "read"    );
+  const uint64_t start    = nanotime();
+  const uint64_t end      = duration > 0 ?
+    start + (uint64_t)duration * 1000000000ULL : UINT64_MAX;
 
-  unsigned int frameCount    = 0;
-  uint64_t     lastFrameTime = 0;
-  struct perf  p1  = {};
-  struct perf  p5  = {};
-  struct perf  p10 = {};
-  struct perf  p30 = {};
+  uint8_t * buffer        = NULL;
+  size_t    bufferSize    = 0;
+  uint64_t  lastFrameTime = 0;
+  int       ret           = 0;
+
+  for(int i = 0; i < STAGE_COUNT; ++i)
+    histogram_reset(&state.stages[i]);
 
   // start accepting frames
-  while(state.running)
+  while(atomic_load(&state.running) && nanotime() < end)
   {
     LGMPMessage msg;
     if ((status = lgmpClientProcess(frameQueue, &msg)) != LGMP_OK)
@@ -160,53 +438,45 @@ static int run(void)
         continue;
 
       DEBUG_ERROR("lgmpClientProcess: %s", lgmpStatusString(status));
-      return -1;
+      ret = -1;
+      break;
     }
 
-    lgmpClientMessageDone(frameQueue);
-
-    uint64_t frameTime = nanotime();
-    uint64_t diff = frameTime - lastFrameTime;
+    const uint64_t frameTime = nanotime();
+    if (state.frames++)
+      histogram_record(&state.stages[STAGE_INTERVAL],
+          frameTime - lastFrameTime);
+    lastFrameTime = frameTime;
 
-    if (frameCount++ == 0)
+    // hold the message while the frame is used so the host can't reuse it
+    const KVMFRFrame * frame = (const KVMFRFrame *)msg.mem;
+    bool ok = true;
+    if (msg.size < sizeof(KVMFRFrame))
     {
-      lastFrameTime = frameTime;
-      p1.min = p5.min = p10.min = p30.min = diff;
-      continue;
-    }
-
-    ++p1 .count;
-    ++p5 .count;
-    ++p10.count;
-    ++p30.count;
-
-#define UPDATE(p, interval) \
-    if (p.ttl + diff >= (1e9 * interval)) \
-    { \
-      fprintf(stdout, "%02d, min:%9lu ns (%5.2f ms) max:%9lu ns (%5.2f ms) avg:%9lu ns (%5.2f ms)\n", \
-          interval, \
-          p.min          , ((float)p.min / 1e6f), \
-          p.max          , ((float)p.max / 1e6f), \
-          p.ttl / p.count, (((float)p.ttl / p.count) / 1e6f)\
-      ); \
-      p.min = p.max = p.ttl = diff; p.count = 1; \
-    } \
-    else \
-    { \
-      p.min = min(p.min, diff); \
-      p.max = max(p.max, diff); \
-      p.ttl += diff; \
+      DEBUG_ERROR("The frame message is too small");
+      ok = false;
     }
+    else if (frame->flags & FRAME_FLAG_COMPRESSED)
+      ++state.compressed;
+    else if (read)
+      ok = readFrame(&msg, frame, &buffer, &bufferSize);
 
-    UPDATE(p1 , 1 );
-    UPDATE(p5 , 5 );
-    UPDATE(p10, 10);
-    UPDATE(p30, 30);
+    if (ok)
+      recordTiming(frame);
 
-    lastFrameTime = frameTime;
+    lgmpClientMessageDone(frameQueue);
+    if (!ok)
+    {
+      ret = -1;
+      break;
+    }
   }
 
-  return 0;
+  free(buffer);
+  if (!writeResults(nanotime() - start))
+    ret = -1;
+
+  return ret;
 }
 
 int main(int argc, char * argv[])
@@ -225,14 +495,24 @@ int main(int argc, char * argv[])
     return -1;
   }
 
+  if (!framebuffer_set_read_threads(option_get_int("app", "importThreads")) ||
+      !framebuffer_set_read_kernel(option_get_string("app", "importKernel")))
+  {
+    option_free();
+    return -1;
+  }
+
   // init the global state vars
-  state.running = true;
+  atomic_store(&state.running, true);
+  signal(SIGINT , sigHandler);
+  signal(SIGTERM, sigHandler);
 
   int ret = -1;
   if (ivshmemOpen(&state.shmDev))
     ret = run();
 
   ivshmemClose(&state.shmDev);
+  framebuffer_set_read_threads(0);
   option_free();
   return ret;
 }